@@ -468,6 +468,14 @@ Status DirectSession::Run(const RunOptions& run_options,
     run_state.collector.reset(
         new StepStatsCollector(run_metadata->mutable_step_stats()));
     args.stats_collector = run_state.collector.get();
+  } else if (StepStatsCollector::SampleStep(
+                 options_.config.graph_options()
+                     .lightweight_trace_sample_rate())) {
+    // The records are converted when the collector is destroyed, along
+    // with run_state.
+    run_state.collector.reset(new StepStatsCollector(
+        run_metadata->mutable_step_stats(), true /* lightweight */));
+    args.stats_collector = run_state.collector.get();
   }
 
 #if GOOGLE_CUDA
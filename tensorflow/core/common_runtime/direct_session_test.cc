@@ -293,6 +293,40 @@ TEST_F(DirectSessionMinusAXTest, RunSimpleNetworkWithOpts) {
   EXPECT_EQ(run_metadata.step_stats().dev_stats_size(), 2);
 }
 
+TEST_F(DirectSessionMinusAXTest, RunSimpleNetworkWithLightweightTrace) {
+  Initialize({3, 2, -1, 0});
+  SessionOptions options;
+  (*options.config.mutable_device_count())["CPU"] = 2;
+  options.config.mutable_graph_options()->set_lightweight_trace_sample_rate(
+      1.0);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+
+  std::vector<Tensor> outputs;
+  RunMetadata run_metadata;
+  TF_ASSERT_OK(session->Run(RunOptions(), {}, {y_ + ":0"}, {y_neg_},
+                            &outputs, &run_metadata));
+  ASSERT_EQ(1, outputs.size());
+  EXPECT_FLOAT_EQ(5.0, outputs[0].matrix<float>()(0, 0));
+
+  // Every node is timed, but no memory or outputs are recorded.
+  ASSERT_EQ(run_metadata.step_stats().dev_stats_size(), 2);
+  int num_nodes = 0;
+  for (const DeviceStepStats& ds : run_metadata.step_stats().dev_stats()) {
+    for (const NodeExecStats& ns : ds.node_stats()) {
+      ++num_nodes;
+      EXPECT_FALSE(ns.node_name().empty());
+      EXPECT_GT(ns.all_start_micros(), 0);
+      EXPECT_LE(ns.op_start_rel_micros(), ns.op_end_rel_micros());
+      EXPECT_LE(ns.op_end_rel_micros(), ns.all_end_rel_micros());
+      EXPECT_EQ(0, ns.memory_size());
+      EXPECT_EQ(0, ns.output_size());
+    }
+  }
+  EXPECT_GT(num_nodes, 0);
+}
+
 TEST(DirectSessionTest, KeepsStateAcrossRunsOfSession) {
   GraphDef def;
   Graph g(OpRegistry::Global());
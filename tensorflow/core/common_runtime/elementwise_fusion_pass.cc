@@ -0,0 +1,191 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/optimization_registry.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/fused_elementwise_op_table.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns true if 'n' may become part of a fused chain.
+bool IsFusable(const Node* n) {
+  if (!n->IsOp() || LookupFusedElementwiseOp(n->type_string()) == nullptr) {
+    return false;
+  }
+  DataType dtype;
+  if (!GetNodeAttr(n->def(), "T", &dtype).ok()) return false;
+  if (dtype != DT_FLOAT && dtype != DT_DOUBLE) return false;
+  DeviceNameUtils::ParsedName parsed;
+  if (!DeviceNameUtils::ParseFullName(n->assigned_device_name(), &parsed) ||
+      parsed.type != DEVICE_CPU) {
+    return false;
+  }
+  return true;
+}
+
+// Returns the single data consumer of 'n' if 'n' can be folded into it:
+// 'n' has exactly one output edge, and the consumer is fusable on the same
+// device with the same type.  Control outputs are rejected because moving them
+// onto the fused node could create a cycle through the consumer's other input.
+Node* FusableConsumer(const Node* n) {
+  const Edge* out = nullptr;
+  for (const Edge* e : n->out_edges()) {
+    if (e->IsControlEdge() || out != nullptr) return nullptr;
+    out = e;
+  }
+  if (out == nullptr || out->src_output() != 0) return nullptr;
+  Node* dst = out->dst();
+  if (!IsFusable(dst) ||
+      dst->assigned_device_name() != n->assigned_device_name() ||
+      dst->def().attr().at("T").type() != n->def().attr().at("T").type()) {
+    return nullptr;
+  }
+  return dst;
+}
+
+// Collapses single-consumer chains of elementwise ops placed on the CPU,
+// e.g. Mul -> Add -> Sigmoid -> Mul, into one _FusedElementwise node.  Each
+// op of the chain otherwise materializes a full tensor, so the chain makes one
+// pass over memory per op; the fused kernel makes one pass in total.
+//
+// Runs after the JIT clustering passes so that nodes claimed by XLA are left
+// alone, and only when OptimizerOptions.do_elementwise_fusion is set.
+class ElementwiseFusionPass : public GraphOptimizationPass {
+ public:
+  Status Run(const GraphOptimizationPassOptions& options) override {
+    if (options.graph == nullptr || options.session_options == nullptr ||
+        !options.session_options->config.graph_options()
+             .optimizer_options()
+             .do_elementwise_fusion()) {
+      return Status::OK();
+    }
+    Graph* g = options.graph->get();
+    if (g == nullptr) {
+      return errors::Internal(
+          "Elementwise fusion should happen before partitioning and a graph "
+          "should be available.");
+    }
+
+    // Link each fusable node to its consumer.  A binary consumer may have two
+    // fusable producers; only the first one joins its chain.
+    std::unordered_map<const Node*, Node*> next;
+    std::unordered_set<const Node*> has_prev;
+    std::vector<Node*> order;
+    GetReversePostOrder(*g, &order);
+    for (Node* n : order) {
+      if (!IsFusable(n)) continue;
+      Node* consumer = FusableConsumer(n);
+      if (consumer == nullptr || has_prev.count(consumer) > 0) continue;
+      next[n] = consumer;
+      has_prev.insert(consumer);
+    }
+
+    for (Node* head : order) {
+      if (next.count(head) == 0 || has_prev.count(head) > 0) continue;
+      std::vector<Node*> chain = {head};
+      while (next.count(chain.back()) > 0) chain.push_back(next[chain.back()]);
+      TF_RETURN_IF_ERROR(FuseChain(g, chain));
+    }
+    return Status::OK();
+  }
+
+ private:
+  static Status FuseChain(Graph* g, const std::vector<Node*>& chain) {
+    std::vector<NodeBuilder::NodeOut> inputs;
+    std::vector<string> ops;
+    std::vector<int> operands;
+    std::vector<bool> swap;
+    std::unordered_set<Node*> control_inputs;
+    std::unordered_set<const Node*> members(chain.begin(), chain.end());
+
+    const Node* prev = nullptr;
+    for (Node* n : chain) {
+      const bool binary =
+          LookupFusedElementwiseOp(n->type_string())->arity == 2;
+      std::vector<const Edge*> data_in(n->num_inputs(), nullptr);
+      for (const Edge* e : n->in_edges()) {
+        if (e->IsControlEdge()) {
+          if (members.count(e->src()) == 0) control_inputs.insert(e->src());
+        } else {
+          data_in[e->dst_input()] = e;
+        }
+      }
+      // The head seeds the accumulator with its first input.
+      int acc_input = 0;
+      if (prev == nullptr) {
+        inputs.emplace_back(data_in[0]->src(), data_in[0]->src_output());
+      } else {
+        acc_input = data_in[0]->src() == prev ? 0 : 1;
+      }
+      ops.push_back(n->type_string());
+      if (binary) {
+        const Edge* other = data_in[1 - acc_input];
+        operands.push_back(inputs.size());
+        inputs.emplace_back(other->src(), other->src_output());
+        swap.push_back(acc_input == 1);
+      } else {
+        operands.push_back(-1);
+        swap.push_back(false);
+      }
+      prev = n;
+    }
+
+    Node* tail = chain.back();
+    std::vector<Node*> control_outputs;
+    std::vector<std::pair<Node*, int>> out_edges;
+    for (const Edge* e : tail->out_edges()) {
+      if (e->IsControlEdge()) {
+        control_outputs.push_back(e->dst());
+      } else {
+        out_edges.push_back({e->dst(), e->dst_input()});
+      }
+    }
+    const string name = tail->name();
+    const string device_name = tail->assigned_device_name();
+    const DataType dtype = tail->def().attr().at("T").type();
+
+    NodeBuilder builder(g->NewName(name + "/fused"), "_FusedElementwise");
+    builder.Input(inputs)
+        .Attr("T", dtype)
+        .Attr("ops", ops)
+        .Attr("operands", operands)
+        .Attr("swap", swap);
+    for (Node* c : control_inputs) builder.ControlInput(c);
+    Node* fused;
+    TF_RETURN_IF_ERROR(builder.Finalize(g, &fused));
+    fused->set_assigned_device_name(device_name);
+
+    for (Node* n : chain) g->RemoveNode(n);
+    for (Node* c : control_outputs) g->AddControlEdge(fused, c);
+    for (const std::pair<Node*, int>& p : out_edges) {
+      g->AddEdge(fused, 0, p.first, p.second);
+    }
+    return Status::OK();
+  }
+};
+REGISTER_OPTIMIZATION(OptimizationPassRegistry::POST_REWRITE_FOR_EXEC, 40,
+                      ElementwiseFusionPass);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,160 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/optimization_registry.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+const char* const kCpu = "/job:localhost/replica:0/task:0/cpu:0";
+
+class ElementwiseFusionPassTest : public ::testing::Test {
+ protected:
+  ElementwiseFusionPassTest() : graph_(new Graph(OpRegistry::Global())) {}
+
+  Node* Placeholder(const string& name) {
+    Node* n;
+    TF_CHECK_OK(NodeBuilder(name, "Placeholder")
+                    .Attr("dtype", DT_FLOAT)
+                    .Finalize(graph_.get(), &n));
+    n->set_assigned_device_name(kCpu);
+    return n;
+  }
+
+  Node* Unary(const string& name, const string& op, Node* x) {
+    Node* n;
+    TF_CHECK_OK(NodeBuilder(name, op).Input(x).Finalize(graph_.get(), &n));
+    n->set_assigned_device_name(kCpu);
+    return n;
+  }
+
+  Node* Binary(const string& name, const string& op, Node* x, Node* y) {
+    Node* n;
+    TF_CHECK_OK(
+        NodeBuilder(name, op).Input(x).Input(y).Finalize(graph_.get(), &n));
+    n->set_assigned_device_name(kCpu);
+    return n;
+  }
+
+  void RunPass(bool enabled) {
+    SessionOptions session_options;
+    session_options.config.mutable_graph_options()
+        ->mutable_optimizer_options()
+        ->set_do_elementwise_fusion(enabled);
+    GraphOptimizationPassOptions opts;
+    opts.graph = &graph_;
+    opts.session_options = &session_options;
+    TF_ASSERT_OK(OptimizationPassRegistry::Global()->RunGrouping(
+        OptimizationPassRegistry::POST_REWRITE_FOR_EXEC, opts));
+  }
+
+  std::vector<const Node*> NodesOfType(const string& type) {
+    std::vector<const Node*> nodes;
+    for (const Node* n : graph_->nodes()) {
+      if (n->type_string() == type) nodes.push_back(n);
+    }
+    return nodes;
+  }
+
+  std::unique_ptr<Graph> graph_;
+};
+
+TEST_F(ElementwiseFusionPassTest, FusesChain) {
+  Node* x = Placeholder("x");
+  Node* y = Placeholder("y");
+  Node* z = Placeholder("z");
+  Node* mul = Binary("mul", "Mul", x, y);
+  Node* add = Binary("add", "Add", z, mul);
+  Node* sigmoid = Unary("sigmoid", "Sigmoid", add);
+  Node* out = Binary("out", "Mul", sigmoid, y);
+  Node* consumer = Unary("consumer", "Identity", out);
+  RunPass(true);
+
+  std::vector<const Node*> fused = NodesOfType("_FusedElementwise");
+  ASSERT_EQ(fused.size(), 1);
+  EXPECT_EQ(fused[0]->assigned_device_name(), kCpu);
+  EXPECT_TRUE(NodesOfType("Mul").empty());
+  EXPECT_TRUE(NodesOfType("Add").empty());
+  EXPECT_TRUE(NodesOfType("Sigmoid").empty());
+
+  std::vector<string> ops;
+  std::vector<int> operands;
+  std::vector<bool> swap;
+  TF_ASSERT_OK(GetNodeAttr(fused[0]->def(), "ops", &ops));
+  TF_ASSERT_OK(GetNodeAttr(fused[0]->def(), "operands", &operands));
+  TF_ASSERT_OK(GetNodeAttr(fused[0]->def(), "swap", &swap));
+  EXPECT_EQ(ops, std::vector<string>({"Mul", "Add", "Sigmoid", "Mul"}));
+  EXPECT_EQ(operands, std::vector<int>({1, 2, -1, 3}));
+  EXPECT_EQ(swap, std::vector<bool>({false, true, false, false}));
+
+  ASSERT_EQ(fused[0]->num_inputs(), 4);
+  const Node* in;
+  TF_ASSERT_OK(fused[0]->input_node(0, &in));
+  EXPECT_EQ(in, x);
+  TF_ASSERT_OK(fused[0]->input_node(2, &in));
+  EXPECT_EQ(in, z);
+  TF_ASSERT_OK(consumer->input_node(0, &in));
+  EXPECT_EQ(in, fused[0]);
+}
+
+TEST_F(ElementwiseFusionPassTest, DisabledByDefault) {
+  Node* x = Placeholder("x");
+  Node* y = Placeholder("y");
+  Unary("exp", "Exp", Binary("add", "Add", x, y));
+  RunPass(false);
+  EXPECT_TRUE(NodesOfType("_FusedElementwise").empty());
+  EXPECT_EQ(NodesOfType("Add").size(), 1);
+}
+
+TEST_F(ElementwiseFusionPassTest, StopsAtSharedValues) {
+  Node* x = Placeholder("x");
+  Node* y = Placeholder("y");
+  // 'add' has two consumers, so it must stay materialized.
+  Node* add = Binary("add", "Add", x, y);
+  Unary("exp", "Exp", add);
+  Unary("tanh", "Tanh", Unary("log", "Log", add));
+  RunPass(true);
+
+  EXPECT_EQ(NodesOfType("Add").size(), 1);
+  EXPECT_EQ(NodesOfType("Exp").size(), 1);
+  std::vector<const Node*> fused = NodesOfType("_FusedElementwise");
+  ASSERT_EQ(fused.size(), 1);
+  std::vector<string> ops;
+  TF_ASSERT_OK(GetNodeAttr(fused[0]->def(), "ops", &ops));
+  EXPECT_EQ(ops, std::vector<string>({"Log", "Tanh"}));
+  const Node* in;
+  TF_ASSERT_OK(fused[0]->input_node(0, &in));
+  EXPECT_EQ(in, add);
+}
+
+TEST_F(ElementwiseFusionPassTest, SkipsNonCpuNodes) {
+  Node* x = Placeholder("x");
+  Node* y = Placeholder("y");
+  Node* add = Binary("add", "Add", x, y);
+  add->set_assigned_device_name("/job:localhost/replica:0/task:0/gpu:0");
+  Unary("exp", "Exp", add);
+  RunPass(true);
+  EXPECT_TRUE(NodesOfType("_FusedElementwise").empty());
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -23,6 +23,7 @@ limitations under the License.
 #include <vector>
 
 #include "tensorflow/core/common_runtime/costmodel_manager.h"
+#include "tensorflow/core/common_runtime/op_metrics.h"
 #include "tensorflow/core/common_runtime/pending_counts.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/framework/allocation_description.pb.h"
@@ -212,6 +213,9 @@ struct NodeItem {
   // The kernel for this node.
   OpKernel* kernel = nullptr;
 
+  // The metrics of the op type of this node on the executor's device.
+  OpMetrics* metrics = nullptr;
+
   bool kernel_is_expensive : 1;  // True iff kernel->IsExpensive()
   bool kernel_is_async : 1;      // True iff kernel->AsAsync() != nullptr
   bool is_merge : 1;             // True iff IsMerge(node)
@@ -645,6 +649,7 @@ Status ExecutorImpl::Initialize() {
       return s;
     }
     CHECK(item->kernel);
+    item->metrics = OpMetrics::Get(n->type_string(), params_.device->name());
     item->kernel_is_expensive = item->kernel->IsExpensive();
     item->kernel_is_async = (item->kernel->AsAsync() != nullptr);
     item->is_merge = IsMerge(n);
@@ -1177,6 +1182,9 @@ class ExecutorState {
   // Step-local container.
   ScopedStepContainer* step_container_;
   StepStatsCollector* stats_collector_;
+  // True if stats_collector_ is lightweight, in which case the scheduled
+  // times passed to Process() are in StepStatsCollector::NowTicks() units.
+  const bool record_node_times_;
   // QUESTION: Make it a checkpoint::TensorSliceReaderCacheWrapper
   // instead of a pointer?  (avoids having to delete).
   checkpoint::TensorSliceReaderCacheWrapper* slice_reader_cache_;
@@ -1239,9 +1247,11 @@ class ExecutorState {
                        AllocatorAttributeVec* input_alloc_attrs,
                        bool* is_input_dead);
 
-  // After item->kernel computation is done, processes its outputs.
+  // After item->kernel computation is done, processes its outputs, and
+  // adds the bytes of those that it counts in OpMetrics to *output_bytes.
   Status ProcessOutputs(const NodeItem& item, OpKernelContext* ctx,
-                        EntryVector* outputs, NodeExecStats* stats);
+                        EntryVector* outputs, NodeExecStats* stats,
+                        int64* output_bytes);
 
   // After processing the outputs, propagates the outputs to their dsts.
   // Contents of *outputs are left in an indeterminate state after
@@ -1254,6 +1264,17 @@ class ExecutorState {
   bool NodeDone(const Status& s, const Node* node, const TaggedNodeSeq& ready,
                 NodeExecStats* stats, TaggedNodeReadyQueue* inline_ready);
 
+  // Sets the end of "times", at which "node" ran, and hands them to the
+  // lightweight stats collector.
+  void RecordNodeTimes(const Node* node, StepStatsCollector::NodeTimes* times);
+
+  // Returns the current time in the units of the scheduled times passed to
+  // Process().
+  int64 ScheduledNow() const {
+    return record_node_times_ ? StepStatsCollector::NowTicks()
+                              : nodestats::NowInUsec();
+  }
+
   // Schedule all the expensive nodes in 'ready', and put all the inexpensive
   // nodes in 'ready' into 'inline_ready'.
   void ScheduleReady(const TaggedNodeSeq& ready,
@@ -1297,6 +1318,8 @@ ExecutorState::ExecutorState(const Executor::Args& args, ExecutorImpl* impl)
       tensor_store_(args.tensor_store),
       step_container_(args.step_container),
       stats_collector_(args.stats_collector),
+      record_node_times_(args.stats_collector != nullptr &&
+                         args.stats_collector->lightweight()),
       slice_reader_cache_(new checkpoint::TensorSliceReaderCacheWrapper),
       call_frame_(args.call_frame),
       impl_(impl),
@@ -1447,7 +1470,8 @@ void ExecutorState::RunAsync(Executor::DoneCallback done) {
 // sync kernels because these vectors are kept on the stack.
 struct ExecutorState::AsyncState {
   AsyncState(const OpKernelContext::Params& p, const TaggedNode& _tagged_node,
-             const NodeItem* _item, Entry* _first_input, NodeExecStats* _stats)
+             const NodeItem* _item, Entry* _first_input, NodeExecStats* _stats,
+             bool _record_times, const StepStatsCollector::NodeTimes& _times)
       : saved_inputs(*p.inputs),
         saved_input_device_contexts(*p.input_device_contexts),
         saved_input_alloc_attrs(*p.input_alloc_attrs),
@@ -1458,7 +1482,9 @@ struct ExecutorState::AsyncState {
         // ParamsButClearingEigenGPUDevice does equivalent of
         //   params.eigen_gpu_device = nullptr;
         ctx(ParamsButClearingEigenGPUDevice(&params), item->num_outputs),
-        stats(_stats) {
+        stats(_stats),
+        record_times(_record_times),
+        times(_times) {
     params.inputs = &saved_inputs;
     params.input_device_contexts = &saved_input_device_contexts;
     params.input_alloc_attrs = &saved_input_alloc_attrs;
@@ -1473,6 +1499,10 @@ struct ExecutorState::AsyncState {
   Entry* first_input;
   OpKernelContext ctx;
   NodeExecStats* stats;
+  bool record_times;
+  StepStatsCollector::NodeTimes times;
+  // When the kernel started to compute, for OpMetrics.
+  int64 start_micros = 0;
 
  private:
   OpKernelContext::Params* ParamsButClearingEigenGPUDevice(
@@ -1516,6 +1546,9 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
 
   Status s;
   NodeExecStats* stats = nullptr;
+  // Used instead of "stats" by a lightweight stats collector.
+  bool record_times = false;
+  StepStatsCollector::NodeTimes times;
   EntryVector outputs;
   bool completed = false;
   inline_ready.push_back(tagged_node);
@@ -1542,7 +1575,15 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
 
     params.track_allocations = false;
     stats = nullptr;
-    if (stats_collector_ && !tagged_node.is_dead) {
+    record_times = false;
+    if (record_node_times_) {
+      // Transfer nodes are not recorded.
+      if (!tagged_node.is_dead && !IsTransferNode(node)) {
+        record_times = true;
+        times.scheduled = scheduled_usec;
+        times.all_start = StepStatsCollector::NowTicks();
+      }
+    } else if (stats_collector_ && !tagged_node.is_dead) {
       // track allocations if and only if we are collecting statistics
       params.track_allocations = true;
       stats = new NodeExecStats;
@@ -1581,6 +1622,7 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
           (first_input + i)->ClearVal();
         }
         MaybeMarkCompleted(input_frame, input_iter, id);
+        if (record_times) RecordNodeTimes(node, &times);
         // Continue to process the nodes in 'inline_ready'.
         completed = NodeDone(s, item.node, ready, stats, &inline_ready);
         continue;
@@ -1598,8 +1640,11 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
         AsyncOpKernel* async = item.kernel->AsAsync();
         DCHECK(async != nullptr);
         launched_asynchronously = true;
-        AsyncState* state =
-            new AsyncState(params, tagged_node, &item, first_input, stats);
+        if (record_times) times.op_start = StepStatsCollector::NowTicks();
+        AsyncState* state = new AsyncState(params, tagged_node, &item,
+                                           first_input, stats, record_times,
+                                           times);
+        state->start_micros = nodestats::NowInUsec();
 
         auto done = [this, state]() {
           Device* device = impl_->params_.device;
@@ -1610,9 +1655,17 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
             VLOG(2) << this << " Async kernel done: "
                     << SummarizeNodeDef(state->item->node->def());
           }
+          const int64 end_micros = nodestats::NowInUsec();
           if (stats) nodestats::SetOpEnd(stats);
+          if (state->record_times) {
+            state->times.op_end = StepStatsCollector::NowTicks();
+          }
           EntryVector outputs;
-          Status s = ProcessOutputs(*state->item, &state->ctx, &outputs, stats);
+          int64 output_bytes = 0;
+          Status s = ProcessOutputs(*state->item, &state->ctx, &outputs, stats,
+                                    &output_bytes);
+          state->item->metrics->Record(state->start_micros, end_micros,
+                                       output_bytes);
           if (stats) nodestats::SetMemory(stats, &state->ctx);
           // Clears inputs.
           const int num_inputs = state->item->num_inputs;
@@ -1637,6 +1690,9 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
             device->ConsumeListOfAccessedTensors(state->ctx.op_device_context(),
                                                  accessed);
           }
+          if (state->record_times) {
+            RecordNodeTimes(state->item->node, &state->times);
+          }
           bool completed =
               NodeDone(s, state->item->node, ready, stats, nullptr);
           delete state;
@@ -1648,10 +1704,16 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
         // Synchronous computes.
         OpKernelContext ctx(&params, item.num_outputs);
         if (stats) nodestats::SetOpStart(stats);
+        if (record_times) times.op_start = StepStatsCollector::NowTicks();
+        const int64 start_micros = nodestats::NowInUsec();
         device->Compute(CHECK_NOTNULL(op_kernel), &ctx);
+        const int64 end_micros = nodestats::NowInUsec();
         if (stats) nodestats::SetOpEnd(stats);
+        if (record_times) times.op_end = StepStatsCollector::NowTicks();
 
-        s = ProcessOutputs(item, &ctx, &outputs, stats);
+        int64 output_bytes = 0;
+        s = ProcessOutputs(item, &ctx, &outputs, stats, &output_bytes);
+        item.metrics->Record(start_micros, end_micros, output_bytes);
         if (s.ok() && impl_->device_record_tensor_accesses_) {
           // Get the list of all tensors accessed during the execution
           ctx.retrieve_accessed_tensors(&accessed_tensors);
@@ -1681,6 +1743,10 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
       if (stats) {
         scheduled_usec = nodestats::NowInUsec();
       }
+      if (record_times) {
+        RecordNodeTimes(node, &times);
+        scheduled_usec = times.all_end;
+      }
       // Postprocess.
       completed = NodeDone(s, item.node, ready, stats, &inline_ready);
     }
@@ -1767,8 +1833,8 @@ Status ExecutorState::PrepareInputs(const NodeItem& item, Entry* first_input,
 }
 
 Status ExecutorState::ProcessOutputs(const NodeItem& item, OpKernelContext* ctx,
-                                     EntryVector* outputs,
-                                     NodeExecStats* stats) {
+                                     EntryVector* outputs, NodeExecStats* stats,
+                                     int64* output_bytes) {
   const Node* node = item.node;
   DCHECK_EQ(0, outputs->size());
   outputs->resize(item.num_outputs);
@@ -1849,6 +1915,9 @@ Status ExecutorState::ProcessOutputs(const NodeItem& item, OpKernelContext* ctx,
           // NOTE that std::move is used here, so val.tensor goes to
           // uninitialized state (val.tensor->IsInitialized return false).
           DCHECK(!out->val_field_is_set);
+          if (DataTypeCanUseMemcpy(dtype) && val->IsInitialized()) {
+            *output_bytes += val->TotalBytes();
+          }
           out->has_value = true;
           out->val_field_is_set = true;
           out->val.Init(std::move(*val.tensor));
@@ -1985,6 +2054,13 @@ void ExecutorState::PropagateOutputs(const TaggedNode& tagged_node,
   }
 }
 
+void ExecutorState::RecordNodeTimes(const Node* node,
+                                    StepStatsCollector::NodeTimes* times) {
+  times->all_end = StepStatsCollector::NowTicks();
+  stats_collector_->RecordNodeTimes(&impl_->params_.device->name(), node,
+                                    *times);
+}
+
 bool ExecutorState::NodeDone(const Status& s, const Node* node,
                              const TaggedNodeSeq& ready, NodeExecStats* stats,
                              TaggedNodeReadyQueue* inline_ready) {
@@ -2038,7 +2114,7 @@ void ExecutorState::ScheduleReady(const TaggedNodeSeq& ready,
 
   int64 scheduled_usec = 0;
   if (stats_collector_) {
-    scheduled_usec = nodestats::NowInUsec();
+    scheduled_usec = ScheduledNow();
   }
   if (inline_ready == nullptr) {
     // Schedule to run all the ready ops in thread pool.
@@ -0,0 +1,202 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/op_metrics.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+#include <utility>
+
+#include "tensorflow/core/lib/gtl/array_slice.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/platform.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+#ifndef IS_MOBILE_PLATFORM
+#include "tensorflow/core/lib/monitoring/collection_registry.h"
+#include "tensorflow/core/lib/monitoring/metric_def.h"
+#endif
+
+namespace tensorflow {
+
+namespace {
+
+auto* op_latency = monitoring::Sampler<2>::New(
+    {"/tensorflow/core/op_latency_usecs",
+     "The time that the kernels of an op type took to compute on a device, "
+     "in microseconds.",
+     "op", "device"},
+    {1, 3, 10, 30, 100, 300, 1000, 3000, 10000, 30000, 100000, 300000,
+     1000000, 3000000, 10000000});
+
+auto* op_output_bytes = monitoring::Counter<2>::New(
+    "/tensorflow/core/op_output_bytes",
+    "The bytes of the tensors, other than references and strings, that the "
+    "kernels of an op type output on a device.",
+    "op", "device");
+
+// The number of samples that a thread buffers.
+const int kBufferSize = 256;
+
+// How long a thread that keeps recording samples may buffer them.
+const int64 kFlushIntervalMicros = 1000 * 1000;
+
+}  // namespace
+
+// The samples of one thread that have not been added to the shared metrics
+// yet. Every buffer is registered, so that collecting the metrics can flush
+// them all; its mutex is only contended while that happens.
+class OpMetricsBuffer {
+ public:
+  OpMetricsBuffer() {
+    mutex_lock l(*all_buffers_mu());
+    all_buffers()->insert(this);
+  }
+
+  ~OpMetricsBuffer() {
+    {
+      mutex_lock l(*all_buffers_mu());
+      all_buffers()->erase(this);
+    }
+    mutex_lock l(mu_);
+    Flush();
+  }
+
+  void Add(OpMetrics* metrics, int64 start_micros, int64 end_micros,
+           int64 output_bytes) {
+    mutex_lock l(mu_);
+    if (size_ == 0) oldest_micros_ = end_micros;
+    const double latency_micros = end_micros - start_micros;
+    samples_[size_++] = {metrics, latency_micros, output_bytes};
+    if (size_ == kBufferSize ||
+        end_micros - oldest_micros_ >= kFlushIntervalMicros) {
+      Flush();
+    }
+  }
+
+  // Flushes the buffer of every thread, and returns the number of samples
+  // that they held.
+  static int64 FlushAll() {
+    mutex_lock l(*all_buffers_mu());
+    int64 num_samples = 0;
+    for (OpMetricsBuffer* buffer : *all_buffers()) {
+      mutex_lock buffer_lock(buffer->mu_);
+      num_samples += buffer->size_;
+      buffer->Flush();
+    }
+    return num_samples;
+  }
+
+ private:
+  static mutex* all_buffers_mu() {
+    static mutex* mu = new mutex;
+    return mu;
+  }
+
+  static std::set<OpMetricsBuffer*>* all_buffers() {
+    static std::set<OpMetricsBuffer*>* buffers =
+        new std::set<OpMetricsBuffer*>;
+    return buffers;
+  }
+
+  struct Sample {
+    OpMetrics* metrics;
+    double latency_micros;
+    int64 output_bytes;
+  };
+
+  // Adds the samples of each op type and device with a single update of
+  // its metrics.
+  void Flush() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    std::sort(samples_, samples_ + size_,
+              [](const Sample& a, const Sample& b) {
+                return std::less<OpMetrics*>()(a.metrics, b.metrics);
+              });
+    double latencies[kBufferSize];
+    int i = 0;
+    while (i < size_) {
+      OpMetrics* metrics = samples_[i].metrics;
+      int num_latencies = 0;
+      int64 output_bytes = 0;
+      for (; i < size_ && samples_[i].metrics == metrics; ++i) {
+        latencies[num_latencies++] = samples_[i].latency_micros;
+        output_bytes += samples_[i].output_bytes;
+      }
+      metrics->latency_->AddN(
+          gtl::ArraySlice<double>(latencies, num_latencies));
+      if (output_bytes > 0) metrics->output_bytes_->IncrementBy(output_bytes);
+    }
+    size_ = 0;
+  }
+
+  mutex mu_;
+  Sample samples_[kBufferSize] GUARDED_BY(mu_);
+  int size_ GUARDED_BY(mu_) = 0;
+  // The end of the oldest sample in the buffer, if any.
+  int64 oldest_micros_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(OpMetricsBuffer);
+};
+
+#ifndef IS_MOBILE_PLATFORM
+namespace {
+
+// The registry collects metrics in the order of their names, so this one is
+// collected, and flushes the buffers of all threads, before the metrics
+// above. Even a thread that has gone idle is then fully accounted for.
+const monitoring::MetricDef<monitoring::MetricKind::kGauge, int64, 0>*
+    buffered_samples = new monitoring::MetricDef<
+        monitoring::MetricKind::kGauge, int64, 0>(
+        "/tensorflow/core/op_buffered_samples",
+        "The number of op samples that threads still buffered when the "
+        "metrics were collected.");
+
+auto* buffered_samples_registration =
+    monitoring::CollectionRegistry::Default()
+        ->Register(buffered_samples,
+                   [](monitoring::MetricCollectorGetter getter) {
+                     const int64 num_samples = OpMetricsBuffer::FlushAll();
+                     getter.Get(buffered_samples).CollectValue({}, num_samples);
+                   })
+        .release();
+
+}  // namespace
+#endif
+
+/* static */
+OpMetrics* OpMetrics::Get(const string& op, const string& device) {
+  static mutex* mu = new mutex;
+  static std::map<std::pair<string, string>, OpMetrics*>* all_metrics =
+      new std::map<std::pair<string, string>, OpMetrics*>;
+  mutex_lock l(*mu);
+  OpMetrics*& metrics = (*all_metrics)[std::make_pair(op, device)];
+  if (metrics == nullptr) {
+    metrics = new OpMetrics(op_latency->GetCell(op, device),
+                            op_output_bytes->GetCell(op, device));
+  }
+  return metrics;
+}
+
+void OpMetrics::Record(int64 start_micros, int64 end_micros,
+                       int64 output_bytes) {
+#ifndef IS_MOBILE_PLATFORM
+  static thread_local OpMetricsBuffer buffer;
+  buffer.Add(this, start_micros, end_micros, output_bytes);
+#endif
+}
+
+}  // namespace tensorflow
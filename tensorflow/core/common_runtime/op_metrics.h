@@ -0,0 +1,65 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef THIRD_PARTY_TENSORFLOW_CORE_COMMON_RUNTIME_OP_METRICS_H_
+#define THIRD_PARTY_TENSORFLOW_CORE_COMMON_RUNTIME_OP_METRICS_H_
+
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// The metrics that executors keep of every op that they run, by op type and
+// device, in the monitoring CollectionRegistry:
+//
+//   /tensorflow/core/op_latency_usecs: the time that the kernels took to
+//     compute, as a histogram.
+//   /tensorflow/core/op_output_bytes: the bytes of the tensors that the
+//     kernels output, other than references and strings.
+//
+// Each thread keeps the samples that it records in a buffer of its own,
+// and adds them to the shared metrics in batches: once the buffer is full,
+// when it records a sample a second or more after the oldest one in the
+// buffer, and whenever the metrics are collected. The collected metrics
+// therefore include every sample recorded before the collection, even by a
+// thread that has since gone idle.
+class OpMetrics {
+ public:
+  // Returns the metrics of the ops of type "op" run on "device", which are
+  // never freed.
+  static OpMetrics* Get(const string& op, const string& device);
+
+  // Records that an op of this type ran from "start_micros" to "end_micros"
+  // and output "output_bytes" bytes.
+  void Record(int64 start_micros, int64 end_micros, int64 output_bytes);
+
+ private:
+  friend class OpMetricsBuffer;
+
+  OpMetrics(monitoring::SamplerCell* latency,
+            monitoring::CounterCell* output_bytes)
+      : latency_(latency), output_bytes_(output_bytes) {}
+
+  monitoring::SamplerCell* const latency_;
+  monitoring::CounterCell* const output_bytes_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(OpMetrics);
+};
+
+}  // namespace tensorflow
+
+#endif  // THIRD_PARTY_TENSORFLOW_CORE_COMMON_RUNTIME_OP_METRICS_H_
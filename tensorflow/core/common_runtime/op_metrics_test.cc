@@ -0,0 +1,111 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/op_metrics.h"
+
+#include <memory>
+
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/monitoring/collection_registry.h"
+#include "tensorflow/core/lib/monitoring/text_exporter.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns the point of "metric_name" for "op" on "device", or nullptr.
+const monitoring::Point* FindPoint(const monitoring::CollectedMetrics& metrics,
+                                   const string& metric_name, const string& op,
+                                   const string& device) {
+  auto it = metrics.point_set_map.find(metric_name);
+  if (it == metrics.point_set_map.end()) return nullptr;
+  for (const auto& point : it->second->points) {
+    if (point->labels.size() == 2 && point->labels[0].value == op &&
+        point->labels[1].value == device) {
+      return point.get();
+    }
+  }
+  return nullptr;
+}
+
+TEST(OpMetricsTest, Get) {
+  OpMetrics* metrics = OpMetrics::Get("TestOp", "/device:CPU:0");
+  EXPECT_EQ(metrics, OpMetrics::Get("TestOp", "/device:CPU:0"));
+  EXPECT_NE(metrics, OpMetrics::Get("TestOp", "/device:CPU:1"));
+  EXPECT_NE(metrics, OpMetrics::Get("OtherTestOp", "/device:CPU:0"));
+}
+
+TEST(OpMetricsTest, RecordAndExport) {
+  OpMetrics* metrics = OpMetrics::Get("RecordedOp", "/device:CPU:0");
+  // More samples than the buffer of this thread holds, so that some are
+  // flushed as they are recorded and the rest when they are collected.
+  const int kNumSamples = 1000;
+  for (int i = 0; i < kNumSamples; ++i) {
+    metrics->Record(100, 110, 4);
+  }
+
+  std::unique_ptr<monitoring::CollectedMetrics> collected =
+      monitoring::CollectionRegistry::Default()->CollectMetrics({});
+  const monitoring::Point* latency =
+      FindPoint(*collected, "/tensorflow/core/op_latency_usecs", "RecordedOp",
+                "/device:CPU:0");
+  ASSERT_NE(nullptr, latency);
+  EXPECT_EQ(kNumSamples, latency->histogram_value.num());
+  EXPECT_EQ(10 * kNumSamples, latency->histogram_value.sum());
+
+  const monitoring::Point* output_bytes =
+      FindPoint(*collected, "/tensorflow/core/op_output_bytes", "RecordedOp",
+                "/device:CPU:0");
+  ASSERT_NE(nullptr, output_bytes);
+  EXPECT_EQ(4 * kNumSamples, output_bytes->int64_value);
+
+  const string text = monitoring::ExportMetricsAsText(*collected);
+  EXPECT_NE(string::npos,
+            text.find("tensorflow_core_op_latency_usecs_count"
+                      "{op=\"RecordedOp\",device=\"/device:CPU:0\"}"));
+}
+
+TEST(OpMetricsTest, CollectFlushesIdleThreads) {
+  // A thread records a single sample and then waits, without recording
+  // any other sample that would flush its buffer.
+  Notification recorded;
+  Notification collected;
+  std::unique_ptr<Thread> thread(Env::Default()->StartThread(
+      ThreadOptions(), "op_metrics_test", [&recorded, &collected]() {
+        OpMetrics::Get("IdleThreadOp", "/device:CPU:0")->Record(100, 130, 8);
+        recorded.Notify();
+        collected.WaitForNotification();
+      }));
+  recorded.WaitForNotification();
+
+  std::unique_ptr<monitoring::CollectedMetrics> collected_metrics =
+      monitoring::CollectionRegistry::Default()->CollectMetrics({});
+  collected.Notify();
+  const monitoring::Point* latency =
+      FindPoint(*collected_metrics, "/tensorflow/core/op_latency_usecs",
+                "IdleThreadOp", "/device:CPU:0");
+  ASSERT_NE(nullptr, latency);
+  EXPECT_EQ(1, latency->histogram_value.num());
+  EXPECT_EQ(30, latency->histogram_value.sum());
+  const monitoring::Point* output_bytes =
+      FindPoint(*collected_metrics, "/tensorflow/core/op_output_bytes",
+                "IdleThreadOp", "/device:CPU:0");
+  ASSERT_NE(nullptr, output_bytes);
+  EXPECT_EQ(8, output_bytes->int64_value);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -17,13 +17,145 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/costmodel_manager.h"
 #include "tensorflow/core/framework/step_stats.pb.h"
 #include "tensorflow/core/graph/costmodel.h"
+#include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/strings/scanner.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/profile_utils/cpu_utils.h"
 
 namespace tensorflow {
 
-StepStatsCollector::StepStatsCollector(StepStats* ss) : step_stats_(ss) {}
+namespace {
+
+// The number of microseconds per tick of NowTicks(), or 0 if the ticks
+// are microseconds.
+double MicrosPerTick() {
+  static const double micros_per_tick =
+      profile_utils::CpuUtils::GetCycleCounterFrequency() > 0
+          ? profile_utils::CpuUtils::GetMicroSecPerClock()
+          : 0.0;
+  return micros_per_tick;
+}
+
+}  // namespace
+
+StepStatsCollector::StepStatsCollector(StepStats* ss)
+    : StepStatsCollector(ss, false /* lightweight */) {}
+
+StepStatsCollector::StepStatsCollector(StepStats* ss, bool lightweight)
+    : step_stats_(ss),
+      lightweight_(lightweight),
+      base_micros_(Env::Default()->NowMicros()),
+      base_ticks_(lightweight ? NowTicks() : 0) {
+  if (lightweight_) {
+    const uint64 num_blocks = kMaxCollectedNodes / kRecordsPerBlock;
+    blocks_.reset(new std::atomic<RecordBlock*>[num_blocks]);
+    for (uint64 i = 0; i < num_blocks; ++i) {
+      blocks_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+}
+
+StepStatsCollector::~StepStatsCollector() {
+  if (lightweight_) {
+    mutex_lock l(mu_);
+    FinalizeLocked();
+  }
+}
+
+/* static */
+uint64 StepStatsCollector::NowTicks() {
+  if (MicrosPerTick() > 0) {
+    return profile_utils::CpuUtils::GetCurrentClockCycle();
+  }
+  return Env::Default()->NowMicros();
+}
+
+/* static */
+bool StepStatsCollector::SampleStep(float sample_rate) {
+  if (sample_rate <= 0) return false;
+  if (sample_rate >= 1) return true;
+  return random::New64() < sample_rate * static_cast<double>(kuint64max);
+}
+
+void StepStatsCollector::RecordNodeTimes(const string* device,
+                                         const Node* node,
+                                         const NodeTimes& times) {
+  DCHECK(lightweight_);
+  const uint64 index = num_records_.fetch_add(1, std::memory_order_relaxed);
+  if (index >= kMaxCollectedNodes) return;
+  std::atomic<RecordBlock*>* slot = &blocks_[index / kRecordsPerBlock];
+  RecordBlock* block = slot->load(std::memory_order_acquire);
+  if (block == nullptr) {
+    RecordBlock* new_block = new RecordBlock;
+    if (slot->compare_exchange_strong(block, new_block,
+                                      std::memory_order_acq_rel)) {
+      block = new_block;
+    } else {
+      // Another thread installed the block first.
+      delete new_block;
+    }
+  }
+  NodeRecord* record = &block->records[index % kRecordsPerBlock];
+  record->device = device;
+  record->node = node;
+  record->times = times;
+}
+
+void StepStatsCollector::Finalize() {
+  mutex_lock l(mu_);
+  FinalizeLocked();
+}
+
+void StepStatsCollector::FinalizeLocked() {
+  if (!lightweight_) return;
+  const uint64 num_records =
+      std::min(num_records_.exchange(0, std::memory_order_acquire),
+               kMaxCollectedNodes);
+  const double micros_per_tick = MicrosPerTick();
+  auto to_micros = [this, micros_per_tick](uint64 ticks) -> int64 {
+    const int64 delta = static_cast<int64>(ticks - base_ticks_);
+    return base_micros_ + (micros_per_tick > 0
+                               ? static_cast<int64>(delta * micros_per_tick)
+                               : delta);
+  };
+  const string* last_device = nullptr;
+  DeviceStepStats* dss = nullptr;
+  for (uint64 i = 0; i < num_records; ++i) {
+    std::atomic<RecordBlock*>* slot = &blocks_[i / kRecordsPerBlock];
+    const RecordBlock* block = slot->load(std::memory_order_acquire);
+    const NodeRecord& record = block->records[i % kRecordsPerBlock];
+    if (step_stats_ == nullptr || collectedNodes >= kMaxCollectedNodes) break;
+    if (record.device != last_device) {
+      dss = FindOrAddDevice(*record.device);
+      last_device = record.device;
+    }
+    const NodeDef& def = record.node->def();
+    const int64 all_start = to_micros(record.times.all_start);
+    NodeExecStats* nt = dss->add_node_stats();
+    nt->set_node_name(def.name());
+    nt->set_scheduled_micros(to_micros(record.times.scheduled));
+    nt->set_all_start_micros(all_start);
+    nt->set_op_start_rel_micros(to_micros(record.times.op_start) - all_start);
+    nt->set_op_end_rel_micros(to_micros(record.times.op_end) - all_start);
+    nt->set_all_end_rel_micros(to_micros(record.times.all_end) - all_start);
+    nt->set_timeline_label(strings::StrCat(
+        def.name(), " = ", def.op(), "(",
+        str_util::Join(
+            std::vector<StringPiece>(def.input().begin(), def.input().end()),
+            ", "),
+        ")"));
+    collectedNodes++;
+  }
+  const uint64 num_blocks = kMaxCollectedNodes / kRecordsPerBlock;
+  for (uint64 i = 0; i < num_blocks; ++i) {
+    delete blocks_[i].exchange(nullptr, std::memory_order_acq_rel);
+  }
+}
 
 static int ExtractGpuWithStreamAll(string device_name) {
   // Check if the device name matches the ".*gpu:(\\d+)/stream:all$" regexp,
@@ -89,6 +221,7 @@ void StepStatsCollector::BuildCostModel(
     CostModelManager* cost_model_manager,
     const std::unordered_map<string, const Graph*>& device_map) {
   mutex_lock lock(mu_);
+  FinalizeLocked();
 
   // Hardware stats for gpu are available under a fake device named
   // "gpu:<id>/stream::all.
@@ -214,28 +347,29 @@ void StepStatsCollector::Save(const string& device, NodeExecStats* nt) {
       delete nt;
       return;
     }
-    DeviceStepStats* dss = nullptr;
-    // Slow linear scan, but it should only be called
-    // by a Worker in a context with < ~10 devices.
-    // TODO(tucker): consider adding a std::unordered_map.
-    for (auto& ds : *step_stats_->mutable_dev_stats()) {
-      if (ds.device() == device) {
-        dss = &ds;
-        break;
-      }
-    }
-    if (dss == nullptr) {
-      dss = step_stats_->add_dev_stats();
-      dss->set_device(device);
-    }
-    nt->Swap(dss->add_node_stats());
+    nt->Swap(FindOrAddDevice(device)->add_node_stats());
     collectedNodes++;
   }
   delete nt;
 }
 
+DeviceStepStats* StepStatsCollector::FindOrAddDevice(const string& device) {
+  // Slow linear scan, but it should only be called
+  // by a Worker in a context with < ~10 devices.
+  // TODO(tucker): consider adding a std::unordered_map.
+  for (auto& ds : *step_stats_->mutable_dev_stats()) {
+    if (ds.device() == device) {
+      return &ds;
+    }
+  }
+  DeviceStepStats* dss = step_stats_->add_dev_stats();
+  dss->set_device(device);
+  return dss;
+}
+
 void StepStatsCollector::Swap(StepStats* ss) {
   mutex_lock l(mu_);
+  FinalizeLocked();
   CHECK(step_stats_);
   ss->Swap(step_stats_);
   collectedNodes = 0;
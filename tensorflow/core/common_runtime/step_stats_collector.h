@@ -15,6 +15,8 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_STEP_STATS_COLLECTOR_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_STEP_STATS_COLLECTOR_H_
 
+#include <atomic>
+#include <memory>
 #include <unordered_map>
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/thread_annotations.h"
@@ -23,16 +25,57 @@ limitations under the License.
 namespace tensorflow {
 
 class CostModelManager;
+class DeviceStepStats;
 class Graph;
+class Node;
 class NodeExecStats;
 class StepStats;
 
 // StepStatsCollector manages the collection of a StepStats object.
 // The StepStats object holds multiple DeviceStats.
 // Each DeviceStats object holds multiple NodeExecStats.
+//
+// A lightweight collector only records when each node was scheduled and
+// ran, through RecordNodeTimes(). The records are fixed-size, kept in
+// blocks that are filled without taking a lock, and timed with the CPU
+// cycle counter where there is one; they are only turned into
+// NodeExecStats by Finalize().
 class StepStatsCollector {
  public:
+  // When a node was scheduled and ran, in the units of NowTicks().
+  struct NodeTimes {
+    uint64 scheduled = 0;
+    uint64 all_start = 0;
+    uint64 op_start = 0;
+    uint64 op_end = 0;
+    uint64 all_end = 0;
+  };
+
   explicit StepStatsCollector(StepStats* ss);
+  StepStatsCollector(StepStats* ss, bool lightweight);
+
+  // Converts the records that have not been converted yet.
+  ~StepStatsCollector();
+
+  bool lightweight() const { return lightweight_; }
+
+  // Returns the current time for RecordNodeTimes(): a CPU cycle count if
+  // the cycle counter frequency is known, and microseconds otherwise.
+  static uint64 NowTicks();
+
+  // Returns true for a random fraction "sample_rate" of the calls, to pick
+  // the steps that a lightweight collector records.
+  static bool SampleStep(float sample_rate);
+
+  // Records that "node" ran on "device" at "times". Both must outlive the
+  // next call to Finalize(). Lock-free, and only valid on a lightweight
+  // collector.
+  void RecordNodeTimes(const string* device, const Node* node,
+                       const NodeTimes& times);
+
+  // Turns the records made by RecordNodeTimes() into NodeExecStats. Every
+  // call to RecordNodeTimes() must have returned before this is called.
+  void Finalize();
 
   // BuildCostModel builds or updates a CostModel managed by cost_model_manager,
   // using the currently collected DeviceStats associated with the devices in
@@ -48,12 +91,37 @@ class StepStatsCollector {
   void Swap(StepStats* ss);
 
  private:
+  struct NodeRecord {
+    const string* device;
+    const Node* node;
+    NodeTimes times;
+  };
+  static constexpr int kRecordsPerBlock = 1024;
+  struct RecordBlock {
+    NodeRecord records[kRecordsPerBlock];
+  };
+
+  DeviceStepStats* FindOrAddDevice(const string& device)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void FinalizeLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   // TODO(suharshs): Make this configurable if its not possible to find a value
   //                 that works for all cases.
   const uint64 kMaxCollectedNodes = 1 << 20;
   mutex mu_;
   StepStats* step_stats_ GUARDED_BY(mu_);
   uint64 collectedNodes GUARDED_BY(mu_) = 0;
+
+  const bool lightweight_;
+  // The time at which the collector was created, in microseconds and in
+  // ticks, from which the records are converted.
+  const int64 base_micros_;
+  const uint64 base_ticks_;
+  // The blocks of records, of which the first kMaxCollectedNodes /
+  // kRecordsPerBlock are allocated as they are first needed.
+  std::unique_ptr<std::atomic<RecordBlock*>[]> blocks_;
+  // The number of records claimed, which may exceed kMaxCollectedNodes.
+  std::atomic<uint64> num_records_{0};
 };
 
 }  // namespace tensorflow
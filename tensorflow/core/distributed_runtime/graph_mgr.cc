@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/graph_mgr.h"
 
+#include <unordered_set>
 #include <vector>
 
 #include "tensorflow/core/common_runtime/constant_folding.h"
@@ -28,40 +29,127 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/distributed_runtime/rendezvous_mgr_interface.h"
 #include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/framework/control_flow.h"
 #include "tensorflow/core/framework/log_memory.h"
 #include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/graph_constructor.h"
 #include "tensorflow/core/graph/graph_partition.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/graph/validate.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 
 namespace tensorflow {
 
-GraphMgr::GraphMgr(const WorkerEnv* worker_env)
-    : worker_env_(worker_env), table_(5) {}
+namespace {
+
+auto* graph_cache_lookups = monitoring::Counter<1>::New(
+    "/tensorflow/core/graph_mgr_cache_lookups",
+    "The number of registered graphs that a worker looked up in its cache "
+    "of initialized graphs.",
+    "result");
+auto* graph_cache_evictions = monitoring::Counter<0>::New(
+    "/tensorflow/core/graph_mgr_cache_evictions",
+    "The number of graphs that a worker dropped from its cache of "
+    "initialized graphs to make room for others.");
+
+}  // namespace
+
+GraphMgr::GraphMgr(const WorkerEnv* worker_env) : GraphMgr(worker_env, 0) {}
+
+GraphMgr::GraphMgr(const WorkerEnv* worker_env, int graph_cache_capacity)
+    : worker_env_(worker_env),
+      table_(5),
+      graph_cache_capacity_(graph_cache_capacity) {}
 
 GraphMgr::~GraphMgr() {
-  for (auto p : table_) p.second->Unref();
+  for (auto p : table_) {
+    p.second->prefix_cancellation.StartCancel();
+    p.second->Unref();
+  }
+  for (CachedGraph* graph : graph_cache_lru_) graph->Unref();
+}
+
+// Returns true if the kernel of "ndef" keeps no state between steps and
+// does not call into the function library it was created with, so that
+// the executors of different items can share it.
+static bool CanShareKernel(const NodeDef& ndef,
+                           const FunctionLibraryDefinition& lib_def) {
+  const OpDef* op_def;
+  if (!OpRegistry::Global()->LookUpOpDef(ndef.op(), &op_def).ok() ||
+      op_def->is_stateful() || lib_def.Find(ndef.op()) != nullptr) {
+    return false;
+  }
+  for (const auto& attr : ndef.attr()) {
+    if (attr.second.has_func() || attr.second.list().func_size() > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+GraphMgr::CachedGraph::~CachedGraph() {
+  // The graphs refer to the library, and the kernels were built from them.
+  partitions.clear();
+  for (const auto& p : kernels) delete p.second;
+  delete lib_def;
+}
+
+bool GraphMgr::CachedGraph::OwnsKernel(const NodeDef& ndef) const {
+  return cached && CanShareKernel(ndef, *lib_def);
+}
+
+Status GraphMgr::CachedGraph::FindOrCreateKernel(const Device* device,
+                                                 const NodeDef& ndef,
+                                                 FunctionLibraryRuntime* lib,
+                                                 OpKernel** kernel) {
+  const string key = strings::StrCat(device->name(), ";", ndef.name());
+  {
+    mutex_lock l(mu);
+    auto iter = kernels.find(key);
+    if (iter != kernels.end()) {
+      *kernel = iter->second;
+      return Status::OK();
+    }
+  }
+  OpKernel* created = nullptr;
+  TF_RETURN_IF_ERROR(lib->CreateKernel(ndef, &created));
+  mutex_lock l(mu);
+  auto result = kernels.insert({key, created});
+  if (!result.second) {
+    // Another item created the same kernel concurrently.
+    delete created;
+  }
+  *kernel = result.first->second;
+  return Status::OK();
 }
 
 GraphMgr::Item::~Item() {
+  // Every started prefix run holds a reference, so all runs are done.
+  for (PrefixRun* run : prefix_runs) delete run;
   for (const auto& unit : this->units) {
     CHECK_NOTNULL(unit.device);
     if (!graph_mgr->skip_cost_models_) {
       graph_mgr->cost_model_manager_.RemoveCostModelForGraph(unit.graph);
     }
+    delete unit.prefix;
     delete unit.root;
     delete unit.lib;
     unit.device->op_segment()->RemoveHold(this->session);
   }
-  delete this->lib_def;
+  if (this->graph != nullptr) this->graph->Unref();
 }
 
 // NOTE: node->device_name() is not set by GraphConstructor.  We
@@ -83,21 +171,227 @@ static Status ValidateGraphDefForDevices(const GraphDef& gdef) {
   return Status::OK();
 }
 
-// Creates executors given a graph definition "gdef" of a "session".
-// If a node in "gdef" is shared by other graphs in "session", the
-// same op kernel is reused. E.g., typically a params node is shared
-// by multiple graphs in a session.
-//
-// If "gdef" is assigned to multiple devices, extra nodes (e.g.,
-// send/recv nodes) maybe added. The extra nodes' name are generated
-// by calling "new_name(old_name)".
-//
-// "executors" are filled with one executor per device if success and
-// the caller takes the ownership of returned executors.
-Status GraphMgr::InitItem(const string& session, const GraphDef& gdef,
-                          const GraphOptions& graph_options, Item* item) {
-  item->session = session;
-  item->lib_def =
+// Ops whose outputs a pipelined step may compute ahead of time: queue
+// dequeues and variable reads.
+static bool IsPrefetchable(const Node* n) {
+  static const std::unordered_set<string>* const kOps =
+      new std::unordered_set<string>({
+          "QueueDequeue", "QueueDequeueV2", "QueueDequeueMany",
+          "QueueDequeueManyV2", "QueueDequeueUpTo", "QueueDequeueUpToV2",
+          "ReadVariableOp",
+      });
+  if (n->type_string() == "Identity") {
+    return n->num_inputs() == 1 && IsRefType(n->input_type(0));
+  }
+  return kOps->count(n->type_string()) > 0;
+}
+
+// Ops that prefetchable ops may read from.  They have no inputs and run in
+// both the prefix graph and the rest of the graph; stateful ones share their
+// kernel, and so their state, through the op segment.
+static bool IsPrefetchSource(const Node* n) {
+  static const std::unordered_set<string>* const kOps =
+      new std::unordered_set<string>({
+          "Const", "Variable", "VariableV2", "VarHandleOp", "FIFOQueue",
+          "FIFOQueueV2", "PaddingFIFOQueue", "PaddingFIFOQueueV2",
+          "RandomShuffleQueue", "RandomShuffleQueueV2", "PriorityQueue",
+          "PriorityQueueV2",
+      });
+  return kOps->count(n->type_string()) > 0;
+}
+
+// Moves the prefetchable nodes of "graph" that depend on nothing else into
+// "*prefix".  Their consumers in "graph" receive the values through new
+// client-terminated _Recv nodes, whose rendezvous keys are appended to
+// "keys".  Leaves "*prefix" null if nothing can be prefetched.
+static Status SplitPrefix(FunctionLibraryDefinition* lib_def,
+                          const Device* device, Graph* graph,
+                          std::unique_ptr<Graph>* prefix,
+                          std::vector<string>* keys) {
+  // A node can run ahead if all of its inputs, data and control, can.  Nodes
+  // inside loops or behind any other computation are therefore excluded.
+  std::vector<Node*> order;
+  GetReversePostOrder(*graph, &order);
+  std::unordered_set<const Node*> ahead;
+  std::vector<Node*> prefetched;
+  for (Node* n : order) {
+    if (!n->IsOp()) continue;
+    const bool prefetchable = IsPrefetchable(n);
+    if (!prefetchable && !IsPrefetchSource(n)) continue;
+    bool inputs_ahead = true;
+    for (const Edge* e : n->in_edges()) {
+      if (!e->src()->IsSource() && ahead.count(e->src()) == 0) {
+        inputs_ahead = false;
+        break;
+      }
+    }
+    if (!inputs_ahead) continue;
+    ahead.insert(n);
+    if (prefetchable && n->num_outputs() > 0) prefetched.push_back(n);
+  }
+  if (prefetched.empty()) return Status::OK();
+
+  // Copy the prefetched nodes and the sources they read into the prefix.
+  std::unordered_set<const Node*> needed(prefetched.begin(),
+                                         prefetched.end());
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    if (needed.count(*it) == 0) continue;
+    for (const Edge* e : (*it)->in_edges()) {
+      if (!e->src()->IsSource()) needed.insert(e->src());
+    }
+  }
+  prefix->reset(new Graph(lib_def));
+  (*prefix)->set_versions(graph->versions());
+  std::unordered_map<const Node*, Node*> copies;
+  for (Node* n : order) {
+    if (needed.count(n) > 0) copies[n] = (*prefix)->CopyNode(n);
+  }
+  for (const auto& p : copies) {
+    for (const Edge* e : p.first->in_edges()) {
+      Node* src = e->src()->IsSource() ? (*prefix)->source_node()
+                                       : copies[e->src()];
+      (*prefix)->AddEdge(src, e->src_output(), p.second, e->dst_input());
+    }
+  }
+
+  // Hand each prefetched value that the rest of the graph consumes from a
+  // _Send in the prefix to a _Recv in "graph".
+  const string& device_name = device->name();
+  const int64 incarnation = device->attributes().incarnation();
+  for (Node* n : prefetched) {
+    std::vector<Node*> recvs(n->num_outputs(), nullptr);
+    auto recv_for = [&](int slot, Node** recv) -> Status {
+      if (recvs[slot] == nullptr) {
+        const string tensor_name =
+            strings::StrCat(n->name(), ":", slot, "/prefetched");
+        Node* send;
+        TF_RETURN_IF_ERROR(
+            NodeBuilder((*prefix)->NewName("prefetch/send"), "_Send")
+                .Input(copies[n], slot)
+                .Attr("tensor_name", tensor_name)
+                .Attr("send_device", device_name)
+                .Attr("send_device_incarnation", incarnation)
+                .Attr("recv_device", device_name)
+                .Attr("client_terminated", true)
+                .Finalize(prefix->get(), &send));
+        send->set_assigned_device_name(device_name);
+        TF_RETURN_IF_ERROR(
+            NodeBuilder(graph->NewName("prefetch/recv"), "_Recv")
+                .Attr("tensor_type", n->output_type(slot))
+                .Attr("tensor_name", tensor_name)
+                .Attr("send_device", device_name)
+                .Attr("send_device_incarnation", incarnation)
+                .Attr("recv_device", device_name)
+                .Attr("client_terminated", true)
+                .Finalize(graph, &recvs[slot]));
+        recvs[slot]->set_assigned_device_name(device_name);
+        keys->push_back(Rendezvous::CreateKey(device_name, incarnation,
+                                              device_name, tensor_name,
+                                              FrameAndIter(0, 0)));
+      }
+      *recv = recvs[slot];
+      return Status::OK();
+    };
+    std::vector<const Edge*> out_edges(n->out_edges().begin(),
+                                       n->out_edges().end());
+    for (const Edge* e : out_edges) {
+      Node* dst = e->dst();
+      if (dst->IsSink() || ahead.count(dst) > 0) continue;
+      Node* recv;
+      if (e->IsControlEdge()) {
+        TF_RETURN_IF_ERROR(recv_for(0, &recv));
+        graph->AddControlEdge(recv, dst);
+      } else {
+        TF_RETURN_IF_ERROR(recv_for(e->src_output(), &recv));
+        graph->AddEdge(recv, 0, dst, e->dst_input());
+      }
+    }
+  }
+  for (Node* n : prefetched) graph->RemoveNode(n);
+  FixupSourceAndSinkEdges(graph);
+  FixupSourceAndSinkEdges(prefix->get());
+  return Status::OK();
+}
+
+// Returns a fingerprint of a deterministic serialization of "msg".
+static string DeterministicFingerprint(const protobuf::Message& msg) {
+  string serialized;
+  {
+    protobuf::io::StringOutputStream stream(&serialized);
+    protobuf::io::CodedOutputStream coded(&stream);
+    coded.SetSerializationDeterministic(true);
+    msg.SerializeToCodedStream(&coded);
+  }
+  const Fprint128 fp = Fingerprint128(serialized);
+  return strings::StrCat(strings::Hex(fp.high64, strings::ZERO_PAD_16),
+                         strings::Hex(fp.low64, strings::ZERO_PAD_16));
+}
+
+Status GraphMgr::FindOrBuildGraph(const GraphDef& gdef,
+                                  const GraphOptions& graph_options,
+                                  CachedGraph** graph) {
+  string key;
+  if (graph_cache_capacity_ > 0) {
+    key = strings::StrCat(DeterministicFingerprint(gdef),
+                          DeterministicFingerprint(graph_options));
+    mutex_lock l(mu_);
+    auto iter = graph_cache_.find(key);
+    if (iter != graph_cache_.end()) {
+      graph_cache_lru_.splice(graph_cache_lru_.begin(), graph_cache_lru_,
+                              iter->second);
+      *graph = *iter->second;
+      (*graph)->Ref();
+      graph_cache_lookups->GetCell("hit")->IncrementBy(1);
+      return Status::OK();
+    }
+    graph_cache_lookups->GetCell("miss")->IncrementBy(1);
+  }
+
+  CachedGraph* built = new CachedGraph;
+  Status s = BuildGraph(gdef, graph_options, built);
+  if (!s.ok()) {
+    built->Unref();
+    return s;
+  }
+
+  if (graph_cache_capacity_ > 0) {
+    std::vector<CachedGraph*> evicted;
+    {
+      mutex_lock l(mu_);
+      // If an identical registration finished building first, the cache
+      // keeps its graph, and this one is used by this item only.
+      if (graph_cache_.count(key) == 0) {
+        built->cached = true;
+        built->Ref();
+        graph_cache_lru_.push_front(built);
+        graph_cache_[key] = graph_cache_lru_.begin();
+        built->key = key;
+        while (graph_cache_lru_.size() >
+               static_cast<size_t>(graph_cache_capacity_)) {
+          CachedGraph* oldest = graph_cache_lru_.back();
+          graph_cache_.erase(oldest->key);
+          graph_cache_lru_.pop_back();
+          evicted.push_back(oldest);
+        }
+      }
+    }
+    // Items built from an evicted graph keep it alive until they are
+    // deregistered.
+    for (CachedGraph* graph : evicted) {
+      graph_cache_evictions->GetCell()->IncrementBy(1);
+      graph->Unref();
+    }
+  }
+  *graph = built;
+  return Status::OK();
+}
+
+// Partitions "gdef" by device, and rewrites and optimizes each partition,
+// as the executors built from "graph" will run them.
+Status GraphMgr::BuildGraph(const GraphDef& gdef,
+                            const GraphOptions& graph_options,
+                            CachedGraph* graph) {
+  graph->lib_def =
       new FunctionLibraryDefinition(OpRegistry::Global(), gdef.library());
 
   TF_RETURN_IF_ERROR(ValidateGraphDefForDevices(gdef));
@@ -105,17 +399,17 @@ Status GraphMgr::InitItem(const string& session, const GraphDef& gdef,
   if (gdef.versions().producer() >= 5) {
     // Validate the graph: we assume that merging two valid graphs
     // should maintain graph validity.
-    TF_RETURN_IF_ERROR(graph::ValidateGraphDef(gdef, *item->lib_def));
+    TF_RETURN_IF_ERROR(graph::ValidateGraphDef(gdef, *graph->lib_def));
   }
 
   // Constructs the graph out of "gdef".
-  Graph graph(item->lib_def);
+  Graph full_graph(graph->lib_def);
   GraphConstructorOptions opts;
   opts.allow_internal_ops = true;
   opts.expect_device_spec = true;
-  TF_RETURN_IF_ERROR(ConvertGraphDefToGraph(opts, gdef, &graph));
+  TF_RETURN_IF_ERROR(ConvertGraphDefToGraph(opts, gdef, &full_graph));
 
-  // Splits "graph" into multiple subgraphs by device names.
+  // Splits "full_graph" into multiple subgraphs by device names.
   std::unordered_map<string, GraphDef> partitions;
   PartitionOptions popts;
   popts.node_to_loc = SplitByDevice;
@@ -134,14 +428,14 @@ Status GraphMgr::InitItem(const string& session, const GraphDef& gdef,
   };
   popts.control_flow_added = true;
   popts.scheduling_for_recvs = graph_options.enable_recv_scheduling();
-  TF_RETURN_IF_ERROR(Partition(popts, &graph, &partitions));
+  TF_RETURN_IF_ERROR(Partition(popts, &full_graph, &partitions));
   if (popts.scheduling_for_recvs) {
     TF_RETURN_IF_ERROR(AddControlEdges(popts, &partitions));
   }
 
   std::unordered_map<string, std::unique_ptr<Graph>> partition_graphs;
   for (const auto& partition : partitions) {
-    std::unique_ptr<Graph> device_graph(new Graph(item->lib_def));
+    std::unique_ptr<Graph> device_graph(new Graph(graph->lib_def));
     GraphConstructorOptions device_opts;
     // There are internal operations (e.g., send/recv) that we now allow.
     device_opts.allow_internal_ops = true;
@@ -152,36 +446,82 @@ Status GraphMgr::InitItem(const string& session, const GraphDef& gdef,
   }
 
   GraphOptimizationPassOptions optimization_options;
-  optimization_options.flib_def = item->lib_def;
+  optimization_options.flib_def = graph->lib_def;
   optimization_options.partition_graphs = &partition_graphs;
   TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
       OptimizationPassRegistry::POST_PARTITIONING, optimization_options));
 
-  LocalExecutorParams params;
-
-  item->units.reserve(partitions.size());
-  item->graph_mgr = this;
+  graph->partitions.reserve(partitions.size());
   const auto& optimizer_opts = graph_options.optimizer_options();
   GraphOptimizer optimizer(optimizer_opts);
   for (auto& p : partition_graphs) {
     const string& device_name = p.first;
     std::unique_ptr<Graph>& subgraph = p.second;
-    item->units.resize(item->units.size() + 1);
-    ExecutionUnit* unit = &(item->units.back());
+    graph->partitions.resize(graph->partitions.size() + 1);
+    CachedGraph::Partition* partition = &graph->partitions.back();
 
     // Find the device.
-    Status s =
-        worker_env_->device_mgr->LookupDevice(device_name, &unit->device);
-    if (!s.ok()) {
-      // Remove the empty unit from the item as the item destructor wants all
-      // units to have valid devices.
-      item->units.pop_back();
-      return s;
-    }
+    TF_RETURN_IF_ERROR(
+        worker_env_->device_mgr->LookupDevice(device_name, &partition->device));
+    Device* device = partition->device;
 
     // Give the device an opportunity to rewrite its subgraph.
-    TF_RETURN_IF_ERROR(
-        unit->device->MaybeRewriteGraph(gdef.library(), &subgraph));
+    TF_RETURN_IF_ERROR(device->MaybeRewriteGraph(gdef.library(), &subgraph));
+
+    // The optimizer inlines functions through a function library runtime;
+    // the executors get runtimes of their own.
+    std::unique_ptr<FunctionLibraryRuntime> lib(NewFunctionLibraryRuntime(
+        worker_env_->device_mgr, worker_env_->env, device,
+        subgraph->versions().producer(), graph->lib_def, optimizer_opts));
+    optimizer.Optimize(lib.get(), worker_env_->env, device, &subgraph);
+    if (graph_options.step_pipeline_depth() > 0 &&
+        device->device_type() == DEVICE_CPU) {
+      TF_RETURN_IF_ERROR(SplitPrefix(graph->lib_def, device, subgraph.get(),
+                                     &partition->prefix,
+                                     &graph->prefix_keys));
+    }
+    TF_RETURN_IF_ERROR(EnsureMemoryTypes(DeviceType(device->device_type()),
+                                         device->name(), subgraph.get()));
+    partition->graph = std::move(subgraph);
+  }
+  return Status::OK();
+}
+
+// Returns "graph" itself if "take" is true, and a copy of it otherwise.
+static Graph* TakeOrCopyGraph(bool take, std::unique_ptr<Graph>* graph) {
+  if (take) return graph->release();
+  Graph* copy = new Graph((*graph)->op_registry());
+  CopyGraph(**graph, copy);
+  return copy;
+}
+
+// Creates executors given a graph definition "gdef" of a "session".
+// If a node in "gdef" is shared by other graphs in "session", the
+// same op kernel is reused. E.g., typically a params node is shared
+// by multiple graphs in a session.
+//
+// If "gdef" is assigned to multiple devices, extra nodes (e.g.,
+// send/recv nodes) maybe added. The extra nodes' name are generated
+// by calling "new_name(old_name)".
+//
+// "executors" are filled with one executor per device if success and
+// the caller takes the ownership of returned executors.
+Status GraphMgr::InitItem(const string& session, const GraphDef& gdef,
+                          const GraphOptions& graph_options, Item* item) {
+  item->session = session;
+  item->graph_mgr = this;
+  TF_RETURN_IF_ERROR(FindOrBuildGraph(gdef, graph_options, &item->graph));
+  CachedGraph* graph = item->graph;
+  item->lib_def = graph->lib_def;
+  item->prefix_keys = graph->prefix_keys;
+
+  LocalExecutorParams params;
+
+  item->units.reserve(graph->partitions.size());
+  for (auto& partition : graph->partitions) {
+    item->units.resize(item->units.size() + 1);
+    ExecutionUnit* unit = &(item->units.back());
+    unit->device = partition.device;
 
     // Top-level nodes in the graph uses the op segment to cache
     // kernels. Therefore, as long as the executor is alive, we need
@@ -192,17 +532,22 @@ Status GraphMgr::InitItem(const string& session, const GraphDef& gdef,
     // Function library runtime.
     unit->lib = NewFunctionLibraryRuntime(
         worker_env_->device_mgr, worker_env_->env, unit->device,
-        subgraph->versions().producer(), item->lib_def,
+        partition.graph->versions().producer(), item->lib_def,
         graph_options.optimizer_options());
 
     // Construct the root executor for the subgraph.
     params.device = unit->device;
     auto lib = unit->lib;
     params.function_library = lib;
-    params.create_kernel = [session, lib, opseg](const NodeDef& ndef,
-                                                 OpKernel** kernel) {
+    const Device* device = unit->device;
+    params.create_kernel = [session, lib, opseg, graph, device](
+        const NodeDef& ndef, OpKernel** kernel) {
       // Caches the kernel only if the node is stateful.
       if (!lib->IsStateful(ndef.op())) {
+        // Stateless kernels of a cached graph are shared by its items.
+        if (graph->OwnsKernel(ndef)) {
+          return graph->FindOrCreateKernel(device, ndef, lib, kernel);
+        }
         return lib->CreateKernel(ndef, kernel);
       }
       auto create_fn = [lib, &ndef](OpKernel** kernel) {
@@ -213,24 +558,29 @@ Status GraphMgr::InitItem(const string& session, const GraphDef& gdef,
       // on the function library here + global op registry.
       return opseg->FindOrCreate(session, ndef.name(), kernel, create_fn);
     };
-    params.delete_kernel = [lib](OpKernel* kernel) {
-      // If the node is stateful, opseg owns it. Otherwise, delete it.
-      if (kernel && !lib->IsStateful(kernel->type_string())) {
+    params.delete_kernel = [lib, graph](OpKernel* kernel) {
+      // If the node is stateful, opseg owns it. If it is shared, the
+      // cached graph owns it. Otherwise, delete it.
+      if (kernel && !lib->IsStateful(kernel->type_string()) &&
+          !graph->OwnsKernel(kernel->def())) {
         delete kernel;
       }
     };
 
-    optimizer.Optimize(lib, worker_env_->env, params.device, &subgraph);
-    TF_RETURN_IF_ERROR(
-        EnsureMemoryTypes(DeviceType(unit->device->device_type()),
-                          unit->device->name(), subgraph.get()));
-    unit->graph = subgraph.get();
+    // A graph that is not cached is used by this item only.
+    Graph* subgraph = TakeOrCopyGraph(!graph->cached, &partition.graph);
+    unit->graph = subgraph;
     unit->build_cost_model = graph_options.build_cost_model();
     if (unit->build_cost_model > 0) {
       skip_cost_models_ = false;
     }
-    TF_RETURN_IF_ERROR(
-        NewLocalExecutor(params, subgraph.release(), &unit->root));
+    TF_RETURN_IF_ERROR(NewLocalExecutor(params, subgraph, &unit->root));
+    if (partition.prefix) {
+      TF_RETURN_IF_ERROR(NewLocalExecutor(
+          params, TakeOrCopyGraph(!graph->cached, &partition.prefix),
+          &unit->prefix));
+      item->pipeline_depth = graph_options.step_pipeline_depth();
+    }
   }
   return Status::OK();
 }
@@ -267,6 +617,7 @@ Status GraphMgr::Deregister(const string& handle) {
     item = iter->second;
     table_.erase(iter);
   }
+  item->prefix_cancellation.StartCancel();
   item->Unref();
   return Status::OK();
 }
@@ -282,6 +633,7 @@ Status GraphMgr::DeregisterAll() {
     table_.clear();
   }
   for (auto item : items) {
+    item->prefix_cancellation.StartCancel();
     item->Unref();
   }
   return Status::OK();
@@ -373,6 +725,19 @@ void GraphMgr::ExecuteAsync(const string& handle, const int64 step_id,
     return;
   }
 
+  // With step pipelining, the prefetched values arrive in the rendezvous
+  // whenever their prefix run finishes; the executors start right away.
+  if (item->pipeline_depth > 0) {
+    rendezvous->Ref();
+    ConsumePrefixRun(TakePrefixRun(item), [this, rendezvous](PrefixRun* run) {
+      Status s = run->status;
+      if (s.ok()) s = SendInputsToRendezvous(rendezvous, run->values);
+      if (!s.ok()) rendezvous->StartAbort(s);
+      rendezvous->Unref();
+      delete run;
+    });
+  }
+
   StartParallelExecutors(handle, step_id, item, rendezvous, collector,
                          cost_graph, cancellation_manager,
                          [this, item, rendezvous, done](const Status& s) {
@@ -425,6 +790,113 @@ void GraphMgr::StartParallelExecutors(const string& handle, int64 step_id,
   }
 }
 
+GraphMgr::PrefixRun* GraphMgr::TakePrefixRun(Item* item) {
+  PrefixRun* run;
+  PrefixRun* to_start = nullptr;
+  {
+    mutex_lock l(item->prefix_mu);
+    if (item->prefix_runs.empty()) {
+      run = new PrefixRun;
+      item->unstarted_prefix_runs.push_back(run);
+    } else {
+      run = item->prefix_runs.front();
+      item->prefix_runs.pop_front();
+    }
+    while (item->prefix_runs.size() <
+           static_cast<size_t>(item->pipeline_depth)) {
+      PrefixRun* next = new PrefixRun;
+      item->prefix_runs.push_back(next);
+      item->unstarted_prefix_runs.push_back(next);
+    }
+    if (!item->prefix_running) {
+      item->prefix_running = true;
+      to_start = item->unstarted_prefix_runs.front();
+      item->unstarted_prefix_runs.pop_front();
+    }
+  }
+  if (to_start != nullptr) StartPrefixRun(item, to_start);
+  return run;
+}
+
+void GraphMgr::StartPrefixRun(Item* item, PrefixRun* run) {
+  if (item->prefix_cancellation.IsCancelled()) {
+    FinishPrefixRun(item, run, errors::Cancelled("Graph was deregistered"));
+    return;
+  }
+  item->Ref();
+  int num_units = 0;
+  for (const auto& unit : item->units) {
+    if (unit.prefix != nullptr) ++num_units;
+  }
+  Executor::Args args;
+  {
+    mutex_lock l(mu_);
+    args.step_id = ++next_id_;
+  }
+  Rendezvous* rendezvous = NewLocalRendezvous();
+  ScopedStepContainer* step_container =
+      new ScopedStepContainer(args.step_id, [this](const string& name) {
+        worker_env_->device_mgr->ClearContainers({name});
+      });
+  ExecutorBarrier* barrier = new ExecutorBarrier(
+      num_units, rendezvous,
+      [this, item, run, rendezvous, step_container](const Status& s) {
+        Status status = s;
+        if (status.ok()) {
+          for (const string& key : item->prefix_keys) run->values[key];
+          status = RecvOutputsFromRendezvous(rendezvous, &run->values);
+        }
+        rendezvous->Unref();
+        delete step_container;
+        FinishPrefixRun(item, run, status);
+        item->Unref();
+      });
+  args.rendezvous = rendezvous;
+  args.cancellation_manager = &item->prefix_cancellation;
+  args.step_container = step_container;
+  args.sync_on_finish = true;
+  thread::ThreadPool* pool = worker_env_->compute_pool;
+  args.runner = std::bind(&thread::ThreadPool::Schedule, pool,
+                          std::placeholders::_1);
+  for (const auto& unit : item->units) {
+    if (unit.prefix != nullptr) unit.prefix->RunAsync(args, barrier->Get());
+  }
+}
+
+void GraphMgr::FinishPrefixRun(Item* item, PrefixRun* run, const Status& s) {
+  PrefixRun* to_start = nullptr;
+  {
+    mutex_lock l(item->prefix_mu);
+    if (item->unstarted_prefix_runs.empty()) {
+      item->prefix_running = false;
+    } else {
+      to_start = item->unstarted_prefix_runs.front();
+      item->unstarted_prefix_runs.pop_front();
+    }
+  }
+  std::function<void(PrefixRun*)> consumer;
+  {
+    mutex_lock l(run->mu);
+    run->status = s;
+    run->done = true;
+    consumer = std::move(run->consumer);
+  }
+  if (consumer) consumer(run);
+  if (to_start != nullptr) StartPrefixRun(item, to_start);
+}
+
+void GraphMgr::ConsumePrefixRun(PrefixRun* run,
+                                std::function<void(PrefixRun*)> consumer) {
+  {
+    mutex_lock l(run->mu);
+    if (!run->done) {
+      run->consumer = std::move(consumer);
+      return;
+    }
+  }
+  consumer(run);
+}
+
 void GraphMgr::BuildCostModel(Item* item, StepStatsCollector* collector,
                               CostGraphDef* cost_graph) {
   if (collector && !skip_cost_models_) {
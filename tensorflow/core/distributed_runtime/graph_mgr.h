@@ -16,6 +16,9 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_GRAPH_MGR_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_GRAPH_MGR_H_
 
+#include <deque>
+#include <list>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -48,6 +51,11 @@ class StepStatsCollector;
 //
 // Multiple threads can call GraphMgr methods concurrently.
 //
+// GraphMgr may keep the partitioned and optimized form of the graphs
+// registered with it, and their stateless kernels, so that a later
+// registration of an identical graph, from any session, reuses them
+// instead of building them again.
+//
 // E.g.,
 //   GraphMgr gmgr(worker_env);
 //   string handle;
@@ -61,6 +69,11 @@ class StepStatsCollector;
 class GraphMgr {
  public:
   explicit GraphMgr(const WorkerEnv* worker_env);
+
+  // Same as above, but keeps up to "graph_cache_capacity" of the most
+  // recently registered distinct graphs for later registrations to reuse.
+  GraphMgr(const WorkerEnv* worker_env, int graph_cache_capacity);
+
   ~GraphMgr();
 
   // Registers a graph. Fills in "handle"
@@ -95,11 +108,70 @@ class GraphMgr {
     Graph* graph = nullptr;
     Device* device = nullptr;
     Executor* root = nullptr;
+    // With step pipelining, computes the queue dequeues and variable reads
+    // that "root" receives through _Recv nodes.  May be null.
+    Executor* prefix = nullptr;
     FunctionLibraryRuntime* lib = nullptr;
     // Build the cost model if this value is strictly positive.
     int64 build_cost_model = 0;
   };
 
+  // The partitions of a registered graph, after optimization, from which
+  // the executors of an Item are built. While it is in graph_cache_, the
+  // items built from it also share its stateless kernels.
+  struct CachedGraph : public core::RefCounted {
+    ~CachedGraph() override;
+
+    // The key of this graph in graph_cache_, if it was added to it.
+    string key;
+
+    // The library the partitions refer to.  Owned.
+    FunctionLibraryDefinition* lib_def = nullptr;
+
+    struct Partition {
+      Device* device = nullptr;
+      std::unique_ptr<Graph> graph;
+      // With step pipelining, the part of "graph" split off into a prefix
+      // executor.  May be null.
+      std::unique_ptr<Graph> prefix;
+    };
+    std::vector<Partition> partitions;
+
+    // Rendezvous keys of the values the prefix graphs produce.
+    std::vector<string> prefix_keys;
+
+    // True if this graph was added to graph_cache_.  Items then copy the
+    // partitions, instead of taking them, and share stateless kernels.
+    bool cached = false;
+
+    // Returns true if the kernel of "ndef" is owned by this graph rather
+    // than by the executor that uses it.
+    bool OwnsKernel(const NodeDef& ndef) const;
+
+    // Returns the kernel of the node "ndef" of the partition on "device",
+    // creating it with "lib" if no item has yet.  OwnsKernel(ndef) must be
+    // true.
+    Status FindOrCreateKernel(const Device* device, const NodeDef& ndef,
+                              FunctionLibraryRuntime* lib, OpKernel** kernel);
+
+    mutex mu;
+    // Shared kernels, keyed by device and node name.
+    std::unordered_map<string, OpKernel*> kernels GUARDED_BY(mu);
+  };
+
+  // The values computed by one run of the prefix executors, ahead of the step
+  // that will consume them.
+  struct PrefixRun {
+    mutex mu;
+    bool done GUARDED_BY(mu) = false;
+    // Called once the run is done, by whichever of FinishPrefixRun() and
+    // ConsumePrefixRun() comes last.  Deletes the run.
+    std::function<void(PrefixRun*)> consumer GUARDED_BY(mu);
+    // Valid once done.
+    Status status;
+    NamedTensors values;
+  };
+
   struct Item : public core::RefCounted {
     // TOOD(zhifengc): Keeps a copy of the original graph if the need arises.
     // TOOD(zhifengc): Stats, updated by multiple runs potentially.
@@ -112,7 +184,11 @@ class GraphMgr {
     // Graph handle.
     string handle;
 
-    // The definition of the library is shared by all partitions.
+    // The graph the executors were built from.  Holds one ref.
+    CachedGraph* graph = nullptr;
+
+    // The definition of the library is shared by all partitions.  Owned
+    // by "graph".
     FunctionLibraryDefinition* lib_def = nullptr;
 
     // A graph is partitioned over multiple devices.  Each partition
@@ -122,6 +198,21 @@ class GraphMgr {
     // Used to deresgister a cost model when cost model is requried in graph
     // manager.
     GraphMgr* graph_mgr;
+
+    // Step pipelining (GraphOptions.step_pipeline_depth).  0 if no unit has a
+    // prefix executor.
+    int pipeline_depth = 0;
+    // Rendezvous keys of the values the prefix executors produce.
+    std::vector<string> prefix_keys;
+    // Cancels the prefix runs when the graph is deregistered.
+    CancellationManager prefix_cancellation;
+    mutex prefix_mu;
+    // Runs that no step has taken yet, oldest first.
+    std::deque<PrefixRun*> prefix_runs GUARDED_BY(prefix_mu);
+    // Runs that have not started yet.  Runs execute one at a time, in order,
+    // so that steps consume queue elements in the order they were dequeued.
+    std::deque<PrefixRun*> unstarted_prefix_runs GUARDED_BY(prefix_mu);
+    bool prefix_running GUARDED_BY(prefix_mu) = false;
   };
 
   // Not owned.
@@ -140,6 +231,24 @@ class GraphMgr {
   // mechanism to gc these graphs.
   std::unordered_map<string, Item*> table_;
 
+  // The number of graphs graph_cache_ holds at most.  0 disables it.
+  const int graph_cache_capacity_;
+
+  // The most recently registered distinct graphs, keyed by a fingerprint
+  // of their GraphDef and GraphOptions, most recently used first.  Each
+  // holds one ref.
+  std::list<CachedGraph*> graph_cache_lru_ GUARDED_BY(mu_);
+  std::unordered_map<string, std::list<CachedGraph*>::iterator> graph_cache_
+      GUARDED_BY(mu_);
+
+  // Returns the oldest prefix run of "item" for a step to consume, and starts
+  // more so that "item->pipeline_depth" steps' worth are ahead.
+  PrefixRun* TakePrefixRun(Item* item);
+  void StartPrefixRun(Item* item, PrefixRun* run);
+  void FinishPrefixRun(Item* item, PrefixRun* run, const Status& s);
+  static void ConsumePrefixRun(PrefixRun* run,
+                               std::function<void(PrefixRun*)> consumer);
+
   void StartParallelExecutors(const string& handle, int64 step_id, Item* item,
                               Rendezvous* rendezvous,
                               StepStatsCollector* collector,
@@ -160,6 +269,15 @@ class GraphMgr {
   Status InitItem(const string& session, const GraphDef& gdef,
                   const GraphOptions& graph_options, Item* item);
 
+  // Sets "*graph" to the partitions of "gdef", from graph_cache_ if an
+  // identical graph is there, and built with BuildGraph() otherwise.  The
+  // caller owns one ref of "*graph".
+  Status FindOrBuildGraph(const GraphDef& gdef,
+                          const GraphOptions& graph_options,
+                          CachedGraph** graph);
+  Status BuildGraph(const GraphDef& gdef, const GraphOptions& graph_options,
+                    CachedGraph* graph);
+
   TF_DISALLOW_COPY_AND_ASSIGN(GraphMgr);
 };
 
@@ -22,6 +22,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/common_runtime/profile_handler.h"
 #include "tensorflow/core/common_runtime/stats_publisher_interface.h"
+#include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/distributed_runtime/scheduler.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/distributed_runtime/worker_interface.h"
@@ -254,8 +255,43 @@ class MasterSession::ReffedClientGraph : public core::RefCounted {
   // acquiring locks.
   std::vector<Part> partitions_;
 
+  // The RunGraph requests and responses of one step of a non-partial run,
+  // one of each per partition. A request is built in full, with its graph
+  // handle and rendezvous keys, for the first step that uses it; the
+  // steps that reuse it only update its step id, executor options and
+  // feed values.
+  struct PreparedStep {
+    std::vector<std::unique_ptr<MutableRunGraphRequestWrapper>> reqs;
+    std::vector<std::unique_ptr<MutableRunGraphResponseWrapper>> resps;
+  };
+
+  // Returns the calls of a previous step, or nullptr if there are none
+  // that no running step uses.
+  std::unique_ptr<PreparedStep> TakePreparedStep() {
+    mutex_lock l(mu_);
+    if (prepared_steps_.empty()) return nullptr;
+    std::unique_ptr<PreparedStep> step = std::move(prepared_steps_.back());
+    prepared_steps_.pop_back();
+    return step;
+  }
+
+  // Keeps the calls of a step that succeeded for a later step. Their
+  // send values must already have been cleared.
+  void ReturnPreparedStep(std::unique_ptr<PreparedStep> step) {
+    mutex_lock l(mu_);
+    if (prepared_steps_.size() < kMaxPreparedSteps) {
+      prepared_steps_.push_back(std::move(step));
+    }
+  }
+
   mutable mutex mu_;
 
+  // Calls kept for reuse, at most one set per step that ran concurrently
+  // and no more than kMaxPreparedSteps. Their requests keep their send
+  // keys but not the feed values of the step that last used them.
+  static const size_t kMaxPreparedSteps = 4;
+  std::vector<std::unique_ptr<PreparedStep>> prepared_steps_ GUARDED_BY(mu_);
+
   // Partition initialization and registration only needs to happen
   // once. init_started_ && !init_done_ indicates the initialization
   // is on going.
@@ -535,27 +571,43 @@ Status MasterSession::ReffedClientGraph::RunPartitions(
   }
   if (pss->collect_timeline) {
     exec_opts.set_record_timeline(true);
+  } else if (pss->collect_lightweight_timeline) {
+    exec_opts.set_record_lightweight_timeline(true);
   }
   if (pss->collect_rpcs) {
     SetRPCLogging(true);
   }
-  if (pss->collect_costs || pss->collect_timeline) {
+  if (pss->collect_costs || pss->collect_timeline ||
+      pss->collect_lightweight_timeline) {
     pss->step_stats.resize(partitions_.size());
   }
 
   const int num = partitions_.size();
   RunManyGraphs calls(num);
 
+  // A non-partial run reuses the requests of an earlier step, and only
+  // patches in the values that change from one step to the next.
+  std::unique_ptr<PreparedStep> prepared;
+  if (!is_partial_) {
+    prepared = TakePreparedStep();
+  }
+  const bool reuse = prepared != nullptr;
+
   for (int i = 0; i < num; ++i) {
     const Part& part = partitions_[i];
     RunManyGraphs::Call* c = calls.get(i);
-    c->req.reset(part.worker->CreateRunGraphRequest());
-    c->resp.reset(part.worker->CreateRunGraphResponse());
+    if (reuse) {
+      c->req = std::move(prepared->reqs[i]);
+      c->resp = std::move(prepared->resps[i]);
+    } else {
+      c->req.reset(part.worker->CreateRunGraphRequest());
+      c->resp.reset(part.worker->CreateRunGraphResponse());
+      c->req->set_graph_handle(part.graph_handle);
+    }
     if (is_partial_) {
       c->req->set_is_partial(is_partial_);
       c->req->set_is_last_partial_run(is_last_partial_run);
     }
-    c->req->set_graph_handle(part.graph_handle);
     c->req->set_step_id(step_id);
     *c->req->mutable_exec_opts() = exec_opts;
     // If any feeds are provided, send the feed values together
@@ -594,6 +646,15 @@ Status MasterSession::ReffedClientGraph::RunPartitions(
           }
         }
       }
+    } else if (reuse) {
+      // The sends were added in the iteration order of part.feed_key,
+      // which does not change once the partitions are registered.
+      size_t send_index = 0;
+      for (const auto& feed_key : part.feed_key) {
+        const int64 feed_index = feeds[feed_key.first];
+        TF_RETURN_IF_ERROR(
+            c->req->SetSendFromRunStepRequest(req, feed_index, send_index++));
+      }
     } else {
       for (const auto& feed_key : part.feed_key) {
         const string& feed = feed_key.first;
@@ -654,7 +715,7 @@ Status MasterSession::ReffedClientGraph::RunPartitions(
           break;
         }
       }
-      if (pss->collect_timeline) {
+      if (pss->collect_timeline || pss->collect_lightweight_timeline) {
         pss->step_stats[i].Swap(calls.get(i)->resp->mutable_step_stats());
       }
       if (pss->collect_costs) {
@@ -666,6 +727,22 @@ Status MasterSession::ReffedClientGraph::RunPartitions(
       }
     }
   }
+
+  if (status.ok() && !is_partial_) {
+    if (!reuse) {
+      prepared.reset(new PreparedStep);
+      prepared->reqs.resize(num);
+      prepared->resps.resize(num);
+    }
+    for (int i = 0; i < num; ++i) {
+      RunManyGraphs::Call* c = calls.get(i);
+      c->req->ClearSendValues();
+      c->resp->Clear();
+      prepared->reqs[i] = std::move(c->req);
+      prepared->resps[i] = std::move(c->resp);
+    }
+    ReturnPreparedStep(std::move(prepared));
+  }
   return status;
 }
 
@@ -740,7 +817,10 @@ void MasterSession::ReffedClientGraph::ProcessStats(
     int64 step_id, PerStepState* pss,
     SimpleGraphExecutionState* execution_state, ProfileHandler* ph,
     const RunOptions& options, RunMetadata* resp) {
-  if (!pss->collect_costs && !pss->collect_timeline) return;
+  if (!pss->collect_costs && !pss->collect_timeline &&
+      !pss->collect_lightweight_timeline) {
+    return;
+  }
 
   // Out-of-band logging data is collected now, during post-processing.
   if (pss->collect_timeline) {
@@ -777,6 +857,11 @@ void MasterSession::ReffedClientGraph::ProcessStats(
     if (options.trace_level() == RunOptions::FULL_TRACE) {
       resp->mutable_step_stats()->Swap(&step_stats_proto);
     }
+  } else if (pss->collect_lightweight_timeline) {
+    for (size_t i = 0; i < partitions_.size(); ++i) {
+      step_stats_proto.MergeFrom(pss->step_stats[i]);
+    }
+    resp->mutable_step_stats()->Swap(&step_stats_proto);
   }
 }
 
@@ -1278,6 +1363,10 @@ Status MasterSession::DoPartialRun(CallOptions* opts,
       pss.collect_timeline = true;
       pss.collect_rpcs = ph->should_collect_rpcs();
     }
+    pss.collect_lightweight_timeline =
+        !pss.collect_timeline &&
+        StepStatsCollector::SampleStep(session_opts_.config.graph_options()
+                                           .lightweight_trace_sample_rate());
 
     run_state->pss = std::move(pss);
     run_state->ph = std::move(ph);
@@ -1385,6 +1474,10 @@ Status MasterSession::DoRunWithLocalExecution(
     pss.collect_timeline = true;
     pss.collect_rpcs = ph->should_collect_rpcs();
   }
+  pss.collect_lightweight_timeline =
+      !pss.collect_timeline &&
+      StepStatsCollector::SampleStep(
+          session_opts_.config.graph_options().lightweight_trace_sample_rate());
 
   Status s =
       rcg->RunPartitions(env_, step_id, count, execution_state_.get(), &pss,
@@ -132,6 +132,8 @@ class MasterSession : public core::RefCounted {
   struct PerStepState {
     bool collect_costs = false;
     bool collect_timeline = false;
+    // Set on the sampled steps that are not otherwise traced.
+    bool collect_lightweight_timeline = false;
     bool collect_rpcs = false;
     Microseconds start_micros = Microseconds(0);
     Microseconds end_micros = Microseconds(0);
@@ -262,13 +262,17 @@ void InMemoryRunGraphRequest::set_graph_handle(const string& handle) {
 
 int64 InMemoryRunGraphRequest::step_id() const { return step_id_; }
 
-void InMemoryRunGraphRequest::set_step_id(int64 step_id) { step_id_ = step_id; }
+void InMemoryRunGraphRequest::set_step_id(int64 step_id) {
+  step_id_ = step_id;
+  proto_version_.reset();
+}
 
 const ExecutorOpts& InMemoryRunGraphRequest::exec_opts() const {
   return exec_opts_;
 }
 
 ExecutorOpts* InMemoryRunGraphRequest::mutable_exec_opts() {
+  proto_version_.reset();
   return &exec_opts_;
 }
 
@@ -292,6 +296,20 @@ Status InMemoryRunGraphRequest::AddSendFromRunStepRequest(
   return Status::OK();
 }
 
+Status InMemoryRunGraphRequest::SetSendFromRunStepRequest(
+    const RunStepRequestWrapper& run_step_request, size_t i,
+    size_t send_index) {
+  proto_version_.reset();
+  return run_step_request.FeedValue(i, &sends_[send_index].second);
+}
+
+void InMemoryRunGraphRequest::ClearSendValues() {
+  proto_version_.reset();
+  for (auto& send : sends_) {
+    send.second = Tensor();
+  }
+}
+
 size_t InMemoryRunGraphRequest::num_recvs() const { return recvs_.size(); }
 
 const string& InMemoryRunGraphRequest::recv_key(size_t i) const {
@@ -387,6 +405,19 @@ Status MutableProtoRunGraphRequest::AddSendFromRunStepRequest(
   return Status::OK();
 }
 
+Status MutableProtoRunGraphRequest::SetSendFromRunStepRequest(
+    const RunStepRequestWrapper& run_step_request, size_t i,
+    size_t send_index) {
+  return run_step_request.FeedValue(
+      i, request_.mutable_send(send_index)->mutable_tensor());
+}
+
+void MutableProtoRunGraphRequest::ClearSendValues() {
+  for (int i = 0; i < request_.send_size(); ++i) {
+    request_.mutable_send(i)->clear_tensor();
+  }
+}
+
 size_t MutableProtoRunGraphRequest::num_recvs() const {
   return request_.recv_key_size();
 }
@@ -485,6 +516,12 @@ void InMemoryRunGraphResponse::AddRecv(const string& key, const Tensor& value) {
   recvs_.emplace_back(key, value);
 }
 
+void InMemoryRunGraphResponse::Clear() {
+  recvs_.clear();
+  step_stats_.Clear();
+  cost_graph_.Clear();
+}
+
 StepStats* InMemoryRunGraphResponse::mutable_step_stats() {
   return &step_stats_;
 }
@@ -527,6 +564,8 @@ void OwnedProtoRunGraphResponse::AddRecv(const string& key,
   value.AsProtoTensorContent(value_proto);
 }
 
+void OwnedProtoRunGraphResponse::Clear() { response_.Clear(); }
+
 StepStats* OwnedProtoRunGraphResponse::mutable_step_stats() {
   return response_.mutable_step_stats();
 }
@@ -571,6 +610,8 @@ void NonOwnedProtoRunGraphResponse::AddRecv(const string& key,
   value.AsProtoTensorContent(value_proto);
 }
 
+void NonOwnedProtoRunGraphResponse::Clear() { response_->Clear(); }
+
 StepStats* NonOwnedProtoRunGraphResponse::mutable_step_stats() {
   return response_->mutable_step_stats();
 }
@@ -272,6 +272,20 @@ class MutableRunGraphRequestWrapper : public RunGraphRequestWrapper {
       const RunStepRequestWrapper& run_step_request, size_t i,
       const string& send_key) = 0;
 
+  // Replaces the value of the `send_index`^{th} send in this request,
+  // which must already have been added, with the i^{th} feed value in
+  // `run_step_request`. This allows a request to be reused across steps
+  // without rebuilding its keys.
+  virtual Status SetSendFromRunStepRequest(
+      const RunStepRequestWrapper& run_step_request, size_t i,
+      size_t send_index) = 0;
+
+  // Drops the values of the sends in this request but keeps their keys,
+  // so that a request kept for reuse does not hold on to the feeds of
+  // the step that last used it. The values must be set again with
+  // SetSendFromRunStepRequest() before the request is sent.
+  virtual void ClearSendValues() = 0;
+
   virtual void add_recv_key(const string& recv_key) = 0;
   virtual void set_is_partial(bool is_partial) = 0;
   virtual void set_is_last_partial_run(bool is_last_partial_run) = 0;
@@ -299,6 +313,10 @@ class InMemoryRunGraphRequest : public MutableRunGraphRequestWrapper {
   Status AddSendFromRunStepRequest(
       const RunStepRequestWrapper& run_step_request, size_t i,
       const string& send_key) override;
+  Status SetSendFromRunStepRequest(
+      const RunStepRequestWrapper& run_step_request, size_t i,
+      size_t send_index) override;
+  void ClearSendValues() override;
   void add_recv_key(const string& recv_key) override;
   void set_is_partial(bool is_partial) override;
   void set_is_last_partial_run(bool is_last_partial_run) override;
@@ -318,7 +336,7 @@ class InMemoryRunGraphRequest : public MutableRunGraphRequestWrapper {
   // NOTE(mrry): Although calls to `ToProto()` on this class are
   // expected to be rare, retaining ownership of the returned message
   // makes it easier to return a reference from the proto-backed
-  // representations.
+  // representations. The setters that a reused request calls drop it.
   mutable std::unique_ptr<RunGraphRequest> proto_version_;
 };
 
@@ -344,6 +362,10 @@ class MutableProtoRunGraphRequest : public MutableRunGraphRequestWrapper {
   Status AddSendFromRunStepRequest(
       const RunStepRequestWrapper& run_step_request, size_t i,
       const string& send_key) override;
+  Status SetSendFromRunStepRequest(
+      const RunStepRequestWrapper& run_step_request, size_t i,
+      size_t send_index) override;
+  void ClearSendValues() override;
   void add_recv_key(const string& recv_key) override;
   void set_is_partial(bool is_partial) override;
   void set_is_last_partial_run(bool is_last_partial_run) override;
@@ -405,6 +427,10 @@ class MutableRunGraphResponseWrapper {
   virtual Status RecvValue(size_t i, Tensor* out_tensor) = 0;
   virtual void AddRecv(const string& key, const Tensor& value) = 0;
 
+  // Removes the recvs and statistics of a previous call, so that this
+  // response can be passed to another RunGraph call.
+  virtual void Clear() = 0;
+
   // Submessages that store performance statistics about the subgraph
   // execution, if necessary.
   virtual StepStats* mutable_step_stats() = 0;
@@ -434,6 +460,7 @@ class InMemoryRunGraphResponse : public MutableRunGraphResponseWrapper {
   Status RecvValue(size_t i, TensorProto* out_tensor) override;
   Status RecvValue(size_t i, Tensor* out_tensor) override;
   void AddRecv(const string& key, const Tensor& value) override;
+  void Clear() override;
   StepStats* mutable_step_stats() override;
   CostGraphDef* mutable_cost_graph() override;
 
@@ -457,6 +484,7 @@ class OwnedProtoRunGraphResponse : public MutableRunGraphResponseWrapper {
   Status RecvValue(size_t i, TensorProto* out_tensor) override;
   Status RecvValue(size_t i, Tensor* out_tensor) override;
   void AddRecv(const string& key, const Tensor& value) override;
+  void Clear() override;
   StepStats* mutable_step_stats() override;
   CostGraphDef* mutable_cost_graph() override;
 
@@ -478,6 +506,7 @@ class NonOwnedProtoRunGraphResponse : public MutableRunGraphResponseWrapper {
   Status RecvValue(size_t i, TensorProto* out_tensor) override;
   Status RecvValue(size_t i, Tensor* out_tensor) override;
   void AddRecv(const string& key, const Tensor& value) override;
+  void Clear() override;
   StepStats* mutable_step_stats() override;
   CostGraphDef* mutable_cost_graph() override;
 
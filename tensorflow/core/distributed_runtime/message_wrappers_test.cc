@@ -216,6 +216,69 @@ TEST(MessageWrappers, RunGraphRequest_Basic) {
   }
 }
 
+// Replaces the feed values of a request built by BuildRunGraphRequest()
+// with those of "run_step_request", in the opposite order.
+static void SwapRunGraphRequestSends(
+    const RunStepRequestWrapper& run_step_request,
+    MutableRunGraphRequestWrapper* run_graph_request) {
+  TF_EXPECT_OK(
+      run_graph_request->SetSendFromRunStepRequest(run_step_request, 1, 0));
+  TF_EXPECT_OK(
+      run_graph_request->SetSendFromRunStepRequest(run_step_request, 0, 1));
+}
+
+static void CheckSwappedRunGraphRequest(const RunGraphRequestWrapper& request) {
+  EXPECT_EQ(2, request.num_sends());
+  EXPECT_EQ("send_0", request.send_key(0));
+  EXPECT_EQ("send_1", request.send_key(1));
+  Tensor val;
+  TF_EXPECT_OK(request.SendValue(0, &val));
+  test::ExpectTensorEqual<int32>(TensorB(), val);
+  TF_EXPECT_OK(request.SendValue(1, &val));
+  test::ExpectTensorEqual<int32>(TensorA(), val);
+  EXPECT_EQ(2, request.num_recvs());
+}
+
+TEST(MessageWrappers, RunGraphRequest_SetSend) {
+  InMemoryRunStepRequest run_step_request;
+  BuildRunStepRequest(&run_step_request);
+
+  InMemoryRunGraphRequest in_memory_request;
+  BuildRunGraphRequest(run_step_request, &in_memory_request);
+  SwapRunGraphRequestSends(run_step_request, &in_memory_request);
+  CheckSwappedRunGraphRequest(in_memory_request);
+
+  MutableProtoRunGraphRequest proto_request;
+  BuildRunGraphRequest(run_step_request, &proto_request);
+  SwapRunGraphRequestSends(run_step_request, &proto_request);
+  CheckSwappedRunGraphRequest(proto_request);
+  CheckSwappedRunGraphRequest(ProtoRunGraphRequest(&proto_request.ToProto()));
+}
+
+TEST(MessageWrappers, RunGraphRequest_ClearSendValues) {
+  InMemoryRunStepRequest run_step_request;
+  BuildRunStepRequest(&run_step_request);
+
+  InMemoryRunGraphRequest in_memory_request;
+  MutableProtoRunGraphRequest proto_request;
+  for (MutableRunGraphRequestWrapper* request :
+       std::vector<MutableRunGraphRequestWrapper*>{&in_memory_request,
+                                                   &proto_request}) {
+    BuildRunGraphRequest(run_step_request, request);
+    request->ClearSendValues();
+    EXPECT_EQ(2, request->num_sends());
+    EXPECT_EQ("send_0", request->send_key(0));
+    EXPECT_EQ("send_1", request->send_key(1));
+    EXPECT_TRUE(request->ToProto().send(0).tensor().tensor_content().empty());
+    EXPECT_TRUE(request->ToProto().send(1).tensor().tensor_content().empty());
+
+    // The cleared sends take the values of the next step.
+    SwapRunGraphRequestSends(run_step_request, request);
+    CheckSwappedRunGraphRequest(*request);
+    CheckSwappedRunGraphRequest(ProtoRunGraphRequest(&request->ToProto()));
+  }
+}
+
 TEST(MessageWrappers, RunGraphResponse_Basic) {
   InMemoryRunGraphResponse in_memory_response;
   BuildRunGraphResponse(&in_memory_response);
@@ -231,6 +294,26 @@ TEST(MessageWrappers, RunGraphResponse_Basic) {
   CheckRunGraphResponse(&non_owned_proto_response);
 }
 
+TEST(MessageWrappers, RunGraphResponse_Clear) {
+  InMemoryRunGraphResponse in_memory_response;
+  OwnedProtoRunGraphResponse owned_proto_response;
+  RunGraphResponse response_proto;
+  NonOwnedProtoRunGraphResponse non_owned_proto_response(&response_proto);
+  for (MutableRunGraphResponseWrapper* response :
+       std::vector<MutableRunGraphResponseWrapper*>{
+           &in_memory_response, &owned_proto_response,
+           &non_owned_proto_response}) {
+    BuildRunGraphResponse(response);
+    response->Clear();
+    EXPECT_EQ(0, response->num_recvs());
+    EXPECT_EQ(0, response->mutable_step_stats()->dev_stats_size());
+    EXPECT_EQ(0, response->mutable_cost_graph()->node_size());
+    // A cleared response can be filled again.
+    BuildRunGraphResponse(response);
+    CheckRunGraphResponse(response);
+  }
+}
+
 TEST(MessageWrappers, RunStepResponse_Basic) {
   {
     // Worker -(in memory)-> Master -(in memory)-> Client.
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_CALL_H_
 #define THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_CALL_H_
 
+#include <deque>
+
 #include "tensorflow/core/platform/macros.h"
 
 #include "grpc++/grpc++.h"
@@ -68,6 +70,12 @@ namespace tensorflow {
 //
 // 4. When the response has been sent, the tag is returned from
 //    `cq_->Next()`, and the call object is deleted.
+//
+// * `ServerStreamingCall<Service, GrpcService, Req, Resp>`: Like
+//   `Call`, but for methods that respond with a stream of messages.
+//   The handler calls `Write()` once per message, from any thread, and
+//   then `Finish()`; the call object is deleted once the stream has
+//   been closed.
 
 // Represents a pending request with unknown message types.
 template <class Service>
@@ -93,13 +101,17 @@ class UntypedCall : public core::RefCounted {
   // the `grpc::ServerContext` associated with the request.
   virtual void RequestCancelled(Service* service, bool ok) = 0;
 
+  // This method will be called when one message of a streamed response
+  // has been written. Only streaming calls write more than one message.
+  virtual void WriteDone(Service* service, bool ok) {}
+
   // Associates a tag in a `::grpc::CompletionQueue` with a callback
   // for an incoming RPC.  An active Tag owns a reference on the corresponding
   // Call object.
   class Tag {
    public:
     // One enum value per supported callback.
-    enum Callback { kRequestReceived, kResponseSent, kCancelled };
+    enum Callback { kRequestReceived, kResponseSent, kCancelled, kWriteDone };
 
     Tag(UntypedCall* call, Callback cb) : call_(call), callback_(cb) {}
 
@@ -117,6 +129,9 @@ class UntypedCall : public core::RefCounted {
         case kCancelled:
           call_->RequestCancelled(service, ok);
           break;
+        case kWriteDone:
+          call_->WriteDone(service, ok);
+          break;
       }
       call_->Unref();  // Ref acquired when tag handed to grpc.
     }
@@ -186,6 +201,10 @@ class Call : public UntypedCall<Service> {
     cancel_callback_ = nullptr;
   }
 
+  // Returns the completion queue on which this call's request was
+  // enqueued. Handlers use it to enqueue the next request for the method.
+  ::grpc::ServerCompletionQueue* cq() const { return cq_; }
+
   // Enqueues a new request for the given service on the given
   // completion queue, using the given `enqueue_function`.
   //
@@ -198,6 +217,7 @@ class Call : public UntypedCall<Service> {
                              bool supports_cancel) {
     auto call = new Call<Service, GrpcService, RequestMessage, ResponseMessage>(
         handle_request_function);
+    call->cq_ = cq;
     if (supports_cancel) {
       call->RegisterCancellationHandler();
     }
@@ -219,6 +239,7 @@ class Call : public UntypedCall<Service> {
       bool supports_cancel) {
     auto call = new Call<Service, GrpcService, RequestMessage, ResponseMessage>(
         handle_request_function);
+    call->cq_ = cq;
     if (supports_cancel) {
       call->RegisterCancellationHandler();
     }
@@ -242,6 +263,7 @@ class Call : public UntypedCall<Service> {
   }
 
   HandleRequestFunction handle_request_function_;
+  ::grpc::ServerCompletionQueue* cq_ = nullptr;  // Not owned.
   ::grpc::ServerContext ctx_;
   ::grpc::ServerAsyncResponseWriter<ResponseMessage> responder_;
 
@@ -256,6 +278,163 @@ class Call : public UntypedCall<Service> {
   std::function<void()> cancel_callback_ GUARDED_BY(mu_);
 };
 
+// Represents a pending call whose response is a stream of messages of
+// type `ResponseMessage`, with a known request-handling method.
+template <class Service, class GrpcService, class RequestMessage,
+          class ResponseMessage>
+class ServerStreamingCall : public UntypedCall<Service> {
+ public:
+  // Represents the generic signature of a `Service::HandleFoo()`
+  // method, where `Foo` is the name of a server-streaming RPC method.
+  using HandleRequestFunction = void (Service::*)(
+      ServerStreamingCall<Service, GrpcService, RequestMessage,
+                          ResponseMessage>*);
+
+  ServerStreamingCall(HandleRequestFunction handle_request_function)
+      : handle_request_function_(handle_request_function), writer_(&ctx_) {}
+
+  virtual ~ServerStreamingCall() {}
+
+  void RequestReceived(Service* service, bool ok) override {
+    if (ok) {
+      this->Ref();
+      (service->*handle_request_function_)(this);
+    }
+  }
+
+  // Queues `message` to be sent after all previously written messages.
+  // May be called from any thread, but not after `Finish()`.
+  void Write(ResponseMessage message) {
+    mutex_lock l(mu_);
+    pending_.push_back(std::move(message));
+    if (!write_in_flight_) {
+      SendNextLocked();
+    }
+  }
+
+  // Closes the stream with `status` once all written messages have been
+  // sent, and releases the reference held by the handler.
+  void Finish(::grpc::Status status) {
+    {
+      mutex_lock l(mu_);
+      finish_status_ = status;
+      finishing_ = true;
+      if (!write_in_flight_) {
+        SendNextLocked();
+      }
+    }
+    this->Unref();
+  }
+
+  void WriteDone(Service* service, bool ok) override {
+    mutex_lock l(mu_);
+    write_in_flight_ = false;
+    if (!ok) {
+      // The stream is broken, so drop the remaining messages.
+      pending_.clear();
+    }
+    SendNextLocked();
+  }
+
+  void RequestCancelled(Service* service, bool ok) override {
+    if (ctx_.IsCancelled()) {
+      mutex_lock l(mu_);
+      if (cancel_callback_) {
+        cancel_callback_();
+      }
+    }
+  }
+
+  // Registers `callback` as the function that should be called if and when this
+  // call is cancelled by the client.
+  void SetCancelCallback(std::function<void()> callback) {
+    mutex_lock l(mu_);
+    cancel_callback_ = std::move(callback);
+  }
+
+  // Clears any cancellation callback that has been registered for this call.
+  void ClearCancelCallback() {
+    mutex_lock l(mu_);
+    cancel_callback_ = nullptr;
+  }
+
+  // Returns the completion queue on which this call's request was
+  // enqueued. Handlers use it to enqueue the next request for the method.
+  ::grpc::ServerCompletionQueue* cq() const { return cq_; }
+
+  // Enqueues a new request for the given service on the given
+  // completion queue, using the given `method_id`.
+  //
+  // The request will be handled with the given
+  // `handle_request_function`.
+  static void EnqueueRequestForMethod(
+      GrpcService* grpc_service, ::grpc::ServerCompletionQueue* cq,
+      int method_id, HandleRequestFunction handle_request_function,
+      bool supports_cancel) {
+    auto call = new ServerStreamingCall<Service, GrpcService, RequestMessage,
+                                        ResponseMessage>(
+        handle_request_function);
+    call->cq_ = cq;
+    if (supports_cancel) {
+      call->RegisterCancellationHandler();
+    }
+
+    // Initial ref for call handed to grpc; released in Tag callback.
+    grpc_service->RequestAsyncServerStreaming(
+        method_id, &call->ctx_, &call->request, &call->writer_, cq, cq,
+        &call->request_received_tag_);
+  }
+
+  RequestMessage request;
+
+ private:
+  // Starts writing the next queued message or, once none are left and
+  // `Finish()` has been called, closes the stream.
+  void SendNextLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (!pending_.empty()) {
+      current_ = std::move(pending_.front());
+      pending_.pop_front();
+      write_in_flight_ = true;
+      this->Ref();  // Ref for grpc; released in Tag callback.
+      writer_.Write(current_, &write_done_tag_);
+    } else if (finishing_) {
+      finishing_ = false;
+      write_in_flight_ = true;  // Nothing may be written after this.
+      this->Ref();              // Ref for grpc; released in Tag callback.
+      writer_.Finish(finish_status_, &response_sent_tag_);
+    }
+  }
+
+  // Creates a completion queue tag for handling cancellation by the client.
+  // NOTE: This method must be called before this call is enqueued on a
+  // completion queue.
+  void RegisterCancellationHandler() {
+    this->Ref();  // Ref for grpc; released in Tag callback.
+    ctx_.AsyncNotifyWhenDone(&cancelled_tag_);
+  }
+
+  HandleRequestFunction handle_request_function_;
+  ::grpc::ServerCompletionQueue* cq_ = nullptr;  // Not owned.
+  ::grpc::ServerContext ctx_;
+  ::grpc::ServerAsyncWriter<ResponseMessage> writer_;
+
+  // Used as void* completion markers from grpc to indicate different
+  // events of interest for a ServerStreamingCall.
+  typedef typename UntypedCall<Service>::Tag Tag;
+  Tag request_received_tag_{this, Tag::kRequestReceived};
+  Tag write_done_tag_{this, Tag::kWriteDone};
+  Tag response_sent_tag_{this, Tag::kResponseSent};
+  Tag cancelled_tag_{this, Tag::kCancelled};
+
+  mutex mu_;
+  std::function<void()> cancel_callback_ GUARDED_BY(mu_);
+  std::deque<ResponseMessage> pending_ GUARDED_BY(mu_);
+  ResponseMessage current_ GUARDED_BY(mu_);  // Being written.
+  bool write_in_flight_ GUARDED_BY(mu_) = false;
+  bool finishing_ GUARDED_BY(mu_) = false;
+  ::grpc::Status finish_status_ GUARDED_BY(mu_);
+};
+
 }  // namespace tensorflow
 
 #endif  // THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_CALL_H_
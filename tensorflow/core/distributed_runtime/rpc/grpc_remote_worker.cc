@@ -46,6 +46,9 @@ class GrpcRemoteWorker : public WorkerInterface {
         cleanupgraph_(Method(GrpcWorkerMethod::kCleanupGraph)),
         cleanupall_(Method(GrpcWorkerMethod::kCleanupAll)),
         recvtensor_(Method(GrpcWorkerMethod::kRecvTensor)),
+        recvtensors_(::grpc::RpcMethod(
+            GrpcWorkerMethodName(GrpcWorkerMethod::kRecvTensors),
+            ::grpc::RpcMethod::SERVER_STREAMING, channel_)),
         logging_(Method(GrpcWorkerMethod::kLogging)),
         tracing_(Method(GrpcWorkerMethod::kTracing)),
         logger_(logger) {}
@@ -120,39 +123,8 @@ class GrpcRemoteWorker : public WorkerInterface {
       wrapper_done = [this, request, req_copy, response, done,
                       start_usec](Status s) {
         if (logger_->LoggingActive()) {
-          int64 end_usec = Env::Default()->NowMicros();
-          int64 step_id = request->step_id();
-          int64 bytes = response->tensor().TotalBytes();
-          int64 send_start_usec = start_usec;
-          // If a send start time was reported by the other side, use
-          // that instead.  Maybe we should mark the display if we're using
-          // our local time instead of the remote start time?
-          if (response->metadata().send_start_micros()) {
-            // send_start_micros is the timestamp taken when the
-            // remote machine began to send the RecvTensor response.
-            // Due to clock skew between source and dest machines, it
-            // is possible that send_start_micros can be larger than
-            // end_usec or less than start_usec.
-            //
-            // To respect causality, we enforce the invariants that
-            // the RecvTensor response can not have been sent before
-            // the RecvTensor request, and must have been sent before
-            // it was received.
-            send_start_usec = std::max(start_usec, static_cast<int64>(
-                response->metadata().send_start_micros()));
-            send_start_usec = std::min(send_start_usec, end_usec - 1);
-          }
-          const string& key = request->rendezvous_key();
-          std::vector<string> key_parts = str_util::Split(key, ';');
-          if (key_parts.size() != 5) {
-            LOG(WARNING) << "Bad key: " << key;
-          } else {
-            logger_->RecordRecvTensor(step_id, send_start_usec, end_usec,
-                                      key_parts[3],  // tensor name
-                                      key_parts[0],  // src_device
-                                      key_parts[2],  // dst_device
-                                      bytes);
-          }
+          LogRecvTensor(request->step_id(), request->rendezvous_key(),
+                        start_usec, *response);
         }
         VLOG(2) << "done callback, req: " << request->DebugString()
                 << " response " << response->metadata().DebugString();
@@ -166,6 +138,32 @@ class GrpcRemoteWorker : public WorkerInterface {
                  std::move(*cb_to_use), call_opts);
   }
 
+  void RecvTensorsAsync(CallOptions* call_opts,
+                        const RecvTensorsRequest* request,
+                        TensorResponse* response,
+                        std::function<void()> on_tensor,
+                        StatusCallback done) override {
+    VLOG(1) << "RecvTensorsAsync req: " << request->DebugString();
+    const int64 start_usec = Env::Default()->NowMicros();
+    std::function<void()> wrapped_on_tensor;
+    if (logger_->LoggingActive()) {
+      wrapped_on_tensor = [this, request, response, on_tensor, start_usec]() {
+        const int key_index = response->metadata().key_index();
+        if (logger_->LoggingActive() && key_index >= 0 &&
+            key_index < request->rendezvous_key_size()) {
+          LogRecvTensor(request->step_id(), request->rendezvous_key(key_index),
+                        start_usec, *response);
+        }
+        on_tensor();
+      };
+    } else {
+      wrapped_on_tensor = std::move(on_tensor);
+    }
+    new StreamingRPCState<RecvTensorsRequest, TensorResponse>(
+        channel_.get(), cq_, recvtensors_, *request, response,
+        std::move(wrapped_on_tensor), std::move(done), call_opts);
+  }
+
   void LoggingAsync(const LoggingRequest* request, LoggingResponse* response,
                     StatusCallback done) override {
     IssueRequest(request, response, logging_, done);
@@ -224,6 +222,130 @@ class GrpcRemoteWorker : public WorkerInterface {
     }
   };
 
+  // Object allocated per active server-streaming RPC. Each message of
+  // the stream is read into the same response object, and handed to
+  // `on_message` before the next one is read.
+  template <class RequestMessage, class ResponseMessage>
+  class StreamingRPCState {
+   public:
+    StreamingRPCState(::grpc::ChannelInterface* channel,
+                      ::grpc::CompletionQueue* cq,
+                      const ::grpc::RpcMethod& method,
+                      const RequestMessage& request, ResponseMessage* response,
+                      std::function<void()> on_message, StatusCallback done,
+                      CallOptions* call_opts)
+        : call_opts_(call_opts),
+          response_(response),
+          on_message_(std::move(on_message)),
+          done_(std::move(done)),
+          reader_(channel, cq, method, InitContext(call_opts), request,
+                  &started_tag_) {}
+
+   private:
+    // Unlike RPCState, which is its own tag, a stream completes several
+    // operations, each of which forwards to `state_`. The tags are owned
+    // by the state rather than deleted when they complete.
+    class Tag : public GrpcClientCQTag {
+     public:
+      typedef void (StreamingRPCState::*Callback)(bool ok);
+      Tag(StreamingRPCState* state, Callback callback)
+          : state_(state), callback_(callback) {}
+      void OnCompleted(bool ok) override { (state_->*callback_)(ok); }
+
+     private:
+      StreamingRPCState* const state_;
+      const Callback callback_;
+    };
+
+    void OnStarted(bool ok) {
+      if (ok) {
+        reader_.Read(response_, &read_tag_);
+      } else {
+        reader_.Finish(&status_, &finished_tag_);
+      }
+    }
+
+    void OnRead(bool ok) {
+      if (ok) {
+        on_message_();
+        reader_.Read(response_, &read_tag_);
+      } else {
+        // The server has closed the stream.
+        reader_.Finish(&status_, &finished_tag_);
+      }
+    }
+
+    void OnFinished(bool ok) {
+      if (!ok) {
+        VLOG(2) << "Call returned with non-ok status: "
+                << status_.error_message();
+      }
+      if (call_opts_) {
+        call_opts_->ClearCancelCallback();
+      }
+      done_(FromGrpcStatus(status_));
+      delete this;
+    }
+
+    ::grpc::ClientContext* InitContext(CallOptions* call_opts) {
+      // The initialization and recovery protocols rely on blocking
+      // until we get a response.
+      context_.set_fail_fast(false);
+      if (call_opts) {
+        call_opts->SetCancelCallback([this]() { context_.TryCancel(); });
+      }
+      return &context_;
+    }
+
+    CallOptions* call_opts_;
+    ResponseMessage* response_;
+    std::function<void()> on_message_;
+    StatusCallback done_;
+    Tag started_tag_{this, &StreamingRPCState::OnStarted};
+    Tag read_tag_{this, &StreamingRPCState::OnRead};
+    Tag finished_tag_{this, &StreamingRPCState::OnFinished};
+    ::grpc::ClientContext context_;
+    ::grpc::ClientAsyncReader<ResponseMessage> reader_;
+    ::grpc::Status status_;
+  };
+
+  // Records a completed RecvTensor in the WorkerCacheLogger.
+  void LogRecvTensor(int64 step_id, const string& key, int64 start_usec,
+                     const TensorResponse& response) {
+    int64 end_usec = Env::Default()->NowMicros();
+    int64 bytes = response.tensor().TotalBytes();
+    int64 send_start_usec = start_usec;
+    // If a send start time was reported by the other side, use
+    // that instead.  Maybe we should mark the display if we're using
+    // our local time instead of the remote start time?
+    if (response.metadata().send_start_micros()) {
+      // send_start_micros is the timestamp taken when the
+      // remote machine began to send the RecvTensor response.
+      // Due to clock skew between source and dest machines, it
+      // is possible that send_start_micros can be larger than
+      // end_usec or less than start_usec.
+      //
+      // To respect causality, we enforce the invariants that
+      // the RecvTensor response can not have been sent before
+      // the RecvTensor request, and must have been sent before
+      // it was received.
+      send_start_usec = std::max(
+          start_usec,
+          static_cast<int64>(response.metadata().send_start_micros()));
+      send_start_usec = std::min(send_start_usec, end_usec - 1);
+    }
+    std::vector<string> key_parts = str_util::Split(key, ';');
+    if (key_parts.size() != 5) {
+      LOG(WARNING) << "Bad key: " << key;
+    } else {
+      logger_->RecordRecvTensor(step_id, send_start_usec, end_usec,
+                                key_parts[3],  // tensor name
+                                key_parts[0],  // src_device
+                                key_parts[2],  // dst_device
+                                bytes);
+    }
+  }
+
   // Utility method for issuing a generic asynchronous request. The
   // given callback, `done`, will be called when the RPC completes.
   template <class RequestMessage, class ResponseMessage>
@@ -251,6 +373,7 @@ class GrpcRemoteWorker : public WorkerInterface {
   const ::grpc::RpcMethod cleanupgraph_;
   const ::grpc::RpcMethod cleanupall_;
   const ::grpc::RpcMethod recvtensor_;
+  const ::grpc::RpcMethod recvtensors_;
   const ::grpc::RpcMethod logging_;
   const ::grpc::RpcMethod tracing_;
 
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <limits>
 #include <memory>
+#include <vector>
 
 #include "grpc++/grpc++.h"
 #include "grpc++/security/credentials.h"
@@ -37,11 +38,14 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/rpc/grpc_worker_cache.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service.h"
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory.h"
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_worker_cache.h"
 #include "tensorflow/core/distributed_runtime/server_lib.h"
 #include "tensorflow/core/distributed_runtime/worker_env.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/host_info.h"
 #include "tensorflow/core/platform/mem.h"
 #include "tensorflow/core/public/session_options.h"
 
@@ -61,6 +65,14 @@ class NoReusePortOption : public ::grpc::ServerBuilderOption {
                          plugins) override {}
 };
 
+// Returns true if "host_port" names a port on the host of this process.
+bool IsLocalHostPort(const string& host_port) {
+  const std::vector<string> parts = str_util::Split(host_port, ':');
+  if (parts.empty() || parts[0].empty()) return false;
+  const string& host = parts[0];
+  return host == "localhost" || host == "127.0.0.1" || host == port::Hostname();
+}
+
 }  // namespace
 
 GrpcServer::GrpcServer(const ServerDef& server_def, Env* env)
@@ -165,7 +177,19 @@ Status GrpcServer::Init() {
   master_impl_ = CreateMaster(&master_env_);
   master_service_ = NewGrpcMasterService(master_impl_.get(), &builder);
   worker_impl_.reset(NewGrpcWorker(&worker_env_));
-  worker_service_ = NewGrpcWorkerService(worker_impl_.get(), &builder);
+  GrpcWorkerServiceOptions worker_service_options;
+  const RPCOptions& rpc_options = sess_opts.config.rpc_options();
+  if (rpc_options.num_worker_service_threads() > 0) {
+    worker_service_options.num_serving_threads =
+        rpc_options.num_worker_service_threads();
+    worker_service_options.handle_nonblocking_calls_inline = true;
+  }
+  worker_service_options.pin_serving_threads =
+      rpc_options.pin_worker_service_threads();
+  worker_service_options.accept_shared_memory_transport =
+      rpc_options.use_shared_memory_transport();
+  worker_service_ = NewGrpcWorkerService(worker_impl_.get(), &builder,
+                                         worker_service_options);
   server_ = builder.BuildAndStart();
 
   if (!server_) {
@@ -203,6 +227,35 @@ Status GrpcServer::Init() {
   }
   worker_env_.worker_cache = NewGrpcWorkerCacheWithLocalWorker(
       channel_cache.release(), worker_impl_.get(), name_prefix);
+  if (rpc_options.use_shared_memory_transport()) {
+    std::vector<string> colocated_targets;
+    for (const auto& job : server_def_.cluster().job()) {
+      for (const auto& task : job.tasks()) {
+        const string target = strings::StrCat("/job:", job.name(),
+                                              "/replica:0/task:", task.first);
+        if (target != name_prefix && IsLocalHostPort(task.second)) {
+          colocated_targets.push_back(target);
+        }
+      }
+    }
+    if (!colocated_targets.empty()) {
+      std::unique_ptr<SharedMemoryRing> ring;
+      Status s = SharedMemoryRing::Create(
+          rpc_options.shared_memory_num_slots() > 0
+              ? rpc_options.shared_memory_num_slots()
+              : 256,
+          rpc_options.shared_memory_slot_bytes() > 0
+              ? rpc_options.shared_memory_slot_bytes()
+              : 64 << 10,
+          &ring);
+      if (s.ok()) {
+        worker_env_.worker_cache = NewSharedMemoryWorkerCache(
+            worker_env_.worker_cache, std::move(ring), colocated_targets);
+      } else {
+        LOG(WARNING) << "Not using the shared memory transport: " << s;
+      }
+    }
+  }
 
   // Finish setting up master environment.
   master_env_.ops = OpRegistry::Global();
@@ -215,9 +268,12 @@ Status GrpcServer::Init() {
   };
 
   // Finish setting up worker environment.
-  worker_env_.graph_mgr = new GraphMgr(&worker_env_);
+  worker_env_.graph_mgr = new GraphMgr(
+      &worker_env_,
+      sess_opts.config.graph_options().registered_graph_cache_size());
   worker_env_.compute_pool = ComputePool(sess_opts);
-  worker_env_.rendezvous_mgr = new RpcRendezvousMgr(&worker_env_);
+  worker_env_.rendezvous_mgr =
+      new RpcRendezvousMgr(&worker_env_, sess_opts.config.rpc_options());
 
   // Provide direct access to the master from in-process clients.
   LocalMaster::Register(target(), master_impl_.get());
@@ -15,21 +15,27 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_session.h"
 
+#include <algorithm>
+
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_testlib.h"
+#include "tensorflow/core/distributed_runtime/server_lib.h"
 #include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/graph/default_device.h"
 #include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/lib/core/error_codes.pb.h"
+#include "tensorflow/core/lib/monitoring/collection_registry.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/init_main.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/protobuf/master.pb.h"
+#include "tensorflow/core/protobuf/tensorflow_server.pb.h"
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/util/port.h"
 
@@ -85,6 +91,69 @@ static Session* NewRemote(const SessionOptions& options) {
   return CHECK_NOTNULL(NewSession(options));
 }
 
+// Starts one server of job "localhost" in this process per entry of
+// "configs", with that entry as its default session config, and returns
+// their targets. Unlike test::TestCluster, this lets a test configure the
+// workers and read their counters. Started servers cannot be shut down, so
+// they are leaked.
+static std::vector<string> StartLocalCluster(
+    const std::vector<ConfigProto>& configs) {
+  const int num_tasks = configs.size();
+  std::vector<string> targets;
+  for (int i = 0; i < num_tasks; ++i) {
+    targets.push_back(
+        strings::StrCat("localhost:", testing::PickUnusedPortOrDie()));
+  }
+  for (int i = 0; i < num_tasks; ++i) {
+    ServerDef server_def;
+    server_def.set_protocol("grpc");
+    server_def.set_job_name("localhost");
+    server_def.set_task_index(i);
+    JobDef* job_def = server_def.mutable_cluster()->add_job();
+    job_def->set_name("localhost");
+    for (int j = 0; j < num_tasks; ++j) {
+      (*job_def->mutable_tasks())[j] = targets[j];
+    }
+    *server_def.mutable_default_session_config() = configs[i];
+    (*server_def.mutable_default_session_config()
+          ->mutable_device_count())["CPU"] = 1;
+    std::unique_ptr<ServerInterface> server;
+    TF_CHECK_OK(NewServer(server_def, &server));
+    TF_CHECK_OK(server->Start());
+    server.release();
+  }
+  return targets;
+}
+
+// Same as above, with "num_tasks" servers that all use "config".
+static std::vector<string> StartLocalCluster(const ConfigProto& config,
+                                             int num_tasks) {
+  return StartLocalCluster(std::vector<ConfigProto>(num_tasks, config));
+}
+
+// Returns the CPU device of "task" in a cluster from StartLocalCluster().
+static string LocalClusterDevice(int task) {
+  return strings::StrCat("/job:localhost/replica:0/task:", task, "/cpu:0");
+}
+
+// Returns the value of the counter "metric_name" in this process for
+// "label", or 0 if it has not been incremented. An empty label selects the
+// value of a counter without labels.
+static int64 CounterValue(const string& metric_name, const string& label) {
+  std::unique_ptr<monitoring::CollectedMetrics> collected =
+      monitoring::CollectionRegistry::Default()->CollectMetrics({});
+  auto it = collected->point_set_map.find(metric_name);
+  if (it == collected->point_set_map.end()) return 0;
+  for (const auto& point : it->second->points) {
+    if (label.empty() ? point->labels.empty()
+                      : (point->labels.size() == 1 &&
+                         point->labels[0].value == label)) {
+      return point->int64_value;
+    }
+  }
+  return 0;
+}
+
 TEST(GrpcSessionTest, BasicNonProtoAPI) {
   GraphDef graph;
   string node_names[3];
@@ -388,6 +457,471 @@ TEST(GrpcSessionTest, LargeTensorSend) {
   TF_CHECK_OK(session->Close());
 }
 
+TEST(GrpcSessionTest, BatchedRecvTensors) {
+  // Coalesce the recvs of each step into RecvTensors calls of at most 8
+  // tensors.
+  ConfigProto config;
+  config.mutable_rpc_options()->set_recv_batch_window_usecs(2000);
+  config.mutable_rpc_options()->set_recv_batch_max_size(8);
+  const std::vector<string> targets = StartLocalCluster(config, 2);
+  const string dev_a = LocalClusterDevice(0);
+  const string dev_b = LocalClusterDevice(1);
+
+  // "sum" on B adds 20 constants from A and "z", which A produces only
+  // after it has received "y" from B, which in turn needs "x" from A.
+  // The recvs of "x" and "z" may be in the same batch, so tensors must be
+  // returned as they become available for the step to finish.
+  Graph graph(OpRegistry::Global());
+  Tensor x_tensor(DT_FLOAT, TensorShape({}));
+  x_tensor.scalar<float>()() = 1000;
+  Node* x = test::graph::Constant(&graph, x_tensor);
+  Node* y = test::graph::Identity(&graph, x);
+  Node* z = test::graph::Identity(&graph, y);
+  std::vector<NodeBuilder::NodeOut> addends = {z};
+  for (int i = 0; i < 20; ++i) {
+    Tensor c_tensor(DT_FLOAT, TensorShape({}));
+    c_tensor.scalar<float>()() = i;
+    addends.emplace_back(test::graph::Constant(&graph, c_tensor));
+  }
+  Node* sum;
+  TF_CHECK_OK(
+      NodeBuilder("sum", "AddN").Input(addends).Finalize(&graph, &sum));
+
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  for (NodeDef& node : *def.mutable_node()) {
+    node.set_device(node.name() == y->name() || node.name() == sum->name()
+                        ? dev_b
+                        : dev_a);
+  }
+
+  const char* kRpcs = "/tensorflow/core/rpc_recv_tensor_rpcs";
+  const char* kTensors = "/tensorflow/core/rpc_recv_tensor_count";
+  const int64 single_rpcs_before = CounterValue(kRpcs, "RecvTensor");
+  const int64 batch_rpcs_before = CounterValue(kRpcs, "RecvTensors");
+  const int64 batch_tensors_before = CounterValue(kTensors, "RecvTensors");
+
+  std::unique_ptr<Session> session(NewRemote(Options(targets[0], 1)));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(def));
+  const int kSteps = 10;
+  for (int step = 0; step < kSteps; ++step) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {sum->name()}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    IsSingleFloatValue(outputs[0], 1000 + 190);
+  }
+  TF_CHECK_OK(session->Close());
+
+  // Every recv went through a RecvTensors call. In each step B receives
+  // "x", "z" and the 20 constants from A, which take at least 3 calls of 8,
+  // and A receives "y".
+  const int64 batch_rpcs = CounterValue(kRpcs, "RecvTensors") -
+                           batch_rpcs_before;
+  const int64 batch_tensors = CounterValue(kTensors, "RecvTensors") -
+                              batch_tensors_before;
+  EXPECT_EQ(single_rpcs_before, CounterValue(kRpcs, "RecvTensor"));
+  EXPECT_EQ(23 * kSteps, batch_tensors);
+  EXPECT_GE(batch_rpcs, 4 * kSteps);
+  EXPECT_LT(batch_rpcs, batch_tensors);
+}
+
+TEST(GrpcSessionTest, WorkerServiceThreads) {
+  // With more than the default polling thread, GetStatus and RecvTensor are
+  // handled on the polling threads instead of the compute pool.
+  ConfigProto config;
+  config.mutable_rpc_options()->set_num_worker_service_threads(4);
+  const std::vector<string> targets = StartLocalCluster(config, 2);
+
+  std::unique_ptr<GrpcSession> session;
+  TF_CHECK_OK(GrpcSession::Create(Options(targets[0], 1), &session));
+  // Listing the devices calls GetStatus on both workers.
+  EXPECT_EQ(2, session->ListDevices().size());
+
+  // "b" on task 1 receives "a" from task 0, which receives "b" back.
+  Graph graph(OpRegistry::Global());
+  Tensor a_tensor(DT_FLOAT, TensorShape({}));
+  a_tensor.scalar<float>()() = 42;
+  Node* a = test::graph::Constant(&graph, a_tensor);
+  Node* b = test::graph::Identity(&graph, a);
+  Node* c = test::graph::Identity(&graph, b);
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  SetDevice(&def, a->name(), LocalClusterDevice(0));
+  SetDevice(&def, b->name(), LocalClusterDevice(1));
+  SetDevice(&def, c->name(), LocalClusterDevice(0));
+
+  const char* kRpcs = "/tensorflow/core/rpc_recv_tensor_rpcs";
+  const int64 rpcs_before = CounterValue(kRpcs, "RecvTensor");
+  TF_CHECK_OK(session->Create(def));
+  const int kSteps = 20;
+  for (int step = 0; step < kSteps; ++step) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {c->name()}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    IsSingleFloatValue(outputs[0], 42);
+  }
+  TF_CHECK_OK(session->Close());
+  EXPECT_EQ(2 * kSteps, CounterValue(kRpcs, "RecvTensor") - rpcs_before);
+}
+
+TEST(GrpcSessionTest, WorkerServiceThreadsWithCompression) {
+  // A RecvTensor call that asks for compression is handled on the compute
+  // pool even with several polling threads, and still gets its tensor.
+  ConfigProto config;
+  RPCOptions* rpc_options = config.mutable_rpc_options();
+  rpc_options->set_num_worker_service_threads(4);
+  rpc_options->mutable_recv_tensor_compression()->set_float_codec(
+      TensorCompressionOptions::ZLIB);
+  const std::vector<string> targets = StartLocalCluster(config, 2);
+
+  Graph graph(OpRegistry::Global());
+  Tensor a_tensor(DT_FLOAT, TensorShape({64, 1024}));
+  for (int i = 0; i < 64 * 1024; ++i) a_tensor.flat<float>()(i) = i % 100;
+  Node* a = test::graph::Constant(&graph, a_tensor);
+  Node* b = test::graph::Identity(&graph, a);
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  SetDevice(&def, a->name(), LocalClusterDevice(0));
+  SetDevice(&def, b->name(), LocalClusterDevice(1));
+
+  std::unique_ptr<Session> session(NewRemote(Options(targets[0], 1)));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(def));
+  for (int step = 0; step < 5; ++step) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {b->name()}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    test::ExpectTensorEqual<float>(a_tensor, outputs[0]);
+  }
+  TF_CHECK_OK(session->Close());
+}
+
+TEST(GrpcSessionTest, SharedMemoryTransport) {
+  // Tensors of up to 1 KiB are copied into a slot of the receiver's ring;
+  // larger ones are handed over in a segment of their own.
+  ConfigProto config;
+  config.mutable_rpc_options()->set_use_shared_memory_transport(true);
+  config.mutable_rpc_options()->set_shared_memory_slot_bytes(1024);
+  const std::vector<string> targets = StartLocalCluster(config, 2);
+
+  // Task 1 receives "small" and "large" from task 0.
+  Graph graph(OpRegistry::Global());
+  Tensor small_tensor(DT_FLOAT, TensorShape({16}));
+  for (int i = 0; i < 16; ++i) small_tensor.flat<float>()(i) = i;
+  Tensor large_tensor(DT_FLOAT, TensorShape({64, 1024}));
+  for (int i = 0; i < 64 * 1024; ++i) large_tensor.flat<float>()(i) = -i;
+  Node* small = test::graph::Constant(&graph, small_tensor);
+  Node* large = test::graph::Constant(&graph, large_tensor);
+  Node* small_copy = test::graph::Identity(&graph, small);
+  Node* large_copy = test::graph::Identity(&graph, large);
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  SetDevice(&def, small->name(), LocalClusterDevice(0));
+  SetDevice(&def, large->name(), LocalClusterDevice(0));
+  SetDevice(&def, small_copy->name(), LocalClusterDevice(1));
+  SetDevice(&def, large_copy->name(), LocalClusterDevice(1));
+
+  const char* kShmTensors = "/tensorflow/core/shared_memory_recv_tensors";
+  const int64 slots_before = CounterValue(kShmTensors, "slot");
+  const int64 segments_before = CounterValue(kShmTensors, "segment");
+
+  std::unique_ptr<Session> session(NewRemote(Options(targets[0], 1)));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(def));
+  const int kSteps = 5;
+  for (int step = 0; step < kSteps; ++step) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {small_copy->name(), large_copy->name()}, {},
+                             &outputs));
+    ASSERT_EQ(2, outputs.size());
+    test::ExpectTensorEqual<float>(small_tensor, outputs[0]);
+    test::ExpectTensorEqual<float>(large_tensor, outputs[1]);
+  }
+  TF_CHECK_OK(session->Close());
+
+  EXPECT_EQ(kSteps, CounterValue(kShmTensors, "slot") - slots_before);
+  EXPECT_EQ(kSteps, CounterValue(kShmTensors, "segment") - segments_before);
+}
+
+TEST(GrpcSessionTest, SharedMemoryTransportNotEnabledBySender) {
+  // Task 1 asks for its tensors in shared memory, but task 0, which sends
+  // them, was not configured to use it.
+  ConfigProto config;
+  config.mutable_rpc_options()->set_use_shared_memory_transport(true);
+  config.mutable_rpc_options()->set_shared_memory_slot_bytes(1024);
+  const std::vector<string> targets =
+      StartLocalCluster({ConfigProto(), config});
+
+  Graph graph(OpRegistry::Global());
+  Tensor small_tensor(DT_FLOAT, TensorShape({16}));
+  for (int i = 0; i < 16; ++i) small_tensor.flat<float>()(i) = i;
+  Tensor large_tensor(DT_FLOAT, TensorShape({64, 1024}));
+  for (int i = 0; i < 64 * 1024; ++i) large_tensor.flat<float>()(i) = -i;
+  Node* small = test::graph::Constant(&graph, small_tensor);
+  Node* large = test::graph::Constant(&graph, large_tensor);
+  Node* small_copy = test::graph::Identity(&graph, small);
+  Node* large_copy = test::graph::Identity(&graph, large);
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  SetDevice(&def, small->name(), LocalClusterDevice(0));
+  SetDevice(&def, large->name(), LocalClusterDevice(0));
+  SetDevice(&def, small_copy->name(), LocalClusterDevice(1));
+  SetDevice(&def, large_copy->name(), LocalClusterDevice(1));
+
+  const char* kShmTensors = "/tensorflow/core/shared_memory_recv_tensors";
+  const int64 slots_before = CounterValue(kShmTensors, "slot");
+  const int64 segments_before = CounterValue(kShmTensors, "segment");
+
+  std::unique_ptr<Session> session(NewRemote(Options(targets[0], 1)));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(def));
+  for (int step = 0; step < 3; ++step) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {small_copy->name(), large_copy->name()}, {},
+                             &outputs));
+    ASSERT_EQ(2, outputs.size());
+    test::ExpectTensorEqual<float>(small_tensor, outputs[0]);
+    test::ExpectTensorEqual<float>(large_tensor, outputs[1]);
+  }
+  TF_CHECK_OK(session->Close());
+
+  // Both tensors were sent over RPC.
+  EXPECT_EQ(0, CounterValue(kShmTensors, "slot") - slots_before);
+  EXPECT_EQ(0, CounterValue(kShmTensors, "segment") - segments_before);
+}
+
+TEST(GrpcSessionTest, SharedMemoryTransportWithoutRing) {
+  ConfigProto config;
+  config.mutable_rpc_options()->set_use_shared_memory_transport(true);
+  config.mutable_rpc_options()->set_shared_memory_slot_bytes(1024);
+  const string kRingPattern = "/dev/shm/tf_shm_*_ring";
+  std::vector<string> old_rings;
+  TF_CHECK_OK(Env::Default()->GetMatchingPaths(kRingPattern, &old_rings));
+  const std::vector<string> targets = StartLocalCluster(config, 2);
+
+  // Unlinks the rings of the new servers, so that no sender can map them,
+  // as if each receiver were in an IPC namespace of its own.
+  std::vector<string> rings;
+  TF_CHECK_OK(Env::Default()->GetMatchingPaths(kRingPattern, &rings));
+  std::vector<string> new_rings;
+  for (const string& ring : rings) {
+    if (std::find(old_rings.begin(), old_rings.end(), ring) ==
+        old_rings.end()) {
+      TF_CHECK_OK(Env::Default()->DeleteFile(ring));
+      new_rings.push_back(ring);
+    }
+  }
+  ASSERT_EQ(2, new_rings.size());
+
+  // Task 1 receives "large", which does not fit in a slot, from task 0.
+  Graph graph(OpRegistry::Global());
+  Tensor large_tensor(DT_FLOAT, TensorShape({64, 1024}));
+  for (int i = 0; i < 64 * 1024; ++i) large_tensor.flat<float>()(i) = -i;
+  Node* large = test::graph::Constant(&graph, large_tensor);
+  Node* large_copy = test::graph::Identity(&graph, large);
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  SetDevice(&def, large->name(), LocalClusterDevice(0));
+  SetDevice(&def, large_copy->name(), LocalClusterDevice(1));
+
+  const char* kShmTensors = "/tensorflow/core/shared_memory_recv_tensors";
+  const int64 slots_before = CounterValue(kShmTensors, "slot");
+  const int64 segments_before = CounterValue(kShmTensors, "segment");
+
+  std::unique_ptr<Session> session(NewRemote(Options(targets[0], 1)));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(def));
+  for (int step = 0; step < 3; ++step) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {large_copy->name()}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    test::ExpectTensorEqual<float>(large_tensor, outputs[0]);
+  }
+  TF_CHECK_OK(session->Close());
+
+  // The tensor was sent over RPC, and no segment was left behind.
+  EXPECT_EQ(0, CounterValue(kShmTensors, "slot") - slots_before);
+  EXPECT_EQ(0, CounterValue(kShmTensors, "segment") - segments_before);
+  for (const string& ring : new_rings) {
+    const string prefix = ring.substr(0, ring.rfind('_'));
+    std::vector<string> segments;
+    TF_CHECK_OK(Env::Default()->GetMatchingPaths(
+        strings::StrCat(prefix, "_[0-9]*"), &segments));
+    EXPECT_EQ(0, segments.size()) << prefix;
+  }
+}
+
+TEST(GrpcSessionTest, SameGraphWithDifferentFeeds) {
+  const std::vector<string> targets = StartLocalCluster(ConfigProto(), 2);
+
+  // "a" is fed on task 0 and "b" on task 1, and each is copied to the
+  // other task.
+  Graph graph(OpRegistry::Global());
+  Tensor zero(DT_FLOAT, TensorShape({}));
+  zero.scalar<float>()() = 0;
+  Node* a = test::graph::Constant(&graph, zero);
+  Node* b = test::graph::Constant(&graph, zero);
+  Node* a_copy = test::graph::Identity(&graph, a);
+  Node* b_copy = test::graph::Identity(&graph, b);
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  SetDevice(&def, a->name(), LocalClusterDevice(0));
+  SetDevice(&def, b->name(), LocalClusterDevice(1));
+  SetDevice(&def, a_copy->name(), LocalClusterDevice(1));
+  SetDevice(&def, b_copy->name(), LocalClusterDevice(0));
+
+  std::unique_ptr<Session> session(NewRemote(Options(targets[0], 1)));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(def));
+  // Every step after the first reuses the RunGraph requests of an earlier
+  // one, so each must send its own feeds rather than those of the step
+  // that last used the requests.
+  for (int step = 0; step < 10; ++step) {
+    Tensor a_value(DT_FLOAT, TensorShape({}));
+    a_value.scalar<float>()() = step;
+    Tensor b_value(DT_FLOAT, TensorShape({}));
+    b_value.scalar<float>()() = -10 * step;
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run(
+        {{strings::StrCat(a->name(), ":0"), a_value},
+         {strings::StrCat(b->name(), ":0"), b_value}},
+        {a_copy->name(), b_copy->name()}, {}, &outputs));
+    ASSERT_EQ(2, outputs.size());
+    IsSingleFloatValue(outputs[0], step);
+    IsSingleFloatValue(outputs[1], -10 * step);
+  }
+  TF_CHECK_OK(session->Close());
+}
+
+// Returns a graph on "device" whose node "*fetch_name" is a copy of the
+// scalar "value".
+static GraphDef ConstantCopyGraph(float value, const string& device,
+                                  string* fetch_name) {
+  Graph graph(OpRegistry::Global());
+  Tensor tensor(DT_FLOAT, TensorShape({}));
+  tensor.scalar<float>()() = value;
+  Node* copy =
+      test::graph::Identity(&graph, test::graph::Constant(&graph, tensor));
+  *fetch_name = copy->name();
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  graph::SetDefaultDevice(device, &def);
+  return def;
+}
+
+TEST(GrpcSessionTest, RegisteredGraphCache) {
+  ConfigProto config;
+  config.mutable_graph_options()->set_registered_graph_cache_size(4);
+  const std::vector<string> targets = StartLocalCluster(config, 1);
+
+  // A seeded random op keeps the state of its generator in its kernel.
+  Graph graph(OpRegistry::Global());
+  Tensor shape(DT_INT32, TensorShape({1}));
+  shape.flat<int32>()(0) = 8;
+  Node* random;
+  TF_CHECK_OK(NodeBuilder(graph.NewName("n"), "RandomUniform")
+                  .Input(test::graph::Constant(&graph, shape))
+                  .Attr("dtype", DT_FLOAT)
+                  .Attr("seed", 17)
+                  .Attr("seed2", 42)
+                  .Finalize(&graph, &random));
+  Node* copy = test::graph::Identity(&graph, random);
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  graph::SetDefaultDevice(LocalClusterDevice(0), &def);
+
+  const char* kLookups = "/tensorflow/core/graph_mgr_cache_lookups";
+  const int64 hits_before = CounterValue(kLookups, "hit");
+  const int64 misses_before = CounterValue(kLookups, "miss");
+
+  std::unique_ptr<Session> first(NewRemote(Options(targets[0], 1)));
+  TF_CHECK_OK(first->Create(def));
+  std::vector<Tensor> first_outputs;
+  TF_CHECK_OK(first->Run({}, {copy->name()}, {}, &first_outputs));
+  EXPECT_EQ(1, CounterValue(kLookups, "miss") - misses_before);
+  EXPECT_EQ(0, CounterValue(kLookups, "hit") - hits_before);
+
+  // Another session registers the same graph, and reuses the first one's.
+  std::unique_ptr<Session> second(NewRemote(Options(targets[0], 1)));
+  TF_CHECK_OK(second->Create(def));
+  std::vector<Tensor> second_outputs;
+  TF_CHECK_OK(second->Run({}, {copy->name()}, {}, &second_outputs));
+  EXPECT_EQ(1, CounterValue(kLookups, "miss") - misses_before);
+  EXPECT_EQ(1, CounterValue(kLookups, "hit") - hits_before);
+
+  // The stateful random op is not shared: each session draws the same
+  // sequence from a generator of its own.
+  for (int step = 0; step < 3; ++step) {
+    ASSERT_EQ(1, first_outputs.size());
+    ASSERT_EQ(1, second_outputs.size());
+    test::ExpectTensorEqual<float>(first_outputs[0], second_outputs[0]);
+    const Tensor previous = first_outputs[0];
+    TF_CHECK_OK(first->Run({}, {copy->name()}, {}, &first_outputs));
+    TF_CHECK_OK(second->Run({}, {copy->name()}, {}, &second_outputs));
+    EXPECT_NE(previous.flat<float>()(0), first_outputs[0].flat<float>()(0));
+  }
+  TF_CHECK_OK(first->Close());
+  TF_CHECK_OK(second->Close());
+}
+
+TEST(GrpcSessionTest, RegisteredGraphCacheEviction) {
+  ConfigProto config;
+  config.mutable_graph_options()->set_registered_graph_cache_size(1);
+  const std::vector<string> targets = StartLocalCluster(config, 1);
+  string fetch_a;
+  const GraphDef def_a = ConstantCopyGraph(1, LocalClusterDevice(0), &fetch_a);
+  string fetch_b;
+  const GraphDef def_b = ConstantCopyGraph(2, LocalClusterDevice(0), &fetch_b);
+
+  const char* kLookups = "/tensorflow/core/graph_mgr_cache_lookups";
+  const char* kEvictions = "/tensorflow/core/graph_mgr_cache_evictions";
+  const int64 hits_before = CounterValue(kLookups, "hit");
+  const int64 misses_before = CounterValue(kLookups, "miss");
+  const int64 evictions_before = CounterValue(kEvictions, "");
+
+  std::unique_ptr<Session> session_a(NewRemote(Options(targets[0], 1)));
+  TF_CHECK_OK(session_a->Create(def_a));
+  std::vector<Tensor> outputs;
+  TF_CHECK_OK(session_a->Run({}, {fetch_a}, {}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  IsSingleFloatValue(outputs[0], 1);
+  EXPECT_EQ(0, CounterValue(kEvictions, "") - evictions_before);
+
+  // The cache holds one graph, so registering "b" evicts "a".
+  std::unique_ptr<Session> session_b(NewRemote(Options(targets[0], 1)));
+  TF_CHECK_OK(session_b->Create(def_b));
+  TF_CHECK_OK(session_b->Run({}, {fetch_b}, {}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  IsSingleFloatValue(outputs[0], 2);
+  EXPECT_EQ(1, CounterValue(kEvictions, "") - evictions_before);
+
+  // The graph "a" registered before its eviction keeps running.
+  for (int step = 0; step < 3; ++step) {
+    TF_CHECK_OK(session_a->Run({}, {fetch_a}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    IsSingleFloatValue(outputs[0], 1);
+  }
+  TF_CHECK_OK(session_b->Close());
+
+  // Registering "a" again builds it again, and evicts "b".
+  std::unique_ptr<Session> session_c(NewRemote(Options(targets[0], 1)));
+  TF_CHECK_OK(session_c->Create(def_a));
+  TF_CHECK_OK(session_c->Run({}, {fetch_a}, {}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  IsSingleFloatValue(outputs[0], 1);
+  EXPECT_EQ(0, CounterValue(kLookups, "hit") - hits_before);
+  EXPECT_EQ(3, CounterValue(kLookups, "miss") - misses_before);
+  EXPECT_EQ(2, CounterValue(kEvictions, "") - evictions_before);
+
+  // Deregistering the evicted graph releases it; the cached one still runs.
+  TF_CHECK_OK(session_a->Close());
+  TF_CHECK_OK(session_c->Run({}, {fetch_a}, {}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  IsSingleFloatValue(outputs[0], 1);
+  TF_CHECK_OK(session_c->Close());
+}
+
 TEST(GrpcSessionTest, MultiDevices_String) {
   std::unique_ptr<test::TestCluster> cluster;
   TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 1), 2, &cluster));
@@ -606,6 +1140,55 @@ TEST(SessionTest, SharedVar) {
   }
 }
 
+TEST(SessionTest, PipelinedDequeue) {
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 1, &cluster));
+
+  GraphDef gdef;
+  string enqueue_name;
+  string sum_name;
+  {
+    Graph g(OpRegistry::Global());
+    Node* queue;
+    TF_CHECK_OK(NodeBuilder("queue", "FIFOQueueV2")
+                    .Attr("component_types", {DT_FLOAT})
+                    .Attr("capacity", 100)
+                    .Finalize(&g, &queue));
+    Tensor values(DT_FLOAT, TensorShape({10}));
+    test::FillFn<float>(&values, [](int i) -> float { return i; });
+    Node* enqueue;
+    TF_CHECK_OK(NodeBuilder("enqueue", "QueueEnqueueManyV2")
+                    .Input(queue)
+                    .Input(std::vector<NodeBuilder::NodeOut>(
+                        {test::graph::Constant(&g, values)}))
+                    .Finalize(&g, &enqueue));
+    enqueue_name = enqueue->name();
+    Node* dequeue;
+    TF_CHECK_OK(NodeBuilder("dequeue", "QueueDequeueV2")
+                    .Input(queue)
+                    .Attr("component_types", {DT_FLOAT})
+                    .Finalize(&g, &dequeue));
+    sum_name = test::graph::Add(&g, dequeue, dequeue)->name();
+    test::graph::ToGraphDef(&g, &gdef);
+  }
+
+  SessionOptions options = Options(cluster->targets()[0], 1);
+  options.config.mutable_graph_options()->set_step_pipeline_depth(3);
+  std::unique_ptr<Session> session(NewRemote(options));
+  TF_CHECK_OK(session->Create(gdef));
+  TF_CHECK_OK(session->Run({}, {}, {enqueue_name}, nullptr));
+  // Later steps dequeue while earlier ones still run, but every step gets
+  // the elements in queue order.  The dequeues left waiting on the empty
+  // queue at the end are cancelled by Close().
+  for (int i = 0; i < 10; ++i) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {sum_name + ":0"}, {}, &outputs));
+    ASSERT_EQ(outputs.size(), 1);
+    IsSingleFloatValue(outputs[0], 2.0f * i);
+  }
+  TF_CHECK_OK(session->Close());
+}
+
 void CreateInvalidGraph(const string& graph_def_ascii,
                         const string& error_substring) {
   GraphDef graph;
@@ -140,11 +140,17 @@ static void EncodeSkeleton(const Tensor& val, io::ProtoEncodeHelper* e) {
 
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
                               ::grpc::ByteBuffer* result) {
+  EncodeTensorToByteBuffer(is_dead, val, 0, result);
+}
+
+void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, int32 key_index,
+                              ::grpc::ByteBuffer* result) {
   const int kLargeTensorBytes = 1024;
   RecvTensorResponse response;
   if (is_dead) {
     response.set_is_dead(is_dead);
   }
+  response.set_key_index(key_index);
   response.set_send_start_micros(Env::Default()->NowMicros());
   if (!DataTypeCanUseMemcpy(val.dtype())) {
     // Straightforward but slow path for complicated kinds of tensor data
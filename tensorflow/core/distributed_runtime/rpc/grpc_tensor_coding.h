@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_TENSOR_CODING_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_TENSOR_CODING_H_
 
+#include "tensorflow/core/platform/types.h"
+
 namespace grpc {
 class ByteBuffer;
 }  // namespace grpc
@@ -51,6 +53,11 @@ void EncodeRecvTensorResponseToByteBuffer(const RecvTensorResponse& proto,
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
                               ::grpc::ByteBuffer* result);
 
+// As above, but also encodes "key_index" as "RecvTensorResponse::key_index",
+// for the responses streamed by the RecvTensors method.
+void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, int32 key_index,
+                              ::grpc::ByteBuffer* result);
+
 }  // namespace grpc
 }  // namespace tensorflow
 
@@ -100,4 +100,25 @@ TEST_F(GrpcTensorCodingTest, Simple) {
 
 TEST_F(GrpcTensorCodingTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(GrpcTensorCodingTest, KeyIndex) {
+  Tensor a(DT_FLOAT, TensorShape({1, 3}));
+  test::FillValues<float>(&a, {1, 2, 3});
+  ::grpc::ByteBuffer buf;
+  grpc::EncodeTensorToByteBuffer(false, a, 5, &buf);
+
+  std::vector<::grpc::Slice> slices;
+  (void)buf.Dump(&slices);
+  string tmp;
+  for (const auto& s : slices) {
+    tmp.append(reinterpret_cast<const char*>(s.begin()), s.size());
+  }
+
+  RecvTensorResponse response;
+  EXPECT_TRUE(response.ParseFromString(tmp));
+  EXPECT_EQ(5, response.key_index());
+  Tensor result_tensor;
+  EXPECT_TRUE(result_tensor.FromProto(response.tensor()));
+  test::ExpectTensorEqual<float>(a, result_tensor);
+}
+
 }  // namespace tensorflow
@@ -15,7 +15,13 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service.h"
 
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <sched.h>
+#endif
+#include <atomic>
 #include <deque>
+#include <memory>
+#include <vector>
 
 #include "grpc++/alarm.h"
 #include "grpc++/server_builder.h"
@@ -36,12 +42,19 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service_impl.h"
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory.h"
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
 #include "tensorflow/core/distributed_runtime/worker.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/protobuf_internal.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 
@@ -49,16 +62,70 @@ namespace tensorflow {
 
 namespace {
 
+auto* worker_service_queue_depth = monitoring::Sampler<1>::New(
+    {"/tensorflow/core/grpc_worker_service_queue_depth",
+     "The number of calls to a worker method that were already in progress "
+     "when another one arrived.",
+     "method"},
+    {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096});
+
+auto* worker_service_latency = monitoring::Sampler<1>::New(
+    {"/tensorflow/core/grpc_worker_service_latency_usecs",
+     "The time from the arrival of a call to a worker method until its "
+     "response is handed to gRPC, in microseconds.",
+     "method"},
+    {10, 30, 100, 300, 1000, 3000, 10000, 30000, 100000, 300000, 1000000,
+     3000000, 10000000});
+
+// Pins the calling thread to the "index"-th core (modulo the number of
+// cores) on which it may currently run.
+void PinCurrentThreadToCore(int index) {
+#if defined(__linux__) && !defined(__ANDROID__)
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    LOG(WARNING) << "Could not get the CPU affinity of a polling thread.";
+    return;
+  }
+  const int num_cores = CPU_COUNT(&allowed);
+  if (num_cores == 0) return;
+  int target = index % num_cores;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (!CPU_ISSET(cpu, &allowed) || target-- > 0) continue;
+    cpu_set_t pinned;
+    CPU_ZERO(&pinned);
+    CPU_SET(cpu, &pinned);
+    if (sched_setaffinity(0, sizeof(pinned), &pinned) != 0) {
+      LOG(WARNING) << "Could not pin a polling thread to CPU " << cpu;
+    }
+    return;
+  }
+#else
+  LOG(WARNING) << "Pinning polling threads is not supported on this platform.";
+#endif
+}
+
 class GrpcWorkerService : public AsyncServiceInterface {
  public:
-  GrpcWorkerService(GrpcWorker* worker, ::grpc::ServerBuilder* builder)
-      : worker_(worker), is_shutdown_(false) {
+  GrpcWorkerService(GrpcWorker* worker, ::grpc::ServerBuilder* builder,
+                    const GrpcWorkerServiceOptions& options)
+      : worker_(worker), options_(options), is_shutdown_(false) {
     builder->RegisterService(&worker_service_);
-    cq_ = builder->AddCompletionQueue();
+    const int num_threads = std::max(1, options_.num_serving_threads);
+    for (int i = 0; i < num_threads; ++i) {
+      cqs_.push_back(builder->AddCompletionQueue());
+    }
+    for (int i = 0; i < kGrpcNumWorkerMethods; ++i) {
+      const char* name = GrpcWorkerMethodName(static_cast<GrpcWorkerMethod>(i));
+      in_flight_[i] = 0;
+      queue_depth_[i] = worker_service_queue_depth->GetCell(name);
+      latency_[i] = worker_service_latency->GetCell(name);
+    }
   }
 
   ~GrpcWorkerService() {
-    delete shutdown_alarm_;
+    for (::grpc::Alarm* alarm : shutdown_alarms_) {
+      delete alarm;
+    }
   }
 
   void Shutdown() override {
@@ -75,14 +142,16 @@ class GrpcWorkerService : public AsyncServiceInterface {
       // NOTE(mrry): This enqueues a special event (with a null tag)
       // that causes the completion queue to be shut down on the
       // polling thread.
-      shutdown_alarm_ =
-          new ::grpc::Alarm(cq_.get(), gpr_now(GPR_CLOCK_MONOTONIC), nullptr);
+      for (const auto& cq : cqs_) {
+        shutdown_alarms_.push_back(
+            new ::grpc::Alarm(cq.get(), gpr_now(GPR_CLOCK_MONOTONIC), nullptr));
+      }
     }
   }
 
 // This macro creates a new request for the given RPC method name
-// (e.g., `ENQUEUE_REQUEST(GetStatus, false);`), and enqueues it on
-// `this->cq_`.
+// (e.g., `ENQUEUE_REQUEST(GetStatus, false, cq);`), and enqueues it on
+// the completion queue `cq`.
 //
 // This macro is invoked one or more times for each RPC method to
 // ensure that there are sufficient completion queue entries to
@@ -90,53 +159,92 @@ class GrpcWorkerService : public AsyncServiceInterface {
 //
 // The implementation of the request handler for each RPC method
 // must ensure that it calls ENQUEUE_REQUEST() for that RPC method,
-// to keep accepting new requests.
-#define ENQUEUE_REQUEST(method, supports_cancel)                       \
+// on the completion queue of the call that it handles, to keep
+// accepting new requests.
+#define ENQUEUE_REQUEST(method, supports_cancel, cq)                   \
   do {                                                                 \
     mutex_lock l(shutdown_mu_);                                        \
     if (!is_shutdown_) {                                               \
       Call<GrpcWorkerService, grpc::WorkerService::AsyncService,       \
            method##Request, method##Response>::                        \
           EnqueueRequestForMethod(                                     \
-              &worker_service_, cq_.get(),                             \
+              &worker_service_, (cq),                                  \
               static_cast<int>(GrpcWorkerMethod::k##method),           \
               &GrpcWorkerService::method##Handler, (supports_cancel)); \
     }                                                                  \
   } while (0)
 
-  // This method blocks forever handling requests from the completion queue.
+  // This method blocks forever handling requests from the completion
+  // queues. The calling thread polls the first queue, and one more
+  // thread is started for each of the others.
   void HandleRPCsLoop() override {
-    // TODO(mrry): This may require performance engineering. We can
-    // add more threads to service the completion queue, and add more
-    // of various request types if they are short and frequent.
-    // Currently we allow unbounded numbers of pending calls for each
-    // method, by re-enqueuing a request before the previous one
-    // completes, and we may decide to bound some of the request
-    // types.
-    ENQUEUE_REQUEST(GetStatus, false);
-    ENQUEUE_REQUEST(CleanupAll, false);
-    ENQUEUE_REQUEST(RegisterGraph, false);
-    ENQUEUE_REQUEST(DeregisterGraph, false);
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int i = 1; i < static_cast<int>(cqs_.size()); ++i) {
+      threads.emplace_back(worker_->env()->env->StartThread(
+          ThreadOptions(), strings::StrCat("TF_worker_service_", i),
+          [this, i]() { PollCompletionQueue(i); }));
+    }
+    PollCompletionQueue(0);
+    // Destroying the threads waits for them to finish polling.
+  }
+
+ private:
+  GrpcWorker* worker_ = nullptr;  // Not owned.
+  const GrpcWorkerServiceOptions options_;
+  std::vector<std::unique_ptr<::grpc::ServerCompletionQueue>> cqs_;
+
+  grpc::WorkerService::AsyncService worker_service_;
+
+  mutex shutdown_mu_;
+  bool is_shutdown_ GUARDED_BY(shutdown_mu_);
+  std::vector<::grpc::Alarm*> shutdown_alarms_;
+
+  // The number of calls to each method that have arrived but whose
+  // responses have not yet been handed to gRPC, and the metric cells
+  // that record it and each call's latency.
+  std::atomic<int64> in_flight_[kGrpcNumWorkerMethods];
+  monitoring::SamplerCell* queue_depth_[kGrpcNumWorkerMethods];
+  monitoring::SamplerCell* latency_[kGrpcNumWorkerMethods];
+
+  // Requests the first calls of each method on the "index"-th
+  // completion queue, then handles its events until it shuts down.
+  void PollCompletionQueue(int index) {
+    if (options_.pin_serving_threads) {
+      PinCurrentThreadToCore(index);
+    }
+    ::grpc::ServerCompletionQueue* cq = cqs_[index].get();
+
+    // TODO(mrry): Currently we allow unbounded numbers of pending
+    // calls for each method, by re-enqueuing a request before the
+    // previous one completes, and we may decide to bound some of the
+    // request types.
+    ENQUEUE_REQUEST(GetStatus, false, cq);
+    ENQUEUE_REQUEST(CleanupAll, false, cq);
+    ENQUEUE_REQUEST(RegisterGraph, false, cq);
+    ENQUEUE_REQUEST(DeregisterGraph, false, cq);
 
     // TODO(mrry): Determine a better policy for enqueuing the appropriate
     // number of each request type.
     for (int i = 0; i < 1000; ++i) {
-      EnqueueRecvTensorRequestRaw();
+      EnqueueRecvTensorRequestRaw(cq);
     }
     for (int i = 0; i < 100; ++i) {
-      ENQUEUE_REQUEST(RunGraph, true);
+      EnqueueRecvTensorsRequest(cq);
     }
     for (int i = 0; i < 100; ++i) {
-      ENQUEUE_REQUEST(CleanupGraph, false);
+      ENQUEUE_REQUEST(RunGraph, true, cq);
+    }
+    for (int i = 0; i < 100; ++i) {
+      ENQUEUE_REQUEST(CleanupGraph, false, cq);
     }
 
-    ENQUEUE_REQUEST(Logging, false);
-    ENQUEUE_REQUEST(Tracing, false);
+    ENQUEUE_REQUEST(Logging, false, cq);
+    ENQUEUE_REQUEST(Tracing, false, cq);
 
     void* tag;
     bool ok;
 
-    while (cq_->Next(&tag, &ok)) {
+    while (cq->Next(&tag, &ok)) {
       UntypedCall<GrpcWorkerService>::Tag* callback_tag =
           static_cast<UntypedCall<GrpcWorkerService>::Tag*>(tag);
       if (callback_tag) {
@@ -144,73 +252,106 @@ class GrpcWorkerService : public AsyncServiceInterface {
       } else {
         // NOTE(mrry): A null `callback_tag` indicates that this is
         // the shutdown alarm.
-        cq_->Shutdown();
+        cq->Shutdown();
       }
     }
   }
 
- private:
-  GrpcWorker* worker_ = nullptr;  // Not owned.
-  std::unique_ptr<::grpc::ServerCompletionQueue> cq_;
+  void Schedule(std::function<void()> f) {
+    worker_->env()->compute_pool->Schedule(std::move(f));
+  }
 
-  grpc::WorkerService::AsyncService worker_service_;
+  // Runs "f", which neither blocks nor does much work, on the polling
+  // thread if the service was configured to, and on the compute pool
+  // otherwise.
+  void ScheduleNonBlocking(std::function<void()> f) {
+    if (options_.handle_nonblocking_calls_inline) {
+      f();
+    } else {
+      Schedule(std::move(f));
+    }
+  }
 
-  mutex shutdown_mu_;
-  bool is_shutdown_ GUARDED_BY(shutdown_mu_);
-  ::grpc::Alarm* shutdown_alarm_ = nullptr;
+  // Records the arrival of a call to `method`, and returns the time at
+  // which it arrived.
+  uint64 CallStarted(GrpcWorkerMethod method) {
+    const int i = static_cast<int>(method);
+    queue_depth_[i]->Add(in_flight_[i].fetch_add(1));
+    return Env::Default()->NowMicros();
+  }
 
-  void Schedule(std::function<void()> f) {
-    worker_->env()->compute_pool->Schedule(std::move(f));
+  // Records that the response to a call to `method` that arrived at
+  // `start_micros` has been handed to gRPC.
+  void CallDone(GrpcWorkerMethod method, uint64 start_micros) {
+    const int i = static_cast<int>(method);
+    in_flight_[i].fetch_sub(1);
+    latency_[i]->Add(Env::Default()->NowMicros() - start_micros);
   }
 
   // The following section contains one request handler method per
   // RPC. The `FooHandler` method is called (indirectly) by
-  // `HandleRPCsLoop()` when the next Foo RPC is received. Each
-  // `FooHandler` call schedules a closure on `worker_->env()->compute_pool`,
-  // and is responsible for requesting the next Foo call by calling
-  // `ENQUEUE_REQUEST(Foo)`.
+  // `PollCompletionQueue()` when the next Foo RPC is received. Each
+  // `FooHandler` call schedules a closure on
+  // `worker_->env()->compute_pool`, or may handle the request on the
+  // polling thread if doing so is cheap, and is responsible for
+  // requesting the next Foo call by calling `ENQUEUE_REQUEST(Foo)`.
 
   template <class RequestMessage, class ResponseMessage>
   using WorkerCall = Call<GrpcWorkerService, grpc::WorkerService::AsyncService,
                           RequestMessage, ResponseMessage>;
 
+  template <class RequestMessage, class ResponseMessage>
+  using StreamingWorkerCall =
+      ServerStreamingCall<GrpcWorkerService, grpc::WorkerService::AsyncService,
+                          RequestMessage, ResponseMessage>;
+
+  // GetStatus only lists the local devices, so it never blocks.
   void GetStatusHandler(WorkerCall<GetStatusRequest, GetStatusResponse>* call) {
-    Schedule([this, call]() {
+    const uint64 start = CallStarted(GrpcWorkerMethod::kGetStatus);
+    ScheduleNonBlocking([this, call, start]() {
       Status s = worker_->GetStatus(&call->request, &call->response);
+      CallDone(GrpcWorkerMethod::kGetStatus, start);
       call->SendResponse(ToGrpcStatus(s));
     });
-    ENQUEUE_REQUEST(GetStatus, false);
+    ENQUEUE_REQUEST(GetStatus, false, call->cq());
   }
 
   void CleanupAllHandler(
       WorkerCall<CleanupAllRequest, CleanupAllResponse>* call) {
-    Schedule([this, call]() {
+    const uint64 start = CallStarted(GrpcWorkerMethod::kCleanupAll);
+    Schedule([this, call, start]() {
       Status s = worker_->CleanupAll(&call->request, &call->response);
+      CallDone(GrpcWorkerMethod::kCleanupAll, start);
       call->SendResponse(ToGrpcStatus(s));
     });
-    ENQUEUE_REQUEST(CleanupAll, false);
+    ENQUEUE_REQUEST(CleanupAll, false, call->cq());
   }
 
   void RegisterGraphHandler(
       WorkerCall<RegisterGraphRequest, RegisterGraphResponse>* call) {
-    Schedule([this, call]() {
+    const uint64 start = CallStarted(GrpcWorkerMethod::kRegisterGraph);
+    Schedule([this, call, start]() {
       Status s = worker_->RegisterGraph(&call->request, &call->response);
+      CallDone(GrpcWorkerMethod::kRegisterGraph, start);
       call->SendResponse(ToGrpcStatus(s));
     });
-    ENQUEUE_REQUEST(RegisterGraph, false);
+    ENQUEUE_REQUEST(RegisterGraph, false, call->cq());
   }
 
   void DeregisterGraphHandler(
       WorkerCall<DeregisterGraphRequest, DeregisterGraphResponse>* call) {
-    Schedule([this, call]() {
+    const uint64 start = CallStarted(GrpcWorkerMethod::kDeregisterGraph);
+    Schedule([this, call, start]() {
       Status s = worker_->DeregisterGraph(&call->request, &call->response);
+      CallDone(GrpcWorkerMethod::kDeregisterGraph, start);
       call->SendResponse(ToGrpcStatus(s));
     });
-    ENQUEUE_REQUEST(DeregisterGraph, false);
+    ENQUEUE_REQUEST(DeregisterGraph, false, call->cq());
   }
 
   void RunGraphHandler(WorkerCall<RunGraphRequest, RunGraphResponse>* call) {
-    Schedule([this, call]() {
+    const uint64 start = CallStarted(GrpcWorkerMethod::kRunGraph);
+    Schedule([this, call, start]() {
       CallOptions* call_opts = new CallOptions;
       ProtoRunGraphRequest* wrapped_request =
           new ProtoRunGraphRequest(&call->request);
@@ -218,72 +359,135 @@ class GrpcWorkerService : public AsyncServiceInterface {
           new NonOwnedProtoRunGraphResponse(&call->response);
       call->SetCancelCallback([call_opts]() { call_opts->StartCancel(); });
       worker_->RunGraphAsync(call_opts, wrapped_request, wrapped_response,
-                             [call, call_opts, wrapped_request,
-                              wrapped_response](const Status& s) {
+                             [this, call, call_opts, wrapped_request,
+                              wrapped_response, start](const Status& s) {
                                call->ClearCancelCallback();
                                delete call_opts;
                                delete wrapped_request;
                                delete wrapped_response;
+                               CallDone(GrpcWorkerMethod::kRunGraph, start);
                                call->SendResponse(ToGrpcStatus(s));
                              });
     });
-    ENQUEUE_REQUEST(RunGraph, true);
+    ENQUEUE_REQUEST(RunGraph, true, call->cq());
   }
 
+  // RecvTensor registers a callback with the rendezvous, which encodes the
+  // response on the thread that produces the tensor, or right away if the
+  // tensor was already produced. That is cheap for a plain response, but
+  // compressing the tensor or writing it to shared memory is not, so a call
+  // that asks for either is always handled on the compute pool.
   void RecvTensorHandlerRaw(
       WorkerCall<RecvTensorRequest, ::grpc::ByteBuffer>* call) {
-    Schedule([this, call]() {
+    const uint64 start = CallStarted(GrpcWorkerMethod::kRecvTensor);
+    if (!options_.accept_shared_memory_transport) {
+      // Only a worker configured to use shared memory writes to it.
+      call->request.clear_transport_options();
+    }
+    auto handle = [this, call, start]() {
       CallOptions* call_opts = new CallOptions;
       call->SetCancelCallback([call_opts]() { call_opts->StartCancel(); });
       worker_->RecvTensorAsync(call_opts, &call->request, &call->response,
-                               [call, call_opts](const Status& s) {
+                               [this, call, call_opts, start](const Status& s) {
                                  call->ClearCancelCallback();
                                  delete call_opts;
+                                 CallDone(GrpcWorkerMethod::kRecvTensor, start);
                                  call->SendResponse(ToGrpcStatus(s));
                                });
-    });
-    EnqueueRecvTensorRequestRaw();
+    };
+    if (call->request.has_compression() ||
+        call->request.has_transport_options()) {
+      Schedule(std::move(handle));
+    } else {
+      ScheduleNonBlocking(std::move(handle));
+    }
+    EnqueueRecvTensorRequestRaw(call->cq());
+  }
+
+  // Like RecvTensor, RecvTensors encodes each response as its tensor
+  // becomes available, so a call that asks for compression is always
+  // handled on the compute pool.
+  void RecvTensorsHandler(
+      StreamingWorkerCall<RecvTensorsRequest, ::grpc::ByteBuffer>* call) {
+    const uint64 start = CallStarted(GrpcWorkerMethod::kRecvTensors);
+    auto handle = [this, call, start]() {
+      CallOptions* call_opts = new CallOptions;
+      call->SetCancelCallback([call_opts]() { call_opts->StartCancel(); });
+      worker_->RecvTensorsAsync(
+          call_opts, &call->request,
+          [call](::grpc::ByteBuffer* buf) { call->Write(std::move(*buf)); },
+          [this, call, call_opts, start](const Status& s) {
+            call->ClearCancelCallback();
+            delete call_opts;
+            CallDone(GrpcWorkerMethod::kRecvTensors, start);
+            call->Finish(ToGrpcStatus(s));
+          });
+    };
+    if (call->request.has_compression()) {
+      Schedule(std::move(handle));
+    } else {
+      ScheduleNonBlocking(std::move(handle));
+    }
+    EnqueueRecvTensorsRequest(call->cq());
   }
 
   void CleanupGraphHandler(
       WorkerCall<CleanupGraphRequest, CleanupGraphResponse>* call) {
-    Schedule([this, call]() {
+    const uint64 start = CallStarted(GrpcWorkerMethod::kCleanupGraph);
+    Schedule([this, call, start]() {
       Status s = worker_->CleanupGraph(&call->request, &call->response);
+      CallDone(GrpcWorkerMethod::kCleanupGraph, start);
       call->SendResponse(ToGrpcStatus(s));
     });
-    ENQUEUE_REQUEST(CleanupGraph, false);
+    ENQUEUE_REQUEST(CleanupGraph, false, call->cq());
   }
 
   void LoggingHandler(WorkerCall<LoggingRequest, LoggingResponse>* call) {
-    Schedule([this, call]() {
+    const uint64 start = CallStarted(GrpcWorkerMethod::kLogging);
+    Schedule([this, call, start]() {
       Status s = worker_->Logging(&call->request, &call->response);
+      CallDone(GrpcWorkerMethod::kLogging, start);
       call->SendResponse(ToGrpcStatus(s));
     });
-    ENQUEUE_REQUEST(Logging, false);
+    ENQUEUE_REQUEST(Logging, false, call->cq());
   }
 
   void TracingHandler(WorkerCall<TracingRequest, TracingResponse>* call) {
-    Schedule([this, call]() {
+    const uint64 start = CallStarted(GrpcWorkerMethod::kTracing);
+    Schedule([this, call, start]() {
       Status s = worker_->Tracing(&call->request, &call->response);
+      CallDone(GrpcWorkerMethod::kTracing, start);
       call->SendResponse(ToGrpcStatus(s));
     });
-    ENQUEUE_REQUEST(Tracing, false);
+    ENQUEUE_REQUEST(Tracing, false, call->cq());
   }
 #undef ENQUEUE_REQUEST
 
-  void EnqueueRecvTensorRequestRaw() {
+  void EnqueueRecvTensorRequestRaw(::grpc::ServerCompletionQueue* cq) {
     mutex_lock l(shutdown_mu_);
     if (!is_shutdown_) {
       Call<GrpcWorkerService, grpc::WorkerService::AsyncService,
            RecvTensorRequest, ::grpc::ByteBuffer>::
           EnqueueRequestForMethod(
-              &worker_service_, cq_.get(),
+              &worker_service_, cq,
               static_cast<int>(GrpcWorkerMethod::kRecvTensor),
               &GrpcWorkerService::RecvTensorHandlerRaw,
               true /* supports cancel*/);
     }
   }
 
+  void EnqueueRecvTensorsRequest(::grpc::ServerCompletionQueue* cq) {
+    mutex_lock l(shutdown_mu_);
+    if (!is_shutdown_) {
+      StreamingWorkerCall<RecvTensorsRequest, ::grpc::ByteBuffer>::
+          EnqueueRequestForMethod(
+              &worker_service_, cq,
+              static_cast<int>(GrpcWorkerMethod::kRecvTensors),
+              &GrpcWorkerService::RecvTensorsHandler,
+              true /* supports cancel*/);
+    }
+  }
+
   TF_DISALLOW_COPY_AND_ASSIGN(GrpcWorkerService);
 };
 
@@ -291,6 +495,138 @@ class GrpcWorkerService : public AsyncServiceInterface {
 
 GrpcWorker::GrpcWorker(WorkerEnv* worker_env) : Worker(worker_env) {}
 
+namespace {
+
+// Compresses "content", the content of a tensor of type "dtype", into
+// "response" with the codec that "compression" selects for it, using
+// "pool" to compress in parallel. Returns false, leaving "response"
+// unchanged, if the tensor is to be sent uncompressed.
+bool CompressRecvTensorContent(const TensorCompressionOptions& compression,
+                               DataType dtype, StringPiece content,
+                               thread::ThreadPool* pool,
+                               RecvTensorResponse* response) {
+  const TensorCompressionOptions::Codec codec =
+      ChooseTensorCodec(compression, dtype, content.size());
+  if (codec == TensorCompressionOptions::NONE) return false;
+  Status s = CompressTensorContent(codec, compression.chunk_bytes(), dtype,
+                                   content, pool,
+                                   response->mutable_compressed_content());
+  if (!s.ok()) {
+    VLOG(1) << "Sending tensor uncompressed: " << s;
+    response->clear_compressed_content();
+    return false;
+  }
+  return true;
+}
+
+// Writes "val" to the shared memory named in "shm", if it is not null, and
+// describes where in "response". Returns false, leaving "response"
+// unchanged, if the tensor is to be sent in the response instead.
+bool WriteRecvTensorToSharedMemory(const SharedMemoryRecvRequest* shm,
+                                   const Tensor& val,
+                                   RecvTensorResponse* response) {
+  if (shm == nullptr) return false;
+  SharedMemoryRecvResponse location;
+  Status s = WriteTensorToSharedMemory(*shm, val, &location);
+  if (!s.ok()) {
+    VLOG(1) << "Sending tensor over RPC: " << s;
+    return false;
+  }
+  response->mutable_transport_options()->PackFrom(location);
+  return true;
+}
+
+// Encodes "val", which was produced on "src_dev", into "response" as a
+// RecvTensorResponse with the given "key_index", and calls "done" once
+// "response" is ready to be sent. A tensor in host memory is written to
+// the shared memory that the receiver named in "shm", if it is not null;
+// otherwise the tensor is compressed as the receiver asked in
+// "compression".
+void EncodeRecvTensorResponse(Device* src_dev,
+                              const Rendezvous::Args& send_args,
+                              const Tensor& val, const bool is_dead,
+                              int32 key_index,
+                              const SharedMemoryRecvRequest* shm,
+                              const TensorCompressionOptions& compression,
+                              thread::ThreadPool* pool,
+                              ::grpc::ByteBuffer* response,
+                              StatusCallback done) {
+  // DMA can only be used for Tensors that do not fall into
+  // the following three odd edge cases: 1) a zero-size
+  // buffer, 2) a dead tensor which has an uninit value, and
+  // 3) the tensor has the on_host allocation attribute,
+  // i.e. it's in CPU RAM *independent of its assigned
+  // device type*.
+  const bool on_host = send_args.alloc_attrs.on_host();
+  {
+    // Non-DMA cases.
+    if (src_dev->tensorflow_gpu_device_info() && (!on_host)) {
+#if GOOGLE_CUDA
+      const DeviceContext* send_dev_context = send_args.device_context;
+      RecvTensorResponse* tmp = new RecvTensorResponse;
+      tmp->set_is_dead(is_dead);
+      tmp->set_key_index(key_index);
+      CHECK(send_dev_context)
+          << "send dev name: " << src_dev->name()
+          << " gpu_info: " << src_dev->tensorflow_gpu_device_info();
+      // "val" is on a GPU. Uses GPUUtil to fill the response proto.
+      StatusCallback response_ready = [response, done, tmp, compression,
+                                       pool](const Status& s) {
+        if (s.ok() && !tmp->is_dead() &&
+            CompressRecvTensorContent(compression, tmp->tensor().dtype(),
+                                      tmp->tensor().tensor_content(), pool,
+                                      tmp)) {
+          tmp->mutable_tensor()->clear_tensor_content();
+        }
+        // The value is now ready to be returned on the wire.
+        tmp->set_send_start_micros(Env::Default()->NowMicros());
+
+        grpc::EncodeRecvTensorResponseToByteBuffer(*tmp, response);
+        done(s);
+        delete tmp;
+      };
+
+      // TODO (jeff,sanjay,mrry): Avoid copy on GPU path by
+      // modifying GPUUtil::SetProtoFromGPU to accept a
+      // ::grpc::ByteBuffer to serialize to, rather than
+      // encoding into a protocol buffer and then
+      // serializing that (i.e. figure out how to use
+      // EncodeTensorToByteBuffer on this path rather than
+      // EncodeRecvTensorResponseToByteBuffer)
+      GPUUtil::SetProtoFromGPU(val, src_dev, send_dev_context,
+                               tmp->mutable_tensor(), is_dead, response_ready);
+#else
+      done(errors::Internal("No GPU device in process"));
+#endif  // GOOGLE_CUDA
+    } else {
+      RecvTensorResponse out_of_line;
+      bool encoded = false;
+      if (!is_dead && DataTypeCanUseMemcpy(val.dtype())) {
+        if (WriteRecvTensorToSharedMemory(shm, val, &out_of_line)) {
+          encoded = true;
+        } else if (CompressRecvTensorContent(compression, val.dtype(),
+                                             val.tensor_data(), pool,
+                                             &out_of_line)) {
+          TensorProto* meta = out_of_line.mutable_tensor();
+          meta->set_dtype(val.dtype());
+          val.shape().AsProto(meta->mutable_tensor_shape());
+          encoded = true;
+        }
+      }
+      if (encoded) {
+        out_of_line.set_key_index(key_index);
+        out_of_line.set_send_start_micros(Env::Default()->NowMicros());
+        grpc::EncodeRecvTensorResponseToByteBuffer(out_of_line, response);
+      } else {
+        grpc::EncodeTensorToByteBuffer(is_dead, val, key_index, response);
+      }
+      done(Status::OK());
+    }
+  }
+}
+
+}  // namespace
+
 // RecvTensorAsync: unlike the other Worker methods, which use protocol buffers
 // for a response object, to avoid extra protocol buffer serialization overhead
 // we generate our response directly into a ::grpc::ByteBuffer object
@@ -317,74 +653,132 @@ void GrpcWorker::RecvTensorAsync(CallOptions* opts,
   // of execution of the callback lambda body below, an RPC
   // cancellation should abort the rendezvous.
   opts->SetCancelCallback([this, step_id]() { AbortStep(step_id); });
+  // A receiver on the same host may ask for the tensor in shared memory.
+  std::shared_ptr<SharedMemoryRecvRequest> shm;
+  if (request->has_transport_options()) {
+    shm = std::make_shared<SharedMemoryRecvRequest>();
+    if (!ParseAny(request->transport_options(), shm.get(),
+                  "tensorflow.SharedMemoryRecvRequest")
+             .ok()) {
+      shm.reset();
+    }
+  }
+  const TensorCompressionOptions& compression = request->compression();
+  thread::ThreadPool* pool = env_->compute_pool;
   env_->rendezvous_mgr->RecvLocalAsync(
       step_id, parsed,
-      [opts, response, done, src_dev](const Status& status,
-                                      const Rendezvous::Args& send_args,
-                                      const Rendezvous::Args& recv_args,
-                                      const Tensor& val, const bool is_dead) {
+      [opts, response, done, src_dev, shm, compression, pool](
+          const Status& status, const Rendezvous::Args& send_args,
+          const Rendezvous::Args& recv_args, const Tensor& val,
+          const bool is_dead) {
         opts->ClearCancelCallback();
         if (status.ok()) {
-          // DMA can only be used for Tensors that do not fall into
-          // the following three odd edge cases: 1) a zero-size
-          // buffer, 2) a dead tensor which has an uninit value, and
-          // 3) the tensor has the on_host allocation attribute,
-          // i.e. it's in CPU RAM *independent of its assigned
-          // device type*.
-          const bool on_host = send_args.alloc_attrs.on_host();
-          {
-            // Non-DMA cases.
-            if (src_dev->tensorflow_gpu_device_info() && (!on_host)) {
-#if GOOGLE_CUDA
-              const DeviceContext* send_dev_context = send_args.device_context;
-              RecvTensorResponse* tmp = new RecvTensorResponse;
-              tmp->set_is_dead(is_dead);
-              CHECK(send_dev_context)
-                  << "send dev name: " << src_dev->name()
-                  << " gpu_info: " << src_dev->tensorflow_gpu_device_info();
-              // "val" is on a GPU. Uses GPUUtil to fill the response proto.
-              StatusCallback response_ready = [response, done,
-                                               tmp](const Status& s) {
-                // The value is now ready to be returned on the wire.
-                tmp->set_send_start_micros(Env::Default()->NowMicros());
-
-                grpc::EncodeRecvTensorResponseToByteBuffer(*tmp, response);
-                done(s);
-                delete tmp;
-              };
-
-              // TODO (jeff,sanjay,mrry): Avoid copy on GPU path by
-              // modifying GPUUtil::SetProtoFromGPU to accept a
-              // ::grpc::ByteBuffer to serialize to, rather than
-              // encoding into a protocol buffer and then
-              // serializing that (i.e. figure out how to use
-              // EncodeTensorToByteBuffer on this path rather than
-              // EncodeRecvTensorResponseToByteBuffer)
-              GPUUtil::SetProtoFromGPU(val, src_dev, send_dev_context,
-                                       tmp->mutable_tensor(), is_dead,
-                                       response_ready);
-#else
-              done(errors::Internal("No GPU device in process"));
-#endif  // GOOGLE_CUDA
-            } else {
-              grpc::EncodeTensorToByteBuffer(is_dead, val, response);
-              done(Status::OK());
-            }
-          }
+          EncodeRecvTensorResponse(src_dev, send_args, val, is_dead, 0,
+                                   shm.get(), compression, pool, response,
+                                   done);
         } else {
           //  !s.ok()
           done(status);
         }
       });
+}
+
+// RecvTensorsAsync: like RecvTensorAsync, but each tensor is encoded into
+// its own ::grpc::ByteBuffer and handed to "write" as soon as it is
+// available, so that one slow tensor does not hold back the others.
+void GrpcWorker::RecvTensorsAsync(
+    CallOptions* opts, const RecvTensorsRequest* request,
+    std::function<void(::grpc::ByteBuffer*)> write, StatusCallback done) {
+  const int64 step_id = request->step_id();
+  const int num_keys = request->rendezvous_key_size();
+  TRACEPRINTF("RecvTensors: %lld %d", step_id, num_keys);
+  // Check every key before requesting any tensor, so that a bad key
+  // fails the whole call up front.
+  std::vector<Rendezvous::ParsedKey> parsed(num_keys);
+  std::vector<Device*> src_devs(num_keys, nullptr);
+  for (int i = 0; i < num_keys; ++i) {
+    Status s = Rendezvous::ParseKey(request->rendezvous_key(i), &parsed[i]);
+    if (s.ok()) {
+      s = PrepareRecvTensor(parsed[i], &src_devs[i]);
+    }
+    if (!s.ok()) {
+      done(s);
+      return;
+    }
+  }
+  if (num_keys == 0) {
+    done(Status::OK());
+    return;
   }
 
+  // Tracks the tensors still to be sent. The call ends as soon as one of
+  // them fails, and any tensor that arrives after that is dropped.
+  struct State {
+    mutex mu;
+    int pending GUARDED_BY(mu);
+    bool finished GUARDED_BY(mu) = false;
+  };
+  State* state = new State;
+  state->pending = num_keys;
+  auto tensor_done = [opts, write, done, state](::grpc::ByteBuffer* buf,
+                                                const Status& s) {
+    bool finish = false;
+    bool last = false;
+    {
+      mutex_lock l(state->mu);
+      if (!state->finished) {
+        if (s.ok()) {
+          write(buf);
+        }
+        finish = !s.ok() || state->pending == 1;
+        state->finished = finish;
+      }
+      last = (--state->pending == 0);
+    }
+    delete buf;
+    if (finish) {
+      opts->ClearCancelCallback();
+      done(s);
+    }
+    if (last) {
+      delete state;
+    }
+  };
+
+  // As in RecvTensorAsync, an RPC cancellation while any of the tensors
+  // is still being produced should abort the rendezvous.
+  opts->SetCancelCallback([this, step_id]() { AbortStep(step_id); });
+  const TensorCompressionOptions& compression = request->compression();
+  thread::ThreadPool* pool = env_->compute_pool;
+  for (int i = 0; i < num_keys; ++i) {
+    Device* src_dev = src_devs[i];
+    env_->rendezvous_mgr->RecvLocalAsync(
+        step_id, parsed[i],
+        [i, src_dev, tensor_done, compression, pool](
+            const Status& status, const Rendezvous::Args& send_args,
+            const Rendezvous::Args& recv_args, const Tensor& val,
+            const bool is_dead) {
+          ::grpc::ByteBuffer* buf = new ::grpc::ByteBuffer;
+          if (status.ok()) {
+            EncodeRecvTensorResponse(
+                src_dev, send_args, val, is_dead, i, nullptr, compression,
+                pool, buf,
+                [buf, tensor_done](const Status& s) { tensor_done(buf, s); });
+          } else {
+            tensor_done(buf, status);
+          }
+        });
+  }
+}
+
   WorkerEnv* GrpcWorker::env() { return env_; }
 
   GrpcWorker* NewGrpcWorker(WorkerEnv* env) { return new GrpcWorker(env); }
 
-  AsyncServiceInterface* NewGrpcWorkerService(GrpcWorker* worker,
-                                              ::grpc::ServerBuilder* builder) {
-    return new GrpcWorkerService(worker, builder);
+  AsyncServiceInterface* NewGrpcWorkerService(
+      GrpcWorker* worker, ::grpc::ServerBuilder* builder,
+      const GrpcWorkerServiceOptions& options) {
+    return new GrpcWorkerService(worker, builder, options);
 }
 
 }  // namespace tensorflow
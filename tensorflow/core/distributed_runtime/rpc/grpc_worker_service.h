@@ -36,14 +36,45 @@ class GrpcWorker : public Worker {
   void RecvTensorAsync(CallOptions* opts, const RecvTensorRequest* request,
                        ::grpc::ByteBuffer* response, StatusCallback done);
 
+  // Specialized version of RecvTensors for gRPC. Calls "write" with each
+  // tensor, encoded as a RecvTensorResponse, in the order in which the
+  // tensors become available; "write" is never called concurrently.
+  void RecvTensorsAsync(CallOptions* opts, const RecvTensorsRequest* request,
+                        std::function<void(::grpc::ByteBuffer*)> write,
+                        StatusCallback done);
+
   WorkerEnv* env();
 };
 
 GrpcWorker* NewGrpcWorker(WorkerEnv* worker_env);
 
+// Options for the gRPC WorkerService implementation.
+struct GrpcWorkerServiceOptions {
+  // The number of completion queues, each with its own polling thread,
+  // from which the service handles requests.
+  int num_serving_threads = 1;
+
+  // If true, each polling thread is pinned to its own core, where the
+  // platform supports it.
+  bool pin_serving_threads = false;
+
+  // If true, the calls that neither block nor do much work (GetStatus, and
+  // RecvTensor and RecvTensors calls that ask for neither compression nor
+  // shared memory) are handled on the polling thread on which they arrive.
+  // Otherwise every call is handled on the compute pool.
+  bool handle_nonblocking_calls_inline = false;
+
+  // If true, RecvTensor writes the tensor to the shared memory that a
+  // receiver on the same host names in its request. Otherwise the
+  // request's transport options are ignored, and every tensor is sent
+  // over RPC.
+  bool accept_shared_memory_transport = false;
+};
+
 // Returns an implementation of WorkerService rpc service.
-AsyncServiceInterface* NewGrpcWorkerService(GrpcWorker* worker,
-                                            ::grpc::ServerBuilder* builder);
+AsyncServiceInterface* NewGrpcWorkerService(
+    GrpcWorker* worker, ::grpc::ServerBuilder* builder,
+    const GrpcWorkerServiceOptions& options = GrpcWorkerServiceOptions());
 
 }  // namespace tensorflow
 
@@ -42,6 +42,8 @@ const char* GrpcWorkerMethodName(GrpcWorkerMethod id) {
       return "/tensorflow.WorkerService/CleanupAll";
     case GrpcWorkerMethod::kRecvTensor:
       return "/tensorflow.WorkerService/RecvTensor";
+    case GrpcWorkerMethod::kRecvTensors:
+      return "/tensorflow.WorkerService/RecvTensors";
     case GrpcWorkerMethod::kLogging:
       return "/tensorflow.WorkerService/Logging";
     case GrpcWorkerMethod::kTracing:
@@ -53,9 +55,13 @@ namespace grpc {
 
 WorkerService::AsyncService::AsyncService() {
   for (int i = 0; i < kGrpcNumWorkerMethods; ++i) {
+    const GrpcWorkerMethod id = static_cast<GrpcWorkerMethod>(i);
     AddMethod(new ::grpc::RpcServiceMethod(
-        GrpcWorkerMethodName(static_cast<GrpcWorkerMethod>(i)),
-        ::grpc::RpcMethod::NORMAL_RPC, nullptr));
+        GrpcWorkerMethodName(id),
+        id == GrpcWorkerMethod::kRecvTensors
+            ? ::grpc::RpcMethod::SERVER_STREAMING
+            : ::grpc::RpcMethod::NORMAL_RPC,
+        nullptr));
     ::grpc::Service::MarkMethodAsync(i);
   }
 }
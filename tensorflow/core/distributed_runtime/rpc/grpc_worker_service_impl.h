@@ -115,6 +115,7 @@ enum class GrpcWorkerMethod {
   kCleanupGraph,
   kCleanupAll,
   kRecvTensor,
+  kRecvTensors,
   kLogging,
   kTracing,
 };
@@ -136,7 +137,9 @@ class WorkerService GRPC_FINAL {
     AsyncService();
     virtual ~AsyncService();
 
-    // Make RequestAsyncUnary public for grpc_call.h
+    // Make RequestAsyncUnary and RequestAsyncServerStreaming public for
+    // grpc_call.h
+    using ::grpc::Service::RequestAsyncServerStreaming;
     using ::grpc::Service::RequestAsyncUnary;
   };
 };
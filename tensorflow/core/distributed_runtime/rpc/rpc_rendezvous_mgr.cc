@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
 
+#include <algorithm>
 #include <unordered_set>
 
 #include "tensorflow/core/common_runtime/device.h"
@@ -26,8 +27,11 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/worker_interface.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
@@ -36,11 +40,61 @@ namespace tensorflow {
 
 namespace {
 
+auto* rpc_rendezvous_steps = monitoring::Counter<0>::New(
+    "/tensorflow/core/rpc_rendezvous_steps",
+    "The number of steps for which an RpcRendezvousMgr created a "
+    "rendezvous.");
+auto* recv_tensor_rpcs = monitoring::Counter<1>::New(
+    "/tensorflow/core/rpc_recv_tensor_rpcs",
+    "The number of calls issued to receive tensors from remote workers.",
+    "method");
+auto* recv_tensor_count = monitoring::Counter<1>::New(
+    "/tensorflow/core/rpc_recv_tensor_count",
+    "The number of tensors received from remote workers.", "method");
+auto* recv_tensor_bytes = monitoring::Counter<1>::New(
+    "/tensorflow/core/rpc_recv_tensor_bytes",
+    "The number of tensor bytes received from remote workers.", "method");
+
+// The counter cells for one method of receiving tensors.
+struct RecvTensorMetrics {
+  explicit RecvTensorMetrics(const char* method)
+      : rpcs(recv_tensor_rpcs->GetCell(method)),
+        tensors(recv_tensor_count->GetCell(method)),
+        bytes(recv_tensor_bytes->GetCell(method)) {}
+
+  void RecordTensor(const Tensor& tensor) {
+    tensors->IncrementBy(1);
+    bytes->IncrementBy(tensor.TotalBytes());
+  }
+
+  monitoring::CounterCell* const rpcs;
+  monitoring::CounterCell* const tensors;
+  monitoring::CounterCell* const bytes;
+};
+
+RecvTensorMetrics* recv_tensor_metrics() {
+  static RecvTensorMetrics* metrics = new RecvTensorMetrics("RecvTensor");
+  return metrics;
+}
+
+RecvTensorMetrics* recv_tensors_metrics() {
+  static RecvTensorMetrics* metrics = new RecvTensorMetrics("RecvTensors");
+  return metrics;
+}
+
+class RpcRecvTensorsCall;
+
 class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  public:
   RpcRemoteRendezvous(const WorkerEnv* env, WorkerCacheInterface* cache,
-                      int64 step_id)
-      : BaseRemoteRendezvous(env, step_id, false), cache_(cache) {}
+                      int64 step_id, int64 batch_window_usecs,
+                      int64 max_batch_size,
+                      const TensorCompressionOptions& compression)
+      : BaseRemoteRendezvous(env, step_id, false),
+        cache_(cache),
+        batch_window_usecs_(batch_window_usecs),
+        max_batch_size_(max_batch_size),
+        compression_(compression) {}
 
  protected:
   void RecvFromRemoteAsync(const Rendezvous::ParsedKey& parsed,
@@ -50,7 +104,29 @@ class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  private:
   ~RpcRemoteRendezvous() override {}
 
+  // Adds a recv to the open batch for its source worker, destination
+  // device and allocator attributes, opening a batch if there is none.
+  // The batch is started when it is full or its window expires.
+  void RecvInBatch(const string& src_worker, WorkerInterface* rwi,
+                   Device* dst_device, const Rendezvous::ParsedKey& parsed,
+                   const Rendezvous::Args& recv_args, DoneCallback done);
+
+  // Starts the batch under "batch_key" if it is still the one with id
+  // "batch_id".
+  void StartBatchIfOpen(const string& batch_key, int64 batch_id);
+
+  void StartBatch(RpcRecvTensorsCall* batch);
+
   WorkerCacheInterface* cache_;  // Not owned.
+  const int64 batch_window_usecs_;
+  const int64 max_batch_size_;
+  const TensorCompressionOptions compression_;
+
+  mutex batch_mu_;
+  int64 next_batch_id_ GUARDED_BY(batch_mu_) = 0;
+  std::unordered_map<string, RpcRecvTensorsCall*> open_batches_
+      GUARDED_BY(batch_mu_);
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRemoteRendezvous);
 };
 
@@ -61,7 +137,9 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
 
   void Init(WorkerInterface* wi, int64 step_id, StringPiece key,
             AllocatorAttributes alloc_attrs, Device* dst_device,
-            const Rendezvous::Args& recv_args, Rendezvous::DoneCallback done) {
+            const Rendezvous::Args& recv_args,
+            const TensorCompressionOptions& compression,
+            thread::ThreadPool* pool, Rendezvous::DoneCallback done) {
     wi_ = wi;
     alloc_attrs_ = alloc_attrs;
     dst_device_ = dst_device;
@@ -69,6 +147,10 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
     done_ = std::move(done);
     req_.set_step_id(step_id);
     req_.set_rendezvous_key(key.data(), key.size());
+    if (compression.ByteSize() > 0) {
+      *req_.mutable_compression() = compression;
+    }
+    resp_.set_decompression_pool(pool);
   }
 
   void Reset(WorkerCacheInterface* wc) {
@@ -204,6 +286,131 @@ static RpcRecvTensorFreeList* get_call_freelist() {
   return call_freelist;
 }
 
+// Retrieves several tensors from one remote process with a single
+// RecvTensors call. Recvs are added to the call until it is started; the
+// tensors are then delivered in the order in which the remote process
+// produces them.
+class RpcRecvTensorsCall : public BaseRecvTensorCall {
+ public:
+  RpcRecvTensorsCall(WorkerInterface* wi, const string& src_worker,
+                     int64 step_id, int64 id, Device* dst_device,
+                     AllocatorAttributes alloc_attrs,
+                     const TensorCompressionOptions& compression,
+                     thread::ThreadPool* pool)
+      : wi_(wi),
+        src_worker_(src_worker),
+        id_(id),
+        dst_device_(dst_device),
+        alloc_attrs_(alloc_attrs) {
+    req_.set_step_id(step_id);
+    if (compression.ByteSize() > 0) {
+      *req_.mutable_compression() = compression;
+    }
+    resp_.set_decompression_pool(pool);
+  }
+
+  // Adds a recv for "key", and returns the number of recvs in the call.
+  //
+  // REQUIRES: The call has not been started.
+  int Add(StringPiece key, const Rendezvous::Args& recv_args,
+          Rendezvous::DoneCallback done) {
+    req_.add_rendezvous_key(key.data(), key.size());
+    recvs_.push_back({recv_args, std::move(done)});
+    return recvs_.size();
+  }
+
+  void Start(std::function<void()> recv_done) override {
+    if (!status().ok()) {
+      // Aborted before the call could be issued.
+      recv_done();
+      return;
+    }
+    recv_tensors_metrics()->rpcs->IncrementBy(1);
+    resp_.InitAlloc(dst_device_, alloc_attrs_);
+    wi_->RecvTensorsAsync(&opts_, &req_, &resp_, [this]() { OnTensor(); },
+                          [this, recv_done](const Status& s) {
+                            if (!s.ok()) {
+                              mutex_lock l(mu_);
+                              status_.Update(s);
+                            }
+                            recv_done();
+                          });
+  }
+
+  void StartAbort(const Status& s) override {
+    {
+      mutex_lock l(mu_);
+      status_.Update(s);
+    }
+    opts_.StartCancel();
+  }
+
+  Status status() const override {
+    mutex_lock l(mu_);
+    return status_;
+  }
+
+  // Fails every recv whose tensor was not received.
+  //
+  // REQUIRES: The call has completed.
+  void FailPendingRecvs() {
+    Status s = status();
+    if (s.ok()) {
+      s = errors::Internal("RecvTensors from ", src_worker_,
+                           " ended without returning all tensors.");
+    }
+    for (Recv& recv : recvs_) {
+      if (recv.done) {
+        recv.done(s, Rendezvous::Args(), recv.recv_args, Tensor{}, false);
+        recv.done = nullptr;
+      }
+    }
+  }
+
+  WorkerInterface* wi() const { return wi_; }
+  const string& src_worker() const { return src_worker_; }
+  int64 id() const { return id_; }
+
+ private:
+  struct Recv {
+    Rendezvous::Args recv_args;
+    Rendezvous::DoneCallback done;  // Cleared once the recv is done.
+  };
+
+  // Delivers the tensor that has just been read into "resp_".
+  void OnTensor() {
+    const int index = resp_.metadata().key_index();
+    if (index < 0 || index >= static_cast<int>(recvs_.size()) ||
+        !recvs_[index].done) {
+      mutex_lock l(mu_);
+      status_.Update(errors::Internal("Unexpected tensor ", index,
+                                      " in RecvTensors response from ",
+                                      src_worker_));
+      return;
+    }
+    recv_tensors_metrics()->RecordTensor(resp_.tensor());
+    Recv& recv = recvs_[index];
+    recv.done(Status::OK(), Rendezvous::Args(), recv.recv_args,
+              resp_.tensor(), resp_.metadata().is_dead());
+    recv.done = nullptr;
+  }
+
+  WorkerInterface* const wi_;
+  const string src_worker_;
+  const int64 id_;
+  Device* const dst_device_;
+  const AllocatorAttributes alloc_attrs_;
+  CallOptions opts_;
+  RecvTensorsRequest req_;
+  TensorResponse resp_;
+  std::vector<Recv> recvs_;
+
+  mutable mutex mu_;
+  Status status_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RpcRecvTensorsCall);
+};
+
 // A private cache that wraps env->worker_cache and allows reuse of
 // WorkerInterface objects.
 class WorkerFreeListCache : public WorkerCacheInterface {
@@ -308,20 +515,33 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
     return;
   }
 
+  if (batch_window_usecs_ > 0) {
+    // The recv is batched with others from the same worker instead.
+    string src_worker = call->src_worker_;
+    get_call_freelist()->Release(call, cache_);
+    RecvInBatch(src_worker, rwi, dst_device, parsed, recv_args,
+                std::move(done));
+    return;
+  }
+
   call->Init(rwi, step_id_, parsed.FullKey(), recv_args.alloc_attrs, dst_device,
-             recv_args, std::move(done));
+             recv_args, compression_, env_->compute_pool, std::move(done));
 
   // Record "call" in active_ so that it can be aborted cleanly.
   RegisterCall(call);
 
   // Start "call".
   Ref();
+  recv_tensor_metrics()->rpcs->IncrementBy(1);
   call->Start([this, call]() {
     // Removes "call" from active_. Prevent StartAbort().
     DeregisterCall(call);
     // If StartAbort was called prior to DeregisterCall, then the
     // current status should be bad.
     Status s = call->status();
+    if (s.ok()) {
+      recv_tensor_metrics()->RecordTensor(call->tensor());
+    }
     call->done()(s, Args(), call->recv_args(), call->tensor(), call->is_dead());
     cache_->ReleaseWorker(call->src_worker_, call->wi_);
     call->wi_ = nullptr;
@@ -330,15 +550,96 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
   });
 }
 
+void RpcRemoteRendezvous::RecvInBatch(const string& src_worker,
+                                      WorkerInterface* rwi, Device* dst_device,
+                                      const Rendezvous::ParsedKey& parsed,
+                                      const Rendezvous::Args& recv_args,
+                                      DoneCallback done) {
+  // Tensors in one batch share the response object, and so its allocator.
+  const string batch_key = strings::StrCat(
+      src_worker, ";", dst_device->name(), ";", recv_args.alloc_attrs.value);
+  RpcRecvTensorsCall* full_batch = nullptr;
+  int64 new_batch_id = -1;
+  {
+    mutex_lock l(batch_mu_);
+    RpcRecvTensorsCall*& batch = open_batches_[batch_key];
+    if (batch == nullptr) {
+      new_batch_id = next_batch_id_++;
+      batch = new RpcRecvTensorsCall(rwi, src_worker, step_id_, new_batch_id,
+                                     dst_device, recv_args.alloc_attrs,
+                                     compression_, env_->compute_pool);
+    }
+    if (batch->Add(parsed.FullKey(), recv_args, std::move(done)) >=
+        max_batch_size_) {
+      full_batch = batch;
+      open_batches_.erase(batch_key);
+    }
+  }
+  if (new_batch_id >= 0 && full_batch == nullptr) {
+    // Wait for the other recvs of the step, which the executor issues
+    // at about the same time, before starting the batch.
+    Ref();
+    env_->env->SchedClosureAfter(
+        batch_window_usecs_, [this, batch_key, new_batch_id]() {
+          StartBatchIfOpen(batch_key, new_batch_id);
+          Unref();
+        });
+  }
+  if (full_batch != nullptr) {
+    StartBatch(full_batch);
+  }
+}
+
+void RpcRemoteRendezvous::StartBatchIfOpen(const string& batch_key,
+                                           int64 batch_id) {
+  RpcRecvTensorsCall* batch = nullptr;
+  {
+    mutex_lock l(batch_mu_);
+    auto it = open_batches_.find(batch_key);
+    if (it == open_batches_.end() || it->second->id() != batch_id) {
+      // The batch has already been started because it was full.
+      return;
+    }
+    batch = it->second;
+    open_batches_.erase(it);
+  }
+  StartBatch(batch);
+}
+
+void RpcRemoteRendezvous::StartBatch(RpcRecvTensorsCall* batch) {
+  // Record "batch" in active_ so that it can be aborted cleanly.
+  RegisterCall(batch);
+
+  Ref();
+  batch->Start([this, batch]() {
+    // Removes "batch" from active_. Prevent StartAbort().
+    DeregisterCall(batch);
+    batch->FailPendingRecvs();
+    cache_->ReleaseWorker(batch->src_worker(), batch->wi());
+    delete batch;
+    Unref();
+  });
+}
+
 }  // namespace
 
-RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env)
+RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env,
+                                   const RPCOptions& rpc_options)
     : BaseRendezvousMgr(env),
-      cache_(new WorkerFreeListCache(env->worker_cache)) {}
+      cache_(new WorkerFreeListCache(env->worker_cache)),
+      batch_window_usecs_(std::max<int64>(
+          rpc_options.recv_batch_window_usecs(), 0)),
+      max_batch_size_(rpc_options.recv_batch_max_size() > 0
+                          ? rpc_options.recv_batch_max_size()
+                          : 128),
+      compression_(rpc_options.recv_tensor_compression()) {}
 
 BaseRemoteRendezvous* RpcRendezvousMgr::Create(int64 step_id,
                                                const WorkerEnv* worker_env) {
-  return new RpcRemoteRendezvous(worker_env, cache_.get(), step_id);
+  rpc_rendezvous_steps->GetCell()->IncrementBy(1);
+  return new RpcRemoteRendezvous(worker_env, cache_.get(), step_id,
+                                 batch_window_usecs_, max_batch_size_,
+                                 compression_);
 }
 
 }  // end namespace tensorflow
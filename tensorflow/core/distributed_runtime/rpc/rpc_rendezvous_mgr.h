@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/distributed_runtime/worker_env.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/protobuf/config.pb.h"
 
 namespace tensorflow {
 
@@ -41,9 +42,19 @@ namespace tensorflow {
 //
 // Tensors sent and recved through rendezvous managed by this
 // RendezvousMgr must have keys generated by Rendezvous::CreateKey.
+//
+// By default every tensor received from a remote worker takes its own
+// RecvTensor call. If "rpc_options.recv_batch_window_usecs" is positive,
+// the recvs that a step issues to the same remote worker within that
+// window are instead coalesced into one RecvTensors call, of at most
+// "rpc_options.recv_batch_max_size" tensors.
+//
+// Every tensor is requested with the "rpc_options.recv_tensor_compression"
+// options, which the sending worker applies where it can.
 class RpcRendezvousMgr : public BaseRendezvousMgr {
  public:
-  explicit RpcRendezvousMgr(const WorkerEnv* env);
+  explicit RpcRendezvousMgr(const WorkerEnv* env,
+                            const RPCOptions& rpc_options = RPCOptions());
 
  protected:
   BaseRemoteRendezvous* Create(int64 step_id,
@@ -53,6 +64,13 @@ class RpcRendezvousMgr : public BaseRendezvousMgr {
   // Private cache_ that allows us to reuse WorkerInterface objects.
   std::unique_ptr<WorkerCacheInterface> cache_;
 
+  // How long to wait for more recvs before starting a RecvTensors call,
+  // or 0 if recvs are not batched.
+  const int64 batch_window_usecs_;
+  const int64 max_batch_size_;
+
+  const TensorCompressionOptions compression_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRendezvousMgr);
 };
 
@@ -0,0 +1,323 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory.h"
+
+#include "tensorflow/core/platform/platform.h"
+
+#if !defined(PLATFORM_WINDOWS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <string.h>
+#include <unordered_map>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#if !defined(PLATFORM_WINDOWS)
+#include "tensorflow/core/platform/posix/error.h"
+#endif
+
+namespace tensorflow {
+
+namespace {
+
+// Every segment name starts with this prefix.
+constexpr char kNamePrefix[] = "/tf_shm_";
+
+// How long a slot whose call failed is kept from being reserved again.
+const int64 kReleaseDelayMicros = 60 * 1000 * 1000;
+
+// The number of rings of other processes that a sender keeps mapped.
+const size_t kMaxMappedRings = 64;
+
+bool IsValidName(const string& name) {
+  return StringPiece(name).starts_with(kNamePrefix) &&
+         name.find('/', 1) == string::npos;
+}
+
+// Maps the segment named "name" of "size" bytes, creating it with that
+// size if "create" is true.
+Status MapSegment(const string& name, int64 size, bool create, char** data) {
+  if (!IsValidName(name)) {
+    return errors::InvalidArgument("Invalid shared memory segment name \"",
+                                   name, "\"");
+  }
+  if (size <= 0) {
+    return errors::InvalidArgument("Invalid shared memory segment size ",
+                                   size);
+  }
+#if defined(PLATFORM_WINDOWS)
+  return errors::Unimplemented("Shared memory is not supported.");
+#else
+  const int fd = create ? shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL,
+                                   S_IRUSR | S_IWUSR)
+                        : shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) return IOError(name, errno);
+  Status s;
+  if (create) {
+    if (ftruncate(fd, size) != 0) s = IOError(name, errno);
+  } else {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      s = IOError(name, errno);
+    } else if (st.st_size < size) {
+      s = errors::InvalidArgument("Shared memory segment \"", name, "\" has ",
+                                  st.st_size, " bytes, expected ", size);
+    }
+  }
+  if (s.ok()) {
+    void* address =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+      s = IOError(name, errno);
+    } else {
+      *data = static_cast<char*>(address);
+    }
+  }
+  close(fd);
+  if (!s.ok() && create) shm_unlink(name.c_str());
+  return s;
+#endif  // defined(PLATFORM_WINDOWS)
+}
+
+// Allocates the buffer of one tensor in a segment that it takes ownership
+// of, and unmaps the segment when the tensor is freed.
+class SharedMemoryTensorAllocator : public Allocator {
+ public:
+  explicit SharedMemoryTensorAllocator(
+      std::unique_ptr<SharedMemorySegment> segment)
+      : segment_(std::move(segment)) {}
+
+  string Name() override { return "SharedMemoryTensorAllocator"; }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    if (reinterpret_cast<intptr_t>(segment_->data()) % alignment != 0 ||
+        num_bytes > static_cast<size_t>(segment_->size())) {
+      return nullptr;
+    }
+    return segment_->data();
+  }
+
+  void DeallocateRaw(void* ptr) override {
+    CHECK_EQ(ptr, static_cast<void*>(segment_->data()));
+    delete this;
+  }
+
+ private:
+  std::unique_ptr<SharedMemorySegment> segment_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedMemoryTensorAllocator);
+};
+
+// The rings of the receivers that this process has sent tensors to.
+class MappedRings {
+ public:
+  static MappedRings* Global() {
+    static MappedRings* rings = new MappedRings;
+    return rings;
+  }
+
+  Status Get(const string& name, int64 size,
+             std::shared_ptr<SharedMemorySegment>* ring) {
+    {
+      mutex_lock l(mu_);
+      auto it = rings_.find(name);
+      if (it != rings_.end() && it->second->size() == size) {
+        *ring = it->second;
+        return Status::OK();
+      }
+    }
+    std::unique_ptr<SharedMemorySegment> segment;
+    TF_RETURN_IF_ERROR(SharedMemorySegment::Open(name, size, &segment));
+    ring->reset(segment.release());
+    mutex_lock l(mu_);
+    // Rings of receivers that have gone away are only dropped when there
+    // are too many, which a long-running job rarely reaches.
+    if (rings_.size() >= kMaxMappedRings) rings_.clear();
+    rings_[name] = *ring;
+    return Status::OK();
+  }
+
+ private:
+  mutex mu_;
+  std::unordered_map<string, std::shared_ptr<SharedMemorySegment>> rings_
+      GUARDED_BY(mu_);
+};
+
+}  // namespace
+
+/* static */
+Status SharedMemorySegment::Create(const string& name, int64 size,
+                                   std::unique_ptr<SharedMemorySegment>* out) {
+  char* data = nullptr;
+  TF_RETURN_IF_ERROR(MapSegment(name, size, true /* create */, &data));
+  out->reset(new SharedMemorySegment(data, size));
+  return Status::OK();
+}
+
+/* static */
+Status SharedMemorySegment::Open(const string& name, int64 size,
+                                 std::unique_ptr<SharedMemorySegment>* out) {
+  char* data = nullptr;
+  TF_RETURN_IF_ERROR(MapSegment(name, size, false /* create */, &data));
+  out->reset(new SharedMemorySegment(data, size));
+  return Status::OK();
+}
+
+/* static */
+void SharedMemorySegment::Unlink(const string& name) {
+#if !defined(PLATFORM_WINDOWS)
+  if (IsValidName(name)) shm_unlink(name.c_str());
+#endif
+}
+
+SharedMemorySegment::~SharedMemorySegment() {
+#if !defined(PLATFORM_WINDOWS)
+  munmap(data_, size_);
+#endif
+}
+
+/* static */
+Status SharedMemoryRing::Create(int num_slots, int64 slot_bytes,
+                                std::unique_ptr<SharedMemoryRing>* out) {
+  if (num_slots <= 0 || slot_bytes <= 0) {
+    return errors::InvalidArgument("Invalid shared memory ring of ", num_slots,
+                                   " slots of ", slot_bytes, " bytes");
+  }
+  // Keep every slot aligned for any tensor type.
+  slot_bytes = (slot_bytes + Allocator::kAllocatorAlignment - 1) /
+               Allocator::kAllocatorAlignment * Allocator::kAllocatorAlignment;
+  const string prefix = strings::StrCat(
+      kNamePrefix, strings::Hex(random::New64(), strings::ZERO_PAD_16));
+  std::unique_ptr<SharedMemorySegment> segment;
+  TF_RETURN_IF_ERROR(SharedMemorySegment::Create(
+      strings::StrCat(prefix, "_ring"), num_slots * slot_bytes, &segment));
+  out->reset(new SharedMemoryRing(prefix, slot_bytes, std::move(segment)));
+  return Status::OK();
+}
+
+SharedMemoryRing::SharedMemoryRing(const string& prefix, int64 slot_bytes,
+                                   std::unique_ptr<SharedMemorySegment> segment)
+    : prefix_(prefix),
+      name_(strings::StrCat(prefix, "_ring")),
+      slot_bytes_(slot_bytes),
+      segment_(std::move(segment)),
+      free_after_micros_(segment_->size() / slot_bytes, 0) {}
+
+SharedMemoryRing::~SharedMemoryRing() { SharedMemorySegment::Unlink(name_); }
+
+int64 SharedMemoryRing::Acquire() {
+  const int64 now = Env::Default()->NowMicros();
+  mutex_lock l(mu_);
+  const int num_slots = free_after_micros_.size();
+  for (int i = 0; i < num_slots; ++i) {
+    const int slot = (next_slot_ + i) % num_slots;
+    if (free_after_micros_[slot] <= now) {
+      free_after_micros_[slot] = kint64max;
+      next_slot_ = (slot + 1) % num_slots;
+      return slot * slot_bytes_;
+    }
+  }
+  return -1;
+}
+
+void SharedMemoryRing::Release(int64 offset, bool reusable) {
+  const int64 free_after =
+      reusable ? 0 : Env::Default()->NowMicros() + kReleaseDelayMicros;
+  mutex_lock l(mu_);
+  free_after_micros_[offset / slot_bytes_] = free_after;
+}
+
+string SharedMemoryRing::NewSegmentName() {
+  mutex_lock l(mu_);
+  return strings::StrCat(prefix_, "_", next_segment_id_++);
+}
+
+Status WriteTensorToSharedMemory(const SharedMemoryRecvRequest& request,
+                                 const Tensor& val,
+                                 SharedMemoryRecvResponse* response) {
+  // Only a receiver whose ring this process can map shares its shared
+  // memory, so check that before writing anything, even to a segment.
+  std::shared_ptr<SharedMemorySegment> ring;
+  TF_RETURN_IF_ERROR(MappedRings::Global()->Get(request.ring_name(),
+                                                request.ring_bytes(), &ring));
+  const StringPiece content = val.tensor_data();
+  if (static_cast<int64>(content.size()) <= request.slot_bytes()) {
+    if (request.slot_offset() < 0 ||
+        request.slot_offset() + request.slot_bytes() > request.ring_bytes()) {
+      return errors::InvalidArgument("Invalid shared memory slot at ",
+                                     request.slot_offset());
+    }
+    memcpy(ring->data() + request.slot_offset(), content.data(),
+           content.size());
+    response->set_location(SharedMemoryRecvResponse::SLOT);
+  } else {
+    std::unique_ptr<SharedMemorySegment> segment;
+    TF_RETURN_IF_ERROR(SharedMemorySegment::Create(
+        request.segment_name(), content.size(), &segment));
+    memcpy(segment->data(), content.data(), content.size());
+    response->set_location(SharedMemoryRecvResponse::SEGMENT);
+  }
+  response->set_dtype(val.dtype());
+  val.shape().AsProto(response->mutable_tensor_shape());
+  return Status::OK();
+}
+
+Status ReadTensorFromSharedMemory(const SharedMemoryRecvRequest& request,
+                                  const SharedMemoryRecvResponse& response,
+                                  const SharedMemoryRing& ring, Tensor* val) {
+  if (!DataTypeCanUseMemcpy(response.dtype()) ||
+      !TensorShape::IsValid(response.tensor_shape())) {
+    return errors::InvalidArgument("Invalid tensor in shared memory");
+  }
+  const TensorShape shape(response.tensor_shape());
+  const int64 num_bytes = shape.num_elements() * DataTypeSize(response.dtype());
+  if (response.location() == SharedMemoryRecvResponse::SLOT) {
+    if (num_bytes > request.slot_bytes()) {
+      return errors::DataLoss("Tensor of ", num_bytes,
+                              " bytes does not fit in its shared memory slot");
+    }
+    Tensor t(cpu_allocator(), response.dtype(), shape);
+    if (num_bytes > 0) {
+      memcpy(const_cast<char*>(t.tensor_data().data()),
+             ring.data() + request.slot_offset(), num_bytes);
+    }
+    *val = std::move(t);
+    return Status::OK();
+  }
+  std::unique_ptr<SharedMemorySegment> segment;
+  Status s =
+      SharedMemorySegment::Open(request.segment_name(), num_bytes, &segment);
+  // The segment stays mapped for as long as the tensor needs it.
+  SharedMemorySegment::Unlink(request.segment_name());
+  TF_RETURN_IF_ERROR(s);
+  SharedMemoryTensorAllocator* allocator =
+      new SharedMemoryTensorAllocator(std::move(segment));
+  // The allocator is owned by the tensor buffer from this point.
+  *val = Tensor(allocator, response.dtype(), shape);
+  return Status::OK();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,143 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_H_
+#define THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_H_
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+namespace tensorflow {
+
+// A POSIX shared memory segment, mapped into this process. Only segments
+// whose names were made by a SharedMemoryRing can be created or opened,
+// so that a peer cannot direct writes to unrelated shared memory.
+class SharedMemorySegment {
+ public:
+  // Creates a segment named "name" of "size" bytes, and maps it. Fails if
+  // a segment of that name already exists.
+  static Status Create(const string& name, int64 size,
+                       std::unique_ptr<SharedMemorySegment>* out);
+
+  // Maps the existing segment named "name", which must hold at least
+  // "size" bytes.
+  static Status Open(const string& name, int64 size,
+                     std::unique_ptr<SharedMemorySegment>* out);
+
+  // Removes the name "name", if it exists. The segment itself is freed
+  // once no process maps it.
+  static void Unlink(const string& name);
+
+  // Unmaps the segment.
+  ~SharedMemorySegment();
+
+  char* data() const { return data_; }
+  int64 size() const { return size_; }
+
+ private:
+  SharedMemorySegment(char* data, int64 size) : data_(data), size_(size) {}
+
+  char* const data_;
+  const int64 size_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedMemorySegment);
+};
+
+// The shared memory through which a worker receives tensors from the
+// workers on the same host: a segment of fixed-size slots, into which
+// senders copy small tensors, and the names of the segments in which they
+// hand over larger ones.
+//
+// Slots are only ever reserved and released by the receiver, one per
+// call, so that a sender may write to the slot of a call without any
+// synchronization with other processes.
+class SharedMemoryRing {
+ public:
+  // Creates a ring of "num_slots" slots of "slot_bytes" bytes each.
+  static Status Create(int num_slots, int64 slot_bytes,
+                       std::unique_ptr<SharedMemoryRing>* out);
+
+  // Unmaps and unlinks the ring. Segments that were handed over through it
+  // are owned by their receivers, and are not affected.
+  ~SharedMemoryRing();
+
+  const string& name() const { return name_; }
+  int64 size() const { return segment_->size(); }
+  int64 slot_bytes() const { return slot_bytes_; }
+  const char* data() const { return segment_->data(); }
+
+  // Reserves a slot and returns its offset, or -1 if every slot is in use.
+  int64 Acquire();
+
+  // Releases the slot at "offset". If "reusable" is false, the call that
+  // reserved it failed, and the sender may yet write to it; the slot is
+  // then handed out again only after a grace period.
+  void Release(int64 offset, bool reusable);
+
+  // Returns a name, unique to this ring, for a segment that a sender
+  // creates to hand a tensor over.
+  string NewSegmentName();
+
+ private:
+  SharedMemoryRing(const string& prefix, int64 slot_bytes,
+                   std::unique_ptr<SharedMemorySegment> segment);
+
+  const string prefix_;
+  const string name_;
+  const int64 slot_bytes_;
+  const std::unique_ptr<SharedMemorySegment> segment_;
+
+  mutex mu_;
+  // For each slot, the time in microseconds after which it may be
+  // reserved, or kint64max while it is reserved.
+  std::vector<int64> free_after_micros_ GUARDED_BY(mu_);
+  int next_slot_ GUARDED_BY(mu_) = 0;
+  int64 next_segment_id_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedMemoryRing);
+};
+
+// Writes the content of "val", which must be in host memory and have a
+// memcpy-able type, to the shared memory named in "request": to the slot
+// reserved for the call if it fits there, or to a new segment otherwise.
+// Describes the tensor in "*response".
+//
+// Returns an error, which the caller may handle by sending the tensor over
+// RPC, if the shared memory cannot be used, in particular if the ring named
+// in "request" cannot be mapped. Nothing is written in that case.
+Status WriteTensorToSharedMemory(const SharedMemoryRecvRequest& request,
+                                 const Tensor& val,
+                                 SharedMemoryRecvResponse* response);
+
+// Reads into "*val" the tensor described by "response", which a sender
+// wrote to the shared memory that "request" named in "ring". A tensor
+// handed over in a segment is not copied: "*val" takes ownership of the
+// segment.
+Status ReadTensorFromSharedMemory(const SharedMemoryRecvRequest& request,
+                                  const SharedMemoryRecvResponse& response,
+                                  const SharedMemoryRing& ring, Tensor* val);
+
+}  // namespace tensorflow
+
+#endif  // THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_H_
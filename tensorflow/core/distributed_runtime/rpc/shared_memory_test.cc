@@ -0,0 +1,157 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory.h"
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns the request that a receiver would send with "ring", with the
+// slot at "slot" reserved, or no slot if "slot" is negative.
+SharedMemoryRecvRequest MakeRequest(SharedMemoryRing* ring, int64 slot) {
+  SharedMemoryRecvRequest request;
+  request.set_ring_name(ring->name());
+  request.set_ring_bytes(ring->size());
+  if (slot >= 0) {
+    request.set_slot_offset(slot);
+    request.set_slot_bytes(ring->slot_bytes());
+  }
+  request.set_segment_name(ring->NewSegmentName());
+  return request;
+}
+
+Tensor FloatTensor(int64 n) {
+  Tensor t(DT_FLOAT, TensorShape({n}));
+  test::FillIota<float>(&t, 1.0f);
+  return t;
+}
+
+TEST(SharedMemoryTest, AcquireAndRelease) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(2, 100, &ring));
+  EXPECT_GE(ring->slot_bytes(), 100);
+  EXPECT_EQ(0, ring->slot_bytes() % Allocator::kAllocatorAlignment);
+  EXPECT_EQ(2 * ring->slot_bytes(), ring->size());
+
+  const int64 first = ring->Acquire();
+  const int64 second = ring->Acquire();
+  EXPECT_EQ(0, first);
+  EXPECT_EQ(ring->slot_bytes(), second);
+  EXPECT_EQ(-1, ring->Acquire());
+
+  ring->Release(first, true /* reusable */);
+  EXPECT_EQ(first, ring->Acquire());
+
+  // A slot whose call failed is not handed out again right away.
+  ring->Release(second, false /* reusable */);
+  EXPECT_EQ(-1, ring->Acquire());
+
+  EXPECT_NE(ring->NewSegmentName(), ring->NewSegmentName());
+}
+
+TEST(SharedMemoryTest, TensorInSlot) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4, 1024, &ring));
+  const SharedMemoryRecvRequest request = MakeRequest(ring.get(), 1024);
+
+  const Tensor sent = FloatTensor(256);
+  SharedMemoryRecvResponse response;
+  TF_ASSERT_OK(WriteTensorToSharedMemory(request, sent, &response));
+  EXPECT_EQ(SharedMemoryRecvResponse::SLOT, response.location());
+
+  Tensor received;
+  TF_ASSERT_OK(ReadTensorFromSharedMemory(request, response, *ring, &received));
+  test::ExpectTensorEqual<float>(sent, received);
+
+  // Empty tensors fit in any slot.
+  TF_ASSERT_OK(WriteTensorToSharedMemory(request, FloatTensor(0), &response));
+  TF_ASSERT_OK(ReadTensorFromSharedMemory(request, response, *ring, &received));
+  test::ExpectTensorEqual<float>(FloatTensor(0), received);
+}
+
+TEST(SharedMemoryTest, TensorInSegment) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4, 1024, &ring));
+  // One tensor too large for its slot, and one sent without a slot.
+  for (const SharedMemoryRecvRequest& request :
+       {MakeRequest(ring.get(), 0), MakeRequest(ring.get(), -1)}) {
+    const Tensor sent = FloatTensor(request.slot_bytes() > 0 ? 1000 : 10);
+    SharedMemoryRecvResponse response;
+    TF_ASSERT_OK(WriteTensorToSharedMemory(request, sent, &response));
+    EXPECT_EQ(SharedMemoryRecvResponse::SEGMENT, response.location());
+
+    Tensor received;
+    TF_ASSERT_OK(
+        ReadTensorFromSharedMemory(request, response, *ring, &received));
+    test::ExpectTensorEqual<float>(sent, received);
+
+    // The receiver unlinked the segment when it took it over.
+    std::unique_ptr<SharedMemorySegment> segment;
+    EXPECT_FALSE(SharedMemorySegment::Open(request.segment_name(),
+                                           sent.TotalBytes(), &segment)
+                     .ok());
+  }
+}
+
+TEST(SharedMemoryTest, RejectsForeignNames) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4, 1024, &ring));
+  SharedMemoryRecvResponse response;
+
+  SharedMemoryRecvRequest request = MakeRequest(ring.get(), 0);
+  request.set_ring_name("/some_other_segment");
+  EXPECT_FALSE(
+      WriteTensorToSharedMemory(request, FloatTensor(10), &response).ok());
+
+  request = MakeRequest(ring.get(), -1);
+  request.set_segment_name("/tf_shm_/../some_other_segment");
+  EXPECT_FALSE(
+      WriteTensorToSharedMemory(request, FloatTensor(10), &response).ok());
+}
+
+TEST(SharedMemoryTest, RejectsSlotOutsideRing) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4, 1024, &ring));
+  SharedMemoryRecvRequest request = MakeRequest(ring.get(), 0);
+  request.set_slot_offset(ring->size());
+  SharedMemoryRecvResponse response;
+  EXPECT_FALSE(
+      WriteTensorToSharedMemory(request, FloatTensor(10), &response).ok());
+}
+
+TEST(SharedMemoryTest, RejectsRingThatCannotBeMapped) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4, 1024, &ring));
+  const SharedMemoryRecvRequest request = MakeRequest(ring.get(), 0);
+  // The ring is gone, as it would be for a receiver in another IPC
+  // namespace, so even a tensor too large for the slot is not written.
+  ring.reset();
+  SharedMemoryRecvResponse response;
+  EXPECT_FALSE(
+      WriteTensorToSharedMemory(request, FloatTensor(1000), &response).ok());
+  std::unique_ptr<SharedMemorySegment> segment;
+  EXPECT_FALSE(
+      SharedMemorySegment::Open(request.segment_name(), 1, &segment).ok());
+}
+
+}  // namespace
+}  // namespace tensorflow
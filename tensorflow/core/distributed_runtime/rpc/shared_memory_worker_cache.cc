@@ -0,0 +1,246 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_worker_cache.h"
+
+#include <unordered_set>
+
+#include "tensorflow/core/distributed_runtime/tensor_coding.h"
+#include "tensorflow/core/distributed_runtime/worker_interface.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/protobuf_internal.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+namespace tensorflow {
+
+namespace {
+
+auto* shared_memory_recv_tensors = monitoring::Counter<1>::New(
+    "/tensorflow/core/shared_memory_recv_tensors",
+    "The number of tensors received from co-located workers through shared "
+    "memory, by where the sender put them.",
+    "location");
+
+// Forwards every call to the worker that it wraps, but asks for the
+// tensors received with RecvTensor to be passed through shared memory.
+class SharedMemoryWorker : public WorkerInterface {
+ public:
+  SharedMemoryWorker(WorkerInterface* wrapped, SharedMemoryRing* ring)
+      : wrapped_(wrapped), ring_(ring) {}
+
+  ~SharedMemoryWorker() override {}
+
+  WorkerInterface* wrapped() const { return wrapped_; }
+
+  void GetStatusAsync(const GetStatusRequest* request,
+                      GetStatusResponse* response,
+                      StatusCallback done) override {
+    wrapped_->GetStatusAsync(request, response, std::move(done));
+  }
+
+  void RegisterGraphAsync(const RegisterGraphRequest* request,
+                          RegisterGraphResponse* response,
+                          StatusCallback done) override {
+    wrapped_->RegisterGraphAsync(request, response, std::move(done));
+  }
+
+  void DeregisterGraphAsync(const DeregisterGraphRequest* request,
+                            DeregisterGraphResponse* response,
+                            StatusCallback done) override {
+    wrapped_->DeregisterGraphAsync(request, response, std::move(done));
+  }
+
+  void RunGraphAsync(CallOptions* opts, RunGraphRequestWrapper* request,
+                     MutableRunGraphResponseWrapper* response,
+                     StatusCallback done) override {
+    wrapped_->RunGraphAsync(opts, request, response, std::move(done));
+  }
+
+  void RunGraphAsync(CallOptions* opts, const RunGraphRequest* request,
+                     RunGraphResponse* response, StatusCallback done) override {
+    wrapped_->RunGraphAsync(opts, request, response, std::move(done));
+  }
+
+  MutableRunGraphRequestWrapper* CreateRunGraphRequest() override {
+    return wrapped_->CreateRunGraphRequest();
+  }
+
+  MutableRunGraphResponseWrapper* CreateRunGraphResponse() override {
+    return wrapped_->CreateRunGraphResponse();
+  }
+
+  void CleanupGraphAsync(const CleanupGraphRequest* request,
+                         CleanupGraphResponse* response,
+                         StatusCallback done) override {
+    wrapped_->CleanupGraphAsync(request, response, std::move(done));
+  }
+
+  void CleanupAllAsync(const CleanupAllRequest* request,
+                       CleanupAllResponse* response,
+                       StatusCallback done) override {
+    wrapped_->CleanupAllAsync(request, response, std::move(done));
+  }
+
+  void RecvTensorAsync(CallOptions* opts, const RecvTensorRequest* request,
+                       TensorResponse* response, StatusCallback done) override {
+    if (request->has_transport_options()) {
+      // The request already asks for another transport.
+      wrapped_->RecvTensorAsync(opts, request, response, std::move(done));
+      return;
+    }
+    SharedMemoryRecvRequest shm;
+    shm.set_ring_name(ring_->name());
+    shm.set_ring_bytes(ring_->size());
+    const int64 slot = ring_->Acquire();
+    if (slot >= 0) {
+      shm.set_slot_offset(slot);
+      shm.set_slot_bytes(ring_->slot_bytes());
+    }
+    shm.set_segment_name(ring_->NewSegmentName());
+    RecvTensorRequest* req = new RecvTensorRequest(*request);
+    req->mutable_transport_options()->PackFrom(shm);
+
+    SharedMemoryRing* ring = ring_;
+    wrapped_->RecvTensorAsync(
+        opts, req, response,
+        [req, shm, slot, ring, response, done](const Status& s) {
+          Status status = s;
+          if (status.ok() && response->metadata().has_transport_options()) {
+            status = ReceiveFromSharedMemory(shm, *ring, response);
+          }
+          if (slot >= 0) {
+            // After a failed call, the sender may still write to the slot.
+            ring->Release(slot, s.ok());
+          }
+          if (!status.ok()) {
+            // The sender may have created a segment that was not claimed.
+            SharedMemorySegment::Unlink(shm.segment_name());
+          }
+          delete req;
+          done(status);
+        });
+  }
+
+  void RecvTensorsAsync(CallOptions* opts, const RecvTensorsRequest* request,
+                        TensorResponse* response,
+                        std::function<void()> on_tensor,
+                        StatusCallback done) override {
+    wrapped_->RecvTensorsAsync(opts, request, response, std::move(on_tensor),
+                               std::move(done));
+  }
+
+  void LoggingAsync(const LoggingRequest* request, LoggingResponse* response,
+                    StatusCallback done) override {
+    wrapped_->LoggingAsync(request, response, std::move(done));
+  }
+
+  void TracingAsync(const TracingRequest* request, TracingResponse* response,
+                    StatusCallback done) override {
+    wrapped_->TracingAsync(request, response, std::move(done));
+  }
+
+ private:
+  // Fills in the tensor of "response", whose content the sender wrote to
+  // the shared memory named in "shm".
+  static Status ReceiveFromSharedMemory(const SharedMemoryRecvRequest& shm,
+                                        const SharedMemoryRing& ring,
+                                        TensorResponse* response) {
+    SharedMemoryRecvResponse location;
+    TF_RETURN_IF_ERROR(ParseAny(response->metadata().transport_options(),
+                                &location,
+                                "tensorflow.SharedMemoryRecvResponse"));
+    Tensor val;
+    TF_RETURN_IF_ERROR(ReadTensorFromSharedMemory(shm, location, ring, &val));
+    shared_memory_recv_tensors
+        ->GetCell(location.location() == SharedMemoryRecvResponse::SLOT
+                      ? "slot"
+                      : "segment")
+        ->IncrementBy(1);
+    return response->InitFromHostTensor(val);
+  }
+
+  WorkerInterface* const wrapped_;  // Not owned.
+  SharedMemoryRing* const ring_;    // Not owned.
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedMemoryWorker);
+};
+
+class SharedMemoryWorkerCache : public WorkerCacheInterface {
+ public:
+  SharedMemoryWorkerCache(WorkerCacheInterface* wrapped,
+                          std::unique_ptr<SharedMemoryRing> ring,
+                          const std::vector<string>& colocated_targets)
+      : wrapped_(wrapped),
+        ring_(std::move(ring)),
+        colocated_targets_(colocated_targets.begin(),
+                           colocated_targets.end()) {}
+
+  void ListWorkers(std::vector<string>* workers) override {
+    wrapped_->ListWorkers(workers);
+  }
+
+  WorkerInterface* CreateWorker(const string& target) override {
+    WorkerInterface* worker = wrapped_->CreateWorker(target);
+    if (worker == nullptr || colocated_targets_.count(target) == 0) {
+      return worker;
+    }
+    return new SharedMemoryWorker(worker, ring_.get());
+  }
+
+  void ReleaseWorker(const string& target, WorkerInterface* worker) override {
+    if (colocated_targets_.count(target) == 0) {
+      wrapped_->ReleaseWorker(target, worker);
+      return;
+    }
+    wrapped_->ReleaseWorker(
+        target, static_cast<SharedMemoryWorker*>(worker)->wrapped());
+    WorkerCacheInterface::ReleaseWorker(target, worker);
+  }
+
+  bool GetDeviceLocalityNonBlocking(const string& device,
+                                    DeviceLocality* locality) override {
+    return wrapped_->GetDeviceLocalityNonBlocking(device, locality);
+  }
+
+  void GetDeviceLocalityAsync(const string& device, DeviceLocality* locality,
+                              StatusCallback done) override {
+    wrapped_->GetDeviceLocalityAsync(device, locality, std::move(done));
+  }
+
+  void SetLogging(bool active) override { wrapped_->SetLogging(active); }
+
+  void ClearLogs() override { wrapped_->ClearLogs(); }
+
+  bool RetrieveLogs(int64 step_id, StepStats* ss) override {
+    return wrapped_->RetrieveLogs(step_id, ss);
+  }
+
+ private:
+  const std::unique_ptr<WorkerCacheInterface> wrapped_;
+  const std::unique_ptr<SharedMemoryRing> ring_;
+  const std::unordered_set<string> colocated_targets_;
+};
+
+}  // namespace
+
+WorkerCacheInterface* NewSharedMemoryWorkerCache(
+    WorkerCacheInterface* wrapped, std::unique_ptr<SharedMemoryRing> ring,
+    const std::vector<string>& colocated_targets) {
+  return new SharedMemoryWorkerCache(wrapped, std::move(ring),
+                                     colocated_targets);
+}
+
+}  // namespace tensorflow
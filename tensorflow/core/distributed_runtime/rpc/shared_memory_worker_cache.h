@@ -0,0 +1,39 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_WORKER_CACHE_H_
+#define THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_WORKER_CACHE_H_
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory.h"
+#include "tensorflow/core/distributed_runtime/worker_cache.h"
+
+namespace tensorflow {
+
+// Returns a WorkerCacheInterface that behaves like "wrapped", except that
+// the tensors received from the tasks named in "colocated_targets", which
+// run on the same host as this process, are passed through "ring" and the
+// shared memory segments that it names.
+//
+// The returned object takes the ownership of "wrapped".
+WorkerCacheInterface* NewSharedMemoryWorkerCache(
+    WorkerCacheInterface* wrapped, std::unique_ptr<SharedMemoryRing> ring,
+    const std::vector<string>& colocated_targets);
+
+}  // namespace tensorflow
+
+#endif  // THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_WORKER_CACHE_H_
@@ -13,6 +13,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <atomic>
 #include <cstdio>
 #include <functional>
 #include <string>
@@ -25,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/graph/default_device.h"
 #include "tensorflow/core/graph/graph_def_builder.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
@@ -247,4 +249,205 @@ BENCHMARK(BM_SingleDevice)
     ->ArgPair(4, 10000)
     ->ArgPair(1, 1000000);
 
+// Dequeues an input on one worker and runs "num_stages" AddN ops on it on
+// another, while a second client keeps the queue full.  With a
+// "pipeline_depth" > 0 the first worker dequeues for the next steps while the
+// second one is still computing.
+static void BM_PipelinedInput(int iters, int pipeline_depth, int num_stages) {
+  testing::StopTiming();
+  const Cluster* cluster = GetCluster();
+  const int tensor_size = 1000;
+
+  using namespace ::tensorflow::ops;  // NOLINT(build/namespaces)
+  Scope s = Scope::NewRootScope();
+  Scope input = s.WithDevice(cluster->devices[0].name());
+  auto queue =
+      FIFOQueue(input.WithOpName("queue"), {DT_FLOAT}, FIFOQueue::Capacity(16));
+  QueueEnqueue(input.WithOpName("enqueue"), queue,
+               {Const(input, 1.0f, {tensor_size, 1})});
+  QueueClose(input.WithOpName("close"), queue,
+             QueueClose::CancelPendingEnqueues(true));
+  Output x = QueueDequeue(input, queue, {DT_FLOAT})[0];
+  Scope compute = s.WithDevice(cluster->devices[1].name());
+  for (int i = 0; i < num_stages; ++i) {
+    x = AddN(compute, std::vector<Output>({x, x}));
+  }
+  AddN(compute.WithOpName("y"), std::vector<Output>({x}));
+  GraphDef def;
+  TF_CHECK_OK(s.ToGraphDef(&def));
+
+  SessionOptions options(cluster->options);
+  options.config.mutable_graph_options()->set_step_pipeline_depth(
+      pipeline_depth);
+  std::unique_ptr<Session> session(NewSession(options));
+  TF_CHECK_OK(session->Create(def));
+  testing::SetLabel(strings::StrCat("pipeline depth ", pipeline_depth, "; ",
+                                    num_stages, " stages"));
+
+  std::atomic<bool> stop(false);
+  thread::ThreadPool filler(Env::Default(), "filler", 1);
+  filler.Schedule([&session, &stop]() {
+    while (!stop && session->Run({}, {}, {"enqueue"}, nullptr).ok()) {
+    }
+  });
+
+  std::vector<Tensor> outputs;
+  for (int i = 0; i < 3; i++) {
+    TF_CHECK_OK(session->Run({}, {"y:0"}, {}, &outputs));
+  }
+  testing::StartTiming();
+  for (int i = 0; i < iters; i++) {
+    TF_CHECK_OK(session->Run({}, {"y:0"}, {}, &outputs));
+  }
+  testing::StopTiming();
+  stop = true;
+  TF_CHECK_OK(session->Run({}, {}, {"close"}, nullptr));
+  TF_CHECK_OK(session->Close());
+}
+BENCHMARK(BM_PipelinedInput)
+    ->ArgPair(0, 1)
+    ->ArgPair(2, 1)
+    ->ArgPair(0, 30)
+    ->ArgPair(2, 30);
+
+// Starts a cluster of two servers on localhost, each polling for worker
+// RPCs with "num_threads" threads, and returns the options for a session
+// on it and its devices. The servers are never shut down.
+static void MakeWorkerServiceCluster(int num_threads, SessionOptions* options,
+                                     std::vector<DeviceAttributes>* devices) {
+  const int n = 2;
+  std::vector<int> port(n);
+  for (int i = 0; i < n; ++i) {
+    port[i] = testing::PickUnusedPortOrDie();
+  }
+  for (int worker_idx = 0; worker_idx < n; ++worker_idx) {
+    ServerDef server;
+    server.set_protocol("grpc");
+    server.set_job_name("localhost");
+    server.set_task_index(worker_idx);
+    auto job_def = server.mutable_cluster()->add_job();
+    job_def->set_name("localhost");
+    for (int i = 0; i < n; i++) {
+      (*(job_def->mutable_tasks()))[i] = strings::StrCat("localhost:", port[i]);
+    }
+    auto config = server.mutable_default_session_config();
+    (*config->mutable_device_count())["CPU"] = 1;
+    config->mutable_rpc_options()->set_num_worker_service_threads(num_threads);
+
+    std::unique_ptr<ServerInterface> svr;
+    TF_CHECK_OK(NewServer(server, &svr));
+    TF_CHECK_OK(svr->Start());
+    svr.release();
+  }
+
+  (*options->config.mutable_device_count())["CPU"] = 1;
+  options->target = strings::StrCat("grpc://localhost:", port[0]);
+  std::unique_ptr<GrpcSession> session;
+  TF_CHECK_OK(GrpcSession::Create(*options, &session));
+  *devices = session->ListDevices();
+}
+
+// Fetches a tensor of "tensor_size" floats from the second worker of a
+// fresh cluster whose workers poll for RPCs with "num_threads" threads,
+// from 16 concurrent clients, and reports the resulting throughput.
+static void BM_WorkerServiceThroughput(int iters, int num_threads,
+                                       int tensor_size) {
+  testing::StopTiming();
+  const int kClients = 16;
+  SessionOptions options;
+  std::vector<DeviceAttributes> devices;
+  MakeWorkerServiceCluster(num_threads, &options, &devices);
+  CHECK_EQ(devices.size(), size_t{2});
+
+  using namespace ::tensorflow::ops;  // NOLINT(build/namespaces)
+  Scope s = Scope::NewRootScope();
+  Output x = Const(s.WithDevice(devices[1].name()), 1.0f, {tensor_size, 1});
+  Identity(s.WithOpName("y").WithDevice(devices[0].name()), x);
+  GraphDef def;
+  TF_CHECK_OK(s.ToGraphDef(&def));
+
+  std::unique_ptr<Session> session(NewSession(options));
+  TF_CHECK_OK(session->Create(def));
+  std::vector<Tensor> outputs;
+  TF_CHECK_OK(session->Run({}, {"y:0"}, {}, &outputs));
+  testing::SetLabel(strings::StrCat(num_threads, " polling threads; ",
+                                    "tensor bytes/send: ",
+                                    tensor_size * sizeof(float)));
+
+  thread::ThreadPool clients(Env::Default(), "clients", kClients);
+  BlockingCounter done(kClients);
+  testing::StartTiming();
+  for (int c = 0; c < kClients; ++c) {
+    const int steps = iters / kClients + (c < iters % kClients ? 1 : 0);
+    clients.Schedule([&session, &done, steps]() {
+      std::vector<Tensor> outputs;
+      for (int i = 0; i < steps; ++i) {
+        TF_CHECK_OK(session->Run({}, {"y:0"}, {}, &outputs));
+      }
+      done.DecrementCount();
+    });
+  }
+  done.Wait();
+  testing::StopTiming();
+  testing::ItemsProcessed(iters);
+  testing::BytesProcessed(static_cast<int64>(iters) * tensor_size *
+                          sizeof(float));
+  TF_CHECK_OK(session->Close());
+}
+BENCHMARK(BM_WorkerServiceThroughput)
+    ->ArgPair(1, 2)
+    ->ArgPair(2, 2)
+    ->ArgPair(4, 2)
+    ->ArgPair(8, 2)
+    ->ArgPair(1, 1000000)
+    ->ArgPair(2, 1000000)
+    ->ArgPair(4, 1000000)
+    ->ArgPair(8, 1000000);
+
+// Runs steps that feed "num_feeds" scalars to the second worker of a fresh
+// two-worker cluster on localhost, and fetch their sum on each worker, so
+// that the cost of a step is dominated by the master preparing and
+// issuing the RunGraph calls.  Reports the number of steps per second.
+static void BM_MasterStepRate(int iters, int num_feeds) {
+  testing::StopTiming();
+  SessionOptions options;
+  std::vector<DeviceAttributes> devices;
+  MakeWorkerServiceCluster(1, &options, &devices);
+  CHECK_EQ(devices.size(), size_t{2});
+
+  using namespace ::tensorflow::ops;  // NOLINT(build/namespaces)
+  Scope s = Scope::NewRootScope();
+  Scope remote = s.WithDevice(devices[1].name());
+  std::vector<Output> feeds;
+  std::vector<std::pair<string, Tensor>> inputs;
+  for (int i = 0; i < num_feeds; ++i) {
+    const string name = strings::StrCat("x", i);
+    feeds.push_back(Placeholder(remote.WithOpName(name), DT_FLOAT));
+    Tensor x(DT_FLOAT, TensorShape({}));
+    x.scalar<float>()() = i;
+    inputs.emplace_back(strings::StrCat(name, ":0"), x);
+  }
+  Output sum = AddN(remote.WithOpName("z"), feeds);
+  Identity(s.WithOpName("y").WithDevice(devices[0].name()), sum);
+  GraphDef def;
+  TF_CHECK_OK(s.ToGraphDef(&def));
+
+  std::unique_ptr<Session> session(NewSession(options));
+  TF_CHECK_OK(session->Create(def));
+  std::vector<Tensor> outputs;
+  for (int i = 0; i < 3; i++) {
+    TF_CHECK_OK(session->Run(inputs, {"y:0", "z:0"}, {}, &outputs));
+  }
+  testing::SetLabel(strings::StrCat(num_feeds, " feeds"));
+
+  testing::StartTiming();
+  for (int i = 0; i < iters; i++) {
+    TF_CHECK_OK(session->Run(inputs, {"y:0", "z:0"}, {}, &outputs));
+  }
+  testing::StopTiming();
+  testing::ItemsProcessed(iters);
+  TF_CHECK_OK(session->Close());
+}
+BENCHMARK(BM_MasterStepRate)->Arg(1)->Arg(8)->Arg(64);
+
 }  // namespace tensorflow
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
 #include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
 
 namespace tensorflow {
 
@@ -46,14 +47,16 @@ void TensorResponse::InitAlloc(DeviceBase* d, const AllocatorAttributes& aa) {
 }
 
 Status TensorResponse::InitFrom(RecvTensorResponse* response) {
-  Status s;
   meta_.Swap(response);
-  if (on_host_) {
-    if (!tensor_.FromProto(allocator_, meta_.tensor())) {
-      s = errors::InvalidArgument("Cannot parse tensor from response");
+  Status s = DecompressTensorProto();
+  if (s.ok()) {
+    if (on_host_) {
+      if (!tensor_.FromProto(allocator_, meta_.tensor())) {
+        s = errors::InvalidArgument("Cannot parse tensor from response");
+      }
+    } else {
+      s = device_->MakeTensorFromProto(meta_.tensor(), alloc_attrs_, &tensor_);
     }
-  } else {
-    s = device_->MakeTensorFromProto(meta_.tensor(), alloc_attrs_, &tensor_);
   }
   {
     TensorProto empty;
@@ -73,6 +76,29 @@ void TensorResponse::InitPartial(const RecvTensorResponse& response) {
   tensor_ = std::move(t);
 }
 
+Status TensorResponse::InitFromHostTensor(const Tensor& host_tensor) {
+  if (on_host_ && !alloc_attrs_.gpu_compatible()) {
+    tensor_ = host_tensor;
+    return Status::OK();
+  }
+  if (on_host_ && DataTypeCanUseMemcpy(host_tensor.dtype())) {
+    Tensor t(allocator_, host_tensor.dtype(), host_tensor.shape());
+    StringPiece src = host_tensor.tensor_data();
+    memcpy(const_cast<char*>(t.tensor_data().data()), src.data(), src.size());
+    tensor_ = std::move(t);
+    return Status::OK();
+  }
+  TensorProto proto;
+  host_tensor.AsProtoTensorContent(&proto);
+  if (on_host_) {
+    if (!tensor_.FromProto(allocator_, proto)) {
+      return errors::InvalidArgument("Cannot parse tensor from response");
+    }
+    return Status::OK();
+  }
+  return device_->MakeTensorFromProto(proto, alloc_attrs_, &tensor_);
+}
+
 Status TensorResponse::ParseFrom(Source* source) {
   if (!on_host_) {
     protobuf::io::CodedInputStream input(source->contents());
@@ -82,8 +108,12 @@ Status TensorResponse::ParseFrom(Source* source) {
     if (!meta_.ParseFromCodedStream(&input) || !input.ConsumedEntireMessage()) {
       return errors::InvalidArgument("Cannot parse tensor from response");
     }
-    Status s =
-        device_->MakeTensorFromProto(meta_.tensor(), alloc_attrs_, &tensor_);
+    Status s = DecompressTensorProto();
+    // A response without a tensor has its content passed out of band, and
+    // the transport calls InitFromHostTensor() with it.
+    if (s.ok() && (meta_.has_tensor() || !meta_.has_transport_options())) {
+      s = device_->MakeTensorFromProto(meta_.tensor(), alloc_attrs_, &tensor_);
+    }
     // Reduce memory usage for big tensors.
     {
       TensorProto empty;
@@ -96,10 +126,36 @@ Status TensorResponse::ParseFrom(Source* source) {
     ClearTensor();
   }
   already_used_ = true;
-  if (ParseFast(source)) return Status::OK();
-  meta_.Clear();
-  if (ParseSlow(source)) return Status::OK();
-  return errors::InvalidArgument("Cannot parse tensor from response");
+  if (!ParseFast(source)) {
+    meta_.Clear();
+    if (!ParseSlow(source)) {
+      return errors::InvalidArgument("Cannot parse tensor from response");
+    }
+  }
+  if (meta_.has_compressed_content()) {
+    // The tensor has been allocated, but its content is still compressed.
+    Status s = DecompressTensorContent(meta_.compressed_content(),
+                                       decompression_pool_, &tensor_);
+    meta_.clear_compressed_content();
+    return s;
+  }
+  return Status::OK();
+}
+
+// If the content of meta_.tensor() arrived compressed, replaces it with
+// the decompressed content.
+Status TensorResponse::DecompressTensorProto() {
+  if (!meta_.has_compressed_content()) return Status::OK();
+  TensorProto* proto = meta_.mutable_tensor();
+  if (!TensorShape::IsValid(proto->tensor_shape())) {
+    return errors::InvalidArgument("Invalid shape for compressed tensor");
+  }
+  Tensor t(cpu_allocator(), proto->dtype(), TensorShape(proto->tensor_shape()));
+  Status s = DecompressTensorContent(meta_.compressed_content(),
+                                     decompression_pool_, &t);
+  meta_.clear_compressed_content();
+  if (s.ok()) t.AsProtoTensorContent(proto);
+  return s;
 }
 
 // Define some helper routines for decoding protocol buffer wire format data
@@ -249,6 +305,18 @@ bool TensorResponse::ParseFast(Source* source) {
         meta_.set_send_start_micros(static_cast<int64>(v));
         break;
       }
+      case RecvTensorResponse::kKeyIndexFieldNumber: {
+        uint32 v;
+        if ((wt != WIRETYPE_VARINT) || !input.ReadVarint32(&v)) return false;
+        meta_.set_key_index(static_cast<int32>(v));
+        break;
+      }
+      case RecvTensorResponse::kCompressedContentFieldNumber: {
+        if ((wt != WIRETYPE_LENGTH_DELIMITED) ||
+            !ReadNestedMessage(&input, meta_.mutable_compressed_content()))
+          return false;
+        break;
+      }
       case RecvTensorResponse::kTransportOptionsFieldNumber: {
         if ((wt != WIRETYPE_LENGTH_DELIMITED) ||
             !ReadNestedMessage(&input, meta_.mutable_transport_options()))
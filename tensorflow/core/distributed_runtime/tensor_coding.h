@@ -29,6 +29,10 @@ class Allocator;
 class DeviceBase;
 class TensorProto;
 
+namespace thread {
+class ThreadPool;
+}  // namespace thread
+
 // TensorResponse can be used as the destination of an RPC that returns
 // a RecvTensorResponse.  It efficiently decodes the incoming data
 // into Tensor contents as well as associated metadata.
@@ -46,6 +50,13 @@ class TensorResponse {
   // Initialize memory allocation related members.
   void InitAlloc(DeviceBase* d, const AllocatorAttributes& aa);
 
+  // Sets the thread pool on which tensor content that arrives compressed
+  // is decompressed, or nullptr (the default) to decompress it on the
+  // parsing thread. Unlike the other members, this is kept by Clear().
+  void set_decompression_pool(thread::ThreadPool* pool) {
+    decompression_pool_ = pool;
+  }
+
   // Source provides a way for a particular RPC implementation to provide
   // received data to ParseFrom.
   class Source {
@@ -78,6 +89,13 @@ class TensorResponse {
   // uninitialized backing storage for actual contents.
   void InitPartial(const RecvTensorResponse& response);
 
+  // Initialize tensor from "host_tensor", which holds the content of a
+  // response that carried no tensor because a transport, described in
+  // its transport_options, passed the content out of band. Shares the
+  // buffer of "host_tensor" when the tensor is received into host memory
+  // that need not be GPU-compatible.
+  Status InitFromHostTensor(const Tensor& host_tensor);
+
   // Return a reference to the parsed tensor.  The tensor will remain
   // live only until *this is destroyed or modified.
   const Tensor& tensor() const { return tensor_; }
@@ -92,12 +110,14 @@ class TensorResponse {
                              TensorProto* tensor_meta);
   bool ParseFast(Source* source);
   bool ParseSlow(Source* source);
+  Status DecompressTensorProto();
 
   bool on_host_ = false;
   DeviceBase* device_ = nullptr;
   AllocatorAttributes alloc_attrs_;
   Allocator* allocator_ = nullptr;
   bool already_used_ = false;
+  thread::ThreadPool* decompression_pool_ = nullptr;
   Tensor tensor_;
   RecvTensorResponse meta_;
 };
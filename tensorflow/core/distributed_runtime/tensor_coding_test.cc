@@ -15,9 +15,11 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
 
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
 #include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
@@ -77,6 +79,7 @@ class TensorResponseTest : public ::testing::Test {
     RecvTensorResponse proto;
     proto.set_is_dead(is_dead);
     proto.set_send_start_micros(123456);
+    proto.set_key_index(7);
     if (use_tensor_content) {
       src.AsProtoTensorContent(proto.mutable_tensor());
     } else {
@@ -97,6 +100,7 @@ class TensorResponseTest : public ::testing::Test {
       const RecvTensorResponse& meta = response.metadata();
       EXPECT_EQ(meta.is_dead(), is_dead);
       EXPECT_EQ(meta.send_start_micros(), 123456);
+      EXPECT_EQ(meta.key_index(), 7);
 
       const Tensor& result = response.tensor();
       EXPECT_EQ(result.dtype(), src.dtype());
@@ -155,6 +159,35 @@ TEST_F(TensorResponseTest, Simple) {
 
 TEST_F(TensorResponseTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(TensorResponseTest, CompressedContent) {
+  Tensor src(DT_FLOAT, TensorShape({10, 1000}));
+  test::FillFn<float>(&src, [](int i) { return static_cast<float>(i % 7); });
+  RecvTensorResponse proto;
+  proto.set_send_start_micros(123456);
+  proto.mutable_tensor()->set_dtype(DT_FLOAT);
+  src.shape().AsProto(proto.mutable_tensor()->mutable_tensor_shape());
+  TF_ASSERT_OK(CompressTensorContent(TensorCompressionOptions::ZLIB, 4096,
+                                     DT_FLOAT, src.tensor_data(), nullptr,
+                                     proto.mutable_compressed_content()));
+  string encoded;
+  proto.AppendToString(&encoded);
+  EXPECT_LT(encoded.size(), src.TotalBytes());
+
+  StringSource source(&encoded, 1024);
+  TensorResponse response;
+  DummyDevice cpu_device(Env::Default());
+  response.InitAlloc(&cpu_device, AllocatorAttributes());
+  TF_ASSERT_OK(response.ParseFrom(&source));
+  EXPECT_EQ(response.metadata().send_start_micros(), 123456);
+  EXPECT_FALSE(response.metadata().has_compressed_content());
+  test::ExpectTensorEqual<float>(src, response.tensor());
+
+  TensorResponse from_proto;
+  from_proto.InitAlloc(&cpu_device, AllocatorAttributes());
+  TF_ASSERT_OK(from_proto.InitFrom(&proto));
+  test::ExpectTensorEqual<float>(src, from_proto.tensor());
+}
+
 string MakeFloatTensorTestCase(int num_elems) {
   std::vector<int8> v(num_elems);
   for (int i = 0; i < num_elems; i++) {
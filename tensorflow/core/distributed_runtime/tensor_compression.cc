@@ -0,0 +1,361 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
+
+#include <zlib.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/bfloat16.h"
+#include "tensorflow/core/framework/numeric_types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/snappy.h"
+
+namespace tensorflow {
+
+namespace {
+
+typedef TensorCompressionOptions::Codec Codec;
+
+// The default number of bytes of uncompressed content per chunk.
+const int64 kDefaultChunkBytes = 1 << 20;
+
+// The size of the header of each QUANTIZED_8BIT chunk: the minimum and the
+// scale, as floats.
+const int64 kQuantizedHeaderBytes = 2 * sizeof(float);
+
+// Returns true if "codec" can compress the content of a tensor of "dtype".
+bool CodecSupports(Codec codec, DataType dtype) {
+  if (!DataTypeCanUseMemcpy(dtype) || DataTypeSize(dtype) == 0) return false;
+  switch (codec) {
+    case TensorCompressionOptions::SNAPPY:
+    case TensorCompressionOptions::ZLIB:
+    case TensorCompressionOptions::SHUFFLED_SNAPPY:
+      return true;
+    case TensorCompressionOptions::FLOAT16:
+    case TensorCompressionOptions::BFLOAT16:
+    case TensorCompressionOptions::QUANTIZED_8BIT:
+      return dtype == DT_FLOAT;
+    default:
+      return false;
+  }
+}
+
+// Calls "fn(i)" for each "i" in [0, n), on the calling thread and, if it is
+// not null, on "pool". Returns once every call has returned.
+//
+// The calling thread runs every call that no thread of "pool" has started,
+// so it only ever waits for calls that are already running. This makes it
+// safe to call from a thread of "pool" itself.
+void ParallelFor(thread::ThreadPool* pool, int64 n,
+                 std::function<void(int64)> fn) {
+  struct State {
+    std::function<void(int64)> fn;
+    int64 n;
+    std::atomic<int64> next{0};
+    mutex mu;
+    condition_variable cv;
+    int64 done GUARDED_BY(mu) = 0;
+
+    void Run() {
+      int64 finished = 0;
+      for (int64 i = next++; i < n; i = next++) {
+        fn(i);
+        ++finished;
+      }
+      if (finished > 0) {
+        mutex_lock l(mu);
+        done += finished;
+        if (done == n) cv.notify_all();
+      }
+    }
+  };
+  auto state = std::make_shared<State>();
+  state->fn = std::move(fn);
+  state->n = n;
+  if (pool != nullptr) {
+    // Closures that only run after the caller has returned find no work
+    // left, and so never call "fn".
+    const int64 num_helpers = std::min<int64>(n - 1, pool->NumThreads());
+    for (int64 i = 0; i < num_helpers; ++i) {
+      pool->Schedule([state]() { state->Run(); });
+    }
+  }
+  state->Run();
+  mutex_lock l(state->mu);
+  while (state->done < n) state->cv.wait(l);
+}
+
+Status SnappyCompress(StringPiece in, string* out) {
+  if (!port::Snappy_Compress(in.data(), in.size(), out)) {
+    return errors::Unimplemented("Snappy compression is not available.");
+  }
+  return Status::OK();
+}
+
+Status SnappyUncompress(StringPiece in, char* out, int64 out_bytes) {
+  size_t length;
+  if (!port::Snappy_GetUncompressedLength(in.data(), in.size(), &length) ||
+      static_cast<int64>(length) != out_bytes ||
+      !port::Snappy_Uncompress(in.data(), in.size(), out)) {
+    return errors::DataLoss("Corrupt snappy-compressed tensor chunk.");
+  }
+  return Status::OK();
+}
+
+// Moves byte "j" of element "i" of "in", whose elements are "element_bytes"
+// bytes long, to "out[j * num_elements + i]".
+void ShuffleBytes(const char* in, int64 num_bytes, int element_bytes,
+                  char* out) {
+  const int64 num_elements = num_bytes / element_bytes;
+  for (int64 i = 0; i < num_elements; ++i) {
+    for (int j = 0; j < element_bytes; ++j) {
+      out[j * num_elements + i] = in[i * element_bytes + j];
+    }
+  }
+}
+
+// The inverse of ShuffleBytes().
+void UnshuffleBytes(const char* in, int64 num_bytes, int element_bytes,
+                    char* out) {
+  const int64 num_elements = num_bytes / element_bytes;
+  for (int j = 0; j < element_bytes; ++j) {
+    for (int64 i = 0; i < num_elements; ++i) {
+      out[i * element_bytes + j] = in[j * num_elements + i];
+    }
+  }
+}
+
+// Compresses one chunk of content, "in", of a tensor whose elements are
+// "element_bytes" bytes long.
+Status CompressChunk(Codec codec, int element_bytes, StringPiece in,
+                     string* out) {
+  switch (codec) {
+    case TensorCompressionOptions::SNAPPY:
+      return SnappyCompress(in, out);
+    case TensorCompressionOptions::ZLIB: {
+      uLongf length = compressBound(in.size());
+      out->resize(length);
+      if (compress2(reinterpret_cast<Bytef*>(&(*out)[0]), &length,
+                    reinterpret_cast<const Bytef*>(in.data()), in.size(),
+                    Z_BEST_SPEED) != Z_OK) {
+        return errors::Internal("zlib compression failed.");
+      }
+      out->resize(length);
+      return Status::OK();
+    }
+    case TensorCompressionOptions::SHUFFLED_SNAPPY: {
+      string shuffled(in.size(), '\0');
+      ShuffleBytes(in.data(), in.size(), element_bytes, &shuffled[0]);
+      return SnappyCompress(shuffled, out);
+    }
+    case TensorCompressionOptions::FLOAT16: {
+      const int64 n = in.size() / sizeof(float);
+      const float* src = reinterpret_cast<const float*>(in.data());
+      out->resize(n * sizeof(Eigen::half));
+      Eigen::half* dst = reinterpret_cast<Eigen::half*>(&(*out)[0]);
+      for (int64 i = 0; i < n; ++i) dst[i] = Eigen::half(src[i]);
+      return Status::OK();
+    }
+    case TensorCompressionOptions::BFLOAT16: {
+      const int64 n = in.size() / sizeof(float);
+      out->resize(n * sizeof(bfloat16));
+      FloatToBFloat16(reinterpret_cast<const float*>(in.data()),
+                      reinterpret_cast<bfloat16*>(&(*out)[0]), n);
+      return Status::OK();
+    }
+    case TensorCompressionOptions::QUANTIZED_8BIT: {
+      const int64 n = in.size() / sizeof(float);
+      const float* src = reinterpret_cast<const float*>(in.data());
+      float min_value = n > 0 ? src[0] : 0.0f;
+      float max_value = min_value;
+      for (int64 i = 0; i < n; ++i) {
+        if (!std::isfinite(src[i])) {
+          return errors::InvalidArgument(
+              "Cannot quantize a tensor with non-finite values.");
+        }
+        min_value = std::min(min_value, src[i]);
+        max_value = std::max(max_value, src[i]);
+      }
+      const float scale = (max_value - min_value) / 255.0f;
+      const float inverse_scale = scale > 0.0f ? 1.0f / scale : 0.0f;
+      out->resize(kQuantizedHeaderBytes + n);
+      char* dst = &(*out)[0];
+      std::memcpy(dst, &min_value, sizeof(float));
+      std::memcpy(dst + sizeof(float), &scale, sizeof(float));
+      uint8* q = reinterpret_cast<uint8*>(dst + kQuantizedHeaderBytes);
+      for (int64 i = 0; i < n; ++i) {
+        const float v = std::round((src[i] - min_value) * inverse_scale);
+        q[i] = static_cast<uint8>(std::min(255.0f, std::max(0.0f, v)));
+      }
+      return Status::OK();
+    }
+    default:
+      return errors::InvalidArgument("Unsupported tensor codec ", codec);
+  }
+}
+
+// Decompresses one chunk, "in", into the "out_bytes" bytes at "out".
+Status DecompressChunk(Codec codec, int element_bytes, StringPiece in,
+                       char* out, int64 out_bytes) {
+  switch (codec) {
+    case TensorCompressionOptions::SNAPPY:
+      return SnappyUncompress(in, out, out_bytes);
+    case TensorCompressionOptions::ZLIB: {
+      uLongf length = out_bytes;
+      if (uncompress(reinterpret_cast<Bytef*>(out), &length,
+                     reinterpret_cast<const Bytef*>(in.data()),
+                     in.size()) != Z_OK ||
+          static_cast<int64>(length) != out_bytes) {
+        return errors::DataLoss("Corrupt zlib-compressed tensor chunk.");
+      }
+      return Status::OK();
+    }
+    case TensorCompressionOptions::SHUFFLED_SNAPPY: {
+      string shuffled(out_bytes, '\0');
+      TF_RETURN_IF_ERROR(SnappyUncompress(in, &shuffled[0], out_bytes));
+      UnshuffleBytes(shuffled.data(), out_bytes, element_bytes, out);
+      return Status::OK();
+    }
+    case TensorCompressionOptions::FLOAT16: {
+      const int64 n = out_bytes / sizeof(float);
+      if (static_cast<int64>(in.size()) !=
+          n * static_cast<int64>(sizeof(Eigen::half))) {
+        break;
+      }
+      const Eigen::half* src = reinterpret_cast<const Eigen::half*>(in.data());
+      float* dst = reinterpret_cast<float*>(out);
+      for (int64 i = 0; i < n; ++i) dst[i] = static_cast<float>(src[i]);
+      return Status::OK();
+    }
+    case TensorCompressionOptions::BFLOAT16: {
+      const int64 n = out_bytes / sizeof(float);
+      if (static_cast<int64>(in.size()) !=
+          n * static_cast<int64>(sizeof(bfloat16))) {
+        break;
+      }
+      BFloat16ToFloat(reinterpret_cast<const bfloat16*>(in.data()),
+                      reinterpret_cast<float*>(out), n);
+      return Status::OK();
+    }
+    case TensorCompressionOptions::QUANTIZED_8BIT: {
+      const int64 n = out_bytes / sizeof(float);
+      if (static_cast<int64>(in.size()) != kQuantizedHeaderBytes + n) break;
+      float min_value;
+      float scale;
+      std::memcpy(&min_value, in.data(), sizeof(float));
+      std::memcpy(&scale, in.data() + sizeof(float), sizeof(float));
+      const uint8* q =
+          reinterpret_cast<const uint8*>(in.data() + kQuantizedHeaderBytes);
+      float* dst = reinterpret_cast<float*>(out);
+      for (int64 i = 0; i < n; ++i) dst[i] = min_value + q[i] * scale;
+      return Status::OK();
+    }
+    default:
+      return errors::InvalidArgument("Unsupported tensor codec ", codec);
+  }
+  return errors::DataLoss("Tensor chunk of ", in.size(),
+                          " bytes has the wrong size for codec ", codec);
+}
+
+// Returns the first error in "statuses", or OK.
+Status FirstError(const std::vector<Status>& statuses) {
+  for (const Status& s : statuses) {
+    if (!s.ok()) return s;
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+TensorCompressionOptions::Codec ChooseTensorCodec(
+    const TensorCompressionOptions& options, DataType dtype, int64 num_bytes) {
+  if (num_bytes == 0 || num_bytes < options.min_bytes()) {
+    return TensorCompressionOptions::NONE;
+  }
+  const Codec codec =
+      dtype == DT_FLOAT ? options.float_codec() : options.default_codec();
+  if (!CodecSupports(codec, dtype)) return TensorCompressionOptions::NONE;
+  return codec;
+}
+
+Status CompressTensorContent(TensorCompressionOptions::Codec codec,
+                             int64 chunk_bytes, DataType dtype,
+                             StringPiece content, thread::ThreadPool* pool,
+                             CompressedTensorContent* out) {
+  if (!CodecSupports(codec, dtype)) {
+    return errors::InvalidArgument("Tensor codec ", codec,
+                                   " does not support ", DataTypeString(dtype));
+  }
+  const int element_bytes = DataTypeSize(dtype);
+  if (chunk_bytes <= 0) chunk_bytes = kDefaultChunkBytes;
+  // Chunks hold whole elements, so that each can be decoded on its own.
+  chunk_bytes = std::max<int64>(element_bytes,
+                                chunk_bytes - chunk_bytes % element_bytes);
+  const int64 num_chunks = (content.size() + chunk_bytes - 1) / chunk_bytes;
+
+  out->Clear();
+  out->set_codec(codec);
+  out->set_chunk_bytes(chunk_bytes);
+  for (int64 i = 0; i < num_chunks; ++i) out->add_chunk();
+  std::vector<Status> statuses(num_chunks);
+  ParallelFor(pool, num_chunks, [&](int64 i) {
+    const int64 begin = i * chunk_bytes;
+    const int64 size = std::min<int64>(chunk_bytes, content.size() - begin);
+    statuses[i] = CompressChunk(codec, element_bytes,
+                                StringPiece(content.data() + begin, size),
+                                out->mutable_chunk(i));
+  });
+  return FirstError(statuses);
+}
+
+Status DecompressTensorContent(const CompressedTensorContent& in,
+                               thread::ThreadPool* pool, Tensor* tensor) {
+  const DataType dtype = tensor->dtype();
+  const Codec codec = in.codec();
+  if (!CodecSupports(codec, dtype)) {
+    return errors::InvalidArgument("Tensor codec ", codec,
+                                   " does not support ", DataTypeString(dtype));
+  }
+  const int element_bytes = DataTypeSize(dtype);
+  const int64 chunk_bytes = in.chunk_bytes();
+  StringPiece content = tensor->tensor_data();
+  const int64 num_bytes = content.size();
+  if (chunk_bytes <= 0 || chunk_bytes % element_bytes != 0 ||
+      in.chunk_size() != (num_bytes + chunk_bytes - 1) / chunk_bytes) {
+    return errors::DataLoss("Compressed content with ", in.chunk_size(),
+                            " chunks of ", chunk_bytes,
+                            " bytes does not match a tensor of ", num_bytes,
+                            " bytes.");
+  }
+  char* dst = const_cast<char*>(content.data());
+  std::vector<Status> statuses(in.chunk_size());
+  ParallelFor(pool, in.chunk_size(), [&](int64 i) {
+    const int64 begin = i * chunk_bytes;
+    statuses[i] =
+        DecompressChunk(codec, element_bytes, in.chunk(i), dst + begin,
+                        std::min<int64>(chunk_bytes, num_bytes - begin));
+  });
+  return FirstError(statuses);
+}
+
+}  // namespace tensorflow
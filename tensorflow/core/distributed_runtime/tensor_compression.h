@@ -0,0 +1,60 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_TENSOR_COMPRESSION_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_TENSOR_COMPRESSION_H_
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+namespace tensorflow {
+
+namespace thread {
+class ThreadPool;
+}  // namespace thread
+
+// Returns the codec that "options" selects for a tensor of type "dtype"
+// with "num_bytes" bytes of content. Returns NONE if the tensor should be
+// sent uncompressed, including when the selected codec does not support
+// "dtype".
+TensorCompressionOptions::Codec ChooseTensorCodec(
+    const TensorCompressionOptions& options, DataType dtype, int64 num_bytes);
+
+// Compresses "content", the content of a tensor of type "dtype", with
+// "codec" into "*out", in chunks of about "chunk_bytes" bytes (or a
+// default size if "chunk_bytes" is 0). The chunks are compressed in
+// parallel on "pool" if it is not null.
+//
+// Returns an error, which the caller may handle by sending the content
+// uncompressed, if "codec" cannot compress "content".
+Status CompressTensorContent(TensorCompressionOptions::Codec codec,
+                             int64 chunk_bytes, DataType dtype,
+                             StringPiece content, thread::ThreadPool* pool,
+                             CompressedTensorContent* out);
+
+// Decompresses "in" into the content of "*tensor", which must already have
+// the dtype and shape of the tensor that was compressed. The chunks are
+// decompressed in parallel on "pool" if it is not null.
+Status DecompressTensorContent(const CompressedTensorContent& in,
+                               thread::ThreadPool* pool, Tensor* tensor);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_TENSOR_COMPRESSION_H_
@@ -0,0 +1,184 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
+
+#include <cmath>
+#include <limits>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+typedef TensorCompressionOptions Options;
+
+// Compresses "src" with "codec" and decompresses it into "*dst". Returns
+// false if "codec" is not available in this build.
+bool RoundTrip(Options::Codec codec, int64 chunk_bytes, const Tensor& src,
+               thread::ThreadPool* pool, Tensor* dst) {
+  CompressedTensorContent compressed;
+  Status s = CompressTensorContent(codec, chunk_bytes, src.dtype(),
+                                   src.tensor_data(), pool, &compressed);
+  if (errors::IsUnimplemented(s)) return false;
+  TF_EXPECT_OK(s);
+  *dst = Tensor(src.dtype(), src.shape());
+  TF_EXPECT_OK(DecompressTensorContent(compressed, pool, dst));
+  return true;
+}
+
+Tensor FloatTensor(int64 n) {
+  Tensor t(DT_FLOAT, TensorShape({n}));
+  test::FillFn<float>(&t, [](int i) { return std::sin(i * 0.01f) * 100; });
+  return t;
+}
+
+TEST(TensorCompressionTest, LosslessCodecs) {
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  Tensor ints(DT_INT32, TensorShape({3, 1001}));
+  test::FillFn<int32>(&ints, [](int i) { return i % 17 - 8; });
+  Tensor bytes(DT_INT8, TensorShape({5000}));
+  test::FillFn<int8>(&bytes, [](int i) { return i % 3; });
+  for (Options::Codec codec :
+       {Options::SNAPPY, Options::ZLIB, Options::SHUFFLED_SNAPPY}) {
+    for (int64 chunk_bytes : {0, 1, 7, 4096}) {
+      for (thread::ThreadPool* p : {static_cast<thread::ThreadPool*>(nullptr),
+                                    &pool}) {
+        Tensor result;
+        if (!RoundTrip(codec, chunk_bytes, FloatTensor(10000), p, &result)) {
+          LOG(INFO) << "Codec " << codec << " is not available";
+          continue;
+        }
+        test::ExpectTensorEqual<float>(FloatTensor(10000), result);
+        ASSERT_TRUE(RoundTrip(codec, chunk_bytes, ints, p, &result));
+        test::ExpectTensorEqual<int32>(ints, result);
+        ASSERT_TRUE(RoundTrip(codec, chunk_bytes, bytes, p, &result));
+        test::ExpectTensorEqual<int8>(bytes, result);
+      }
+    }
+  }
+}
+
+TEST(TensorCompressionTest, LossyCodecs) {
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  const Tensor src = FloatTensor(10000);
+  auto expected = src.flat<float>();
+  Tensor result;
+
+  ASSERT_TRUE(RoundTrip(Options::FLOAT16, 4096, src, &pool, &result));
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(expected(i), result.flat<float>()(i),
+                std::abs(expected(i)) / 1024 + 1e-3);
+  }
+
+  ASSERT_TRUE(RoundTrip(Options::BFLOAT16, 4096, src, &pool, &result));
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(expected(i), result.flat<float>()(i),
+                std::abs(expected(i)) / 128 + 1e-30);
+  }
+
+  // The values span [-100, 100], so a byte resolves steps of 200 / 255.
+  ASSERT_TRUE(RoundTrip(Options::QUANTIZED_8BIT, 4096, src, &pool, &result));
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(expected(i), result.flat<float>()(i), 200.0 / 255 / 2 + 1e-3);
+  }
+
+  // A chunk of equal values decodes exactly.
+  Tensor constant(DT_FLOAT, TensorShape({100}));
+  constant.flat<float>().setConstant(3.5f);
+  ASSERT_TRUE(RoundTrip(Options::QUANTIZED_8BIT, 0, constant, &pool, &result));
+  test::ExpectTensorEqual<float>(constant, result);
+}
+
+TEST(TensorCompressionTest, ChooseTensorCodec) {
+  Options options;
+  options.set_float_codec(Options::BFLOAT16);
+  options.set_default_codec(Options::ZLIB);
+  options.set_min_bytes(1024);
+  EXPECT_EQ(Options::BFLOAT16, ChooseTensorCodec(options, DT_FLOAT, 1024));
+  EXPECT_EQ(Options::NONE, ChooseTensorCodec(options, DT_FLOAT, 1023));
+  EXPECT_EQ(Options::ZLIB, ChooseTensorCodec(options, DT_INT64, 4096));
+  EXPECT_EQ(Options::NONE, ChooseTensorCodec(options, DT_STRING, 4096));
+
+  // Lossy codecs only apply to floats.
+  options.set_default_codec(Options::QUANTIZED_8BIT);
+  EXPECT_EQ(Options::NONE, ChooseTensorCodec(options, DT_DOUBLE, 4096));
+
+  EXPECT_EQ(Options::NONE, ChooseTensorCodec(Options(), DT_FLOAT, 1 << 20));
+}
+
+TEST(TensorCompressionTest, RejectsNonFiniteQuantization) {
+  Tensor src = FloatTensor(100);
+  src.flat<float>()(50) = std::numeric_limits<float>::quiet_NaN();
+  CompressedTensorContent compressed;
+  EXPECT_FALSE(CompressTensorContent(Options::QUANTIZED_8BIT, 0, DT_FLOAT,
+                                     src.tensor_data(), nullptr, &compressed)
+                   .ok());
+}
+
+TEST(TensorCompressionTest, RejectsMismatchedContent) {
+  const Tensor src = FloatTensor(1000);
+  CompressedTensorContent compressed;
+  TF_ASSERT_OK(CompressTensorContent(Options::ZLIB, 1024, DT_FLOAT,
+                                     src.tensor_data(), nullptr, &compressed));
+  ASSERT_EQ(4, compressed.chunk_size());
+
+  Tensor wrong_shape(DT_FLOAT, TensorShape({2000}));
+  EXPECT_FALSE(DecompressTensorContent(compressed, nullptr, &wrong_shape).ok());
+
+  Tensor wrong_type(DT_INT8, TensorShape({4000}));
+  compressed.set_codec(Options::FLOAT16);
+  EXPECT_FALSE(DecompressTensorContent(compressed, nullptr, &wrong_type).ok());
+
+  Tensor dst(DT_FLOAT, TensorShape({1000}));
+  compressed.set_codec(Options::ZLIB);
+  compressed.mutable_chunk(2)->resize(10);
+  EXPECT_FALSE(DecompressTensorContent(compressed, nullptr, &dst).ok());
+}
+
+static void BM_Compress(int iters, int codec) {
+  testing::StopTiming();
+  thread::ThreadPool pool(Env::Default(), "bench", 8);
+  const Tensor src = FloatTensor(4 << 20);
+  CompressedTensorContent compressed;
+  testing::BytesProcessed(static_cast<int64>(iters) * src.TotalBytes());
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    TF_CHECK_OK(CompressTensorContent(static_cast<Options::Codec>(codec), 0,
+                                      DT_FLOAT, src.tensor_data(), &pool,
+                                      &compressed));
+  }
+  testing::StopTiming();
+  testing::SetLabel(strings::StrCat(
+      "compressed to ", compressed.ByteSize() * 100 / src.TotalBytes(), "%"));
+}
+BENCHMARK(BM_Compress)
+    ->Arg(Options::SNAPPY)
+    ->Arg(Options::ZLIB)
+    ->Arg(Options::SHUFFLED_SNAPPY)
+    ->Arg(Options::FLOAT16)
+    ->Arg(Options::BFLOAT16)
+    ->Arg(Options::QUANTIZED_8BIT);
+
+}  // namespace
+}  // namespace tensorflow
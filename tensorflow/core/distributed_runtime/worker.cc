@@ -145,6 +145,9 @@ void Worker::DoRunGraph(CallOptions* opts, RunGraphRequestWrapper* request,
       request->exec_opts().record_costs()) {
     collector = new StepStatsCollector(response->mutable_step_stats());
     // TODO(mrry,pbar): GPU tracing for distributed steps.
+  } else if (request->exec_opts().record_lightweight_timeline()) {
+    collector = new StepStatsCollector(response->mutable_step_stats(),
+                                       true /* lightweight */);
   }
   CancellationManager* cm = new CancellationManager;
   opts->SetCancelCallback([this, cm, step_id]() {
@@ -353,4 +356,14 @@ void Worker::RecvTensorAsync(CallOptions* opts,
   done(errors::Unimplemented("Worker::RecvTensorAsync()"));
 }
 
+void Worker::RecvTensorsAsync(CallOptions* opts,
+                              const RecvTensorsRequest* request,
+                              TensorResponse* response,
+                              std::function<void()> on_tensor,
+                              StatusCallback done) {
+  // As with RecvTensorAsync, only transport-specific implementations
+  // (such as `GrpcWorker::RecvTensorsAsync()`) support this method.
+  done(errors::Unimplemented("Worker::RecvTensorsAsync()"));
+}
+
 }  // namespace tensorflow
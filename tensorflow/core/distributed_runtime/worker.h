@@ -72,6 +72,11 @@ class Worker : public WorkerInterface {
   void RecvTensorAsync(CallOptions* opts, const RecvTensorRequest* request,
                        TensorResponse* response, StatusCallback done) override;
 
+  void RecvTensorsAsync(CallOptions* opts, const RecvTensorsRequest* request,
+                        TensorResponse* response,
+                        std::function<void()> on_tensor,
+                        StatusCallback done) override;
+
   void LoggingAsync(const LoggingRequest* request, LoggingResponse* response,
                     StatusCallback done) override;
 
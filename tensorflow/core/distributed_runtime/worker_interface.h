@@ -98,6 +98,17 @@ class WorkerInterface {
                                TensorResponse* response,
                                StatusCallback done) = 0;
 
+  // Receives the tensors named by `request->rendezvous_key()`, in the
+  // order in which they become available. `response` is reused for
+  // every tensor: `on_tensor` is called once per tensor, never
+  // concurrently, and `response->metadata().key_index()` identifies the
+  // key of the tensor it holds. `done` is called last.
+  virtual void RecvTensorsAsync(CallOptions* opts,
+                                const RecvTensorsRequest* request,
+                                TensorResponse* response,
+                                std::function<void()> on_tensor,
+                                StatusCallback done) = 0;
+
   virtual void LoggingAsync(const LoggingRequest* request,
                             LoggingResponse* response, StatusCallback done) = 0;
 
@@ -0,0 +1,128 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/compact_string_tensor.h"
+
+#include "tensorflow/core/framework/allocation_description.pb.h"
+
+namespace tensorflow {
+
+CompactStringBuffer::CompactStringBuffer(Allocator* a, int64 num_elements,
+                                         int64 arena_bytes)
+    : alloc_(a),
+      num_elements_(num_elements),
+      storage_bytes_(sizeof(Slot) * num_elements + arena_bytes),
+      storage_(nullptr),
+      slots_(nullptr),
+      arena_(nullptr),
+      strings_(nullptr) {
+  CHECK_GE(num_elements, 0);
+  CHECK_GE(arena_bytes, 0);
+  if (storage_bytes_ > 0) {
+    storage_ = alloc_->AllocateRaw(Allocator::kAllocatorAlignment,
+                                   storage_bytes_);
+    CHECK(storage_ != nullptr) << "Failed to allocate " << storage_bytes_
+                               << " bytes for a compact string tensor";
+    slots_ = static_cast<Slot*>(storage_);
+    arena_ = reinterpret_cast<char*>(slots_ + num_elements);
+    memset(slots_, 0, sizeof(Slot) * num_elements);
+  }
+}
+
+CompactStringBuffer::~CompactStringBuffer() {
+  string* strings = strings_.load(std::memory_order_relaxed);
+  if (strings != nullptr) alloc_->Deallocate<string>(strings, num_elements_);
+  if (storage_ != nullptr) alloc_->DeallocateRaw(storage_);
+}
+
+void CompactStringBuffer::Set(int64 i, StringPiece s, int64 arena_offset) {
+  DCHECK_LT(i, num_elements_);
+  DCHECK(!materialized());
+  CHECK_LE(s.size(), kuint32max);
+  Slot* slot = &slots_[i];
+  slot->size = static_cast<uint32>(s.size());
+  if (s.size() <= kMaxInlineStringSize) {
+    memcpy(slot->data, s.data(), s.size());
+  } else {
+    DCHECK_LE(sizeof(Slot) * num_elements_ + arena_offset + s.size(),
+              storage_bytes_);
+    memcpy(arena_ + arena_offset, s.data(), s.size());
+    const uint64 offset = arena_offset;
+    memcpy(slot->data, &offset, sizeof(offset));
+  }
+}
+
+void* CompactStringBuffer::data() const {
+  string* strings = strings_.load(std::memory_order_acquire);
+  if (strings == nullptr && num_elements_ > 0) {
+    mutex_lock l(mu_);
+    strings = strings_.load(std::memory_order_relaxed);
+    if (strings == nullptr) {
+      strings = alloc_->Allocate<string>(num_elements_);
+      CHECK(strings != nullptr) << "Failed to allocate " << num_elements_
+                                << " strings";
+      for (int64 i = 0; i < num_elements_; ++i) {
+        const StringPiece s = Get(i);
+        strings[i].assign(s.data(), s.size());
+      }
+      strings_.store(strings, std::memory_order_release);
+    }
+  }
+  return strings;
+}
+
+void CompactStringBuffer::FillAllocationDescription(
+    AllocationDescription* proto) const {
+  proto->set_requested_bytes(storage_bytes_);
+  proto->set_allocator_name(alloc_->Name());
+  proto->set_ptr(reinterpret_cast<uintptr_t>(storage_));
+  if (alloc_->TracksAllocationSizes() && storage_ != nullptr) {
+    proto->set_allocated_bytes(alloc_->AllocatedSize(storage_));
+    const int64 id = alloc_->AllocationId(storage_);
+    if (id > 0) proto->set_allocation_id(id);
+    if (RefCountIsOne()) proto->set_has_single_reference(true);
+  }
+}
+
+CompactStringTensorBuilder::CompactStringTensorBuilder(Allocator* a,
+                                                       const TensorShape& shape,
+                                                       int64 arena_bytes)
+    : shape_(shape),
+      buf_(new CompactStringBuffer(a, shape.num_elements(), arena_bytes)) {}
+
+CompactStringTensorBuilder::~CompactStringTensorBuilder() {
+  if (buf_ != nullptr) buf_->Unref();
+}
+
+Tensor CompactStringTensorBuilder::Finish() {
+  CHECK(buf_ != nullptr) << "Finish() called twice";
+  Tensor t(DT_STRING, shape_, buf_);
+  buf_->Unref();
+  buf_ = nullptr;
+  return t;
+}
+
+StringTensorView::StringTensorView(const Tensor& t) : size_(t.NumElements()) {
+  CHECK_EQ(t.dtype(), DT_STRING);
+  const CompactStringBuffer* compact =
+      t.buf_ == nullptr ? nullptr : t.buf_->compact_strings();
+  if (compact != nullptr && !compact->materialized()) {
+    compact_ = compact;
+  } else if (size_ > 0) {
+    strings_ = t.flat<string>().data();
+  }
+}
+
+}  // namespace tensorflow
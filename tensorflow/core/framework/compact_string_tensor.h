@@ -0,0 +1,164 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// A compact representation for DT_STRING tensors.
+//
+// A DT_STRING tensor normally holds one std::string per element, so every
+// element too long for std::string's inline buffer is a heap allocation of
+// its own. A compact string tensor keeps each element in a 16-byte slot
+// instead: strings of up to kMaxInlineStringSize bytes are stored in the slot
+// itself and longer ones in a character arena. Slots and arena are a single
+// allocation owned by the tensor's buffer, whatever the number of elements.
+//
+// To the rest of TensorFlow a compact tensor is an ordinary DT_STRING tensor.
+// The first typed access to it (flat<string>(), vec<string>(), ...) builds
+// std::string elements from the slots, and from then on those are the
+// tensor's elements. Kernels that only read strings should use
+// StringTensorView, which reads the slots directly and never builds them.
+
+#ifndef TENSORFLOW_FRAMEWORK_COMPACT_STRING_TENSOR_H_
+#define TENSORFLOW_FRAMEWORK_COMPACT_STRING_TENSOR_H_
+
+#include <string.h>
+#include <atomic>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Longest string stored inside its slot.
+constexpr size_t kMaxInlineStringSize = 12;
+
+// The TensorBuffer of a compact DT_STRING tensor.
+class CompactStringBuffer : public TensorBuffer {
+ public:
+  // Allocates 'num_elements' empty slots and 'arena_bytes' bytes of arena.
+  CompactStringBuffer(Allocator* a, int64 num_elements, int64 arena_bytes);
+
+  // Returns element 'i' as stored in the slots.
+  StringPiece Get(int64 i) const {
+    const Slot& slot = slots_[i];
+    if (slot.size <= kMaxInlineStringSize) {
+      return StringPiece(slot.data, slot.size);
+    }
+    uint64 offset;
+    memcpy(&offset, slot.data, sizeof(offset));
+    return StringPiece(arena_ + offset, slot.size);
+  }
+
+  // Stores 's' as element 'i'. If 's' is longer than kMaxInlineStringSize its
+  // bytes are copied to [arena_offset, arena_offset + s.size()) of the arena.
+  // Calls for different elements and disjoint arena ranges may run
+  // concurrently.
+  void Set(int64 i, StringPiece s, int64 arena_offset);
+
+  // Returns true once data() has built the std::string elements.
+  bool materialized() const {
+    return strings_.load(std::memory_order_acquire) != nullptr;
+  }
+
+  // Returns the std::string elements, building them on the first call.
+  void* data() const override;
+  size_t size() const override { return sizeof(string) * num_elements_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override;
+  const CompactStringBuffer* compact_strings() const override { return this; }
+
+ private:
+  struct Slot {
+    uint32 size;
+    // The string itself if it fits, otherwise its uint64 arena offset.
+    char data[kMaxInlineStringSize];
+  };
+  static_assert(sizeof(Slot) == 16, "Slots must be 16 bytes");
+
+  ~CompactStringBuffer() override;
+
+  Allocator* const alloc_;
+  const int64 num_elements_;
+  const size_t storage_bytes_;
+  void* storage_;  // Slots followed by the arena.
+  Slot* slots_;
+  char* arena_;
+
+  mutable mutex mu_;
+  mutable std::atomic<string*> strings_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(CompactStringBuffer);
+};
+
+// Builds a compact DT_STRING tensor in place, e.g.
+//
+//   CompactStringTensorBuilder builder(allocator, shape, arena_bytes);
+//   for (...) builder.Set(i, piece, arena_offset);
+//   Tensor t = builder.Finish();
+//
+// where 'arena_bytes' is the sum of ArenaBytes() over the elements and each
+// element is given its own range of the arena.
+class CompactStringTensorBuilder {
+ public:
+  CompactStringTensorBuilder(Allocator* a, const TensorShape& shape,
+                             int64 arena_bytes);
+  ~CompactStringTensorBuilder();
+
+  // Returns the number of arena bytes an element of 'size' bytes takes.
+  static int64 ArenaBytes(size_t size) {
+    return size > kMaxInlineStringSize ? size : 0;
+  }
+
+  // See CompactStringBuffer::Set(). Elements that are never set are empty.
+  void Set(int64 i, StringPiece s, int64 arena_offset) {
+    buf_->Set(i, s, arena_offset);
+  }
+
+  // Returns the tensor. The builder must not be used afterwards.
+  Tensor Finish();
+
+ private:
+  const TensorShape shape_;
+  CompactStringBuffer* buf_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(CompactStringTensorBuilder);
+};
+
+// Read-only access to the elements of a DT_STRING tensor, compact or not.
+// Valid as long as the tensor is alive and its elements are not modified.
+class StringTensorView {
+ public:
+  explicit StringTensorView(const Tensor& t);
+
+  int64 size() const { return size_; }
+
+  StringPiece operator()(int64 i) const {
+    DCHECK_LT(i, size_);
+    return compact_ != nullptr ? compact_->Get(i) : StringPiece(strings_[i]);
+  }
+
+ private:
+  const CompactStringBuffer* compact_ = nullptr;
+  const string* strings_ = nullptr;
+  int64 size_;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_FRAMEWORK_COMPACT_STRING_TENSOR_H_
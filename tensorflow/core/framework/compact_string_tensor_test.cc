@@ -0,0 +1,163 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/compact_string_tensor.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Counts the allocations made through it.
+class CountingAllocator : public Allocator {
+ public:
+  string Name() override { return "counting"; }
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    ++num_allocations_;
+    return port::AlignedMalloc(num_bytes, alignment);
+  }
+  void DeallocateRaw(void* ptr) override { port::AlignedFree(ptr); }
+  void GetStats(AllocatorStats* stats) override { stats->Clear(); }
+
+  int num_allocations() const { return num_allocations_; }
+
+ private:
+  int num_allocations_ = 0;
+};
+
+const std::vector<string>& TestStrings() {
+  static const std::vector<string>* strings = new std::vector<string>{
+      "", "a", "twelve bytes", "thirteen bytes", "",
+      "a string that does not fit in a slot", "x"};
+  return *strings;
+}
+
+// Builds a compact tensor of TestStrings() from 'a'.
+Tensor MakeCompactTensor(Allocator* a) {
+  int64 arena_bytes = 0;
+  for (const string& s : TestStrings()) {
+    arena_bytes += CompactStringTensorBuilder::ArenaBytes(s.size());
+  }
+  CompactStringTensorBuilder builder(
+      a, TensorShape({static_cast<int64>(TestStrings().size())}),
+      arena_bytes);
+  int64 arena_offset = 0;
+  for (size_t i = 0; i < TestStrings().size(); ++i) {
+    builder.Set(i, TestStrings()[i], arena_offset);
+    arena_offset += CompactStringTensorBuilder::ArenaBytes(
+        TestStrings()[i].size());
+  }
+  return builder.Finish();
+}
+
+TEST(CompactStringTensorTest, ViewReadsSlotsWithoutMaterializing) {
+  CountingAllocator a;
+  Tensor t = MakeCompactTensor(&a);
+  EXPECT_EQ(DT_STRING, t.dtype());
+  EXPECT_TRUE(t.IsInitialized());
+  EXPECT_EQ(1, a.num_allocations());
+
+  StringTensorView view(t);
+  ASSERT_EQ(static_cast<int64>(TestStrings().size()), view.size());
+  for (size_t i = 0; i < TestStrings().size(); ++i) {
+    EXPECT_EQ(TestStrings()[i], view(i).ToString());
+  }
+  // Neither the view nor IsInitialized() built std::string elements.
+  EXPECT_EQ(1, a.num_allocations());
+}
+
+TEST(CompactStringTensorTest, TypedAccessMaterializes) {
+  CountingAllocator a;
+  Tensor t = MakeCompactTensor(&a);
+  auto flat = t.flat<string>();
+  EXPECT_EQ(2, a.num_allocations());
+  for (size_t i = 0; i < TestStrings().size(); ++i) {
+    EXPECT_EQ(TestStrings()[i], flat(i));
+  }
+  // Later accesses reuse the same elements, and modifications through them
+  // are seen by views created afterwards.
+  EXPECT_EQ(flat.data(), t.flat<string>().data());
+  flat(1) = "changed";
+  EXPECT_EQ("changed", StringTensorView(t)(1).ToString());
+  EXPECT_EQ(2, a.num_allocations());
+}
+
+TEST(CompactStringTensorTest, UnsetElementsAreEmpty) {
+  CompactStringTensorBuilder builder(cpu_allocator(), TensorShape({2, 2}), 20);
+  builder.Set(2, "a long string value", 0);
+  Tensor t = builder.Finish();
+  test::ExpectTensorEqual<string>(
+      test::AsTensor<string>({"", "", "a long string value", ""},
+                             TensorShape({2, 2})),
+      t);
+}
+
+TEST(CompactStringTensorTest, Empty) {
+  CompactStringTensorBuilder builder(cpu_allocator(), TensorShape({0}), 0);
+  Tensor t = builder.Finish();
+  EXPECT_TRUE(t.IsInitialized());
+  EXPECT_EQ(0, StringTensorView(t).size());
+  EXPECT_EQ(0, t.flat<string>().size());
+}
+
+TEST(CompactStringTensorTest, ViewOfRegularTensor) {
+  Tensor t = test::AsTensor<string>({"abc", "", "a string too long to inline"});
+  StringTensorView view(t);
+  ASSERT_EQ(3, view.size());
+  EXPECT_EQ("abc", view(0).ToString());
+  EXPECT_EQ("", view(1).ToString());
+  EXPECT_EQ("a string too long to inline", view(2).ToString());
+}
+
+TEST(CompactStringTensorTest, SliceAndProtoRoundTrip) {
+  Tensor t = MakeCompactTensor(cpu_allocator());
+  const Tensor expected = test::AsTensor<string>(TestStrings());
+
+  Tensor slice = t.Slice(2, 6);
+  test::ExpectTensorEqual<string>(expected.Slice(2, 6), slice);
+
+  TensorProto proto;
+  MakeCompactTensor(cpu_allocator()).AsProtoTensorContent(&proto);
+  Tensor parsed;
+  ASSERT_TRUE(parsed.FromProto(proto));
+  test::ExpectTensorEqual<string>(expected, parsed);
+}
+
+TEST(CompactStringTensorTest, ConcurrentMaterialization) {
+  Tensor t = MakeCompactTensor(cpu_allocator());
+  std::vector<const string*> data(8);
+  {
+    thread::ThreadPool pool(Env::Default(), "test", data.size());
+    for (size_t i = 0; i < data.size(); ++i) {
+      pool.Schedule([&t, &data, i]() {
+        const Tensor& shared = t;
+        data[i] = shared.flat<string>().data();
+      });
+    }
+  }
+  for (const string* d : data) EXPECT_EQ(data[0], d);
+  EXPECT_EQ(TestStrings()[5], data[0][5]);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -475,7 +475,10 @@ Tensor::Tensor(DataType type, const TensorShape& shape, TensorBuffer* buf)
 }
 
 bool Tensor::IsInitialized() const {
-  return (buf_ != nullptr && buf_->data() != nullptr) ||
+  // Compact string buffers always hold their elements; checking data() would
+  // needlessly build std::strings from them.
+  return (buf_ != nullptr && (buf_->compact_strings() != nullptr ||
+                              buf_->data() != nullptr)) ||
          shape_.num_elements() == 0;
 }
 
@@ -35,7 +35,8 @@ limitations under the License.
 
 namespace tensorflow {
 
-class TensorBuffer;  // Forward declaration.
+class CompactStringBuffer;  // Forward declaration.
+class TensorBuffer;         // Forward declaration.
 class TensorCApi;
 
 /// @ingroup core
@@ -434,7 +435,9 @@ class Tensor {
   TensorShape shape_;
   TensorBuffer* buf_;
 
+  friend class CompactStringTensorBuilder;  // For access to the constructor
   friend class DMAHelper;
+  friend class StringTensorView;  // For access to buf_
   friend class TensorCApi;
   friend class TensorReference;       // For access to buf_
   friend class VariableOp;            // For access to set_shape
@@ -493,6 +496,12 @@ class TensorBuffer : public core::RefCounted {
   virtual void FillAllocationDescription(
       AllocationDescription* proto) const = 0;
 
+  // Returns this buffer if it holds DT_STRING elements in the compact
+  // representation of compact_string_tensor.h, and nullptr otherwise.
+  virtual const CompactStringBuffer* compact_strings() const {
+    return nullptr;
+  }
+
   template <typename T>
   T* base() const {
     return reinterpret_cast<T*>(data());
@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -115,12 +116,22 @@ class AsStringOp : public OpKernel {
                                             &output_tensor));
     auto output_flat = output_tensor->flat<string>();
 
-#define ENCODE_TYPE(type, T, enc_str)                                     \
-  case (type): {                                                          \
-    const auto& input_flat = input_tensor->flat<T>();                     \
-    for (int i = 0; i < input_flat.size(); ++i) {                         \
-      output_flat(i) = strings::Printf((enc_str.c_str()), input_flat(i)); \
-    }                                                                     \
+    // Format straight into the output strings; short results stay within the
+    // string's inline buffer and never go through a temporary.
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    const int64 num_elements = input_tensor->NumElements();
+
+#define ENCODE_TYPE(type, T, enc_str)                                      \
+  case (type): {                                                           \
+    const auto& input_flat = input_tensor->flat<T>();                      \
+    Shard(worker_threads.num_threads, worker_threads.workers, num_elements, \
+          kFormatCost, [&](int64 start, int64 limit) {                     \
+            for (int64 i = start; i < limit; ++i) {                        \
+              strings::Appendf(&output_flat(i), (enc_str.c_str()),         \
+                               input_flat(i));                             \
+            }                                                              \
+          });                                                              \
   } break
 
     switch (dtype) {
@@ -131,16 +142,19 @@ class AsStringOp : public OpKernel {
       ENCODE_TYPE(DT_INT8, int8, format_);
       case (DT_BOOL): {
         const auto& input_flat = input_tensor->flat<bool>();
-        for (int i = 0; i < input_flat.size(); ++i) {
+        for (int64 i = 0; i < num_elements; ++i) {
           output_flat(i) = (input_flat(i)) ? "true" : "false";
         }
       } break;
       case (DT_COMPLEX64): {
         const auto& input_flat = input_tensor->flat<complex64>();
-        for (int i = 0; i < input_flat.size(); ++i) {
-          output_flat(i) = strings::Printf(
-              format_.c_str(), input_flat(i).real(), input_flat(i).imag());
-        }
+        Shard(worker_threads.num_threads, worker_threads.workers,
+              num_elements, 2 * kFormatCost, [&](int64 start, int64 limit) {
+                for (int64 i = start; i < limit; ++i) {
+                  strings::Appendf(&output_flat(i), format_.c_str(),
+                                   input_flat(i).real(), input_flat(i).imag());
+                }
+              });
       } break;
       default:
         bool can_encode_type = false;
@@ -153,6 +167,9 @@ class AsStringOp : public OpKernel {
   }
 
  private:
+  // Rough number of cycles to format one number.
+  static constexpr int64 kFormatCost = 250;
+
   string format_;
 };
 
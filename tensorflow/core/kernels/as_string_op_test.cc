@@ -0,0 +1,131 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class AsStringOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(DataType dtype, int precision, int width, const string& fill) {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "AsString")
+                     .Input(FakeInput(dtype))
+                     .Attr("precision", precision)
+                     .Attr("width", width)
+                     .Attr("fill", fill)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(AsStringOpTest, Int32WithWidthAndFill) {
+  MakeOp(DT_INT32, -1, 4, "0");
+  AddInputFromArray<int32>(TensorShape({3}), {7, -12, 12345});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_STRING, TensorShape({3}));
+  test::FillValues<string>(&expected, {"0007", "-012", "12345"});
+  test::ExpectTensorEqual<string>(expected, *GetOutput(0));
+}
+
+TEST_F(AsStringOpTest, Bool) {
+  MakeOp(DT_BOOL, -1, -1, "");
+  AddInputFromArray<bool>(TensorShape({2}), {true, false});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_STRING, TensorShape({2}));
+  test::FillValues<string>(&expected, {"true", "false"});
+  test::ExpectTensorEqual<string>(expected, *GetOutput(0));
+}
+
+// Enough elements that the formatting is split across the device's worker
+// threads; every element must still land in its own output slot.
+const int kShardedSize = 64 * 1024;
+
+TEST_F(AsStringOpTest, ShardedInt64) {
+  MakeOp(DT_INT64, -1, -1, "");
+  AddInput<int64>(TensorShape({kShardedSize}),
+                  [](int i) { return static_cast<int64>(i) * 1000003 - 7; });
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_STRING, TensorShape({kShardedSize}));
+  for (int i = 0; i < kShardedSize; ++i) {
+    expected.flat<string>()(i) = strings::Printf(
+        "%lld", static_cast<long long>(static_cast<int64>(i) * 1000003 - 7));
+  }
+  test::ExpectTensorEqual<string>(expected, *GetOutput(0));
+}
+
+TEST_F(AsStringOpTest, ShardedFloatWithPrecision) {
+  MakeOp(DT_FLOAT, 3, -1, "");
+  AddInput<float>(TensorShape({kShardedSize}),
+                  [](int i) { return i * 0.25f - 100.0f; });
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_STRING, TensorShape({kShardedSize}));
+  for (int i = 0; i < kShardedSize; ++i) {
+    expected.flat<string>()(i) = strings::Printf("%.3f", i * 0.25f - 100.0f);
+  }
+  test::ExpectTensorEqual<string>(expected, *GetOutput(0));
+}
+
+TEST_F(AsStringOpTest, ShardedComplex64) {
+  MakeOp(DT_COMPLEX64, 1, -1, "");
+  AddInput<complex64>(TensorShape({kShardedSize}),
+                      [](int i) { return complex64(i, -i * 0.5f); });
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_STRING, TensorShape({kShardedSize}));
+  for (int i = 0; i < kShardedSize; ++i) {
+    expected.flat<string>()(i) =
+        strings::Printf("(%.1f,%.1f)", static_cast<float>(i), -i * 0.5f);
+  }
+  test::ExpectTensorEqual<string>(expected, *GetOutput(0));
+}
+
+Graph* SetupAsStringGraph(const Tensor& input) {
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(NodeBuilder("as_string_op", "AsString")
+                  .Input(test::graph::Constant(g, input))
+                  .Finalize(g, nullptr /* node */));
+  return g;
+}
+
+static void BM_AsString(int iters, int num_elements) {
+  testing::StopTiming();
+  Tensor input(DT_FLOAT, TensorShape({num_elements}));
+  input.flat<float>().setRandom();
+  Graph* g = SetupAsStringGraph(input);
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_elements);
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+BENCHMARK(BM_AsString)->Arg(16)->Arg(1024)->Arg(64 * 1024)->Arg(1024 * 1024);
+
+}  // namespace
+}  // namespace tensorflow
@@ -84,12 +84,13 @@ class BaseCandidateSamplerOp : public OpKernel {
     // samples than expected, which will result in reused random bits.
     const int64 samples32 = 2048 * num_sampled_;
 
-    // Pick sampled candidates.
+    // Pick sampled candidates.  Large batches without uniqueness are drawn
+    // on the worker threads.
     auto local_gen = generator_.ReserveSamples32(samples32);
-    random::SimplePhilox random(&local_gen);
-    sampler_->SampleBatchGetExpectedCount(&random, unique_, &sampled_candidate,
-                                          &sampled_expected_count,
-                                          true_candidate, &true_expected_count);
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    sampler_->SampleBatchGetExpectedCountParallel(
+        worker_threads->workers, local_gen, unique_, &sampled_candidate,
+        &sampled_expected_count, true_candidate, &true_expected_count);
 
     if (sampler_->NeedsUpdates()) {
       sampler_->Update(true_candidate);
@@ -18,6 +18,8 @@ limitations under the License.
 #define EIGEN_USE_THREADS
 
 #include <limits>
+#include <memory>
+#include <vector>
 
 #include "tensorflow/core/util/ctc/ctc_beam_search.h"
 #include "tensorflow/core/framework/op.h"
@@ -26,7 +28,9 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/util/sparse/sparse_tensor.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -248,6 +252,10 @@ class CTCBeamSearchDecoderOp : public OpKernel {
   explicit CTCBeamSearchDecoderOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("merge_repeated", &merge_repeated_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("beam_width", &beam_width_));
+    OP_REQUIRES_OK(
+        ctx, ctx->GetAttr("label_selection_size", &label_selection_size_));
+    OP_REQUIRES_OK(
+        ctx, ctx->GetAttr("label_selection_margin", &label_selection_margin_));
     int top_paths;
     OP_REQUIRES_OK(ctx, ctx->GetAttr("top_paths", &top_paths));
     decode_helper_.SetTopPaths(top_paths);
@@ -264,7 +272,6 @@ class CTCBeamSearchDecoderOp : public OpKernel {
                             ctx, &inputs, &seq_len, &log_prob, &decoded_indices,
                             &decoded_values, &decoded_shape));
 
-    auto inputs_t = inputs->tensor<float, 3>();
     auto seq_len_t = seq_len->vec<int32>();
     auto log_prob_t = log_prob->matrix<float>();
 
@@ -280,40 +287,41 @@ class CTCBeamSearchDecoderOp : public OpKernel {
 
     log_prob_t.setZero();
 
-    std::vector<TTypes<float>::UnalignedConstMatrix> input_list_t;
-
-    for (std::size_t t = 0; t < max_time; ++t) {
-      input_list_t.emplace_back(inputs_t.data() + t * batch_size * num_classes,
-                                batch_size, num_classes);
-    }
-
-    ctc::CTCBeamSearchDecoder<> beam_search(num_classes, beam_width_,
-                                            &beam_scorer_, 1 /* batch_size */,
-                                            merge_repeated_);
-    Tensor input_chip(DT_FLOAT, TensorShape({num_classes}));
-    auto input_chip_t = input_chip.flat<float>();
-
     std::vector<std::vector<std::vector<int> > > best_paths(batch_size);
-    std::vector<float> log_probs;
+    const float* inputs_data = inputs->flat<float>().data();
+    const int top_paths = decode_helper_.GetTopPaths();
 
+    // Batch entries are independent, so they are decoded in parallel.  Each
+    // shard takes a decoder from the pool and decodes its entries one after
+    // the other, reusing the decoder's beam arena.
     // Assumption: the blank index is num_classes - 1
-    for (int b = 0; b < batch_size; ++b) {
-      auto& best_paths_b = best_paths[b];
-      best_paths_b.resize(decode_helper_.GetTopPaths());
-      for (int t = 0; t < seq_len_t(b); ++t) {
-        input_chip_t = input_list_t[t].chip(b, 0);
-        auto input_bi =
-            Eigen::Map<const Eigen::ArrayXf>(input_chip_t.data(), num_classes);
-        beam_search.Step(input_bi);
-      }
-      beam_search.TopPaths(decode_helper_.GetTopPaths(), &best_paths_b,
-                           &log_probs, merge_repeated_);
-      beam_search.Reset();
+    auto decode = [this, &best_paths, &seq_len_t, &log_prob_t, inputs_data,
+                   batch_size, num_classes, top_paths](int64 start,
+                                                       int64 limit) {
+      std::unique_ptr<Decoder> beam_search = GetDecoder(num_classes);
+      std::vector<float> log_probs;
+      for (int64 b = start; b < limit; ++b) {
+        auto& best_paths_b = best_paths[b];
+        best_paths_b.resize(top_paths);
+        for (int t = 0; t < seq_len_t(b); ++t) {
+          auto input_bi = Eigen::Map<const Eigen::ArrayXf>(
+              inputs_data + (t * batch_size + b) * num_classes, num_classes);
+          beam_search->Step(input_bi);
+        }
+        beam_search->TopPaths(top_paths, &best_paths_b, &log_probs,
+                              merge_repeated_);
+        beam_search->Reset();
 
-      for (int bp = 0; bp < decode_helper_.GetTopPaths(); ++bp) {
-        log_prob_t(b, bp) = log_probs[bp];
+        for (int bp = 0; bp < top_paths; ++bp) {
+          log_prob_t(b, bp) = log_probs[bp];
+        }
       }
-    }
+      ReturnDecoder(std::move(beam_search));
+    };
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    const int64 cost_per_entry = max_time * beam_width_ * num_classes * 10;
+    Shard(worker_threads->num_threads, worker_threads->workers, batch_size,
+          cost_per_entry, decode);
 
     OP_REQUIRES_OK(ctx, decode_helper_.StoreAllDecodedSequences(
                             best_paths, &decoded_indices, &decoded_values,
@@ -321,10 +329,43 @@ class CTCBeamSearchDecoderOp : public OpKernel {
   }
 
  private:
+  typedef ctc::CTCBeamSearchDecoder<> Decoder;
+
+  // Returns an idle decoder for 'num_classes' classes, creating one if the
+  // pool has none.
+  std::unique_ptr<Decoder> GetDecoder(int num_classes) {
+    {
+      mutex_lock l(mu_);
+      while (!decoders_.empty()) {
+        std::unique_ptr<Decoder> decoder = std::move(decoders_.back());
+        decoders_.pop_back();
+        if (decoder->num_classes() == num_classes) return decoder;
+      }
+    }
+    std::unique_ptr<Decoder> decoder(new Decoder(
+        num_classes, beam_width_, &beam_scorer_, 1 /* batch_size */,
+        merge_repeated_));
+    decoder->SetLabelSelectionParameters(label_selection_size_,
+                                         label_selection_margin_);
+    return decoder;
+  }
+
+  void ReturnDecoder(std::unique_ptr<Decoder> decoder) {
+    mutex_lock l(mu_);
+    decoders_.push_back(std::move(decoder));
+  }
+
   CTCDecodeHelper decode_helper_;
-  ctc::CTCBeamSearchDecoder<>::DefaultBeamScorer beam_scorer_;
+  // Stateless, so it is shared by all decoders.
+  Decoder::DefaultBeamScorer beam_scorer_;
   bool merge_repeated_;
   int beam_width_;
+  int label_selection_size_;
+  float label_selection_margin_;
+
+  mutex mu_;
+  std::vector<std::unique_ptr<Decoder>> decoders_ GUARDED_BY(mu_);
+
   TF_DISALLOW_COPY_AND_ASSIGN(CTCBeamSearchDecoderOp);
 };
 
@@ -0,0 +1,141 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class CTCBeamSearchDecoderOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(int beam_width, int top_paths) {
+    top_paths_ = top_paths;
+    TF_ASSERT_OK(NodeDefBuilder("ctc_beam_search", "CTCBeamSearchDecoder")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("beam_width", beam_width)
+                     .Attr("top_paths", top_paths)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Gives the kernel 'num_threads' worker threads.  With one thread the batch
+  // is decoded serially by a single decoder; with more, batch entries are
+  // sharded and each shard takes its own decoder from the kernel's pool.
+  void PinWorkerThreads(int num_threads) {
+    pool_.reset(
+        new thread::ThreadPool(Env::Default(), "ctc_test", num_threads));
+    worker_threads_.num_threads = num_threads;
+    worker_threads_.workers = pool_.get();
+    device_->set_tensorflow_cpu_worker_threads(&worker_threads_);
+  }
+
+  // Runs the kernel built by MakeOp() on the given inputs and returns all of
+  // its outputs.  The kernel, and so its pool of decoders, is kept across
+  // calls.
+  std::vector<Tensor> Decode(const Tensor& inputs, const Tensor& seq_len) {
+    inputs_.clear();
+    AddInputFromArray<float>(
+        inputs.shape(), gtl::ArraySlice<float>(inputs.flat<float>().data(),
+                                               inputs.NumElements()));
+    AddInputFromArray<int32>(
+        seq_len.shape(), gtl::ArraySlice<int32>(seq_len.flat<int32>().data(),
+                                                seq_len.NumElements()));
+    TF_CHECK_OK(RunOpKernel());
+    std::vector<Tensor> outputs;
+    for (int i = 0; i < 3 * top_paths_ + 1; ++i) {
+      outputs.push_back(*GetOutput(i));
+    }
+    return outputs;
+  }
+
+  void ExpectSameOutputs(const std::vector<Tensor>& expected,
+                         const std::vector<Tensor>& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (int i = 0; i < 3 * top_paths_; ++i) {
+      test::ExpectTensorEqual<int64>(expected[i], actual[i]);
+    }
+    test::ExpectTensorEqual<float>(expected.back(), actual.back());
+  }
+
+ private:
+  int top_paths_ = 0;
+  std::unique_ptr<thread::ThreadPool> pool_;
+  DeviceBase::CpuWorkerThreads worker_threads_;
+};
+
+TEST_F(CTCBeamSearchDecoderOpTest, ShardedBatchMatchesSerialDecoding) {
+  const int kMaxTime = 40;
+  const int kBatchSize = 24;
+  const int kNumClasses = 8;
+  // Label selection is left off, so every label is expanded at every step.
+  MakeOp(/*beam_width=*/10, /*top_paths=*/3);
+
+  // Random logits and sequence lengths, so that entries decode to paths of
+  // different lengths and each batch entry has a distinct result.
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor inputs(DT_FLOAT, TensorShape({kMaxTime, kBatchSize, kNumClasses}));
+  for (int64 i = 0; i < inputs.NumElements(); ++i) {
+    inputs.flat<float>()(i) = 4 * rnd.RandFloat() - 2;
+  }
+  Tensor seq_len(DT_INT32, TensorShape({kBatchSize}));
+  for (int b = 0; b < kBatchSize; ++b) {
+    seq_len.flat<int32>()(b) = 1 + rnd.Uniform(kMaxTime);
+  }
+
+  PinWorkerThreads(1);
+  const std::vector<Tensor> serial = Decode(inputs, seq_len);
+
+  // The first sharded run creates new decoders next to the pooled one; the
+  // second one reuses the warm decoders that the first run returned.
+  PinWorkerThreads(8);
+  ExpectSameOutputs(serial, Decode(inputs, seq_len));
+  ExpectSameOutputs(serial, Decode(inputs, seq_len));
+
+  // Decoding each entry on its own gives the same log probabilities, so no
+  // beam state leaks between the entries that a decoder handles in turn.
+  for (int b = 0; b < kBatchSize; ++b) {
+    Tensor entry_inputs(DT_FLOAT, TensorShape({kMaxTime, 1, kNumClasses}));
+    for (int t = 0; t < kMaxTime; ++t) {
+      for (int c = 0; c < kNumClasses; ++c) {
+        entry_inputs.flat<float>()(t * kNumClasses + c) =
+            inputs.flat<float>()((t * kBatchSize + b) * kNumClasses + c);
+      }
+    }
+    Tensor entry_seq_len(DT_INT32, TensorShape({1}));
+    entry_seq_len.flat<int32>()(0) = seq_len.flat<int32>()(b);
+    const std::vector<Tensor> entry = Decode(entry_inputs, entry_seq_len);
+    for (int p = 0; p < 3; ++p) {
+      EXPECT_EQ(serial.back().matrix<float>()(b, p),
+                entry.back().matrix<float>()(0, p))
+          << "batch entry " << b << ", path " << p;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -19,8 +19,11 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/delimiter_scanner.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -38,6 +41,10 @@ class DecodeCSVOp : public OpKernel {
                 errors::InvalidArgument("field_delim should be only 1 char"));
 
     delim_ = delim[0];
+    // Characters that end (or invalidate) an unquoted field.
+    const char unquoted_stops[] = {delim_, '"', '\n', '\r'};
+    unquoted_scanner_.reset(
+        new DelimiterScanner(StringPiece(unquoted_stops, 4)));
   }
 
   void Compute(OpKernelContext* ctx) override {
@@ -60,178 +67,219 @@ class DecodeCSVOp : public OpKernel {
     OpOutputList output;
     OP_REQUIRES_OK(ctx, ctx->output_list("output", &output));
 
+    std::vector<Tensor*> outputs(out_type_.size());
     for (int i = 0; i < static_cast<int>(out_type_.size()); ++i) {
-      Tensor* out = nullptr;
-      OP_REQUIRES_OK(ctx, output.allocate(i, records->shape(), &out));
+      OP_REQUIRES_OK(ctx, output.allocate(i, records->shape(), &outputs[i]));
     }
 
+    int64 total_bytes = 0;
     for (int64 i = 0; i < records_size; ++i) {
-      const StringPiece record(records_t(i));
+      total_bytes += records_t(i).size();
+    }
+    const int64 cost_per_record =
+        kCostPerByte * (1 + total_bytes / std::max<int64>(records_size, 1));
+
+    // Records are decoded in parallel. Every shard stops at its first bad
+    // record, and the error reported is the one of the earliest bad record
+    // overall, which is what a serial scan would have reported.
+    mutex mu;
+    int64 first_error_record = records_size;
+    Status first_error;
+    auto decode_records = [&](int64 start, int64 limit) {
+      // Field buffers are reused from record to record so that steady-state
+      // decoding does not allocate.
       std::vector<string> fields;
-      ExtractFields(ctx, record, &fields);
-      OP_REQUIRES(ctx, fields.size() == out_type_.size(),
-                  errors::InvalidArgument("Expect ", out_type_.size(),
-                                          " fields but have ", fields.size(),
-                                          " in record ", i));
-
-      // Check each field in the record
-      for (int f = 0; f < static_cast<int>(out_type_.size()); ++f) {
-        const DataType& dtype = out_type_[f];
-        switch (dtype) {
-          case DT_INT32: {
-            // If this field is empty, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty()) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-
-              output[f]->flat<int32>()(i) = record_defaults[f].flat<int32>()(0);
-            } else {
-              int32 value;
-              OP_REQUIRES(ctx, strings::safe_strto32(fields[f], &value),
-                          errors::InvalidArgument("Field ", f, " in record ", i,
-                                                  " is not a valid int32: ",
-                                                  fields[f]));
-              output[f]->flat<int32>()(i) = value;
-            }
-            break;
+      for (int64 i = start; i < limit; ++i) {
+        Status s = DecodeRecord(records_t(i), i, record_defaults, &fields,
+                                &outputs);
+        if (!s.ok()) {
+          mutex_lock l(mu);
+          if (i < first_error_record) {
+            first_error_record = i;
+            first_error = s;
           }
-          case DT_INT64: {
-            // If this field is empty, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty()) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-
-              output[f]->flat<int64>()(i) = record_defaults[f].flat<int64>()(0);
-            } else {
-              int64 value;
-              OP_REQUIRES(ctx, strings::safe_strto64(fields[f], &value),
-                          errors::InvalidArgument("Field ", f, " in record ", i,
-                                                  " is not a valid int64: ",
-                                                  fields[f]));
-              output[f]->flat<int64>()(i) = value;
+          return;
+        }
+      }
+    };
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads.num_threads, worker_threads.workers, records_size,
+          cost_per_record, decode_records);
+    OP_REQUIRES_OK(ctx, first_error);
+  }
+
+ private:
+  // Rough number of cycles spent per record byte to split and convert it.
+  static constexpr int64 kCostPerByte = 20;
+
+  std::vector<DataType> out_type_;
+  char delim_;
+  std::unique_ptr<DelimiterScanner> unquoted_scanner_;
+
+  // Decodes record 'i' into element 'i' of every output.
+  Status DecodeRecord(const string& record_str, int64 i,
+                      const OpInputList& record_defaults,
+                      std::vector<string>* field_buffers,
+                      std::vector<Tensor*>* outputs) const {
+    int num_fields = 0;
+    TF_RETURN_IF_ERROR(ExtractFields(record_str, field_buffers, &num_fields));
+    if (num_fields != static_cast<int>(out_type_.size())) {
+      return errors::InvalidArgument("Expect ", out_type_.size(),
+                                     " fields but have ", num_fields,
+                                     " in record ", i);
+    }
+    const std::vector<string>& fields = *field_buffers;
+
+    // Check each field in the record
+    for (int f = 0; f < static_cast<int>(out_type_.size()); ++f) {
+      const DataType& dtype = out_type_[f];
+      Tensor* out = (*outputs)[f];
+      // If this field is empty, check if default is given:
+      // If yes, use default value; Otherwise report error.
+      if (fields[f].empty() && record_defaults[f].NumElements() != 1) {
+        return errors::InvalidArgument(
+            "Field ", f, " is required but missing in record ", i, "!");
+      }
+      switch (dtype) {
+        case DT_INT32: {
+          if (fields[f].empty()) {
+            out->flat<int32>()(i) = record_defaults[f].flat<int32>()(0);
+          } else {
+            int32 value;
+            if (!strings::safe_strto32(fields[f], &value)) {
+              return errors::InvalidArgument("Field ", f, " in record ", i,
+                                             " is not a valid int32: ",
+                                             fields[f]);
             }
-            break;
+            out->flat<int32>()(i) = value;
           }
-          case DT_FLOAT: {
-            // If this field is empty, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty()) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-              output[f]->flat<float>()(i) = record_defaults[f].flat<float>()(0);
-            } else {
-              float value;
-              OP_REQUIRES(ctx, strings::safe_strtof(fields[f].c_str(), &value),
-                          errors::InvalidArgument("Field ", f, " in record ", i,
-                                                  " is not a valid float: ",
-                                                  fields[f]));
-              output[f]->flat<float>()(i) = value;
+          break;
+        }
+        case DT_INT64: {
+          if (fields[f].empty()) {
+            out->flat<int64>()(i) = record_defaults[f].flat<int64>()(0);
+          } else {
+            int64 value;
+            if (!strings::safe_strto64(fields[f], &value)) {
+              return errors::InvalidArgument("Field ", f, " in record ", i,
+                                             " is not a valid int64: ",
+                                             fields[f]);
             }
-            break;
+            out->flat<int64>()(i) = value;
           }
-          case DT_STRING: {
-            // If this field is empty, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty()) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-              output[f]->flat<string>()(i) =
-                  record_defaults[f].flat<string>()(0);
-            } else {
-              output[f]->flat<string>()(i) = fields[f];
+          break;
+        }
+        case DT_FLOAT: {
+          if (fields[f].empty()) {
+            out->flat<float>()(i) = record_defaults[f].flat<float>()(0);
+          } else {
+            float value;
+            if (!strings::safe_strtof(fields[f].c_str(), &value)) {
+              return errors::InvalidArgument("Field ", f, " in record ", i,
+                                             " is not a valid float: ",
+                                             fields[f]);
             }
-            break;
+            out->flat<float>()(i) = value;
+          }
+          break;
+        }
+        case DT_STRING: {
+          if (fields[f].empty()) {
+            out->flat<string>()(i) = record_defaults[f].flat<string>()(0);
+          } else {
+            out->flat<string>()(i) = fields[f];
           }
-          default:
-            OP_REQUIRES(ctx, false,
-                        errors::InvalidArgument("csv: data type ", dtype,
-                                                " not supported in field ", f));
+          break;
         }
+        default:
+          return errors::InvalidArgument("csv: data type ", dtype,
+                                         " not supported in field ", f);
       }
     }
+    return Status::OK();
   }
 
- private:
-  std::vector<DataType> out_type_;
-  char delim_;
+  // Splits 'input' into fields, unescaping quoted ones. The first
+  // '*num_fields' entries of 'result' hold the fields on return; the strings
+  // themselves are reused across calls.
+  Status ExtractFields(StringPiece input, std::vector<string>* result,
+                       int* num_fields) const {
+    auto next_field = [result, num_fields]() {
+      if (*num_fields == static_cast<int>(result->size())) {
+        result->emplace_back();
+      }
+      string* field = &(*result)[(*num_fields)++];
+      field->clear();
+      return field;
+    };
 
-  void ExtractFields(OpKernelContext* ctx, StringPiece input,
-                     std::vector<string>* result) {
-    int64 current_idx = 0;
-    if (!input.empty()) {
-      while (static_cast<size_t>(current_idx) < input.size()) {
-        if (input[current_idx] == '\n' || input[current_idx] == '\r') {
-          current_idx++;
-          continue;
-        }
+    const char* data = input.data();
+    const size_t size = input.size();
+    size_t current_idx = 0;
+    if (size == 0) return Status::OK();
+    while (current_idx < size) {
+      if (data[current_idx] == '\n' || data[current_idx] == '\r') {
+        current_idx++;
+        continue;
+      }
+
+      bool quoted = false;
+      if (data[current_idx] == '"') {
+        quoted = true;
+        current_idx++;
+      }
 
-        bool quoted = false;
-        if (input[current_idx] == '"') {
-          quoted = true;
-          current_idx++;
+      // This is the body of the field;
+      string* field = next_field();
+      if (!quoted) {
+        const size_t end =
+            current_idx +
+            unquoted_scanner_->Find(data + current_idx, size - current_idx);
+        if (end < size && data[end] != delim_) {
+          return errors::InvalidArgument(
+              "Unquoted fields cannot have quotes/CRLFs inside");
         }
+        field->assign(data + current_idx, end - current_idx);
 
-        // This is the body of the field;
-        string field;
-        if (!quoted) {
-          while (static_cast<size_t>(current_idx) < input.size() &&
-                 input[current_idx] != delim_) {
-            OP_REQUIRES(ctx, input[current_idx] != '"' &&
-                                 input[current_idx] != '\n' &&
-                                 input[current_idx] != '\r',
-                        errors::InvalidArgument(
-                            "Unquoted fields cannot have quotes/CRLFs inside"));
-            field += input[current_idx];
-            current_idx++;
+        // Go to next field or the end
+        current_idx = end + 1;
+      } else {
+        // Quoted field needs to be ended with '"' and delim or end. Copy the
+        // runs between quotes in bulk and unescape doubled quotes.
+        while (current_idx < size - 1) {
+          const void* quote =
+              memchr(data + current_idx, '"', size - 1 - current_idx);
+          if (quote == nullptr) {
+            field->append(data + current_idx, size - 1 - current_idx);
+            current_idx = size - 1;
+            break;
           }
-
-          // Go to next field or the end
-          current_idx++;
-        } else {
-          // Quoted field needs to be ended with '"' and delim or end
-          while (
-              (static_cast<size_t>(current_idx) < input.size() - 1) &&
-              (input[current_idx] != '"' || input[current_idx + 1] != delim_)) {
-            if (input[current_idx] != '"') {
-              field += input[current_idx];
-              current_idx++;
-            } else {
-              OP_REQUIRES(
-                  ctx, input[current_idx + 1] == '"',
-                  errors::InvalidArgument("Quote inside a string has to be "
-                                          "escaped by another quote"));
-              field += '"';
-              current_idx += 2;
-            }
+          const size_t quote_idx = static_cast<const char*>(quote) - data;
+          field->append(data + current_idx, quote_idx - current_idx);
+          current_idx = quote_idx;
+          if (data[current_idx + 1] == delim_) break;
+          if (data[current_idx + 1] != '"') {
+            return errors::InvalidArgument(
+                "Quote inside a string has to be escaped by another quote");
           }
-
-          OP_REQUIRES(
-              ctx, (static_cast<size_t>(current_idx) < input.size() &&
-                    input[current_idx] == '"' &&
-                    (static_cast<size_t>(current_idx) == input.size() - 1 ||
-                     input[current_idx + 1] == delim_)),
-              errors::InvalidArgument("Quoted field has to end with quote "
-                                      "followed by delim or end"));
-
+          field->push_back('"');
           current_idx += 2;
         }
 
-        result->push_back(field);
-      }
+        if (!(current_idx < size && data[current_idx] == '"' &&
+              (current_idx == size - 1 || data[current_idx + 1] == delim_))) {
+          return errors::InvalidArgument(
+              "Quoted field has to end with quote followed by delim or end");
+        }
 
-      // Check if the last field is missing
-      if (input[input.size() - 1] == delim_) result->push_back(string());
+        current_idx += 2;
+      }
     }
+
+    // Check if the last field is missing
+    if (data[size - 1] == delim_) next_field();
+    return Status::OK();
   }
 };
 
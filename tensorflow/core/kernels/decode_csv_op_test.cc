@@ -0,0 +1,129 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class DecodeCSVOpTest : public OpsTestBase {
+ protected:
+  void MakeOp() {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "DecodeCSV")
+                     .Input(FakeInput(DT_STRING))
+                     .Input(FakeInput({DT_INT32, DT_FLOAT, DT_STRING}))
+                     .Attr("OUT_TYPE", {DT_INT32, DT_FLOAT, DT_STRING})
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(DecodeCSVOpTest, QuotedAndDefaultFields) {
+  MakeOp();
+  AddInputFromArray<string>(TensorShape({3}),
+                            {"1,2.5,abc", ",,\"x,\"\"y\"\"\"", "3,0.5,"});
+  AddInputFromArray<int32>(TensorShape({1}), {7});
+  AddInputFromArray<float>(TensorShape({1}), {1.5});
+  AddInputFromArray<string>(TensorShape({1}), {"def"});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_ints(allocator(), DT_INT32, TensorShape({3}));
+  test::FillValues<int32>(&expected_ints, {1, 7, 3});
+  test::ExpectTensorEqual<int32>(expected_ints, *GetOutput(0));
+  Tensor expected_floats(allocator(), DT_FLOAT, TensorShape({3}));
+  test::FillValues<float>(&expected_floats, {2.5, 1.5, 0.5});
+  test::ExpectTensorEqual<float>(expected_floats, *GetOutput(1));
+  Tensor expected_strings(allocator(), DT_STRING, TensorShape({3}));
+  test::FillValues<string>(&expected_strings, {"abc", "x,\"y\"", "def"});
+  test::ExpectTensorEqual<string>(expected_strings, *GetOutput(2));
+}
+
+TEST_F(DecodeCSVOpTest, ReportsFirstBadRecord) {
+  MakeOp();
+  std::vector<string> records(1000, "1,2,x");
+  records[700] = "1,2";
+  records[900] = "a,2,x";
+  AddInputFromArray<string>(TensorShape({1000}), records);
+  AddInputFromArray<int32>(TensorShape({0}), {});
+  AddInputFromArray<float>(TensorShape({0}), {});
+  AddInputFromArray<string>(TensorShape({0}), {});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.ToString())
+                  .contains("Expect 3 fields but have 2 in record 700"))
+      << s;
+}
+
+static void BM_DecodeCSV(int iters, int num_records, int num_fields) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor records(DT_STRING, TensorShape({num_records}));
+  auto records_t = records.flat<string>();
+  for (int i = 0; i < num_records; ++i) {
+    for (int f = 0; f < num_fields; ++f) {
+      if (f > 0) records_t(i).push_back(',');
+      switch (f % 3) {
+        case 0:
+          strings::StrAppend(&records_t(i), i + f);
+          break;
+        case 1:
+          strings::StrAppend(&records_t(i), (i + f) * 0.25f);
+          break;
+        default:
+          strings::StrAppend(&records_t(i), "\"token", f, "\"");
+      }
+    }
+  }
+
+  std::vector<NodeBuilder::NodeOut> defaults;
+  DataTypeVector out_types;
+  for (int f = 0; f < num_fields; ++f) {
+    const DataType dtype =
+        f % 3 == 0 ? DT_INT64 : (f % 3 == 1 ? DT_FLOAT : DT_STRING);
+    out_types.push_back(dtype);
+    defaults.emplace_back(
+        test::graph::Constant(g, Tensor(dtype, TensorShape({0}))));
+  }
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "DecodeCSV")
+                  .Input(test::graph::Constant(g, records))
+                  .Input(defaults)
+                  .Attr("OUT_TYPE", out_types)
+                  .Finalize(g, nullptr /* node */));
+
+  int64 bytes = 0;
+  for (int i = 0; i < num_records; ++i) bytes += records_t(i).size();
+  testing::BytesProcessed(static_cast<int64>(iters) * bytes);
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+BENCHMARK(BM_DecodeCSV)
+    ->ArgPair(1024, 3)
+    ->ArgPair(1024, 30)
+    ->ArgPair(64 * 1024, 3)
+    ->ArgPair(64 * 1024, 30);
+
+}  // namespace
+}  // namespace tensorflow
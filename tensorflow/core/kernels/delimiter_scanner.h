@@ -0,0 +1,105 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_DELIMITER_SCANNER_H_
+#define TENSORFLOW_KERNELS_DELIMITER_SCANNER_H_
+
+#include <string.h>
+
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace tensorflow {
+
+// Finds the first occurrence of any character of a small delimiter set in a
+// byte range. Used by the string tokenizing kernels in place of a per-byte
+// loop.
+//
+// A single delimiter is found with memchr(), which libc already vectorizes.
+// Up to kMaxVectorDelimiters delimiters are compared 16 bytes at a time with
+// SSE2 when it is available. Larger sets, and the tails of the vectorized
+// scan, go through a 256-entry lookup table.
+class DelimiterScanner {
+ public:
+  static constexpr int kMaxVectorDelimiters = 4;
+
+  explicit DelimiterScanner(StringPiece delimiters)
+      : num_delimiters_(delimiters.size()) {
+    memset(table_, 0, sizeof(table_));
+    for (size_t i = 0; i < delimiters.size(); ++i) {
+      table_[static_cast<uint8>(delimiters[i])] = true;
+    }
+    // Duplicate delimiters are harmless, and unused slots repeat the first
+    // delimiter so the vector loop does not need to special-case them.
+    const char first = delimiters.empty() ? '\0' : delimiters[0];
+    for (int i = 0; i < kMaxVectorDelimiters; ++i) {
+      chars_[i] = i < static_cast<int>(delimiters.size()) ? delimiters[i]
+                                                          : first;
+    }
+  }
+
+  // Returns true if 'c' is one of the delimiters.
+  bool IsDelimiter(char c) const { return table_[static_cast<uint8>(c)]; }
+
+  // Returns the offset of the first delimiter in [data, data + size), or
+  // 'size' if there is none.
+  size_t Find(const char* data, size_t size) const {
+    if (num_delimiters_ == 0) return size;
+    if (num_delimiters_ == 1) {
+      const void* p = memchr(data, chars_[0], size);
+      return p == nullptr ? size : static_cast<const char*>(p) - data;
+    }
+    size_t i = 0;
+#ifdef __SSE2__
+    if (num_delimiters_ <= kMaxVectorDelimiters) {
+      const __m128i d0 = _mm_set1_epi8(chars_[0]);
+      const __m128i d1 = _mm_set1_epi8(chars_[1]);
+      const __m128i d2 = _mm_set1_epi8(chars_[2]);
+      const __m128i d3 = _mm_set1_epi8(chars_[3]);
+      for (; i + 16 <= size; i += 16) {
+        const __m128i block =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i hits =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, d0),
+                                      _mm_cmpeq_epi8(block, d1)),
+                         _mm_or_si128(_mm_cmpeq_epi8(block, d2),
+                                      _mm_cmpeq_epi8(block, d3)));
+        const int mask = _mm_movemask_epi8(hits);
+        if (mask != 0) return i + __builtin_ctz(mask);
+      }
+    }
+#endif
+    for (; i < size; ++i) {
+      if (IsDelimiter(data[i])) return i;
+    }
+    return size;
+  }
+
+ private:
+  const size_t num_delimiters_;
+  char chars_[kMaxVectorDelimiters];
+  bool table_[256];
+
+  TF_DISALLOW_COPY_AND_ASSIGN(DelimiterScanner);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_DELIMITER_SCANNER_H_
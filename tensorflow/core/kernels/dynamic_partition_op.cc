@@ -15,7 +15,10 @@ limitations under the License.
 
 // See docs in ../ops/data_flow_ops.cc.
 
+#include <algorithm>
+#include <atomic>
 #include <vector>
+
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -23,11 +26,27 @@ limitations under the License.
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/util/util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
+namespace {
+
+// Rows per block are chosen so that a block is worth scheduling on its own; at
+// most kMaxBlocks blocks keep the offset table small for wide fan-outs.
+constexpr int64 kMinRowsPerBlock = 1024;
+constexpr int64 kMaxBlocks = 256;
+
+}  // namespace
+
 // Shared code that is not dependent on the type of T.  We do this to reduce
 // code size by not duplicating all this for all T (float, double, int32, etc.)
+//
+// Rows are split into contiguous blocks.  A first pass, sharded over blocks,
+// counts how many rows of each block go to each partition; a prefix sum over
+// the counts then gives every block its own write offset in every output, so
+// the second pass can copy all blocks in parallel while keeping the rows of a
+// partition in their original order.
 class DynamicPartitionOp_Shared : public OpKernel {
  public:
   explicit DynamicPartitionOp_Shared(OpKernelConstruction* c) : OpKernel(c) {
@@ -39,9 +58,13 @@ class DynamicPartitionOp_Shared : public OpKernel {
     //   in the graph?
   }
 
+  // On success, 'block_offsets' holds num_blocks() * num_partitions_ entries:
+  // the row of outputs[p] where block b starts writing is
+  // block_offsets[b * num_partitions_ + p].
   void ValidateAndAllocateOutputs(OpKernelContext* c, const Tensor** data,
                                   const Tensor** partitions,
-                                  OpOutputList* Tout) {
+                                  OpOutputList* Tout,
+                                  std::vector<int64>* block_offsets) {
     OP_REQUIRES_OK(c, c->input("data", data));
     OP_REQUIRES_OK(c, c->input("partitions", partitions));
     OP_REQUIRES(
@@ -52,17 +75,52 @@ class DynamicPartitionOp_Shared : public OpKernel {
             "got data.shape = ", (*data)->shape().DebugString(),
             ", partitions.shape = ", (*partitions)->shape().DebugString()));
 
-    // Count how many occurrences of each partition id we have in partitions
-    gtl::InlinedVector<int, 32> partition_count(num_partitions_);
+    // Count how many occurrences of each partition id we have in each block
+    // of partitions.  Blocks remember their first bad row, so the reported
+    // error is the same as for a sequential scan.
     auto e_partitions = (*partitions)->flat<int32>();
     const int64 N = e_partitions.dimension(0);
-    for (int64 i = 0; i < N; i++) {
-      const int32 p = internal::SubtleMustCopy(e_partitions(i));
-      OP_REQUIRES(c, FastBoundsCheck(p, num_partitions_),
-                  errors::InvalidArgument(
-                      "partitions", SliceDebugString((*partitions)->shape(), i),
-                      " = ", p, " is not in [0, ", num_partitions_, ")"));
-      partition_count[p]++;
+    const int64 num_blocks = NumBlocks(N);
+    block_offsets->assign(num_blocks * num_partitions_, 0);
+    std::vector<int64> first_bad_row(num_blocks, -1);
+    auto count_blocks = [this, &e_partitions, N, num_blocks, block_offsets,
+                         &first_bad_row](int64 start, int64 limit) {
+      for (int64 b = start; b < limit; ++b) {
+        int64* counts = block_offsets->data() + b * num_partitions_;
+        const int64 row_limit = BlockStart(b + 1, N, num_blocks);
+        for (int64 i = BlockStart(b, N, num_blocks); i < row_limit; ++i) {
+          const int32 p = internal::SubtleMustCopy(e_partitions(i));
+          if (!FastBoundsCheck(p, num_partitions_)) {
+            first_bad_row[b] = i;
+            break;
+          }
+          counts[p]++;
+        }
+      }
+    };
+    auto worker_threads = c->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_blocks,
+          BlockCost(N, num_blocks, /*slice_size=*/1), count_blocks);
+    for (int64 b = 0; b < num_blocks; ++b) {
+      if (first_bad_row[b] >= 0) {
+        const int64 i = first_bad_row[b];
+        c->CtxFailure(errors::InvalidArgument(
+            "partitions", SliceDebugString((*partitions)->shape(), i), " = ",
+            internal::SubtleMustCopy(e_partitions(i)), " is not in [0, ",
+            num_partitions_, ")"));
+        return;
+      }
+    }
+
+    // Turn the per-block counts into per-block write offsets.
+    gtl::InlinedVector<int64, 32> partition_count(num_partitions_);
+    for (int64 b = 0; b < num_blocks; ++b) {
+      int64* offsets = block_offsets->data() + b * num_partitions_;
+      for (int p = 0; p < num_partitions_; p++) {
+        const int64 count = offsets[p];
+        offsets[p] = partition_count[p];
+        partition_count[p] += count;
+      }
     }
 
     // Allocate output tensors of the right size
@@ -79,6 +137,21 @@ class DynamicPartitionOp_Shared : public OpKernel {
   }
 
  protected:
+  static int64 NumBlocks(int64 num_rows) {
+    return std::max<int64>(
+        1, std::min(kMaxBlocks, num_rows / kMinRowsPerBlock));
+  }
+
+  // First row of block 'b'.  BlockStart(num_blocks) == num_rows.
+  static int64 BlockStart(int64 b, int64 num_rows, int64 num_blocks) {
+    return num_rows * b / num_blocks;
+  }
+
+  // Cost of one block of rows with 'slice_size' elements each.
+  static int64 BlockCost(int64 num_rows, int64 num_blocks, int64 slice_size) {
+    return (num_rows / num_blocks + 1) * (slice_size + 4);
+  }
+
   int num_partitions_;
 };
 
@@ -91,66 +164,57 @@ class DynamicPartitionOp : public DynamicPartitionOp_Shared {
     const Tensor* data;
     const Tensor* partitions;
     OpOutputList outputs;
-    ValidateAndAllocateOutputs(c, &data, &partitions, &outputs);
+    std::vector<int64> block_offsets;
+    ValidateAndAllocateOutputs(c, &data, &partitions, &outputs,
+                               &block_offsets);
     if (!c->status().ok()) return;
     if (num_partitions_ == 0 || data->NumElements() == 0) return;
 
     auto e_partitions = partitions->flat<int32>();
     const int64 N = e_partitions.dimension(0);
-    gtl::InlinedVector<int, 32> output_index(num_partitions_);
-
-    if (partitions->dims() == data->dims()) {
-      // Walk through data and copy the data to the appropriate output tensor
-      const auto data_flat = data->flat<T>();
-      std::vector<Eigen::TensorMap<Eigen::Tensor<T, 1, Eigen::RowMajor>,
-                                   Eigen::Aligned> > out_vec;
-      for (int p = 0; p < num_partitions_; p++) {
-        out_vec.push_back(outputs[p]->vec<T>());
-      }
-      for (int64 i = 0; i < N; i++) {
-        const int32 p = internal::SubtleMustCopy(e_partitions(i));
-        OP_REQUIRES(
-            c, FastBoundsCheck(p, num_partitions_),
-            errors::InvalidArgument("indices[", i, "] is out of range"));
-        auto oi = output_index[p];
-        OP_REQUIRES(c, FastBoundsCheck(oi, out_vec[p].size()),
-                    errors::InvalidArgument(
-                        "out_vec[", p, "] size: ", out_vec[p].size(),
-                        " is not LTE output_index[", p, "] : ", oi));
-        out_vec[p](oi) = data_flat(i);
-        output_index[p]++;
-      }
-    } else {
-      // If data has extra dimensions, use Eigen slices
-      std::vector<Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>,
-                                   Eigen::Aligned> > out_flat;
-      for (int p = 0; p < num_partitions_; p++) {
-        out_flat.push_back(outputs[p]->flat_outer_dims<T>());
-      }
+    const int64 slice_size = data->NumElements() / N;
+    const int64 num_blocks = NumBlocks(N);
+    const T* data_base = data->flat<T>().data();
+    gtl::InlinedVector<T*, 32> out_base(num_partitions_);
+    gtl::InlinedVector<int64, 32> out_rows(num_partitions_);
+    for (int p = 0; p < num_partitions_; p++) {
+      out_base[p] = outputs[p]->flat<T>().data();
+      out_rows[p] = outputs[p]->dim_size(0);
+    }
 
-      // Walk through data and copy the data to the appropriate output tensor
-      const int64 slice_size = data->NumElements() / N;
-      const auto data_flat = data->shaped<T, 2>({N, slice_size});
-      Eigen::DSizes<Eigen::DenseIndex, 2> sizes(1, slice_size);
-      for (int64 i = 0; i < N; i++) {
-        // outputs[p][output_index[p]++] = data[i]
-        const int32 p = internal::SubtleMustCopy(e_partitions(i));
-        OP_REQUIRES(
-            c, FastBoundsCheck(p, num_partitions_),
-            errors::InvalidArgument("indices[", i,
-                                    "] has been asynchronously overwitten and "
-                                    "is no longer in range!"));
-        auto oi = output_index[p];
-        OP_REQUIRES(c, FastBoundsCheck(oi, out_flat[p].dimension(0)),
-                    errors::InvalidArgument("Size of output_index: ", oi,
-                                            " is no longer in range."));
-        Eigen::DSizes<Eigen::DenseIndex, 2> out_indices(oi, 0);
-        Eigen::DSizes<Eigen::DenseIndex, 2> data_indices(i, 0);
-        out_flat[p].slice(out_indices, sizes) =
-            data_flat.slice(data_indices, sizes);
-        output_index[p]++;
+    // Walk through data and copy each row to the appropriate output tensor:
+    //   outputs[p][output_index[p]++] = data[i]
+    // 'partitions' is re-read here, so it is bounds-checked again in case it
+    // has been overwritten since the counting pass.
+    std::atomic<bool> overwritten(false);
+    auto copy_blocks = [this, &e_partitions, &block_offsets, &out_base,
+                        &out_rows, &overwritten, data_base, N, num_blocks,
+                        slice_size](int64 start, int64 limit) {
+      gtl::InlinedVector<int64, 32> output_index(num_partitions_);
+      for (int64 b = start; b < limit; ++b) {
+        std::copy_n(block_offsets.data() + b * num_partitions_,
+                    num_partitions_, output_index.begin());
+        const int64 row_limit = BlockStart(b + 1, N, num_blocks);
+        for (int64 i = BlockStart(b, N, num_blocks); i < row_limit; ++i) {
+          const int32 p = internal::SubtleMustCopy(e_partitions(i));
+          if (!FastBoundsCheck(p, num_partitions_) ||
+              !FastBoundsCheck(output_index[p], out_rows[p])) {
+            overwritten = true;
+            return;
+          }
+          const T* src = data_base + i * slice_size;
+          std::copy(src, src + slice_size,
+                    out_base[p] + output_index[p]++ * slice_size);
+        }
       }
-    }
+    };
+    auto worker_threads = c->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_blocks,
+          BlockCost(N, num_blocks, slice_size), copy_blocks);
+    OP_REQUIRES(c, !overwritten,
+                errors::InvalidArgument(
+                    "partitions has been asynchronously overwritten and is no "
+                    "longer in range!"));
   }
 };
 
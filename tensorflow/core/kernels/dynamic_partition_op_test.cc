@@ -16,6 +16,7 @@ limitations under the License.
 #include <functional>
 #include <memory>
 
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/fake_input.h"
 #include "tensorflow/core/framework/graph.pb.h"
@@ -24,10 +25,13 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace {
@@ -154,5 +158,85 @@ TEST_F(DynamicPartitionOpTest, Error_IndexOutOfRange) {
       << s;
 }
 
+TEST_F(DynamicPartitionOpTest, ManyBlocksKeepOrder) {
+  MakeOp();
+
+  // Enough rows to be split into several blocks; every partition must still
+  // receive its rows in input order.
+  const int N = 10000;
+  const int kWidth = 3;
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<float> data(N * kWidth);
+  std::vector<int32> partitions(N);
+  std::vector<std::vector<float>> expected(4);
+  for (int i = 0; i < N; ++i) {
+    partitions[i] = rnd.Uniform(4);
+    for (int j = 0; j < kWidth; ++j) {
+      data[i * kWidth + j] = i * kWidth + j;
+      expected[partitions[i]].push_back(i * kWidth + j);
+    }
+  }
+  AddInputFromArray<float>(TensorShape({N, kWidth}), data);
+  AddInputFromArray<int32>(TensorShape({N}), partitions);
+  TF_ASSERT_OK(RunOpKernel());
+
+  for (int p = 0; p < 4; ++p) {
+    const int rows = expected[p].size() / kWidth;
+    Tensor expected_p(allocator(), DT_FLOAT, TensorShape({rows, kWidth}));
+    test::FillValues<float>(&expected_p, expected[p]);
+    test::ExpectTensorEqual<float>(expected_p, *GetOutput(p));
+  }
+}
+
+TEST_F(DynamicPartitionOpTest, Error_IndexOutOfRangeReportsFirst) {
+  MakeOp();
+
+  const int N = 10000;
+  std::vector<int32> partitions(N, 1);
+  partitions[N - 10] = -1;
+  partitions[N / 2] = 7;
+  AddInputFromArray<float>(TensorShape({N}), std::vector<float>(N, 1.0f));
+  AddInputFromArray<int32>(TensorShape({N}), partitions);
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.ToString())
+                  .contains("partitions[5000] = 7 is not in [0, 4)"))
+      << s;
+}
+
+static Graph* DynamicPartition(int num_rows, int width, int num_partitions) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor data(DT_FLOAT, TensorShape({num_rows, width}));
+  data.flat<float>().setRandom();
+  Tensor partitions(DT_INT32, TensorShape({num_rows}));
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  auto partitions_vec = partitions.vec<int32>();
+  for (int i = 0; i < num_rows; ++i) {
+    partitions_vec(i) = rnd.Uniform(num_partitions);
+  }
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "DynamicPartition")
+                  .Input(test::graph::Constant(g, data))
+                  .Input(test::graph::Constant(g, partitions))
+                  .Attr("num_partitions", num_partitions)
+                  .Finalize(g, nullptr));
+  return g;
+}
+
+// Arg pairs are (num_rows, width); the widest rows use fewer of them to keep
+// the inputs at a few hundred MB.
+static void BM_DynamicPartition(int iters, int num_rows, int width) {
+  const int64 bytes = static_cast<int64>(num_rows) * width * sizeof(float);
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_rows);
+  testing::BytesProcessed(static_cast<int64>(iters) * bytes);
+  test::Benchmark("cpu", DynamicPartition(num_rows, width, 32)).Run(iters);
+}
+BENCHMARK(BM_DynamicPartition)
+    ->ArgPair(1 << 20, 8)
+    ->ArgPair(1 << 20, 32)
+    ->ArgPair(1 << 20, 128)
+    ->ArgPair(1 << 18, 512)
+    ->ArgPair(1 << 17, 1024);
+
 }  // namespace
 }  // namespace tensorflow
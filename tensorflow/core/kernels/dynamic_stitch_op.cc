@@ -15,10 +15,14 @@ limitations under the License.
 
 // See docs in ../ops/data_flow_ops.cc.
 
+#include <algorithm>
+#include <vector>
+
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -99,42 +103,43 @@ class DynamicStitchOp : public OpKernel {
     // TODO(jeff): Currently we leave uninitialized any portions of
     // merged that aren't covered by an index in indices.  What should we do?
     if (first_dim_size > 0) {
+      // Resolve duplicate indices first: a sequential pass records the last
+      // writer of each merged row, which is the row a sequential copy would
+      // leave behind.  The copies themselves are then independent and can be
+      // sharded over the merged rows.
       auto merged_flat = merged->flat_outer_dims<T>();
-      const int slice_size = merged_flat.dimension(1);
+      const int64 slice_size = merged_flat.dimension(1);
+      std::vector<const T*> source_rows(first_dim_size, nullptr);
       for (int input_num = 0; input_num < indices_inputs.size(); input_num++) {
         const Tensor& indices = indices_inputs[input_num];
         auto indices_vec = indices.flat<int32>();
-        const Tensor& data = data_inputs[input_num];
-        auto data_flat =
-            data.shaped<T, 2>({indices_vec.dimension(0), slice_size});
-
-        if (DataTypeCanUseMemcpy(DataTypeToEnum<T>::v())) {
-          T* merged_base = &merged_flat(0, 0);
-          const T* data_base = &data_flat(0, 0);
-          const size_t slice_bytes = slice_size * sizeof(T);
-          for (int i = 0; i < indices_vec.size(); i++) {
-            int32 index = internal::SubtleMustCopy(indices_vec(i));
-            OP_REQUIRES(
-                c, FastBoundsCheck(index, first_dim_size),
-                errors::InvalidArgument("indices[", i, "] is out of range"));
-            memcpy(merged_base + index * slice_size, data_base + i * slice_size,
-                   slice_bytes);
-          }
-        } else {
-          Eigen::DSizes<Eigen::DenseIndex, 2> sizes(1, slice_size);
-          for (int i = 0; i < indices_vec.size(); i++) {
-            // Copy slice data[i] to merged[indices[i]]
-            Eigen::DSizes<Eigen::DenseIndex, 2> data_indices(i, 0);
-            int32 index = internal::SubtleMustCopy(indices_vec(i));
-            OP_REQUIRES(
-                c, FastBoundsCheck(index, first_dim_size),
-                errors::InvalidArgument("indices[", i, "] is out of range"));
-            Eigen::DSizes<Eigen::DenseIndex, 2> merged_indices(index, 0);
-            merged_flat.slice(merged_indices, sizes) =
-                data_flat.slice(data_indices, sizes);
-          }
+        const T* data_base = data_inputs[input_num].flat<T>().data();
+        for (int i = 0; i < indices_vec.size(); i++) {
+          int32 index = internal::SubtleMustCopy(indices_vec(i));
+          OP_REQUIRES(
+              c, FastBoundsCheck(index, first_dim_size),
+              errors::InvalidArgument("indices[", i, "] is out of range"));
+          source_rows[index] = data_base + i * slice_size;
         }
       }
+
+      T* merged_base = merged_flat.data();
+      auto copy_rows = [&source_rows, merged_base, slice_size](int64 start,
+                                                              int64 limit) {
+        for (int64 row = start; row < limit; ++row) {
+          const T* src = source_rows[row];
+          if (src == nullptr) continue;
+          if (DataTypeCanUseMemcpy(DataTypeToEnum<T>::v())) {
+            memcpy(merged_base + row * slice_size, src,
+                   slice_size * sizeof(T));
+          } else {
+            std::copy(src, src + slice_size, merged_base + row * slice_size);
+          }
+        }
+      };
+      auto worker_threads = c->device()->tensorflow_cpu_worker_threads();
+      Shard(worker_threads->num_threads, worker_threads->workers,
+            first_dim_size, slice_size + 1, copy_rows);
     }
   }
 
@@ -16,6 +16,7 @@ limitations under the License.
 #include <functional>
 #include <memory>
 
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/fake_input.h"
 #include "tensorflow/core/framework/graph.pb.h"
@@ -24,12 +25,15 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace {
@@ -142,5 +146,94 @@ TEST_F(DynamicStitchOpTest, Error_DataAndIndicesSizeMismatch) {
       << s;
 }
 
+TEST_F(DynamicStitchOpTest, DuplicateIndicesLastWins) {
+  MakeOp(2, DT_FLOAT);
+
+  // Index 1 is written by both inputs and index 2 twice by the second one;
+  // the last write in input order wins.
+  AddInputFromArray<int32>(TensorShape({2}), {0, 1});
+  AddInputFromArray<int32>(TensorShape({3}), {2, 1, 2});
+  AddInputFromArray<float>(TensorShape({2, 2}), {0, 1, 10, 11});
+  AddInputFromArray<float>(TensorShape({3, 2}), {20, 21, 30, 31, 40, 41});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected, {0, 1, 30, 31, 40, 41});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(DynamicStitchOpTest, ManyRows) {
+  MakeOp(2, DT_FLOAT);
+
+  // Interleave two inputs over enough rows to be sharded.
+  const int N = 20000;
+  const int kWidth = 5;
+  std::vector<int32> indices[2];
+  std::vector<float> data[2];
+  for (int i = 0; i < N; ++i) {
+    indices[i % 2].push_back(N - 1 - i);
+    for (int j = 0; j < kWidth; ++j) data[i % 2].push_back(i * kWidth + j);
+  }
+  AddInputFromArray<int32>(TensorShape({N / 2}), indices[0]);
+  AddInputFromArray<int32>(TensorShape({N / 2}), indices[1]);
+  AddInputFromArray<float>(TensorShape({N / 2, kWidth}), data[0]);
+  AddInputFromArray<float>(TensorShape({N / 2, kWidth}), data[1]);
+  TF_ASSERT_OK(RunOpKernel());
+
+  auto merged = GetOutput(0)->matrix<float>();
+  ASSERT_EQ(merged.dimension(0), N);
+  for (int row = 0; row < N; ++row) {
+    const int i = N - 1 - row;
+    for (int j = 0; j < kWidth; ++j) {
+      ASSERT_EQ(merged(row, j), i * kWidth + j);
+    }
+  }
+}
+
+// Stitches 'num_inputs' shards of a random permutation of 'num_rows' rows,
+// the way sharded embedding lookups reassemble their results.
+static Graph* DynamicStitch(int num_rows, int width, int num_inputs) {
+  Graph* g = new Graph(OpRegistry::Global());
+  std::vector<int32> permutation(num_rows);
+  for (int i = 0; i < num_rows; ++i) permutation[i] = i;
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  for (int i = num_rows - 1; i > 0; --i) {
+    std::swap(permutation[i], permutation[rnd.Uniform(i + 1)]);
+  }
+  std::vector<NodeBuilder::NodeOut> indices;
+  std::vector<NodeBuilder::NodeOut> data;
+  const int rows_per_input = num_rows / num_inputs;
+  for (int k = 0; k < num_inputs; ++k) {
+    Tensor index(DT_INT32, TensorShape({rows_per_input}));
+    std::copy_n(permutation.begin() + k * rows_per_input, rows_per_input,
+                index.flat<int32>().data());
+    Tensor values(DT_FLOAT, TensorShape({rows_per_input, width}));
+    values.flat<float>().setRandom();
+    indices.push_back(test::graph::Constant(g, index));
+    data.push_back(test::graph::Constant(g, values));
+  }
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "DynamicStitch")
+                  .Input(indices)
+                  .Input(data)
+                  .Finalize(g, nullptr));
+  return g;
+}
+
+// Arg pairs are (num_rows, width); the widest rows use fewer of them to keep
+// the inputs at a few hundred MB.
+static void BM_DynamicStitch(int iters, int num_rows, int width) {
+  const int64 bytes = static_cast<int64>(num_rows) * width * sizeof(float);
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_rows);
+  testing::BytesProcessed(static_cast<int64>(iters) * bytes);
+  test::Benchmark("cpu", DynamicStitch(num_rows, width, 8)).Run(iters);
+}
+BENCHMARK(BM_DynamicStitch)
+    ->ArgPair(1 << 20, 8)
+    ->ArgPair(1 << 20, 32)
+    ->ArgPair(1 << 20, 128)
+    ->ArgPair(1 << 18, 512)
+    ->ArgPair(1 << 17, 1024);
+
 }  // namespace
 }  // namespace tensorflow
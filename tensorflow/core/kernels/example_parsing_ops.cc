@@ -335,7 +335,11 @@ class SingleSequenceExampleParserOp : public OpKernel {
     OP_REQUIRES_OK(ctx, ctx->output_list("feature_list_dense_values",
                                          &feature_list_dense_values));
 
-    SequenceExample ex;
+    // Parse into an arena so that the many small feature messages and their
+    // strings are carved out of a few blocks and released all at once.
+    protobuf::Arena arena;
+    SequenceExample& ex =
+        *protobuf::Arena::CreateMessage<SequenceExample>(&arena);
     OP_REQUIRES(
         ctx, ParseProtoUnlimited(&ex, serialized_t()),
         errors::InvalidArgument("Could not parse example input, value: '",
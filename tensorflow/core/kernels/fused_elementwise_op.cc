@@ -0,0 +1,302 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/cwise_ops.h"
+#include "tensorflow/core/kernels/fused_elementwise_op_table.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+struct FusedStep {
+  FusedElementwiseOpcode opcode;
+  int operand;  // -1 for unary steps.
+  bool swap;
+};
+
+// Number of output elements evaluated together.  All steps of a chain run over
+// one block before moving on, so the accumulator and the operands stay in L1.
+constexpr int64 kBlockSize = 1024;
+
+// How an input is read for a block of output elements.
+enum class InputLayout {
+  kDense,      // Same number of elements as the output; read in place.
+  kScalar,     // A single element; read as a constant.
+  kBroadcast,  // Anything else; gathered into a scratch buffer.
+};
+
+// Broadcasts 'a' and 'b' numpy-style into 'out'.  Returns false if the shapes
+// are incompatible.
+bool BroadcastShapes(const TensorShape& a, const TensorShape& b,
+                     TensorShape* out) {
+  const int rank = std::max(a.dims(), b.dims());
+  gtl::InlinedVector<int64, 8> dims(rank);
+  for (int i = 0; i < rank; ++i) {
+    const int ai = a.dims() - rank + i;
+    const int bi = b.dims() - rank + i;
+    const int64 da = ai >= 0 ? a.dim_size(ai) : 1;
+    const int64 db = bi >= 0 ? b.dim_size(bi) : 1;
+    if (da != db && da != 1 && db != 1) return false;
+    dims[i] = da == 1 ? db : da;
+  }
+  *out = TensorShape(dims);
+  return true;
+}
+
+}  // namespace
+
+template <typename T>
+class FusedElementwiseOp : public OpKernel {
+ public:
+  typedef Eigen::Array<T, Eigen::Dynamic, 1> Array;
+  typedef Eigen::Map<Array> Block;
+  typedef Eigen::Map<const Array> ConstBlock;
+
+  explicit FusedElementwiseOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    std::vector<string> ops;
+    std::vector<int> operands;
+    std::vector<bool> swap;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("ops", &ops));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("operands", &operands));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("swap", &swap));
+    OP_REQUIRES(ctx, ops.size() == operands.size() && ops.size() == swap.size(),
+                errors::InvalidArgument(
+                    "ops, operands and swap must have the same length, got ",
+                    ops.size(), ", ", operands.size(), " and ", swap.size()));
+    const int num_inputs = ctx->num_inputs();
+    for (size_t i = 0; i < ops.size(); ++i) {
+      const FusedElementwiseOpInfo* info = LookupFusedElementwiseOp(ops[i]);
+      OP_REQUIRES(ctx, info != nullptr,
+                  errors::InvalidArgument("Unsupported fused op: ", ops[i]));
+      if (info->arity == 2) {
+        OP_REQUIRES(ctx, operands[i] >= 0 && operands[i] < num_inputs,
+                    errors::InvalidArgument("Operand ", operands[i], " of ",
+                                            ops[i], " is out of range [0, ",
+                                            num_inputs, ")"));
+      } else {
+        OP_REQUIRES(ctx, operands[i] == -1,
+                    errors::InvalidArgument("Unary op ", ops[i],
+                                            " must have operand -1, got ",
+                                            operands[i]));
+      }
+      steps_.push_back({info->opcode, operands[i], swap[i]});
+    }
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const int num_inputs = ctx->num_inputs();
+    TensorShape out_shape = ctx->input(0).shape();
+    for (int i = 1; i < num_inputs; ++i) {
+      TensorShape broadcast;
+      OP_REQUIRES(
+          ctx, BroadcastShapes(out_shape, ctx->input(i).shape(), &broadcast),
+          errors::InvalidArgument("Incompatible shapes: ",
+                                  out_shape.DebugString(), " vs. ",
+                                  ctx->input(i).shape().DebugString()));
+      out_shape = broadcast;
+    }
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, out_shape, &output));
+    const int64 total = out_shape.num_elements();
+    if (total == 0) return;
+
+    // Broadcast inputs are gathered with per-dimension strides into the
+    // output's index space (stride 0 along broadcast dimensions).
+    const int rank = out_shape.dims();
+    gtl::InlinedVector<int64, 8> out_dims(rank);
+    for (int d = 0; d < rank; ++d) out_dims[d] = out_shape.dim_size(d);
+    std::vector<InputLayout> layouts(num_inputs);
+    std::vector<gtl::InlinedVector<int64, 8>> strides(num_inputs);
+    int num_broadcast = 0;
+    for (int i = 0; i < num_inputs; ++i) {
+      const TensorShape& shape = ctx->input(i).shape();
+      if (shape.num_elements() == total) {
+        layouts[i] = InputLayout::kDense;
+      } else if (shape.num_elements() == 1) {
+        layouts[i] = InputLayout::kScalar;
+      } else {
+        layouts[i] = InputLayout::kBroadcast;
+        ++num_broadcast;
+        strides[i].resize(rank, 0);
+        int64 stride = 1;
+        for (int d = shape.dims() - 1; d >= 0; --d) {
+          const int out_d = rank - shape.dims() + d;
+          if (shape.dim_size(d) != 1) strides[i][out_d] = stride;
+          stride *= shape.dim_size(d);
+        }
+      }
+    }
+
+    T* out = output->flat<T>().data();
+    auto eval_blocks = [&](int64 start_block, int64 limit_block) {
+      std::vector<T> scratch(num_broadcast > 0 ? kBlockSize : 0);
+      for (int64 b = start_block; b < limit_block; ++b) {
+        const int64 begin = b * kBlockSize;
+        const int64 size = std::min(kBlockSize, total - begin);
+        Block acc(out + begin, size);
+        Load(ctx, layouts, strides, out_dims, 0, begin, size, acc.data());
+        for (const FusedStep& step : steps_) {
+          if (step.operand < 0) {
+            ApplyUnary(step.opcode, &acc);
+            continue;
+          }
+          const Tensor& in = ctx->input(step.operand);
+          switch (layouts[step.operand]) {
+            case InputLayout::kDense:
+              ApplyBinary(step, ConstBlock(in.flat<T>().data() + begin, size),
+                          &acc);
+              break;
+            case InputLayout::kScalar:
+              ApplyBinary(step, Array::Constant(size, in.flat<T>()(0)), &acc);
+              break;
+            case InputLayout::kBroadcast:
+              Load(ctx, layouts, strides, out_dims, step.operand, begin, size,
+                   scratch.data());
+              ApplyBinary(step, ConstBlock(scratch.data(), size), &acc);
+              break;
+          }
+        }
+      }
+    };
+
+    // Transcendentals dominate the per-element cost when present.
+    int64 cost_per_element = 0;
+    for (const FusedStep& step : steps_) {
+      cost_per_element +=
+          step.opcode >= FusedElementwiseOpcode::kSqrt ? 20 : 1;
+    }
+    const int64 num_blocks = (total + kBlockSize - 1) / kBlockSize;
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_blocks,
+          cost_per_element * kBlockSize, eval_blocks);
+  }
+
+ private:
+  // Copies elements [begin, begin + size) of input 'i', broadcast to the
+  // output shape, into 'dst'.
+  static void Load(OpKernelContext* ctx,
+                   const std::vector<InputLayout>& layouts,
+                   const std::vector<gtl::InlinedVector<int64, 8>>& strides,
+                   const gtl::InlinedVector<int64, 8>& out_dims, int i,
+                   int64 begin, int64 size, T* dst) {
+    const T* src = ctx->input(i).flat<T>().data();
+    switch (layouts[i]) {
+      case InputLayout::kDense:
+        std::copy(src + begin, src + begin + size, dst);
+        return;
+      case InputLayout::kScalar:
+        std::fill(dst, dst + size, src[0]);
+        return;
+      case InputLayout::kBroadcast:
+        break;
+    }
+    // Decompose 'begin' into an output coordinate, then walk it like an
+    // odometer so each element costs one add in the common case.
+    const int rank = out_dims.size();
+    const gtl::InlinedVector<int64, 8>& stride = strides[i];
+    gtl::InlinedVector<int64, 8> coord(rank);
+    int64 offset = 0;
+    int64 rem = begin;
+    for (int d = rank - 1; d >= 0; --d) {
+      coord[d] = rem % out_dims[d];
+      rem /= out_dims[d];
+      offset += coord[d] * stride[d];
+    }
+    for (int64 k = 0; k < size; ++k) {
+      dst[k] = src[offset];
+      for (int d = rank - 1; d >= 0; --d) {
+        offset += stride[d];
+        if (++coord[d] < out_dims[d]) break;
+        offset -= coord[d] * stride[d];
+        coord[d] = 0;
+      }
+    }
+  }
+
+  static void ApplyUnary(FusedElementwiseOpcode opcode, Block* acc) {
+#define FUSED_UNARY_CASE(OPCODE, FUNCTOR)                        \
+  case FusedElementwiseOpcode::OPCODE:                           \
+    *acc = acc->unaryExpr(typename functor::FUNCTOR<T>::func()); \
+    break;
+    switch (opcode) {
+      FUSED_UNARY_CASE(kNeg, neg)
+      FUSED_UNARY_CASE(kAbs, abs)
+      FUSED_UNARY_CASE(kSquare, square)
+      FUSED_UNARY_CASE(kSqrt, sqrt)
+      FUSED_UNARY_CASE(kRsqrt, rsqrt)
+      FUSED_UNARY_CASE(kExp, exp)
+      FUSED_UNARY_CASE(kLog, log)
+      FUSED_UNARY_CASE(kTanh, tanh)
+      FUSED_UNARY_CASE(kSigmoid, sigmoid)
+      FUSED_UNARY_CASE(kReciprocal, inverse)
+      default:
+        LOG(FATAL) << "Not a unary fused op";
+    }
+#undef FUSED_UNARY_CASE
+  }
+
+  template <typename Rhs>
+  static void ApplyBinary(const FusedStep& step, const Rhs& rhs, Block* acc) {
+#define FUSED_BINARY_CASE(OPCODE, FUNCTOR)                               \
+  case FusedElementwiseOpcode::OPCODE:                                   \
+    if (step.swap) {                                                     \
+      *acc = rhs.binaryExpr(*acc, typename functor::FUNCTOR<T>::func()); \
+    } else {                                                             \
+      *acc = acc->binaryExpr(rhs, typename functor::FUNCTOR<T>::func()); \
+    }                                                                    \
+    break;
+    switch (step.opcode) {
+      FUSED_BINARY_CASE(kAdd, add)
+      FUSED_BINARY_CASE(kSub, sub)
+      FUSED_BINARY_CASE(kMul, mul)
+      FUSED_BINARY_CASE(kDiv, div)
+      FUSED_BINARY_CASE(kMaximum, maximum)
+      FUSED_BINARY_CASE(kMinimum, minimum)
+      FUSED_BINARY_CASE(kSquaredDifference, squared_difference)
+      default:
+        LOG(FATAL) << "Not a binary fused op";
+    }
+#undef FUSED_BINARY_CASE
+  }
+
+  std::vector<FusedStep> steps_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FusedElementwiseOp);
+};
+
+#define REGISTER_KERNEL(type)                                    \
+  REGISTER_KERNEL_BUILDER(Name("_FusedElementwise")              \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<type>("T"),        \
+                          FusedElementwiseOp<type>);
+
+TF_CALL_float(REGISTER_KERNEL);
+TF_CALL_double(REGISTER_KERNEL);
+#undef REGISTER_KERNEL
+
+}  // namespace tensorflow
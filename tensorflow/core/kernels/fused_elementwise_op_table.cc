@@ -0,0 +1,53 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/fused_elementwise_op_table.h"
+
+namespace tensorflow {
+
+namespace {
+
+const FusedElementwiseOpInfo kFusedElementwiseOps[] = {
+    {"Add", 2, FusedElementwiseOpcode::kAdd},
+    {"Sub", 2, FusedElementwiseOpcode::kSub},
+    {"Mul", 2, FusedElementwiseOpcode::kMul},
+    {"Div", 2, FusedElementwiseOpcode::kDiv},
+    {"RealDiv", 2, FusedElementwiseOpcode::kDiv},
+    {"Maximum", 2, FusedElementwiseOpcode::kMaximum},
+    {"Minimum", 2, FusedElementwiseOpcode::kMinimum},
+    {"SquaredDifference", 2, FusedElementwiseOpcode::kSquaredDifference},
+    {"Neg", 1, FusedElementwiseOpcode::kNeg},
+    {"Abs", 1, FusedElementwiseOpcode::kAbs},
+    {"Square", 1, FusedElementwiseOpcode::kSquare},
+    {"Sqrt", 1, FusedElementwiseOpcode::kSqrt},
+    {"Rsqrt", 1, FusedElementwiseOpcode::kRsqrt},
+    {"Exp", 1, FusedElementwiseOpcode::kExp},
+    {"Log", 1, FusedElementwiseOpcode::kLog},
+    {"Tanh", 1, FusedElementwiseOpcode::kTanh},
+    {"Sigmoid", 1, FusedElementwiseOpcode::kSigmoid},
+    {"Reciprocal", 1, FusedElementwiseOpcode::kReciprocal},
+    {"Inv", 1, FusedElementwiseOpcode::kReciprocal},
+};
+
+}  // namespace
+
+const FusedElementwiseOpInfo* LookupFusedElementwiseOp(StringPiece op_name) {
+  for (const FusedElementwiseOpInfo& info : kFusedElementwiseOps) {
+    if (op_name == info.name) return &info;
+  }
+  return nullptr;
+}
+
+}  // namespace tensorflow
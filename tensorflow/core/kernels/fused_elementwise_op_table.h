@@ -0,0 +1,59 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_FUSED_ELEMENTWISE_OP_TABLE_H_
+#define TENSORFLOW_KERNELS_FUSED_ELEMENTWISE_OP_TABLE_H_
+
+#include "tensorflow/core/lib/core/stringpiece.h"
+
+namespace tensorflow {
+
+// The steps a _FusedElementwise kernel knows how to evaluate.  Unary
+// transcendentals start at kSqrt; the kernel's cost model relies on that.
+enum class FusedElementwiseOpcode {
+  kAdd,
+  kSub,
+  kMul,
+  kDiv,
+  kMaximum,
+  kMinimum,
+  kSquaredDifference,
+  kNeg,
+  kAbs,
+  kSquare,
+  kSqrt,
+  kRsqrt,
+  kExp,
+  kLog,
+  kTanh,
+  kSigmoid,
+  kReciprocal,
+};
+
+struct FusedElementwiseOpInfo {
+  const char* name;  // The op that this step replaces, e.g. "Add".
+  int arity;         // 1 or 2.
+  FusedElementwiseOpcode opcode;
+};
+
+// Returns the entry for op 'op_name' if ElementwiseFusionPass may fold it
+// into a _FusedElementwise node, or nullptr otherwise.  The pass and the
+// kernel both use this table, so every op the pass fuses is one the kernel
+// can run.
+const FusedElementwiseOpInfo* LookupFusedElementwiseOp(StringPiece op_name);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_FUSED_ELEMENTWISE_OP_TABLE_H_
@@ -0,0 +1,166 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedElementwiseOpTest : public OpsTestBase {
+ protected:
+  Status Init(int num_inputs, const std::vector<string>& ops,
+              const std::vector<int>& operands,
+              const std::vector<bool>& swap) {
+    TF_CHECK_OK(NodeDefBuilder("fused", "_FusedElementwise")
+                    .Input(FakeInput(num_inputs, DT_FLOAT))
+                    .Attr("ops", ops)
+                    .Attr("operands", operands)
+                    .Attr("swap", swap)
+                    .Finalize(node_def()));
+    return InitOp();
+  }
+};
+
+float Sigmoid(float x) { return 1.0f / (1.0f + std::exp(-x)); }
+
+TEST_F(FusedElementwiseOpTest, Chain) {
+  // sigmoid(z + x * y) * y
+  TF_ASSERT_OK(Init(4, {"Mul", "Add", "Sigmoid", "Mul"}, {1, 2, -1, 3},
+                    {false, true, false, false}));
+  AddInputFromArray<float>(TensorShape({4}), {1, 2, 3, 4});
+  AddInputFromArray<float>(TensorShape({4}), {0.5, -1, 0, 2});
+  AddInputFromArray<float>(TensorShape({4}), {1, 1, -1, -1});
+  AddInputFromArray<float>(TensorShape({4}), {0.5, -1, 0, 2});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({4}));
+  test::FillValues<float>(&expected,
+                          {Sigmoid(1.5f) * 0.5f, Sigmoid(-1.0f) * -1.0f,
+                           Sigmoid(-1.0f) * 0.0f, Sigmoid(7.0f) * 2.0f});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedElementwiseOpTest, SwappedOperands) {
+  // 10 - (x / 2)
+  TF_ASSERT_OK(Init(3, {"Div", "Sub"}, {1, 2}, {false, true}));
+  AddInputFromArray<float>(TensorShape({3}), {2, 4, 6});
+  AddInputFromArray<float>(TensorShape({}), {2});
+  AddInputFromArray<float>(TensorShape({}), {10});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3}));
+  test::FillValues<float>(&expected, {9, 8, 7});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedElementwiseOpTest, Broadcast) {
+  // -(row + col) with row: [1, 3] and col: [2, 1]; both inputs broadcast.
+  TF_ASSERT_OK(Init(2, {"Add", "Neg"}, {1, -1}, {false, false}));
+  AddInputFromArray<float>(TensorShape({1, 3}), {1, 2, 3});
+  AddInputFromArray<float>(TensorShape({2, 1}), {10, 20});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 3}));
+  test::FillValues<float>(&expected, {-11, -12, -13, -21, -22, -23});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedElementwiseOpTest, BroadcastAcrossBlocks) {
+  // A suffix-broadcast operand over an output larger than one block.
+  const int rows = 37, cols = 100;
+  TF_ASSERT_OK(Init(2, {"Mul"}, {1}, {false}));
+  std::vector<float> x(rows * cols), bias(cols);
+  for (int i = 0; i < rows * cols; ++i) x[i] = i;
+  for (int j = 0; j < cols; ++j) bias[j] = j % 7;
+  AddInputFromArray<float>(TensorShape({rows, cols}), x);
+  AddInputFromArray<float>(TensorShape({cols}), bias);
+  TF_ASSERT_OK(RunOpKernel());
+  auto out = GetOutput(0)->matrix<float>();
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      EXPECT_EQ(out(i, j), x[i * cols + j] * bias[j]);
+    }
+  }
+}
+
+TEST_F(FusedElementwiseOpTest, IncompatibleShapes) {
+  TF_ASSERT_OK(Init(2, {"Add"}, {1}, {false}));
+  AddInputFromArray<float>(TensorShape({3}), {1, 2, 3});
+  AddInputFromArray<float>(TensorShape({2}), {1, 2});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.ToString()).contains("Incompatible shapes"))
+      << s;
+}
+
+TEST_F(FusedElementwiseOpTest, UnsupportedOp) {
+  Status s = Init(1, {"MatMul"}, {-1}, {false});
+  EXPECT_TRUE(StringPiece(s.ToString()).contains("Unsupported fused op"))
+      << s;
+}
+
+// sigmoid(x * w + b) * x, evaluated either as four cwise kernels or as one
+// fused kernel.
+static Graph* GatedActivation(int num, bool fused) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor x(DT_FLOAT, TensorShape({num}));
+  Tensor w(DT_FLOAT, TensorShape({num}));
+  Tensor b(DT_FLOAT, TensorShape({}));
+  x.flat<float>().setRandom();
+  w.flat<float>().setRandom();
+  b.scalar<float>()() = 0.5f;
+  Node* xn = test::graph::Constant(g, x);
+  Node* wn = test::graph::Constant(g, w);
+  Node* bn = test::graph::Constant(g, b);
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "_FusedElementwise")
+                    .Input({xn, wn, bn, xn})
+                    .Attr("ops", {"Mul", "Add", "Sigmoid", "Mul"})
+                    .Attr("operands", {1, 2, -1, 3})
+                    .Attr("swap", {false, false, false, false})
+                    .Finalize(g, nullptr));
+  } else {
+    Node* n = test::graph::Binary(g, "Mul", xn, wn);
+    n = test::graph::Binary(g, "Add", n, bn);
+    n = test::graph::Unary(g, "Sigmoid", n);
+    test::graph::Binary(g, "Mul", n, xn);
+  }
+  return g;
+}
+
+static void BM_GatedActivation(int iters, int num, bool fused) {
+  testing::ItemsProcessed(static_cast<int64>(iters) * num);
+  testing::BytesProcessed(static_cast<int64>(iters) * num * sizeof(float));
+  test::Benchmark("cpu", GatedActivation(num, fused)).Run(iters);
+}
+
+static void BM_GatedActivation_Unfused(int iters, int num) {
+  BM_GatedActivation(iters, num, false);
+}
+static void BM_GatedActivation_Fused(int iters, int num) {
+  BM_GatedActivation(iters, num, true);
+}
+BENCHMARK(BM_GatedActivation_Unfused)->Range(4 << 10, 16 << 20);
+BENCHMARK(BM_GatedActivation_Fused)->Range(4 << 10, 16 << 20);
+
+}  // namespace
+}  // namespace tensorflow
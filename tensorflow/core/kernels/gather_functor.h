@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_KERNELS_GATHER_FUNCTOR_H_
 #define TENSORFLOW_KERNELS_GATHER_FUNCTOR_H_
 
+#include <atomic>
+
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 
 #include "tensorflow/core/framework/tensor_types.h"
@@ -29,15 +31,23 @@ typedef Eigen::ThreadPoolDevice CPUDevice;
 
 namespace functor {
 
-// Helper method to copy using memcpy.
+// Rows ahead of the one being copied whose params are prefetched.  When the
+// table is much larger than the last level cache every row is a DRAM miss, so
+// the prefetch has to be issued several rows early to overlap the misses.
+constexpr int kGatherPrefetchDistance = 8;
+
+// Bytes prefetched from the start of each upcoming row.  Longer rows are
+// streamed by the hardware prefetcher once their copy starts.
+constexpr int kGatherPrefetchBytes = 256;
+
+// Helper method to copy using memcpy.  Copies rows [begin, end) of 'out', and
+// returns the first i in that range whose index is out of bounds, or -1.
 template <typename T, typename Index, typename SliceIndex,
           SliceIndex static_slice_elems>
 SliceIndex HandleCopies(typename TTypes<T>::ConstMatrix params,
                         typename TTypes<Index>::ConstFlat indices,
-                        SliceIndex slice_elems,
-                        typename TTypes<T>::Matrix out) {
-  const SliceIndex first_dim_size =
-      static_cast<SliceIndex>(indices.dimension(0));
+                        SliceIndex slice_elems, SliceIndex begin,
+                        SliceIndex end, typename TTypes<T>::Matrix out) {
   const Index limit = static_cast<Index>(params.dimension(0));
   T* out_base = &out(0, 0);
   const T* params_base = &params(0, 0);
@@ -47,11 +57,28 @@ SliceIndex HandleCopies(typename TTypes<T>::ConstMatrix params,
   }
   // Compute slice_bytes here so that static knowledge is available
   const size_t slice_bytes = slice_elems * sizeof(T);
-  for (SliceIndex i = 0; i < first_dim_size; i++) {
-    const SliceIndex j = i + 1;
-    if (j < first_dim_size) {
-      port::prefetch<port::PREFETCH_HINT_T0>(&params(indices(j), 0));
-      port::prefetch<port::PREFETCH_HINT_T0>(&out(j, 0));
+  const size_t prefetch_bytes = slice_bytes < kGatherPrefetchBytes
+                                    ? slice_bytes
+                                    : kGatherPrefetchBytes;
+  auto prefetch_row = [&](SliceIndex i) {
+    const Index index = indices(i);
+    if (!FastBoundsCheck(index, limit)) return;
+    const char* row =
+        reinterpret_cast<const char*>(params_base + index * slice_elems);
+    for (size_t b = 0; b < prefetch_bytes; b += 64) {
+      port::prefetch<port::PREFETCH_HINT_T0>(row + b);
+    }
+  };
+  for (SliceIndex i = begin; i < end && i < begin + kGatherPrefetchDistance;
+       i++) {
+    prefetch_row(i);
+  }
+  for (SliceIndex i = begin; i < end; i++) {
+    if (i + kGatherPrefetchDistance < end) {
+      prefetch_row(i + kGatherPrefetchDistance);
+    }
+    if (i + 1 < end) {
+      port::prefetch<port::PREFETCH_HINT_T0>(&out(i + 1, 0));
     }
     // Grab the index and check its validity.  An earlier version of the
     // code checked it and then grabbed it from memory a second time, which
@@ -76,6 +103,14 @@ struct GatherFunctorCPU {
   int64 operator()(typename TTypes<T>::ConstMatrix params,
                    typename TTypes<Index>::ConstFlat indices,
                    typename TTypes<T>::Matrix out) {
+    return Run(params, indices, out, 0, indices.size());
+  }
+
+  // Gathers rows [begin, end) of 'out' only, so that disjoint ranges can be
+  // copied by different threads.
+  static int64 Run(typename TTypes<T>::ConstMatrix params,
+                   typename TTypes<Index>::ConstFlat indices,
+                   typename TTypes<T>::Matrix out, int64 begin, int64 end) {
     const int64 N = indices.size();
     const int64 slice_size = out.size() / N;
     int64 bad_i;
@@ -83,22 +118,32 @@ struct GatherFunctorCPU {
     bool use_large = (slice_size > std::numeric_limits<int32>::max() ||
                       params.size() > std::numeric_limits<int32>::max() ||
                       N > std::numeric_limits<int32>::max());
-#define CALL(elems)                                                   \
-  do {                                                                \
-    if (use_large) {                                                  \
-      bad_i = HandleCopies<T, Index, int64, elems>(params, indices,   \
-                                                   slice_size, out);  \
-    } else {                                                          \
-      const int32 small_slice = static_cast<int32>(slice_size);       \
-      bad_i = HandleCopies<T, Index, int32, elems>(params, indices,   \
-                                                   small_slice, out); \
-    }                                                                 \
+#define CALL(elems)                                                      \
+  do {                                                                   \
+    if (use_large) {                                                     \
+      bad_i = HandleCopies<T, Index, int64, elems>(params, indices,      \
+                                                   slice_size, begin,    \
+                                                   end, out);            \
+    } else {                                                             \
+      const int32 small_slice = static_cast<int32>(slice_size);          \
+      bad_i = HandleCopies<T, Index, int32, elems>(                      \
+          params, indices, small_slice, static_cast<int32>(begin),       \
+          static_cast<int32>(end), out);                                 \
+    }                                                                    \
   } while (0)
 
-    if (slice_size == 10)
+    // Common small slices get a copy of static size, which the compiler
+    // inlines instead of calling memcpy for every row.
+    if (slice_size == 1)
+      CALL(1);
+    else if (slice_size == 10)
       CALL(10);
     else if (slice_size == 20)
       CALL(20);
+    else if (slice_size == 32)
+      CALL(32);
+    else if (slice_size == 64)
+      CALL(64);
     else
       CALL(-1);
 #undef CALL
@@ -107,6 +152,34 @@ struct GatherFunctorCPU {
   }
 };
 
+// Gathers on the threads of 'd', each thread copying a contiguous range of
+// 'out'.  Like the serial version, returns the first out-of-bounds position
+// of 'indices', or -1.  Templated on the device so that this header still
+// compiles where Eigen's thread pool device is not defined (e.g. by nvcc).
+template <typename Device, typename T, typename Index>
+int64 GatherFunctorParallel(const Device& d,
+                            typename TTypes<T>::ConstMatrix params,
+                            typename TTypes<Index>::ConstFlat indices,
+                            typename TTypes<T>::Matrix out) {
+  const int64 N = indices.size();
+  const double slice_bytes = static_cast<double>(out.size() / N) * sizeof(T);
+  std::atomic<int64> bad_i(-1);
+  auto work = [&params, &indices, &out, &bad_i](int64 begin, int64 end) {
+    const int64 i =
+        GatherFunctorCPU<T, Index>::Run(params, indices, out, begin, end);
+    if (i < 0) return;
+    int64 prev = bad_i.load();
+    while ((prev < 0 || i < prev) && !bad_i.compare_exchange_weak(prev, i)) {
+    }
+  };
+  // On top of the bytes copied, a row of a large table costs a DRAM miss of
+  // a few hundred cycles, so even tiny slices are worth spreading out.
+  d.parallelFor(
+      N, Eigen::TensorOpCost(slice_bytes + sizeof(Index), slice_bytes, 200),
+      work);
+  return bad_i.load();
+}
+
 template <typename Device, typename T, typename Index>
 struct GatherFunctor {
   int64 operator()(const Device& d, typename TTypes<T>::ConstMatrix params,
@@ -119,7 +192,7 @@ struct GatherFunctor<CPUDevice, T, Index> {
   int64 operator()(const CPUDevice& d, typename TTypes<T>::ConstMatrix params,
                    typename TTypes<Index>::ConstFlat indices,
                    typename TTypes<T>::Matrix out) {
-    return GatherFunctorCPU<T, Index>()(params, indices, out);
+    return GatherFunctorParallel<CPUDevice, T, Index>(d, params, indices, out);
   }
 };
 
@@ -133,23 +133,65 @@ TEST_F(GatherOpTest, Error_IndexOutOfRange) {
       << s;
 }
 
+TEST_F(GatherOpTest, ManyIndices) {
+  MakeOp(DT_INT32);
+
+  // Enough rows to be split across threads.
+  const int kRows = 1000;
+  const int kDim = 10;
+  const int kNumIndices = 50000;
+  std::vector<float> params(kRows * kDim);
+  for (int i = 0; i < kRows * kDim; ++i) params[i] = i;
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int32> indices(kNumIndices);
+  for (int32& i : indices) i = rnd.Uniform(kRows);
+  AddInputFromArray<float>(TensorShape({kRows, kDim}), params);
+  AddInputFromArray<int32>(TensorShape({kNumIndices}), indices);
+  TF_ASSERT_OK(RunOpKernel());
+
+  auto out = GetOutput(0)->matrix<float>();
+  for (int i = 0; i < kNumIndices; ++i) {
+    for (int j = 0; j < kDim; ++j) {
+      ASSERT_EQ(out(i, j), params[indices[i] * kDim + j]);
+    }
+  }
+}
+
+TEST_F(GatherOpTest, Error_FirstIndexOutOfRangeIsReported) {
+  MakeOp(DT_INT32);
+
+  // Several bad indices far apart; the first one is reported no matter how
+  // the work is split.
+  const int kNumIndices = 50000;
+  std::vector<int32> indices(kNumIndices, 1);
+  indices[30000] = 7;
+  indices[45000] = -1;
+  AddInputFromArray<float>(TensorShape({5}), {0, 1, 2, 3, 4});
+  AddInputFromArray<int32>(TensorShape({kNumIndices}), indices);
+  Status s = RunOpKernel();
+  EXPECT_TRUE(
+      StringPiece(s.ToString()).contains("indices[30000] = 7 is not in [0, 5)"))
+      << s;
+}
+
 constexpr int kLookups = 2000;
 
 template <typename Index>
-static Graph* Gather(int dim) {
+static Graph* Gather(int table_mb, int dim, int num_lookups) {
   Graph* g = new Graph(OpRegistry::Global());
-  // Always use a 512MB buffer.
-  const int kRows = ((512 << 20) / sizeof(float)) / dim;
+  const int kRows =
+      ((static_cast<int64>(table_mb) << 20) / sizeof(float)) / dim;
   Tensor params(DT_FLOAT, TensorShape({kRows, dim}));
   params.flat<float>().setRandom();
 
   random::PhiloxRandom philox(301, 17);
   random::SimplePhilox rnd(&philox);
   std::vector<Index> indices_vec;
-  for (int i = 0; i < kLookups; i++) {
+  for (int i = 0; i < num_lookups; i++) {
     indices_vec.push_back(rnd.Uniform(kRows));
   }
-  Tensor indices(DataTypeToEnum<Index>::value, TensorShape({kLookups}));
+  Tensor indices(DataTypeToEnum<Index>::value, TensorShape({num_lookups}));
   for (int i = 0; i < indices_vec.size(); i++) {
     indices.flat<Index>()(i) = indices_vec[i];
   }
@@ -165,7 +207,8 @@ static Graph* Gather(int dim) {
     testing::ItemsProcessed(tot);                                 \
     testing::BytesProcessed(tot * sizeof(float));                 \
     testing::UseRealTime();                                       \
-    test::Benchmark(#DEVICE, Gather<INDEX>(dim)).Run(iters);      \
+    test::Benchmark(#DEVICE, Gather<INDEX>(512, dim, kLookups))   \
+        .Run(iters);                                              \
   }                                                               \
   BENCHMARK(BM_##DEVICE##_gather_##INDEX)                         \
       ->Arg(1)                                                    \
@@ -181,5 +224,27 @@ BM_GATHER(gpu, int32);
 BM_GATHER(cpu, int64);
 BM_GATHER(gpu, int64);
 
+// Embedding style lookups: many rows out of tables from well inside to far
+// beyond the last level cache.  Arg pairs are (table size in MB, row size).
+static void BM_cpu_gather_embedding(int iters, int table_mb, int dim) {
+  const int kNumLookups = 100000;
+  const int64 tot = static_cast<int64>(iters) * kNumLookups * dim;
+  testing::ItemsProcessed(tot);
+  testing::BytesProcessed(tot * sizeof(float));
+  testing::UseRealTime();
+  test::Benchmark("cpu", Gather<int32>(table_mb, dim, kNumLookups))
+      .Run(iters);
+}
+BENCHMARK(BM_cpu_gather_embedding)
+    ->ArgPair(4, 1)
+    ->ArgPair(4, 32)
+    ->ArgPair(4, 256)
+    ->ArgPair(256, 1)
+    ->ArgPair(256, 32)
+    ->ArgPair(256, 256)
+    ->ArgPair(2048, 1)
+    ->ArgPair(2048, 32)
+    ->ArgPair(2048, 256);
+
 }  // namespace
 }  // namespace tensorflow
@@ -334,6 +334,24 @@ struct TensorEvaluator<const TensorMirrorPadOp<PaddingDimensions, ArgType>,
 namespace tensorflow {
 namespace functor {
 
+namespace internal {
+
+// Pads by copying contiguous blocks instead of evaluating TensorMirrorPadOp,
+// which computes a mirrored index for every element.  Only the CPU has an
+// implementation (see mirror_pad_op_cpu_impl.h); Run() returns false if the
+// expression should be evaluated instead.
+template <typename Device, typename T, int Dims>
+struct MirrorPadUsingCopies {
+  static bool Run(const Device& device,
+                  typename TTypes<T, Dims, int32>::Tensor output,
+                  typename TTypes<T, Dims, int32>::ConstTensor input,
+                  TTypes<int32>::ConstMatrix padding, int offset) {
+    return false;
+  }
+};
+
+}  // namespace internal
+
 // offset argument must be either 0 or 1. This controls whether the boundary
 // values are replicated (offset == 0) or not replicated (offset == 1).
 template <typename Device, typename T, int Dims>
@@ -342,6 +360,10 @@ struct MirrorPad {
                   typename TTypes<T, Dims, int32>::Tensor output,
                   typename TTypes<T, Dims, int32>::ConstTensor input,
                   TTypes<int32>::ConstMatrix padding, int offset) {
+    if (internal::MirrorPadUsingCopies<Device, T, Dims>::Run(
+            device, output, input, padding, offset)) {
+      return;
+    }
     Eigen::array<Eigen::IndexPair<int32>, Dims> padding_dims;
 
     for (int i = 0; i < Dims; ++i) {
@@ -18,6 +18,8 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
+
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/kernels/mirror_pad_op.h"
 
@@ -25,6 +27,120 @@ namespace tensorflow {
 
 using CpuDevice = Eigen::ThreadPoolDevice;
 
+namespace functor {
+namespace internal {
+
+// Runs of fewer contiguous input elements than this are left to Eigen.
+constexpr int64 kMirrorPadMinCopyRun = 16;
+// Pad blocks smaller than this are filled a slab at a time; larger ones are
+// copied in parallel, one block per task.
+constexpr int64 kMirrorPadParallelCopyBytes = 16 << 10;
+
+template <typename T, int Dims>
+struct MirrorPadUsingCopies<CpuDevice, T, Dims> {
+  static bool Run(const CpuDevice& device,
+                  typename TTypes<T, Dims, int32>::Tensor output,
+                  typename TTypes<T, Dims, int32>::ConstTensor input,
+                  TTypes<int32>::ConstMatrix padding, int offset) {
+    if (output.size() == 0) return true;
+    // Dimensions after the last padded one are copied whole.
+    int last = Dims - 1;
+    while (last > 0 && padding(last, 0) == 0 && padding(last, 1) == 0) {
+      --last;
+    }
+    int64 in_dims[Dims];
+    int64 out_strides[Dims];
+    int64 stride = 1;
+    for (int i = Dims - 1; i >= 0; --i) {
+      in_dims[i] = input.dimension(i);
+      out_strides[i] = stride;
+      stride *= output.dimension(i);
+    }
+    const int64 run = in_dims[last] * out_strides[last];
+    if (run < kMirrorPadMinCopyRun) return false;
+
+    const T* src = input.data();
+    T* dst = output.data();
+    // Output offset of the start of dimension 'dim' for the input elements
+    // whose coordinates in dimensions [0, dim) are those of 'outer'.
+    auto outer_offset = [&in_dims, &out_strides, padding](int64 outer,
+                                                          int dim) {
+      int64 offset = 0;
+      for (int i = dim - 1; i >= 0; --i) {
+        offset += (outer % in_dims[i] + padding(i, 0)) * out_strides[i];
+        outer /= in_dims[i];
+      }
+      return offset;
+    };
+
+    // Copy the input into the interior of the output, one run at a time.
+    const int64 num_runs = input.size() / run;
+    const int64 run_offset = padding(last, 0) * out_strides[last];
+    const double run_bytes = run * sizeof(T);
+    device.parallelFor(
+        num_runs, Eigen::TensorOpCost(run_bytes, run_bytes, 0),
+        [src, dst, run, run_offset, last, &outer_offset](int64 first,
+                                                         int64 end) {
+          for (int64 r = first; r < end; ++r) {
+            std::copy(src + r * run, src + (r + 1) * run,
+                      dst + outer_offset(r, last) + run_offset);
+          }
+        });
+
+    // Then mirror the padded dimensions from the innermost out.  By the time
+    // dimension 'dim' is mirrored, the dimensions after it are complete, so
+    // every pad position is filled by copying the contiguous block of one
+    // interior position.
+    int64 num_slabs = num_runs;
+    for (int dim = last; dim >= 0; --dim) {
+      const int64 left = padding(dim, 0);
+      const int64 num_pads = left + padding(dim, 1);
+      const int64 n = in_dims[dim];
+      const int64 block = out_strides[dim];
+      // Fills pad position 'p' of the slab starting at 'base'.
+      auto fill = [left, n, block, offset](T* base, int64 p) {
+        const int64 target = p < left ? left - 1 - p : n + p;
+        const int64 source =
+            p < left ? left + p + offset : 2 * left + n - 1 - p - offset;
+        std::copy(base + source * block, base + (source + 1) * block,
+                  base + target * block);
+      };
+      const double block_bytes = block * sizeof(T);
+      if (num_pads > 0 && block_bytes < kMirrorPadParallelCopyBytes) {
+        device.parallelFor(
+            num_slabs,
+            Eigen::TensorOpCost(block_bytes * num_pads,
+                                block_bytes * num_pads, 0),
+            [dst, dim, num_pads, &fill, &outer_offset](int64 first,
+                                                       int64 end) {
+              for (int64 s = first; s < end; ++s) {
+                T* base = dst + outer_offset(s, dim);
+                for (int64 p = 0; p < num_pads; ++p) fill(base, p);
+              }
+            });
+      } else if (num_pads > 0) {
+        device.parallelFor(
+            num_slabs * num_pads,
+            Eigen::TensorOpCost(block_bytes, block_bytes, 0),
+            [dst, dim, num_pads, &fill, &outer_offset](int64 first,
+                                                       int64 end) {
+              for (int64 u = first; u < end; ++u) {
+                fill(dst + outer_offset(u / num_pads, dim), u % num_pads);
+              }
+            });
+      }
+      if (dim > 0) num_slabs /= in_dims[dim - 1];
+    }
+    return true;
+  }
+};
+
+}  // namespace internal
+}  // namespace functor
+
+// Tests include this header for the specialization above alone; the functors
+// are instantiated once per dimension by mirror_pad_op_cpu_impl_*.cc.
+#ifdef CPU_PROVIDED_IXDIM
 #define DEFINE_CPU_SPECS(T) \
   template struct functor::MirrorPad<CpuDevice, T, CPU_PROVIDED_IXDIM>;
 TF_CALL_POD_TYPES(DEFINE_CPU_SPECS);
@@ -34,6 +150,7 @@ TF_CALL_POD_TYPES(DEFINE_CPU_SPECS);
   template struct functor::MirrorPadGrad<CpuDevice, T, CPU_PROVIDED_IXDIM>;
 TF_CALL_NUMBER_TYPES(DEFINE_CPU_SPECS);
 #undef DEFINE_CPU_SPECS
+#endif  // CPU_PROVIDED_IXDIM
 
 }  // namespace tensorflow
 
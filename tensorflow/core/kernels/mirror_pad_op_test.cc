@@ -0,0 +1,162 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include "tensorflow/core/kernels/mirror_pad_op_cpu_impl.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/common_runtime/eigen_thread_pool.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+typedef functor::MirrorPad<CpuDevice, float, 4> MirrorPadFunctor;
+
+// Pads 'in' with either the MirrorPad functor or the TensorMirrorPadOp
+// expression it used to evaluate unconditionally.
+void MirrorPad(const CpuDevice& d, const Tensor& in, const Tensor& paddings,
+               int offset, bool use_functor, Tensor* out) {
+  auto output = To32Bit(out->tensor<float, 4>());
+  auto input = To32Bit(in.tensor<float, 4>());
+  TTypes<int32>::ConstMatrix padding = paddings.matrix<int32>();
+  if (use_functor) {
+    MirrorPadFunctor()(d, output, input, padding, offset);
+  } else {
+    Eigen::array<Eigen::IndexPair<int32>, 4> padding_dims;
+    for (int i = 0; i < 4; ++i) {
+      padding_dims[i] = Eigen::IndexPair<int32>(padding(i, 0), padding(i, 1));
+    }
+    output.device(d) =
+        MirrorPadFunctor::MirrorPadOp(input, padding_dims, offset);
+  }
+}
+
+Tensor PaddedTensor(const Tensor& in, const Tensor& paddings) {
+  auto padding = paddings.matrix<int32>();
+  TensorShape shape;
+  for (int i = 0; i < 4; ++i) {
+    shape.AddDim(in.dim_size(i) + padding(i, 0) + padding(i, 1));
+  }
+  return Tensor(DT_FLOAT, shape);
+}
+
+TEST(MirrorPadOpTest, MatchesMirrorPadOp) {
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  EigenThreadPoolWrapper wrapper(&pool);
+  CpuDevice d(&wrapper, 4);
+  random::PhiloxRandom philox(23, 3);
+  random::SimplePhilox rnd(&philox);
+  for (int iter = 0; iter < 200; ++iter) {
+    // Offset 0 is SYMMETRIC mode and offset 1 is REFLECT mode.
+    const int offset = iter % 2;
+    TensorShape shape;
+    Tensor paddings(DT_INT32, TensorShape({4, 2}));
+    auto padding = paddings.matrix<int32>();
+    for (int i = 0; i < 4; ++i) {
+      const int dim = 1 + rnd.Uniform(rnd.OneIn(4) ? 40 : 6);
+      shape.AddDim(dim);
+      padding(i, 0) = rnd.Uniform(dim - offset + 1);
+      padding(i, 1) = rnd.Uniform(dim - offset + 1);
+    }
+    Tensor in(DT_FLOAT, shape);
+    in.flat<float>().setRandom();
+    Tensor expected = PaddedTensor(in, paddings);
+    Tensor actual = PaddedTensor(in, paddings);
+    MirrorPad(d, in, paddings, offset, false, &expected);
+    MirrorPad(d, in, paddings, offset, true, &actual);
+    test::ExpectTensorEqual<float>(expected, actual);
+  }
+}
+
+TEST(MirrorPadOpTest, CopiesLongRuns) {
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  EigenThreadPoolWrapper wrapper(&pool);
+  CpuDevice d(&wrapper, 4);
+  Tensor random_in(DT_FLOAT, TensorShape({2, 6, 5, 8}));
+  random_in.flat<float>().setRandom();
+  const Tensor& in = random_in;
+  // The innermost dimension is not padded, so runs are 5 * 8 elements long.
+  const Tensor paddings =
+      test::AsTensor<int32>({1, 0, 2, 3, 4, 1, 0, 0}, TensorShape({4, 2}));
+  for (int offset = 0; offset < 2; ++offset) {
+    Tensor expected = PaddedTensor(in, paddings);
+    Tensor actual = PaddedTensor(in, paddings);
+    MirrorPad(d, in, paddings, offset, false, &expected);
+    EXPECT_TRUE(
+        (functor::internal::MirrorPadUsingCopies<CpuDevice, float, 4>::Run(
+            d, To32Bit(actual.tensor<float, 4>()),
+            To32Bit(in.tensor<float, 4>()), paddings.matrix<int32>(),
+            offset)));
+    test::ExpectTensorEqual<float>(expected, actual);
+  }
+
+  // Padding the innermost dimension of 3 elements is left to Eigen.
+  const Tensor short_in(DT_FLOAT, TensorShape({4, 4, 4, 3}));
+  const Tensor short_paddings =
+      test::AsTensor<int32>({0, 0, 1, 1, 1, 1, 1, 1}, TensorShape({4, 2}));
+  Tensor short_out = PaddedTensor(short_in, short_paddings);
+  EXPECT_FALSE(
+      (functor::internal::MirrorPadUsingCopies<CpuDevice, float, 4>::Run(
+          d, To32Bit(short_out.tensor<float, 4>()),
+          To32Bit(short_in.tensor<float, 4>()),
+          short_paddings.matrix<int32>(), 0)));
+}
+
+// Typical image and sequence shapes; each entry is the input dimensions
+// followed by the padding on both sides of each dimension.
+const int kMirrorPadCases[][4 + 8] = {
+    {32, 224, 224, 3, 0, 0, 3, 3, 3, 3, 0, 0},   // 7x7 convolution input.
+    {32, 56, 56, 64, 0, 0, 1, 1, 1, 1, 0, 0},    // 3x3 convolution input.
+    {64, 1, 1000, 128, 0, 0, 0, 0, 2, 2, 0, 0},  // Sequence convolution input.
+};
+
+static void BM_MirrorPad(int iters, int index, bool use_functor) {
+  testing::StopTiming();
+  thread::ThreadPool pool(Env::Default(), "bench", port::NumSchedulableCPUs());
+  EigenThreadPoolWrapper wrapper(&pool);
+  CpuDevice d(&wrapper, port::NumSchedulableCPUs());
+  const int* c = kMirrorPadCases[index];
+  Tensor in(DT_FLOAT, TensorShape({c[0], c[1], c[2], c[3]}));
+  in.flat<float>().setRandom();
+  Tensor paddings(DT_INT32, TensorShape({4, 2}));
+  for (int i = 0; i < 8; ++i) paddings.flat<int32>()(i) = c[4 + i];
+  Tensor out = PaddedTensor(in, paddings);
+  testing::BytesProcessed(static_cast<int64>(iters) * out.TotalBytes());
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    MirrorPad(d, in, paddings, 1, use_functor, &out);
+  }
+}
+
+static void BM_MirrorPad_Expression(int iters, int index) {
+  BM_MirrorPad(iters, index, false);
+}
+static void BM_MirrorPad_Functor(int iters, int index) {
+  BM_MirrorPad(iters, index, true);
+}
+BENCHMARK(BM_MirrorPad_Expression)->Arg(0)->Arg(1)->Arg(2);
+BENCHMARK(BM_MirrorPad_Functor)->Arg(0)->Arg(1)->Arg(2);
+
+}  // namespace
+}  // namespace tensorflow
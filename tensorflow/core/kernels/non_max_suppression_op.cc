@@ -19,8 +19,10 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/non_max_suppression_op.h"
 
+#include <algorithm>
 #include <vector>
 
+#include "third_party/eigen3/Eigen/Core"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -31,6 +33,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gtl/stl_util.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -55,40 +58,115 @@ static inline void ParseAndCheckBoxSizes(OpKernelContext* context,
               errors::InvalidArgument("scores has incompatible shape"));
 }
 
-static inline void DecreasingArgSort(const std::vector<float>& values,
-                                     std::vector<int>* indices) {
-  indices->resize(values.size());
-  for (int i = 0; i < values.size(); ++i) (*indices)[i] = i;
-  std::sort(
-      indices->begin(), indices->end(),
-      [&values](const int i, const int j) { return values[i] > values[j]; });
+namespace {
+
+// Selected boxes are checked against a candidate this many at a time, so
+// that a suppressed candidate stops after the block that suppresses it.
+constexpr int kIOUBlockSize = 64;
+
+struct Box {
+  float ymin;
+  float xmin;
+  float ymax;
+  float xmax;
+  float area;
+};
+
+// Reads box i with its corners ordered, since either diagonal pair of
+// corners may be given.
+inline Box GetBox(typename TTypes<float, 2>::ConstTensor boxes, int i) {
+  Box box;
+  box.ymin = std::min<float>(boxes(i, 0), boxes(i, 2));
+  box.xmin = std::min<float>(boxes(i, 1), boxes(i, 3));
+  box.ymax = std::max<float>(boxes(i, 0), boxes(i, 2));
+  box.xmax = std::max<float>(boxes(i, 1), boxes(i, 3));
+  box.area = (box.ymax - box.ymin) * (box.xmax - box.xmin);
+  return box;
 }
 
-// Compute intersection-over-union overlap between boxes i and j.
-static inline float ComputeIOU(typename TTypes<float, 2>::ConstTensor boxes,
-                               int i, int j) {
-  const float ymin_i = std::min<float>(boxes(i, 0), boxes(i, 2));
-  const float xmin_i = std::min<float>(boxes(i, 1), boxes(i, 3));
-  const float ymax_i = std::max<float>(boxes(i, 0), boxes(i, 2));
-  const float xmax_i = std::max<float>(boxes(i, 1), boxes(i, 3));
-  const float ymin_j = std::min<float>(boxes(j, 0), boxes(j, 2));
-  const float xmin_j = std::min<float>(boxes(j, 1), boxes(j, 3));
-  const float ymax_j = std::max<float>(boxes(j, 0), boxes(j, 2));
-  const float xmax_j = std::max<float>(boxes(j, 1), boxes(j, 3));
-
-  const float area_i = (ymax_i - ymin_i) * (xmax_i - xmin_i);
-  const float area_j = (ymax_j - ymin_j) * (xmax_j - xmin_j);
-  if (area_i <= 0 || area_j <= 0) return 0.0;
-  const float intersection_ymin = std::max<float>(ymin_i, ymin_j);
-  const float intersection_xmin = std::max<float>(xmin_i, xmin_j);
-  const float intersection_ymax = std::min<float>(ymax_i, ymax_j);
-  const float intersection_xmax = std::min<float>(xmax_i, xmax_j);
-  const float intersection_area =
-      std::max<float>(intersection_ymax - intersection_ymin, 0.0) *
-      std::max<float>(intersection_xmax - intersection_xmin, 0.0);
-  return intersection_area / (area_i + area_j - intersection_area);
+// The boxes selected so far, in structure-of-arrays layout so that the
+// overlap of a candidate with a block of them is computed with SIMD.  Boxes
+// without area overlap nothing, and are not stored.
+class SelectedBoxes {
+ public:
+  explicit SelectedBoxes(int capacity)
+      : ymin_(capacity), xmin_(capacity), ymax_(capacity), xmax_(capacity),
+        area_(capacity) {}
+
+  void Add(const Box& box) {
+    if (box.area <= 0) return;
+    ymin_[size_] = box.ymin;
+    xmin_[size_] = box.xmin;
+    ymax_[size_] = box.ymax;
+    xmax_[size_] = box.xmax;
+    area_[size_] = box.area;
+    ++size_;
+  }
+
+  // Returns true if some selected box overlaps "box" with an
+  // intersection-over-union above iou_threshold.
+  bool Suppresses(const Box& box, float iou_threshold) const {
+    if (box.area <= 0) return false;
+    typedef Eigen::Map<const Eigen::ArrayXf> ConstArray;
+    for (int begin = 0; begin < size_; begin += kIOUBlockSize) {
+      const int n = std::min(kIOUBlockSize, size_ - begin);
+      const ConstArray ymin(ymin_.data() + begin, n);
+      const ConstArray xmin(xmin_.data() + begin, n);
+      const ConstArray ymax(ymax_.data() + begin, n);
+      const ConstArray xmax(xmax_.data() + begin, n);
+      const ConstArray area(area_.data() + begin, n);
+      const auto intersection =
+          (ymax.min(box.ymax) - ymin.max(box.ymin)).max(0.0f) *
+          (xmax.min(box.xmax) - xmin.max(box.xmin)).max(0.0f);
+      const auto iou = intersection / (area + box.area - intersection);
+      if (iou.maxCoeff() > iou_threshold) return true;
+    }
+    return false;
+  }
+
+ private:
+  std::vector<float> ymin_;
+  std::vector<float> xmin_;
+  std::vector<float> ymax_;
+  std::vector<float> xmax_;
+  std::vector<float> area_;
+  int size_ = 0;
+};
+
+// Greedily selects up to max_output_size boxes in decreasing order of score,
+// ties going to the lower index, skipping any box whose IOU with an already
+// selected box is above iou_threshold.  Candidates come off a heap, so only
+// as many are ordered as are looked at before max_output_size is reached.
+void SelectBoxes(typename TTypes<float, 2>::ConstTensor boxes,
+                 const float* scores, int num_boxes, float iou_threshold,
+                 int max_output_size, std::vector<int>* selected) {
+  selected->clear();
+  const int output_size = std::min(max_output_size, num_boxes);
+  if (output_size <= 0) return;
+  std::vector<int> candidates(num_boxes);
+  for (int i = 0; i < num_boxes; ++i) candidates[i] = i;
+  auto lower_priority = [scores](const int i, const int j) {
+    return scores[i] < scores[j] || (scores[i] == scores[j] && i > j);
+  };
+  std::make_heap(candidates.begin(), candidates.end(), lower_priority);
+
+  SelectedBoxes selected_boxes(output_size);
+  auto heap_end = candidates.end();
+  while (heap_end != candidates.begin() &&
+         selected->size() < static_cast<size_t>(output_size)) {
+    std::pop_heap(candidates.begin(), heap_end, lower_priority);
+    --heap_end;
+    const int i = *heap_end;
+    const Box box = GetBox(boxes, i);
+    if (!selected_boxes.Suppresses(box, iou_threshold)) {
+      selected->push_back(i);
+      selected_boxes.Add(box);
+    }
+  }
 }
 
+}  // namespace
+
 template <typename Device>
 class NonMaxSuppressionOp : public OpKernel {
  public:
@@ -118,37 +196,15 @@ class NonMaxSuppressionOp : public OpKernel {
       return;
     }
 
-    const int output_size =
-        std::min(max_output_size.scalar<int>()(), num_boxes);
-    typename TTypes<float, 2>::ConstTensor boxes_data =
-        boxes.tensor<float, 2>();
-
-    std::vector<float> scores_data(num_boxes);
-    std::copy_n(scores.flat<float>().data(), num_boxes, scores_data.begin());
-    std::vector<int> sorted_indices;
-    DecreasingArgSort(scores_data, &sorted_indices);
+    const int max_output_size_value = max_output_size.scalar<int>()();
+    OP_REQUIRES(context, max_output_size_value >= 0,
+                errors::InvalidArgument(
+                    "max_output_size must be non-negative, got ",
+                    max_output_size_value));
 
-    std::vector<bool> active(num_boxes, true);
     std::vector<int> selected;
-    int num_active = active.size();
-    for (int i = 0; i < num_boxes; ++i) {
-      if (num_active == 0 || selected.size() >= output_size) break;
-      if (active[i]) {
-        selected.push_back(sorted_indices[i]);
-      } else {
-        continue;
-      }
-      for (int j = i + 1; j < num_boxes; ++j) {
-        if (active[j]) {
-          float iou =
-              ComputeIOU(boxes_data, sorted_indices[i], sorted_indices[j]);
-          if (iou > iou_threshold_) {
-            active[j] = false;
-            num_active--;
-          }
-        }
-      }
-    }
+    SelectBoxes(boxes.tensor<float, 2>(), scores.flat<float>().data(),
+                num_boxes, iou_threshold_, max_output_size_value, &selected);
 
     // Allocate output tensor
     Tensor* output = nullptr;
@@ -167,4 +223,84 @@ class NonMaxSuppressionOp : public OpKernel {
 REGISTER_KERNEL_BUILDER(Name("NonMaxSuppression").Device(DEVICE_CPU),
                         NonMaxSuppressionOp<CPUDevice>);
 
+template <typename Device>
+class BatchNonMaxSuppressionOp : public OpKernel {
+ public:
+  explicit BatchNonMaxSuppressionOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("iou_threshold", &iou_threshold_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    OP_REQUIRES(context, iou_threshold_ >= 0 && iou_threshold_ <= 1,
+                errors::InvalidArgument("iou_threshold must be in [0, 1]"));
+
+    // boxes: [batch_size, num_boxes, 4]
+    const Tensor& boxes = context->input(0);
+    OP_REQUIRES(context, boxes.dims() == 3 && boxes.dim_size(2) == 4,
+                errors::InvalidArgument(
+                    "boxes must be 3-D with 4 columns, got shape ",
+                    boxes.shape().DebugString()));
+    const int batch_size = boxes.dim_size(0);
+    const int num_boxes = boxes.dim_size(1);
+    // scores: [batch_size, num_boxes]
+    const Tensor& scores = context->input(1);
+    OP_REQUIRES(context, scores.dims() == 2 &&
+                             scores.dim_size(0) == batch_size &&
+                             scores.dim_size(1) == num_boxes,
+                errors::InvalidArgument("scores has incompatible shape ",
+                                        scores.shape().DebugString()));
+    // max_output_size: scalar
+    const Tensor& max_output_size = context->input(2);
+    OP_REQUIRES(
+        context, TensorShapeUtils::IsScalar(max_output_size.shape()),
+        errors::InvalidArgument("max_output_size must be 0-D, got shape ",
+                                max_output_size.shape().DebugString()));
+    const int output_size = max_output_size.scalar<int>()();
+    OP_REQUIRES(context, output_size >= 0,
+                errors::InvalidArgument(
+                    "max_output_size must be non-negative, got ", output_size));
+
+    Tensor* selected_indices = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, TensorShape({batch_size, output_size}),
+                                &selected_indices));
+    Tensor* valid_outputs = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(1, TensorShape({batch_size}),
+                                            &valid_outputs));
+    auto selected_indices_data = selected_indices->matrix<int>();
+    auto valid_outputs_data = valid_outputs->vec<int>();
+    selected_indices_data.setZero();
+
+    const float* boxes_data = boxes.flat<float>().data();
+    const float* scores_data = scores.flat<float>().data();
+    auto select = [&](int64 start, int64 limit) {
+      std::vector<int> selected;
+      for (int64 b = start; b < limit; ++b) {
+        typename TTypes<float, 2>::ConstTensor image_boxes(
+            boxes_data + b * num_boxes * 4, num_boxes, 4);
+        SelectBoxes(image_boxes, scores_data + b * num_boxes, num_boxes,
+                    iou_threshold_, output_size, &selected);
+        std::copy(selected.begin(), selected.end(),
+                  selected_indices_data.data() + b * output_size);
+        valid_outputs_data(b) = selected.size();
+      }
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    // Each image orders its candidates and checks up to output_size of them
+    // against the boxes selected so far.
+    const int64 cost_per_image =
+        num_boxes * 50 + static_cast<int64>(num_boxes) * output_size * 10;
+    Shard(worker_threads.num_threads, worker_threads.workers, batch_size,
+          cost_per_image, select);
+  }
+
+ private:
+  float iou_threshold_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("BatchNonMaxSuppression").Device(DEVICE_CPU),
+                        BatchNonMaxSuppressionOp<CPUDevice>);
+
 }  // namespace tensorflow
@@ -13,6 +13,10 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/fake_input.h"
 #include "tensorflow/core/framework/graph.pb.h"
@@ -22,10 +26,13 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 
@@ -173,4 +180,190 @@ TEST_F(NonMaxSuppressionOpTest, TestEmptyInput) {
   test::ExpectTensorEqual<int>(expected, *GetOutput(0));
 }
 
+// Random boxes of a few sizes around a few centers, so that many overlap.
+static void RandomBoxes(random::SimplePhilox* rnd, int num_boxes,
+                        std::vector<float>* corners,
+                        std::vector<float>* scores) {
+  corners->resize(num_boxes * 4);
+  scores->resize(num_boxes);
+  for (int i = 0; i < num_boxes; ++i) {
+    const float y = rnd->Uniform(20) + rnd->RandFloat();
+    const float x = rnd->Uniform(20) + rnd->RandFloat();
+    const float h = 0.5f + rnd->Uniform(4);
+    const float w = 0.5f + rnd->Uniform(4);
+    (*corners)[i * 4 + 0] = y;
+    (*corners)[i * 4 + 1] = x;
+    (*corners)[i * 4 + 2] = y + h;
+    (*corners)[i * 4 + 3] = x + w;
+    // Coarse scores, so that there are ties.
+    (*scores)[i] = rnd->Uniform(100) / 100.0f;
+  }
+}
+
+// The straightforward greedy algorithm, to check the op against.
+static std::vector<int> ReferenceNonMaxSuppression(
+    const std::vector<float>& corners, const std::vector<float>& scores,
+    float iou_threshold, int max_output_size) {
+  const int num_boxes = scores.size();
+  std::vector<int> order(num_boxes);
+  for (int i = 0; i < num_boxes; ++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&scores](int i, int j) {
+    return scores[i] > scores[j];
+  });
+  auto iou = [&corners](int i, int j) {
+    const float* a = &corners[i * 4];
+    const float* b = &corners[j * 4];
+    const float area_a = (a[2] - a[0]) * (a[3] - a[1]);
+    const float area_b = (b[2] - b[0]) * (b[3] - b[1]);
+    const float intersection =
+        std::max<float>(std::min(a[2], b[2]) - std::max(a[0], b[0]), 0.0) *
+        std::max<float>(std::min(a[3], b[3]) - std::max(a[1], b[1]), 0.0);
+    return intersection / (area_a + area_b - intersection);
+  };
+  std::vector<int> selected;
+  for (int i : order) {
+    if (selected.size() >= max_output_size) break;
+    bool keep = true;
+    for (int j : selected) {
+      if (iou(j, i) > iou_threshold) {
+        keep = false;
+        break;
+      }
+    }
+    if (keep) selected.push_back(i);
+  }
+  return selected;
+}
+
+TEST_F(NonMaxSuppressionOpTest, TestMatchesReferenceOnRandomBoxes) {
+  MakeOp(.4);
+  random::PhiloxRandom philox(7, 11);
+  random::SimplePhilox rnd(&philox);
+  std::vector<float> corners, scores;
+  // Enough boxes that more than one block of selected boxes is checked.
+  RandomBoxes(&rnd, 3000, &corners, &scores);
+  AddInputFromArray<float>(TensorShape({3000, 4}), corners);
+  AddInputFromArray<float>(TensorShape({3000}), scores);
+  AddInputFromArray<int>(TensorShape({}), {200});
+  TF_ASSERT_OK(RunOpKernel());
+
+  const std::vector<int> reference =
+      ReferenceNonMaxSuppression(corners, scores, .4, 200);
+  Tensor expected(allocator(), DT_INT32,
+                  TensorShape({static_cast<int64>(reference.size())}));
+  test::FillValues<int>(&expected, reference);
+  test::ExpectTensorEqual<int>(expected, *GetOutput(0));
+}
+
+TEST_F(NonMaxSuppressionOpTest, TestNegativeMaxOutputSize) {
+  MakeOp(.5);
+  AddInputFromArray<float>(TensorShape({1, 4}), {0, 0, 1, 1});
+  AddInputFromArray<float>(TensorShape({1}), {.9f});
+  AddInputFromArray<int>(TensorShape({}), {-1});
+  Status s = RunOpKernel();
+
+  ASSERT_FALSE(s.ok());
+  EXPECT_TRUE(
+      StringPiece(s.ToString()).contains("max_output_size must be non-negative"))
+      << s;
+}
+
+class BatchNonMaxSuppressionOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(float iou_threshold) {
+    TF_EXPECT_OK(NodeDefBuilder("batch_non_max_suppression_op",
+                                "BatchNonMaxSuppression")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("iou_threshold", iou_threshold)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+};
+
+TEST_F(BatchNonMaxSuppressionOpTest, TestSelectFromThreeClustersPerImage) {
+  MakeOp(.5);
+  // The second image is the first with its scores reversed.
+  AddInputFromArray<float>(
+      TensorShape({2, 6, 4}),
+      {0, 0, 1, 1, 0, 0.1f, 1, 1.1f, 0, -0.1f, 1, 0.9f,
+       0, 10, 1, 11, 0, 10.1f, 1, 11.1f, 0, 100, 1, 101,
+       0, 0, 1, 1, 0, 0.1f, 1, 1.1f, 0, -0.1f, 1, 0.9f,
+       0, 10, 1, 11, 0, 10.1f, 1, 11.1f, 0, 100, 1, 101});
+  AddInputFromArray<float>(TensorShape({2, 6}),
+                           {.9f, .75f, .6f, .95f, .5f, .3f,
+                            .3f, .5f, .95f, .6f, .75f, .9f});
+  AddInputFromArray<int>(TensorShape({}), {4});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_indices(allocator(), DT_INT32, TensorShape({2, 4}));
+  test::FillValues<int>(&expected_indices, {3, 0, 5, 0, 2, 5, 4, 0});
+  test::ExpectTensorEqual<int>(expected_indices, *GetOutput(0));
+  Tensor expected_valid(allocator(), DT_INT32, TensorShape({2}));
+  test::FillValues<int>(&expected_valid, {3, 3});
+  test::ExpectTensorEqual<int>(expected_valid, *GetOutput(1));
+}
+
+TEST_F(BatchNonMaxSuppressionOpTest, TestInconsistentBoxAndScoreShapes) {
+  MakeOp(.5);
+  AddInputFromArray<float>(TensorShape({2, 1, 4}), {0, 0, 1, 1, 0, 0, 1, 1});
+  AddInputFromArray<float>(TensorShape({1, 1}), {.9f});
+  AddInputFromArray<int>(TensorShape({}), {3});
+  Status s = RunOpKernel();
+
+  ASSERT_FALSE(s.ok());
+  EXPECT_TRUE(
+      StringPiece(s.ToString()).contains("scores has incompatible shape"))
+      << s;
+}
+
+static Graph* NonMaxSuppression(int batch_size, int num_boxes,
+                                int max_output_size) {
+  random::PhiloxRandom philox(7, 11);
+  random::SimplePhilox rnd(&philox);
+  std::vector<float> corners, scores;
+  RandomBoxes(&rnd, batch_size * num_boxes, &corners, &scores);
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor boxes(DT_FLOAT, batch_size == 0 ? TensorShape({num_boxes, 4})
+                                         : TensorShape({batch_size, num_boxes,
+                                                        4}));
+  std::copy(corners.begin(), corners.end(), boxes.flat<float>().data());
+  Tensor box_scores(DT_FLOAT, batch_size == 0
+                                  ? TensorShape({num_boxes})
+                                  : TensorShape({batch_size, num_boxes}));
+  std::copy(scores.begin(), scores.end(), box_scores.flat<float>().data());
+  Tensor max_output(DT_INT32, TensorShape({}));
+  max_output.scalar<int>()() = max_output_size;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), batch_size == 0
+                                               ? "NonMaxSuppression"
+                                               : "BatchNonMaxSuppression")
+                  .Input(test::graph::Constant(g, boxes))
+                  .Input(test::graph::Constant(g, box_scores))
+                  .Input(test::graph::Constant(g, max_output))
+                  .Attr("iou_threshold", 0.5f)
+                  .Finalize(g, nullptr));
+  return g;
+}
+
+// A batch size of 0 runs NonMaxSuppression on a single image.
+#define BM_NonMaxSuppressionDev(BATCH, BOXES, OUTPUTS)                      \
+  static void BM_NonMaxSuppression##_##BATCH##_##BOXES##_##OUTPUTS(         \
+      int iters) {                                                          \
+    testing::ItemsProcessed(static_cast<int64>(iters) *                     \
+                            std::max(BATCH, 1) * BOXES);                    \
+    test::Benchmark("cpu", NonMaxSuppression(BATCH, BOXES, OUTPUTS))        \
+        .Run(iters);                                                        \
+  }                                                                         \
+  BENCHMARK(BM_NonMaxSuppression##_##BATCH##_##BOXES##_##OUTPUTS);
+
+BM_NonMaxSuppressionDev(0, 1000, 100);
+BM_NonMaxSuppressionDev(0, 5000, 100);
+BM_NonMaxSuppressionDev(0, 20000, 100);
+BM_NonMaxSuppressionDev(0, 20000, 1000);
+BM_NonMaxSuppressionDev(0, 50000, 300);
+BM_NonMaxSuppressionDev(8, 5000, 100);
+BM_NonMaxSuppressionDev(8, 20000, 300);
+BM_NonMaxSuppressionDev(32, 20000, 100);
+
 }  // namespace tensorflow
@@ -15,16 +15,20 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/range_sampler.h"
 
+#include <algorithm>
+#include <functional>
 #include <unordered_set>
 #include <vector>
 
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/prefetch.h"
 #include "tensorflow/core/platform/types.h"
 
 namespace tensorflow {
@@ -72,6 +76,25 @@ static float ExpectedCountHelper(float p, int batch_size, int num_tries) {
   return -expm1(num_tries * log1p(-p));
 }
 
+// Values drawn per block by SampleBatchGetExpectedCountParallel.  Block b
+// draws from the caller's generator skipped ahead by b * kSampleBlockSize
+// 128-bit samples.
+constexpr int64 kSampleBlockSize = 4096;
+
+// Rough cost, in cycles, of drawing one value or looking up one probability
+// in a table that does not fit in cache.
+constexpr int64 kSampleCost = 100;
+
+// Runs fn over [0, total), on "workers" if there are any.
+void ParallelFor(thread::ThreadPool* workers, int64 total, int64 cost_per_unit,
+                 const std::function<void(int64, int64)>& fn) {
+  if (workers == nullptr) {
+    fn(0, total);
+  } else {
+    workers->ParallelFor(total, cost_per_unit, fn);
+  }
+}
+
 }  // namespace
 
 void RangeSampler::SampleBatchGetExpectedCountAvoid(
@@ -119,6 +142,148 @@ void RangeSampler::SampleBatchGetExpectedCountAvoid(
   }
 }
 
+void RangeSampler::SampleBatchGetExpectedCountParallel(
+    thread::ThreadPool* workers, const random::PhiloxRandom& gen, bool unique,
+    MutableArraySlice<int64> batch,
+    MutableArraySlice<float> batch_expected_count, ArraySlice<int64> extras,
+    MutableArraySlice<float> extras_expected_count) const {
+  const int64 batch_size = batch.size();
+  if (unique || batch_size <= kSampleBlockSize) {
+    random::PhiloxRandom local_gen = gen;
+    random::SimplePhilox rnd(&local_gen);
+    SampleBatchGetExpectedCount(&rnd, unique, batch, batch_expected_count,
+                                extras, extras_expected_count);
+    return;
+  }
+
+  const int64 num_blocks = (batch_size + kSampleBlockSize - 1) /
+                           kSampleBlockSize;
+  ParallelFor(workers, num_blocks, kSampleBlockSize * kSampleCost,
+              [this, &gen, &batch, batch_size](int64 start, int64 limit) {
+                for (int64 b = start; b < limit; ++b) {
+                  random::PhiloxRandom block_gen = gen;
+                  block_gen.Skip(b * kSampleBlockSize);
+                  const int64 begin = b * kSampleBlockSize;
+                  const int64 size =
+                      std::min(kSampleBlockSize, batch_size - begin);
+                  SampleBlock(&block_gen, MutableArraySlice<int64>(
+                                              batch.data() + begin, size));
+                }
+              });
+
+  // Without rejections, the expected count of a value is
+  // Probability(value) * batch_size (see ExpectedCountHelper).
+  if (batch_expected_count.size() > 0) {
+    CHECK_EQ(batch_size, batch_expected_count.size());
+    ParallelFor(workers, batch_size, kSampleCost,
+                [this, &batch, &batch_expected_count, batch_size](
+                    int64 start, int64 limit) {
+                  for (int64 i = start; i < limit; ++i) {
+                    batch_expected_count[i] =
+                        ExpectedCountHelper(Probability(batch[i]), batch_size,
+                                            batch_size);
+                  }
+                });
+  }
+  CHECK_EQ(extras.size(), extras_expected_count.size());
+  ParallelFor(workers, extras.size(), kSampleCost,
+              [this, &extras, &extras_expected_count, batch_size](
+                  int64 start, int64 limit) {
+                for (int64 i = start; i < limit; ++i) {
+                  extras_expected_count[i] = ExpectedCountHelper(
+                      Probability(extras[i]), batch_size, batch_size);
+                }
+              });
+}
+
+void RangeSampler::SampleBlock(random::PhiloxRandom* gen,
+                               MutableArraySlice<int64> batch) const {
+  random::SimplePhilox rnd(gen);
+  for (size_t i = 0; i < batch.size(); ++i) {
+    batch[i] = Sample(&rnd);
+  }
+}
+
+AliasTable::AliasTable(gtl::ArraySlice<float> weights) { Init(weights); }
+
+AliasTable::AliasTable(gtl::ArraySlice<double> weights) { Init(weights); }
+
+template <typename T>
+void AliasTable::Init(gtl::ArraySlice<T> weights) {
+  const int64 n = weights.size();
+  CHECK_GT(n, 0);
+  CHECK_LT(n, kint32max);
+  double total = 0.0;
+  for (const T w : weights) {
+    CHECK_GE(w, 0);
+    total += w;
+  }
+  CHECK_GT(total, 0.0);
+
+  // Vose's variant of the alias method: buckets filled less than one
+  // ("small") take the rest of their mass from one that is overfull.
+  entries_.resize(n);
+  probabilities_.resize(n);
+  std::vector<double> scaled(n);
+  std::vector<int32> small;
+  std::vector<int32> large;
+  for (int64 i = 0; i < n; ++i) {
+    probabilities_[i] = weights[i] / total;
+    scaled[i] = weights[i] * n / total;
+    if (scaled[i] < 1.0) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+  while (!small.empty() && !large.empty()) {
+    const int32 s = small.back();
+    small.pop_back();
+    const int32 l = large.back();
+    entries_[s].threshold = static_cast<uint32>(scaled[s] * 4294967296.0);
+    entries_[s].alias = l;
+    scaled[l] -= 1.0 - scaled[s];
+    if (scaled[l] < 1.0) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // Whatever is left is full up to rounding errors; alias such buckets to
+  // themselves so that rounding can never return another value.
+  for (const int32 i : small) {
+    entries_[i].threshold = kuint32max;
+    entries_[i].alias = i;
+  }
+  for (const int32 i : large) {
+    entries_[i].threshold = kuint32max;
+    entries_[i].alias = i;
+  }
+}
+
+void AliasTable::SampleBatch(random::PhiloxRandom* gen,
+                             MutableArraySlice<int64> batch) const {
+  // Buckets for a chunk of values are picked and prefetched before any of
+  // them is read, so the cache misses of a chunk overlap.
+  const int kChunk = 16;
+  uint32 bits[kChunk];
+  const int64 size = batch.size();
+  for (int64 begin = 0; begin < size; begin += kChunk) {
+    const int n = std::min<int64>(kChunk, size - begin);
+    for (int i = 0; i < n; i += 2) {
+      const random::PhiloxRandom::ResultType r = (*gen)();
+      for (int j = 0; j < 2 && i + j < n; ++j) {
+        const int64 bucket = Bucket(r[2 * j]);
+        port::prefetch<port::PREFETCH_HINT_T0>(&entries_[bucket]);
+        batch[begin + i + j] = bucket;
+        bits[i + j] = r[2 * j + 1];
+      }
+    }
+    for (int i = 0; i < n; ++i) {
+      batch[begin + i] = Resolve(batch[begin + i], bits[i]);
+    }
+  }
+}
+
 AllSampler::AllSampler(int64 range) : RangeSampler(range) {}
 
 void AllSampler::SampleBatchGetExpectedCountAvoid(
@@ -144,6 +309,16 @@ void AllSampler::SampleBatchGetExpectedCountAvoid(
   }
 }
 
+void AllSampler::SampleBatchGetExpectedCountParallel(
+    thread::ThreadPool* workers, const random::PhiloxRandom& gen, bool unique,
+    MutableArraySlice<int64> batch,
+    MutableArraySlice<float> batch_expected_count, ArraySlice<int64> extras,
+    MutableArraySlice<float> extras_expected_count) const {
+  SampleBatchGetExpectedCountAvoid(nullptr, unique, batch,
+                                   batch_expected_count, extras,
+                                   extras_expected_count, ArraySlice<int64>());
+}
+
 UniformSampler::UniformSampler(int64 range)
     : RangeSampler(range), inv_range_(1.0 / range) {}
 
@@ -196,37 +371,91 @@ void ThreadUnsafeUnigramSampler::Update(ArraySlice<int64> values) {
   }
 }
 
+namespace {
+
+// Samples from one AliasTable, so that a batch drawn through the RangeSampler
+// methods sees a single snapshot of a changing distribution.
+class AliasTableSampler : public RangeSampler {
+ public:
+  explicit AliasTableSampler(const AliasTable* table)
+      : RangeSampler(table->size()), table_(table) {}
+
+  int64 Sample(random::SimplePhilox* rnd) const override {
+    return table_->Sample(rnd);
+  }
+
+  float Probability(int64 value) const override {
+    return table_->Probability(value);
+  }
+
+ protected:
+  void SampleBlock(random::PhiloxRandom* gen,
+                   MutableArraySlice<int64> batch) const override {
+    table_->SampleBatch(gen, batch);
+  }
+
+ private:
+  const AliasTable* const table_;
+};
+
+}  // namespace
+
 // Thread-safe unigram sampler
 UnigramSampler::UnigramSampler(int64 range)
-    : RangeSampler(range), unsafe_sampler_(range) {
+    : RangeSampler(range),
+      counts_(range, 1.0),
+      total_count_(range),
+      pending_count_(0.0) {
   CHECK_LT(range, kint32max);
+  table_.reset(new AliasTable(counts_));
 }
 
 int64 UnigramSampler::Sample(random::SimplePhilox* rnd) const {
-  mutex_lock lock(mu_);  // could use reader lock
-  return unsafe_sampler_.Sample(rnd);
+  return table()->Sample(rnd);
 }
 
 float UnigramSampler::Probability(int64 value) const {
-  mutex_lock lock(mu_);  // could use reader lock
-  return unsafe_sampler_.Probability(value);
+  return table()->Probability(value);
 }
 
-// Overriding at a high level results in far fewer lock acquisitions.
 void UnigramSampler::SampleBatchGetExpectedCountAvoid(
     random::SimplePhilox* rnd, bool unique, MutableArraySlice<int64> batch,
     MutableArraySlice<float> batch_expected_count, ArraySlice<int64> extras,
     MutableArraySlice<float> extras_expected_count,
     ArraySlice<int64> avoided_values) const {
-  mutex_lock lock(mu_);  // could use reader lock
-  unsafe_sampler_.SampleBatchGetExpectedCountAvoid(
-      rnd, unique, batch, batch_expected_count, extras, extras_expected_count,
-      avoided_values);
+  std::shared_ptr<const AliasTable> snapshot = table();
+  AliasTableSampler(snapshot.get())
+      .SampleBatchGetExpectedCountAvoid(rnd, unique, batch,
+                                        batch_expected_count, extras,
+                                        extras_expected_count, avoided_values);
+}
+
+void UnigramSampler::SampleBatchGetExpectedCountParallel(
+    thread::ThreadPool* workers, const random::PhiloxRandom& gen, bool unique,
+    MutableArraySlice<int64> batch,
+    MutableArraySlice<float> batch_expected_count, ArraySlice<int64> extras,
+    MutableArraySlice<float> extras_expected_count) const {
+  std::shared_ptr<const AliasTable> snapshot = table();
+  AliasTableSampler(snapshot.get())
+      .SampleBatchGetExpectedCountParallel(workers, gen, unique, batch,
+                                           batch_expected_count, extras,
+                                           extras_expected_count);
 }
 
 void UnigramSampler::Update(ArraySlice<int64> values) {
-  mutex_lock lock(mu_);
-  unsafe_sampler_.Update(values);
+  mutex_lock lock(update_mu_);
+  for (const int64 value : values) {
+    if (value < 0 || value >= range_) continue;
+    counts_[value] += 1.0;
+    total_count_ += 1.0;
+    pending_count_ += 1.0;
+  }
+  if (pending_count_ * kRebuildFraction < total_count_) return;
+  // Build outside mu_, so that sampling continues from the old table.
+  std::shared_ptr<const AliasTable> rebuilt(new AliasTable(counts_));
+  pending_count_ = 0.0;
+  mutex_lock table_lock(mu_);
+  table_.swap(rebuilt);
 }
 
 FixedUnigramSampler::FixedUnigramSampler(Env* env, int64 range,
@@ -242,7 +471,7 @@ FixedUnigramSampler::FixedUnigramSampler(Env* env, int64 range,
   // TODO(vanhoucke): make this non-crashing.
   TF_CHECK_OK(LoadFromFile(env, vocab_file, distortion));
   CHECK_EQ(range, weights_.size());
-  dist_sampler_.reset(new random::DistributionSampler(weights_));
+  table_.reset(new AliasTable(weights_));
 }
 
 FixedUnigramSampler::FixedUnigramSampler(int64 range,
@@ -258,7 +487,7 @@ FixedUnigramSampler::FixedUnigramSampler(int64 range,
   LoadFromUnigrams(unigrams, distortion);
   // TODO(vanhoucke): make this non-crashing.
   CHECK_EQ(range, weights_.size());
-  dist_sampler_.reset(new random::DistributionSampler(weights_));
+  table_.reset(new AliasTable(weights_));
 }
 
 float FixedUnigramSampler::Probability(int64 value) const {
@@ -269,7 +498,12 @@ float FixedUnigramSampler::Probability(int64 value) const {
 }
 
 int64 FixedUnigramSampler::Sample(random::SimplePhilox* rnd) const {
-  return dist_sampler_->Sample(rnd);
+  return table_->Sample(rnd);
+}
+
+void FixedUnigramSampler::SampleBlock(random::PhiloxRandom* gen,
+                                      MutableArraySlice<int64> batch) const {
+  table_->SampleBatch(gen, batch);
 }
 
 void FixedUnigramSampler::FillReservedIds(int32 num_reserved_ids) {
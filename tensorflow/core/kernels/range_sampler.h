@@ -16,14 +16,17 @@ limitations under the License.
 #ifndef TENSORFLOW_KERNELS_RANGE_SAMPLER_H_
 #define TENSORFLOW_KERNELS_RANGE_SAMPLER_H_
 
+#include <memory>
 #include <vector>
 
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
-#include "tensorflow/core/lib/random/distribution_sampler.h"
+#include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/random/weighted_picker.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/types.h"
@@ -31,6 +34,9 @@ limitations under the License.
 namespace tensorflow {
 
 class Env;
+namespace thread {
+class ThreadPool;
+}  // namespace thread
 
 // Abstract subclass for sampling from the set of non-negative integers
 // [0, range)
@@ -90,6 +96,22 @@ class RangeSampler {
       gtl::MutableArraySlice<float> extras_expected_count,
       gtl::ArraySlice<int64> avoided_values) const;
 
+  // Same as SampleBatchGetExpectedCount (see above), but the random bits come
+  // from "gen", and a large batch with unique=false is drawn in blocks spread
+  // over "workers" (which may be null).  Each block draws from its own
+  // stream, "gen" skipped ahead by the block's offset, so the result does not
+  // depend on the number of threads.  Unique batches and batches of a single
+  // block are drawn serially, exactly as SampleBatchGetExpectedCount does.
+  //
+  // The caller should reserve one 128-bit sample from "gen" per value in the
+  // batch, rounded up to whole blocks of 4096 values.
+  virtual void SampleBatchGetExpectedCountParallel(
+      thread::ThreadPool* workers, const random::PhiloxRandom& gen,
+      bool unique, gtl::MutableArraySlice<int64> batch,
+      gtl::MutableArraySlice<float> batch_expected_count,
+      gtl::ArraySlice<int64> extras,
+      gtl::MutableArraySlice<float> extras_expected_count) const;
+
   // Does this sampler need to be updated with values, e.g. UnigramSampler
   virtual bool NeedsUpdates() const { return false; }
 
@@ -101,9 +123,68 @@ class RangeSampler {
   int64 range() { return range_; }
 
  protected:
+  // Fills "batch" with independent samples, using at most one 128-bit sample
+  // from "gen" per value.  The default calls Sample() for each value;
+  // samplers with a cheaper batched draw override it.
+  virtual void SampleBlock(random::PhiloxRandom* gen,
+                           gtl::MutableArraySlice<int64> batch) const;
+
   const int64 range_;
 };
 
+// An immutable table for Walker's alias method over [0, weights.size()),
+// like random::DistributionSampler, which also records the normalized
+// probabilities so that a table answers both Sample() and Probability().
+// All methods are const and lock-free; tables are shared between threads.
+class AliasTable {
+ public:
+  // REQUIRES: weights are non-negative, with a positive sum, and there are
+  // fewer than kint32max of them.
+  explicit AliasTable(gtl::ArraySlice<float> weights);
+  explicit AliasTable(gtl::ArraySlice<double> weights);
+
+  int64 Sample(random::SimplePhilox* rnd) const {
+    const int64 bucket = Bucket(rnd->Rand32());
+    return Resolve(bucket, rnd->Rand32());
+  }
+
+  // Fills "batch" with independent samples, using one 128-bit sample from
+  // "gen" per two values.  Bucket lookups are prefetched ahead of use, which
+  // matters once the table no longer fits in cache.
+  void SampleBatch(random::PhiloxRandom* gen,
+                   gtl::MutableArraySlice<int64> batch) const;
+
+  float Probability(int64 value) const { return probabilities_[value]; }
+
+  int64 size() const { return entries_.size(); }
+
+ private:
+  struct Entry {
+    // A bucket keeps its own value when the second random word is below
+    // "threshold", and yields "alias" otherwise.
+    uint32 threshold;
+    int32 alias;
+  };
+
+  template <typename T>
+  void Init(gtl::ArraySlice<T> weights);
+
+  // Maps a uniform 32-bit word onto [0, size()).
+  int64 Bucket(uint32 bits) const {
+    return (static_cast<uint64>(bits) * entries_.size()) >> 32;
+  }
+
+  int64 Resolve(int64 bucket, uint32 bits) const {
+    const Entry& entry = entries_[bucket];
+    return bits < entry.threshold ? bucket : entry.alias;
+  }
+
+  std::vector<Entry> entries_;
+  std::vector<float> probabilities_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AliasTable);
+};
+
 // An AllSampler only samples batches of size equal to range.
 // It returns the entire range.
 // It cannot sample single values.
@@ -130,6 +211,13 @@ class AllSampler : public RangeSampler {
       gtl::ArraySlice<int64> extras,
       gtl::MutableArraySlice<float> extras_expected_count,
       gtl::ArraySlice<int64> avoided_values) const override;
+
+  void SampleBatchGetExpectedCountParallel(
+      thread::ThreadPool* workers, const random::PhiloxRandom& gen,
+      bool unique, gtl::MutableArraySlice<int64> batch,
+      gtl::MutableArraySlice<float> batch_expected_count,
+      gtl::ArraySlice<int64> extras,
+      gtl::MutableArraySlice<float> extras_expected_count) const override;
 };
 
 class UniformSampler : public RangeSampler {
@@ -177,7 +265,14 @@ class ThreadUnsafeUnigramSampler : public RangeSampler {
   random::WeightedPicker picker_;
 };
 
-// Thread-safe unigram sampler
+// Thread-safe unigram sampler.
+//
+// Update() accumulates counts, and draws come from an immutable AliasTable
+// built from them, so sampling only locks to grab the current table.  The
+// table is rebuilt once the counts added since the last build reach
+// 1/kRebuildFraction of the total, so the sampled distribution lags the
+// counts by at most that much, while a steady stream of updates costs O(1)
+// amortized per value instead of an O(range) rebuild per call.
 class UnigramSampler : public RangeSampler {
  public:
   explicit UnigramSampler(int64 range);
@@ -187,7 +282,7 @@ class UnigramSampler : public RangeSampler {
 
   float Probability(int64 value) const override;
 
-  // Overriding at a high level results in far fewer lock acquisitions.
+  // Overriding at a high level makes the whole batch use one table.
   void SampleBatchGetExpectedCountAvoid(
       random::SimplePhilox* rnd, bool unique,
       gtl::MutableArraySlice<int64> batch,
@@ -196,12 +291,34 @@ class UnigramSampler : public RangeSampler {
       gtl::MutableArraySlice<float> extras_expected_count,
       gtl::ArraySlice<int64> avoided_values) const override;
 
+  void SampleBatchGetExpectedCountParallel(
+      thread::ThreadPool* workers, const random::PhiloxRandom& gen,
+      bool unique, gtl::MutableArraySlice<int64> batch,
+      gtl::MutableArraySlice<float> batch_expected_count,
+      gtl::ArraySlice<int64> extras,
+      gtl::MutableArraySlice<float> extras_expected_count) const override;
+
   bool NeedsUpdates() const override { return true; }
   void Update(gtl::ArraySlice<int64> values) override;
 
  private:
-  ThreadUnsafeUnigramSampler unsafe_sampler_ GUARDED_BY(mu_);
+  static const int kRebuildFraction = 64;
+
+  std::shared_ptr<const AliasTable> table() const {
+    mutex_lock lock(mu_);
+    return table_;
+  }
+
   mutable mutex mu_;
+  std::shared_ptr<const AliasTable> table_ GUARDED_BY(mu_);
+
+  // Serializes Update(); never held while sampling.
+  mutex update_mu_;
+  // Every value starts with a count of one.
+  std::vector<double> counts_ GUARDED_BY(update_mu_);
+  double total_count_ GUARDED_BY(update_mu_);
+  // The part of total_count_ added since table_ was built.
+  double pending_count_ GUARDED_BY(update_mu_);
 };
 
 // A unigram sampler that uses a fixed unigram distribution read from a
@@ -224,9 +341,13 @@ class FixedUnigramSampler : public RangeSampler {
 
   int64 Sample(random::SimplePhilox* rnd) const override;
 
+ protected:
+  void SampleBlock(random::PhiloxRandom* gen,
+                   gtl::MutableArraySlice<int64> batch) const override;
+
  private:
   // Underlying distribution sampler.
-  std::unique_ptr<random::DistributionSampler> dist_sampler_;
+  std::unique_ptr<AliasTable> table_;
   // Weights for individual samples. The probability of a sample i is defined
   // as weights_.at(i) / total_weight_.
   std::vector<float> weights_;
@@ -17,11 +17,14 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/range_sampler.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/distribution_sampler.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace {
@@ -329,6 +332,172 @@ TEST_F(RangeSamplerTest, Avoid) {
   EXPECT_EQ(expected_sum, sum);
 }
 
+TEST_F(RangeSamplerTest, ParallelIndependentOfThreads) {
+  std::vector<float> weights = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+  sampler_.reset(new FixedUnigramSampler(9, weights, 0.8, 0, 1, 0));
+  const int batch_size = 20000;
+  random::PhiloxRandom philox(123, 17);
+  std::vector<int64> serial(batch_size);
+  std::vector<float> serial_expected(batch_size);
+  sampler_->SampleBatchGetExpectedCountParallel(
+      nullptr, philox, false, &serial, &serial_expected, ArraySlice<int64>(),
+      MutableArraySlice<float>());
+  thread::ThreadPool workers(Env::Default(), "test", 4);
+  std::vector<int64> parallel(batch_size);
+  std::vector<float> parallel_expected(batch_size);
+  std::vector<int64> extras = {0, 8};
+  std::vector<float> extras_expected(2);
+  sampler_->SampleBatchGetExpectedCountParallel(
+      &workers, philox, false, &parallel, &parallel_expected, extras,
+      &extras_expected);
+  EXPECT_EQ(serial, parallel);
+  EXPECT_EQ(serial_expected, parallel_expected);
+  for (int i = 0; i < 2; i++) {
+    EXPECT_NEAR(extras_expected[i],
+                sampler_->Probability(extras[i]) * batch_size, 1e-2);
+  }
+
+  std::vector<int> h(9);
+  for (int64 val : parallel) {
+    ASSERT_GE(val, 0);
+    ASSERT_LT(val, 9);
+    h[val]++;
+  }
+  for (int val = 0; val < 9; val++) {
+    EXPECT_NEAR((h[val] + 0.0) / batch_size, sampler_->Probability(val), 0.01);
+  }
+}
+
+TEST_F(RangeSamplerTest, UnigramParallelHistogram) {
+  sampler_.reset(new UnigramSampler(10));
+  Update1();
+  const int batch_size = 100000;
+  thread::ThreadPool workers(Env::Default(), "test", 4);
+  random::PhiloxRandom philox(123, 17);
+  std::vector<int64> batch(batch_size);
+  std::vector<float> expected(batch_size);
+  sampler_->SampleBatchGetExpectedCountParallel(
+      &workers, philox, false, &batch, &expected, ArraySlice<int64>(),
+      MutableArraySlice<float>());
+  std::vector<int> h(10);
+  for (int i = 0; i < batch_size; i++) {
+    h[batch[i]]++;
+    ASSERT_NEAR(expected[i], sampler_->Probability(batch[i]) * batch_size,
+                1e-2);
+  }
+  for (int val = 0; val < 10; val++) {
+    EXPECT_NEAR((h[val] + 0.0) / batch_size, sampler_->Probability(val), 0.01);
+  }
+}
+
+TEST_F(RangeSamplerTest, UnigramDefersSmallUpdates) {
+  sampler_.reset(new UnigramSampler(1000));
+  // One more count is under 1/64 of the total, so the table is kept...
+  sampler_->Update(std::vector<int64>({3}));
+  EXPECT_NEAR(sampler_->Probability(3), 1.0 / 1000, 1e-6);
+  // ...until enough counts have accumulated.
+  sampler_->Update(std::vector<int64>(20, 3));
+  EXPECT_NEAR(sampler_->Probability(3), 22.0 / 1021, 1e-6);
+  CheckProbabilitiesSumToOne();
+}
+
+// Zipfian weights over "range" values, like word counts of a vocabulary.
+std::vector<float> ZipfWeights(int range) {
+  std::vector<float> weights(range);
+  for (int i = 0; i < range; i++) {
+    weights[i] = 1.0f / (i + 1);
+  }
+  return weights;
+}
+
+const int kBenchmarkBatch = 64 << 10;
+
+// The previous FixedUnigramSampler backend, for comparison.
+static void BM_DistributionSampler(int iters, int range) {
+  testing::StopTiming();
+  random::DistributionSampler sampler(ZipfWeights(range));
+  random::PhiloxRandom philox(123, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int64> batch(kBenchmarkBatch);
+  testing::StartTiming();
+  for (int i = 0; i < iters; i++) {
+    for (int j = 0; j < kBenchmarkBatch; j++) {
+      batch[j] = sampler.Sample(&rnd);
+    }
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * kBenchmarkBatch);
+}
+BENCHMARK(BM_DistributionSampler)->Range(1 << 10, 16 << 20);
+
+// The WeightedPicker that backed UnigramSampler, for comparison.
+static void BM_ThreadUnsafeUnigram(int iters, int range) {
+  testing::StopTiming();
+  ThreadUnsafeUnigramSampler sampler(range);
+  random::PhiloxRandom philox(123, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int64> batch(kBenchmarkBatch);
+  testing::StartTiming();
+  for (int i = 0; i < iters; i++) {
+    sampler.SampleBatch(&rnd, false, &batch);
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * kBenchmarkBatch);
+}
+BENCHMARK(BM_ThreadUnsafeUnigram)->Range(1 << 10, 16 << 20);
+
+static void BM_FixedUnigram(int iters, int range, int num_threads) {
+  testing::StopTiming();
+  FixedUnigramSampler sampler(range, ZipfWeights(range), 0.75, 0, 1, 0);
+  std::unique_ptr<thread::ThreadPool> workers;
+  if (num_threads > 1) {
+    workers.reset(
+        new thread::ThreadPool(Env::Default(), "bench", num_threads));
+  }
+  random::PhiloxRandom philox(123, 17);
+  std::vector<int64> batch(kBenchmarkBatch);
+  std::vector<float> expected(kBenchmarkBatch);
+  testing::StartTiming();
+  for (int i = 0; i < iters; i++) {
+    sampler.SampleBatchGetExpectedCountParallel(
+        workers.get(), philox, false, &batch, &expected, ArraySlice<int64>(),
+        MutableArraySlice<float>());
+    philox.Skip(kBenchmarkBatch);
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * kBenchmarkBatch);
+}
+
+static void BM_FixedUnigram_1Thread(int iters, int range) {
+  BM_FixedUnigram(iters, range, 1);
+}
+static void BM_FixedUnigram_8Threads(int iters, int range) {
+  BM_FixedUnigram(iters, range, 8);
+}
+BENCHMARK(BM_FixedUnigram_1Thread)->Range(1 << 10, 16 << 20);
+BENCHMARK(BM_FixedUnigram_8Threads)->Range(1 << 10, 16 << 20);
+
+// Updates with a batch of true classes, then samples, as the
+// LearnedUnigramCandidateSampler op does in every step.
+static void BM_UnigramUpdateAndSample(int iters, int range) {
+  testing::StopTiming();
+  UnigramSampler sampler(range);
+  thread::ThreadPool workers(Env::Default(), "bench", 8);
+  random::PhiloxRandom philox(123, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int64> true_classes(1024);
+  std::vector<int64> batch(kBenchmarkBatch);
+  std::vector<float> expected(kBenchmarkBatch);
+  testing::StartTiming();
+  for (int i = 0; i < iters; i++) {
+    for (int64& c : true_classes) c = rnd.Uniform(range);
+    sampler.SampleBatchGetExpectedCountParallel(
+        &workers, philox, false, &batch, &expected, ArraySlice<int64>(),
+        MutableArraySlice<float>());
+    philox.Skip(kBenchmarkBatch);
+    sampler.Update(true_classes);
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * kBenchmarkBatch);
+}
+BENCHMARK(BM_UnigramUpdateAndSample)->Range(1 << 10, 16 << 20);
+
 }  // namespace
 
 }  // namespace tensorflow
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <string>
 
+#include "tensorflow/core/framework/compact_string_tensor.h"
 #include "tensorflow/core/framework/kernel_def_builder.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -25,7 +26,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
-#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -109,6 +110,9 @@ TensorShape GetOutputShape(gtl::InlinedVector<bool, 8> index_is_reduced,
   return output_shape;
 }
 
+// Rough number of cycles to append one input element to a joined output.
+constexpr int64 kCostPerJoinedElement = 50;
+
 }  // namespace
 
 class ReduceJoinOp : public OpKernel {
@@ -122,7 +126,8 @@ class ReduceJoinOp : public OpKernel {
 
   void Compute(OpKernelContext* context) override {
     const Tensor& input = context->input(0);
-    const auto input_flat = input.flat<string>();
+    // Read through a view so that compact inputs stay compact.
+    const StringTensorView input_flat(input);
     const TensorShape& input_shape = input.shape();
     const int32 input_dims = input_shape.dims();
 
@@ -160,21 +165,48 @@ class ReduceJoinOp : public OpKernel {
 
     const int64 reduction_iter_size =
         GetReductionIterSize(reduced_indices, input_shape);
-    gtl::InlinedVector<StringPiece, 8> curr_strings(reduction_iter_size);
-    for (int64 output_index = 0; output_index < output_shape.num_elements();
-         ++output_index) {
-      int64 output_full_index = LinearSubIndexToFullIndex(
-          output_index, unreduced_indices, input_shape, strides);
-      for (int64 reduction_index = 0; reduction_index < reduction_iter_size;
-           ++reduction_index) {
-        int64 reduction_full_index = LinearSubIndexToFullIndex(
-            reduction_index, reduced_indices, input_shape, strides);
-        curr_strings[reduction_index] =
-            input_flat(output_full_index + reduction_full_index);
-      }
-      output_flat(output_index) =
-          str_util::Join(curr_strings, separator_.c_str());
+    // The offsets of the joined elements relative to the first one are the
+    // same for every output element, so compute them once.
+    std::vector<int64> reduction_offsets(reduction_iter_size);
+    for (int64 reduction_index = 0; reduction_index < reduction_iter_size;
+         ++reduction_index) {
+      reduction_offsets[reduction_index] = LinearSubIndexToFullIndex(
+          reduction_index, reduced_indices, input_shape, strides);
     }
+
+    const StringPiece separator(separator_);
+    auto join_range = [&](int64 start, int64 limit) {
+      for (int64 output_index = start; output_index < limit; ++output_index) {
+        const int64 output_full_index = LinearSubIndexToFullIndex(
+            output_index, unreduced_indices, input_shape, strides);
+        // Size the output exactly before appending, so that each element
+        // costs at most one allocation and no temporaries.
+        size_t joined_size = 0;
+        for (const int64 offset : reduction_offsets) {
+          joined_size += input_flat(output_full_index + offset).size();
+        }
+        if (reduction_iter_size > 0) {
+          joined_size += separator.size() * (reduction_iter_size - 1);
+        }
+        string* joined = &output_flat(output_index);
+        joined->reserve(joined_size);
+        for (int64 reduction_index = 0; reduction_index < reduction_iter_size;
+             ++reduction_index) {
+          if (reduction_index > 0) {
+            joined->append(separator.data(), separator.size());
+          }
+          const StringPiece piece = input_flat(
+              output_full_index + reduction_offsets[reduction_index]);
+          joined->append(piece.data(), piece.size());
+        }
+      }
+    };
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          output_shape.num_elements(),
+          kCostPerJoinedElement * std::max<int64>(reduction_iter_size, 1),
+          join_range);
   }
 
  private:
@@ -0,0 +1,261 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/compact_string_tensor.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+// Counts every heap allocation made by this test binary, so that the tests
+// and benchmarks below can report how many allocations ReduceJoin makes per
+// joined output element.
+static std::atomic<tensorflow::int64> num_allocations(0);
+
+void* operator new(std::size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+namespace tensorflow {
+namespace {
+
+class ReduceJoinOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(bool keep_dims, const string& separator) {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "ReduceJoin")
+                     .Input(FakeInput(DT_STRING))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("keep_dims", keep_dims)
+                     .Attr("separator", separator)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(ReduceJoinOpTest, Basic) {
+  MakeOp(false, "-");
+  AddInputFromArray<string>(TensorShape({2, 3}),
+                            {"a", "b", "c", "d", "e", "f"});
+  AddInputFromArray<int32>(TensorShape({1}), {1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_STRING, TensorShape({2}));
+  test::FillValues<string>(&expected, {"a-b-c", "d-e-f"});
+  test::ExpectTensorEqual<string>(expected, *GetOutput(0));
+}
+
+TEST_F(ReduceJoinOpTest, NegativeAndMultipleIndices) {
+  MakeOp(true, "");
+  AddInputFromArray<string>(TensorShape({2, 2, 2}),
+                            {"a", "b", "c", "d", "e", "f", "g", "h"});
+  AddInputFromArray<int32>(TensorShape({2}), {-1, 0});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_STRING, TensorShape({1, 2, 1}));
+  test::FillValues<string>(&expected, {"abef", "cdgh"});
+  test::ExpectTensorEqual<string>(expected, *GetOutput(0));
+}
+
+TEST_F(ReduceJoinOpTest, EmptyReduction) {
+  MakeOp(false, ",");
+  AddInputFromArray<string>(TensorShape({2, 0}), {});
+  AddInputFromArray<int32>(TensorShape({1}), {1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_STRING, TensorShape({2}));
+  test::FillValues<string>(&expected, {"", ""});
+  test::ExpectTensorEqual<string>(expected, *GetOutput(0));
+}
+
+// Counts the allocations made through it.
+class CountingAllocator : public Allocator {
+ public:
+  string Name() override { return "counting"; }
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    ++num_allocations_;
+    return port::AlignedMalloc(num_bytes, alignment);
+  }
+  void DeallocateRaw(void* ptr) override { port::AlignedFree(ptr); }
+  void GetStats(AllocatorStats* stats) override { stats->Clear(); }
+
+  int num_allocations() const { return num_allocations_; }
+
+ private:
+  int num_allocations_ = 0;
+};
+
+TEST_F(ReduceJoinOpTest, CompactInput) {
+  MakeOp(false, " ");
+  const std::vector<string> values = {"a", "short",
+                                      "a string too long to inline",
+                                      "", "x",
+                                      "another string in the arena"};
+  int64 arena_bytes = 0;
+  for (const string& v : values) {
+    arena_bytes += CompactStringTensorBuilder::ArenaBytes(v.size());
+  }
+  CountingAllocator compact_allocator;
+  CompactStringTensorBuilder builder(&compact_allocator, TensorShape({2, 3}),
+                                     arena_bytes);
+  int64 arena_offset = 0;
+  for (size_t i = 0; i < values.size(); ++i) {
+    builder.Set(i, values[i], arena_offset);
+    arena_offset += CompactStringTensorBuilder::ArenaBytes(values[i].size());
+  }
+  // Declared after the allocator, so that it is released first.
+  Tensor input = builder.Finish();
+  inputs_.push_back({nullptr, &input});
+  AddInputFromArray<int32>(TensorShape({1}), {1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_STRING, TensorShape({2}));
+  test::FillValues<string>(
+      &expected, {"a short a string too long to inline",
+                  " x another string in the arena"});
+  test::ExpectTensorEqual<string>(expected, *GetOutput(0));
+  // The input was read from its slots, without building std::strings.
+  EXPECT_EQ(1, compact_allocator.num_allocations());
+}
+
+// Builds a [num_rows, num_cols] tensor of strings that are too long to be
+// stored inline in a std::string.
+Tensor GetTestStrings(int num_rows, int num_cols) {
+  Tensor input(DT_STRING, TensorShape({num_rows, num_cols}));
+  auto input_flat = input.flat<string>();
+  for (int i = 0; i < num_rows * num_cols; ++i) {
+    input_flat(i) = strings::StrCat("element_number_", i, "_of_the_input");
+  }
+  return input;
+}
+
+TEST_F(ReduceJoinOpTest, ShardedOverOutputs) {
+  // Enough outputs, each joining enough elements, that the kernel splits the
+  // work across the device's worker threads.
+  const int kRows = 4096;
+  const int kCols = 16;
+  MakeOp(false, ", ");
+  Tensor input = GetTestStrings(kRows, kCols);
+  AddInputFromArray<string>(
+      input.shape(),
+      gtl::ArraySlice<string>(input.flat<string>().data(), kRows * kCols));
+  AddInputFromArray<int32>(TensorShape({1}), {1});
+
+  const int64 allocations_before = num_allocations.load();
+  TF_ASSERT_OK(RunOpKernel());
+  const int64 allocations = num_allocations.load() - allocations_before;
+
+  Tensor expected(allocator(), DT_STRING, TensorShape({kRows}));
+  const auto input_matrix = input.matrix<string>();
+  for (int i = 0; i < kRows; ++i) {
+    std::vector<string> row;
+    for (int j = 0; j < kCols; ++j) row.push_back(input_matrix(i, j));
+    expected.flat<string>()(i) = str_util::Join(row, ", ");
+  }
+  test::ExpectTensorEqual<string>(expected, *GetOutput(0));
+
+  // Each joined string is sized once; growing it piece by piece would take
+  // several allocations per output. The slack covers the kernel context and
+  // the sharding closures.
+  EXPECT_LT(allocations, kRows + kRows / 2);
+}
+
+TEST_F(ReduceJoinOpTest, ShardedOverOuterDimension) {
+  // Reducing the outer dimension strides through the input, so each output
+  // gathers elements that are far apart.
+  const int kRows = 64;
+  const int kCols = 1024;
+  MakeOp(true, "|");
+  Tensor input = GetTestStrings(kRows, kCols);
+  AddInputFromArray<string>(
+      input.shape(),
+      gtl::ArraySlice<string>(input.flat<string>().data(), kRows * kCols));
+  AddInputFromArray<int32>(TensorShape({1}), {0});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_STRING, TensorShape({1, kCols}));
+  const auto input_matrix = input.matrix<string>();
+  for (int j = 0; j < kCols; ++j) {
+    std::vector<string> column;
+    for (int i = 0; i < kRows; ++i) column.push_back(input_matrix(i, j));
+    expected.flat<string>()(j) = str_util::Join(column, "|");
+  }
+  test::ExpectTensorEqual<string>(expected, *GetOutput(0));
+}
+
+Graph* SetupReduceJoinGraph(const Tensor& input, int32 axis) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor reduction_indices(DT_INT32, TensorShape({1}));
+  reduction_indices.flat<int32>()(0) = axis;
+
+  TF_CHECK_OK(NodeBuilder("reduce_join_op", "ReduceJoin")
+                  .Input(test::graph::Constant(g, input))
+                  .Input(test::graph::Constant(g, reduction_indices))
+                  .Attr("separator", " ")
+                  .Finalize(g, nullptr /* node */));
+  return g;
+}
+
+static void BM_ReduceJoin(int iters, int num_rows, int num_cols) {
+  testing::StopTiming();
+  Tensor input = GetTestStrings(num_rows, num_cols);
+  int64 bytes = 0;
+  for (int i = 0; i < num_rows * num_cols; ++i) {
+    bytes += input.flat<string>()(i).size();
+  }
+  Graph* g = SetupReduceJoinGraph(input, 1);
+  testing::BytesProcessed(static_cast<int64>(iters) * bytes);
+  testing::UseRealTime();
+  test::Benchmark benchmark("cpu", g);
+  const int64 allocations_before = num_allocations.load();
+  testing::StartTiming();
+  benchmark.Run(iters);
+  testing::StopTiming();
+  // Includes the executor's own per-step allocations, which dominate when
+  // there are few outputs.
+  const int64 allocations = num_allocations.load() - allocations_before;
+  testing::SetLabel(strings::Printf(
+      "%.2f allocs/output",
+      static_cast<double>(allocations) /
+          (static_cast<double>(iters) * num_rows)));
+}
+
+BENCHMARK(BM_ReduceJoin)
+    ->ArgPair(1, 1024)
+    ->ArgPair(64, 16)
+    ->ArgPair(1024, 16)
+    ->ArgPair(1024, 256)
+    ->ArgPair(16 * 1024, 16);
+
+}  // namespace
+}  // namespace tensorflow
@@ -31,10 +31,12 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/kernels/reduction_ops.h"
+#include "tensorflow/core/kernels/reduction_ops_cpu.h"
 #include "tensorflow/core/kernels/transpose_functor.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
@@ -129,6 +131,53 @@ class ReductionHelper {
   gtl::InlinedVector<int64, 4> out_reshape_;   // Reshape output for reduction.
 };
 
+// Runs the reduction on the CPU reduction engine (reduction_ops_cpu.h) when
+// the device, type, reducer and simplified geometry are all supported.
+// Returns false, without touching 'out', otherwise.
+template <typename Device, typename T, typename Reducer,
+          typename Enable = void>
+struct CpuReductionEngine {
+  static bool Run(OpKernelContext* ctx, const ReductionHelper& helper,
+                  const Tensor& data, Tensor* out) {
+    return false;
+  }
+};
+
+template <typename T, typename Reducer>
+struct CpuReductionEngine<
+    CPUDevice, T, Reducer,
+    typename std::enable_if<
+        functor::CpuReductionFor<T, Reducer>::kSupported>::type> {
+  static bool Run(OpKernelContext* ctx, const ReductionHelper& helper,
+                  const Tensor& data, Tensor* out) {
+    const TensorShape shape = helper.data_reshape();
+    int64 outer, reduce, inner;
+    if (helper.ndims() == 2 && helper.reduce_first_axis()) {
+      outer = 1;
+      reduce = shape.dim_size(0);
+      inner = shape.dim_size(1);
+    } else if (helper.ndims() == 2) {
+      outer = shape.dim_size(0);
+      reduce = shape.dim_size(1);
+      inner = 1;
+    } else if (helper.ndims() == 3 && !helper.reduce_first_axis()) {
+      outer = shape.dim_size(0);
+      reduce = shape.dim_size(1);
+      inner = shape.dim_size(2);
+    } else {
+      // Full reductions are already parallel in Eigen, and the remaining
+      // shapes are transposed first.
+      return false;
+    }
+    typedef typename functor::CpuReductionFor<T, Reducer>::Reduction
+        Reduction;
+    functor::ReduceMiddleAxisCPU<T, Reduction>(
+        *ctx->device()->tensorflow_cpu_worker_threads(), data.flat<T>().data(),
+        outer, reduce, inner, out->flat<T>().data());
+    return true;
+  }
+};
+
 // For operations where the output is a reduction function along some
 // dimensions of the input.
 template <typename Device, class T, typename Reducer>
@@ -139,6 +188,10 @@ class ReductionOp : public OpKernel {
     OP_REQUIRES_OK(ctx, ctx->MatchSignature({dt, DT_INT32}, {dt}));
 
     OP_REQUIRES_OK(ctx, ctx->GetAttr("keep_dims", &keep_dims_));
+    // Setting TF_USE_CPU_REDUCTION_ENGINE=0 keeps every reduction on the
+    // Eigen path, e.g. to compare the two.
+    OP_REQUIRES_OK(ctx, ReadBoolFromEnvVar("TF_USE_CPU_REDUCTION_ENGINE", true,
+                                           &use_cpu_reduction_engine_));
   }
 
   void Compute(OpKernelContext* ctx) override {
@@ -188,6 +241,10 @@ class ReductionOp : public OpKernel {
       // with identity elements.  Example: tf.reduce_sum(tf.zeros((0, 3)), [0]).
       // Eigen sometimes crashes in this case, so we do it manually.
       Functor::FillIdentity(d, tmp_out.flat<T>(), reducer);
+    } else if (use_cpu_reduction_engine_ &&
+               CpuReductionEngine<Device, T, Reducer>::Run(ctx, helper, data,
+                                                           &tmp_out)) {
+      // Reduced by the cache-blocked CPU engine.
     } else if ((helper.ndims() == 1) && helper.reduce_first_axis()) {
       // Reduce to a scalar.
       Functor::Reduce(d, helper.out<T, 0>(&tmp_out), helper.in<T, 1>(data),
@@ -241,6 +298,8 @@ class ReductionOp : public OpKernel {
  private:
   // True if the number of dimensions should be maintained.
   bool keep_dims_;
+  // True if supported CPU reductions may use CpuReductionEngine.
+  bool use_cpu_reduction_engine_;
 };
 
 namespace functor {
@@ -0,0 +1,251 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Cache-blocked, multithreaded CPU reductions over the middle axis of an
+// [outer, reduce, inner] view of a tensor. This covers the reductions that
+// ReductionHelper simplifies to "reduce the rows of a matrix", "reduce the
+// columns of a matrix" and "reduce the middle axis of a 3-D tensor", without
+// going through Eigen's generic tensor reduction evaluator.
+//
+// The work is split by geometry:
+//  * inner == 1: every output is a contiguous run of the input, reduced with
+//    a vectorized Eigen array reduction.
+//  * inner > 1: outputs are processed in blocks of columns small enough for
+//    their accumulators to stay in L1 while the reduced rows stream by.
+//  * When there are too few such units to keep the worker threads busy, the
+//    reduced axis is split into chunks as well, and the partial results are
+//    merged in a second pass.
+
+#ifndef TENSORFLOW_KERNELS_REDUCTION_OPS_CPU_H_
+#define TENSORFLOW_KERNELS_REDUCTION_OPS_CPU_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+namespace functor {
+
+namespace internal {
+
+template <typename T>
+using ReductionVec = Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>>;
+template <typename T>
+using ConstReductionVec = Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>;
+
+}  // namespace internal
+
+// A reduction keeps one accumulator per output element:
+//
+//   Init(n, acc):          sets acc[i] to the identity, for i in [0, n).
+//   Accumulate(in, n, acc):
+//                          folds in[i] into acc[i].
+//   AccumulateContiguous(in, n, acc):
+//                          folds all of in[0, n) into acc[0].
+//   Merge(partial, n, acc):
+//                          folds the partial results partial[i] into acc[i].
+//   Finalize(count, n, acc):
+//                          turns accumulators over 'count' inputs into the
+//                          final outputs.
+template <typename T>
+struct SumReduction {
+  static void Init(int64 n, T* acc) {
+    internal::ReductionVec<T>(acc, n).setZero();
+  }
+  static void Accumulate(const T* in, int64 n, T* acc) {
+    internal::ReductionVec<T>(acc, n) += internal::ConstReductionVec<T>(in, n);
+  }
+  static void AccumulateContiguous(const T* in, int64 n, T* acc) {
+    acc[0] += internal::ConstReductionVec<T>(in, n).sum();
+  }
+  static void Merge(const T* partial, int64 n, T* acc) {
+    Accumulate(partial, n, acc);
+  }
+  static void Finalize(int64 count, int64 n, T* acc) {}
+};
+
+template <typename T>
+struct MeanReduction : SumReduction<T> {
+  static void Finalize(int64 count, int64 n, T* acc) {
+    internal::ReductionVec<T>(acc, n) /= static_cast<T>(count);
+  }
+};
+
+template <typename T>
+struct ProdReduction {
+  static void Init(int64 n, T* acc) {
+    internal::ReductionVec<T>(acc, n).setOnes();
+  }
+  static void Accumulate(const T* in, int64 n, T* acc) {
+    internal::ReductionVec<T>(acc, n) *= internal::ConstReductionVec<T>(in, n);
+  }
+  static void AccumulateContiguous(const T* in, int64 n, T* acc) {
+    acc[0] *= internal::ConstReductionVec<T>(in, n).prod();
+  }
+  static void Merge(const T* partial, int64 n, T* acc) {
+    Accumulate(partial, n, acc);
+  }
+  static void Finalize(int64 count, int64 n, T* acc) {}
+};
+
+// Max and Min start from the same identity as the Eigen reducers so that
+// results agree with the Eigen path, including for empty slices.
+template <typename T>
+struct MaxReduction {
+  static void Init(int64 n, T* acc) {
+    internal::ReductionVec<T>(acc, n)
+        .setConstant(Eigen::internal::MaxReducer<T>().initialize());
+  }
+  static void Accumulate(const T* in, int64 n, T* acc) {
+    internal::ReductionVec<T> a(acc, n);
+    a = a.max(internal::ConstReductionVec<T>(in, n));
+  }
+  static void AccumulateContiguous(const T* in, int64 n, T* acc) {
+    const T m = internal::ConstReductionVec<T>(in, n).maxCoeff();
+    if (m > acc[0]) acc[0] = m;
+  }
+  static void Merge(const T* partial, int64 n, T* acc) {
+    Accumulate(partial, n, acc);
+  }
+  static void Finalize(int64 count, int64 n, T* acc) {}
+};
+
+template <typename T>
+struct MinReduction {
+  static void Init(int64 n, T* acc) {
+    internal::ReductionVec<T>(acc, n)
+        .setConstant(Eigen::internal::MinReducer<T>().initialize());
+  }
+  static void Accumulate(const T* in, int64 n, T* acc) {
+    internal::ReductionVec<T> a(acc, n);
+    a = a.min(internal::ConstReductionVec<T>(in, n));
+  }
+  static void AccumulateContiguous(const T* in, int64 n, T* acc) {
+    const T m = internal::ConstReductionVec<T>(in, n).minCoeff();
+    if (m < acc[0]) acc[0] = m;
+  }
+  static void Merge(const T* partial, int64 n, T* acc) {
+    Accumulate(partial, n, acc);
+  }
+  static void Finalize(int64 count, int64 n, T* acc) {}
+};
+
+// Maps the Eigen reducers used by ReductionOp to the reductions above. Only
+// float and double are handled; everything else stays on the Eigen path.
+template <typename T, typename Reducer>
+struct CpuReductionFor {
+  static constexpr bool kSupported = false;
+};
+
+#define TF_CPU_REDUCTION_FOR(T, EIGEN_REDUCER, REDUCTION)         \
+  template <>                                                     \
+  struct CpuReductionFor<T, Eigen::internal::EIGEN_REDUCER<T>> { \
+    static constexpr bool kSupported = true;                      \
+    typedef REDUCTION<T> Reduction;                               \
+  };
+#define TF_CPU_REDUCTIONS_FOR(T)                        \
+  TF_CPU_REDUCTION_FOR(T, SumReducer, SumReduction)     \
+  TF_CPU_REDUCTION_FOR(T, MeanReducer, MeanReduction)   \
+  TF_CPU_REDUCTION_FOR(T, ProdReducer, ProdReduction)   \
+  TF_CPU_REDUCTION_FOR(T, MaxReducer, MaxReduction)     \
+  TF_CPU_REDUCTION_FOR(T, MinReducer, MinReduction)
+TF_CPU_REDUCTIONS_FOR(float)
+TF_CPU_REDUCTIONS_FOR(double)
+#undef TF_CPU_REDUCTIONS_FOR
+#undef TF_CPU_REDUCTION_FOR
+
+// Reduces 'in', viewed as [outer, reduce, inner], over its middle axis into
+// the [outer, inner] tensor 'out'. Requires reduce > 0.
+template <typename T, typename Reduction>
+void ReduceMiddleAxisCPU(const DeviceBase::CpuWorkerThreads& worker_threads,
+                         const T* in, int64 outer, int64 reduce, int64 inner,
+                         T* out) {
+  // Bytes of accumulators per column block; keeps them resident in L1.
+  static const int64 kInnerBlockBytes = 16 << 10;
+  // Smallest number of input values worth handing to a thread on its own.
+  static const int64 kMinValuesPerUnit = 16 << 10;
+
+  const int64 plane = outer * inner;
+  const int64 inner_block = std::min<int64>(
+      inner, std::max<int64>(1, kInnerBlockBytes / sizeof(T)));
+  const int64 num_blocks = (inner + inner_block - 1) / inner_block;
+  const int64 num_units = outer * num_blocks;
+
+  // Split the reduced axis too when there are not enough independent output
+  // blocks to occupy every thread.
+  int64 num_chunks = 1;
+  const int64 target_units = 4 * std::max(1, worker_threads.num_threads);
+  if (num_units < target_units) {
+    const int64 min_rows_per_chunk =
+        std::max<int64>(1, kMinValuesPerUnit / inner_block);
+    num_chunks = std::min((target_units + num_units - 1) / num_units,
+                          std::max<int64>(1, reduce / min_rows_per_chunk));
+  }
+  const int64 rows_per_chunk = (reduce + num_chunks - 1) / num_chunks;
+  num_chunks = (reduce + rows_per_chunk - 1) / rows_per_chunk;
+
+  // Chunk 0 accumulates straight into 'out'; the others get scratch planes
+  // that are merged into it afterwards.
+  std::vector<T> partials((num_chunks - 1) * plane);
+
+  auto reduce_units = [&](int64 start, int64 limit) {
+    for (int64 u = start; u < limit; ++u) {
+      const int64 chunk = u % num_chunks;
+      const int64 o = u / num_chunks / num_blocks;
+      const int64 i0 = (u / num_chunks % num_blocks) * inner_block;
+      const int64 n = std::min(inner_block, inner - i0);
+      const int64 r0 = chunk * rows_per_chunk;
+      const int64 r1 = std::min(reduce, r0 + rows_per_chunk);
+
+      T* acc = (chunk == 0 ? out : partials.data() + (chunk - 1) * plane) +
+               o * inner + i0;
+      const T* src = in + o * reduce * inner + i0;
+      Reduction::Init(n, acc);
+      if (inner == 1) {
+        Reduction::AccumulateContiguous(src + r0, r1 - r0, acc);
+      } else {
+        for (int64 r = r0; r < r1; ++r) {
+          Reduction::Accumulate(src + r * inner, n, acc);
+        }
+      }
+      if (num_chunks == 1) Reduction::Finalize(reduce, n, acc);
+    }
+  };
+  Shard(worker_threads.num_threads, worker_threads.workers,
+        num_units * num_chunks,
+        std::max<int64>(1, rows_per_chunk * inner_block), reduce_units);
+
+  if (num_chunks > 1) {
+    auto merge_partials = [&](int64 start, int64 limit) {
+      for (int64 chunk = 1; chunk < num_chunks; ++chunk) {
+        Reduction::Merge(partials.data() + (chunk - 1) * plane + start,
+                         limit - start, out + start);
+      }
+      Reduction::Finalize(reduce, limit - start, out + start);
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, plane,
+          num_chunks, merge_partials);
+  }
+}
+
+}  // namespace functor
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_REDUCTION_OPS_CPU_H_
@@ -13,8 +13,19 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <stdlib.h>
+
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/reduction_ops_cpu.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 
@@ -84,4 +95,232 @@ static void BM_Mean3DToScalarGPU(int iters, int num) {
 }
 BENCHMARK(BM_Mean3DToScalarGPU)->Range(1 << 13, 1 << 20);
 
+// Checks ReduceMiddleAxisCPU against a naive reduction for geometries that
+// exercise row, column-block and split-axis strategies. Inputs are drawn
+// uniformly from [center - spread / 2, center + spread / 2).
+template <typename Reduction, typename Naive>
+static void CheckMiddleAxisReduction(int64 outer, int64 reduce, int64 inner,
+                                     double center, double spread,
+                                     Naive naive) {
+  thread::ThreadPool pool(Env::Default(), "reduction_test", 4);
+  DeviceBase::CpuWorkerThreads worker_threads;
+  worker_threads.num_threads = 4;
+  worker_threads.workers = &pool;
+
+  random::PhiloxRandom philox(outer * 1000 + inner, reduce);
+  random::SimplePhilox rnd(&philox);
+  std::vector<double> in(outer * reduce * inner);
+  for (double& x : in) x = center + spread * (rnd.RandDouble() - 0.5);
+  std::vector<double> out(outer * inner);
+  functor::ReduceMiddleAxisCPU<double, Reduction>(
+      worker_threads, in.data(), outer, reduce, inner, out.data());
+
+  for (int64 o = 0; o < outer; ++o) {
+    for (int64 i = 0; i < inner; ++i) {
+      double expected = naive(&in[o * reduce * inner + i], reduce, inner);
+      EXPECT_NEAR(expected, out[o * inner + i], 1e-9)
+          << "at (" << o << ", " << i << ") of [" << outer << ", " << reduce
+          << ", " << inner << "]";
+    }
+  }
+}
+
+static const int64 kMiddleAxisShapes[][3] = {
+    {1, 100000, 1}, {3, 50000, 1}, {1000, 7, 1},   {1, 300, 5000},
+    {2, 40000, 3},  {17, 33, 65},  {5, 2, 9000},   {64, 1, 64}};
+
+TEST(ReduceMiddleAxisCPUTest, Sum) {
+  for (const auto& s : kMiddleAxisShapes) {
+    CheckMiddleAxisReduction<functor::SumReduction<double>>(
+        s[0], s[1], s[2], 0, 1, [](const double* p, int64 n, int64 stride) {
+          double sum = 0;
+          for (int64 r = 0; r < n; ++r) sum += p[r * stride];
+          return sum;
+        });
+  }
+}
+
+TEST(ReduceMiddleAxisCPUTest, Mean) {
+  for (const auto& s : kMiddleAxisShapes) {
+    CheckMiddleAxisReduction<functor::MeanReduction<double>>(
+        s[0], s[1], s[2], 0, 1, [](const double* p, int64 n, int64 stride) {
+          double sum = 0;
+          for (int64 r = 0; r < n; ++r) sum += p[r * stride];
+          return sum / n;
+        });
+  }
+}
+
+TEST(ReduceMiddleAxisCPUTest, Prod) {
+  // Values close to 1 keep long products in range.
+  for (const auto& s : kMiddleAxisShapes) {
+    CheckMiddleAxisReduction<functor::ProdReduction<double>>(
+        s[0], s[1], s[2], 1, 0.01, [](const double* p, int64 n, int64 stride) {
+          double prod = 1;
+          for (int64 r = 0; r < n; ++r) prod *= p[r * stride];
+          return prod;
+        });
+  }
+}
+
+TEST(ReduceMiddleAxisCPUTest, Max) {
+  for (const auto& s : kMiddleAxisShapes) {
+    CheckMiddleAxisReduction<functor::MaxReduction<double>>(
+        s[0], s[1], s[2], 0, 1, [](const double* p, int64 n, int64 stride) {
+          double m = p[0];
+          for (int64 r = 1; r < n; ++r) m = std::max(m, p[r * stride]);
+          return m;
+        });
+  }
+}
+
+TEST(ReduceMiddleAxisCPUTest, Min) {
+  for (const auto& s : kMiddleAxisShapes) {
+    CheckMiddleAxisReduction<functor::MinReduction<double>>(
+        s[0], s[1], s[2], 0, 1, [](const double* p, int64 n, int64 stride) {
+          double m = p[0];
+          for (int64 r = 1; r < n; ++r) m = std::min(m, p[r * stride]);
+          return m;
+        });
+  }
+}
+
+class ReductionOpTest : public OpsTestBase {
+ protected:
+  // Runs "reduce" over "axes" of "data", through the CPU reduction engine if
+  // "use_engine" is true and through the Eigen path otherwise.
+  Tensor Reduce(const string& reduce, const Tensor& data,
+                const std::vector<int32>& axes, bool use_engine) {
+    // ReductionOp reads the variable when the kernel is constructed.
+    setenv("TF_USE_CPU_REDUCTION_ENGINE", use_engine ? "1" : "0", 1);
+    TF_CHECK_OK(NodeDefBuilder("reduce", reduce)
+                    .Input(FakeInput(DT_FLOAT))
+                    .Input(FakeInput(DT_INT32))
+                    .Attr("keep_dims", false)
+                    .Finalize(node_def()));
+    TF_CHECK_OK(InitOp());
+    unsetenv("TF_USE_CPU_REDUCTION_ENGINE");
+
+    inputs_.clear();
+    AddInputFromArray<float>(
+        data.shape(),
+        gtl::ArraySlice<float>(data.flat<float>().data(), data.NumElements()));
+    AddInputFromArray<int32>(TensorShape({static_cast<int64>(axes.size())}),
+                             axes);
+    TF_CHECK_OK(RunOpKernel());
+    return *GetOutput(0);
+  }
+
+  // Checks that the engine and Eigen agree on "reduce" over "axes" of a
+  // [d0, d1, d2] tensor drawn uniformly from
+  // [center - spread / 2, center + spread / 2).
+  void CheckEngineMatchesEigen(const string& reduce, int d0, int d1, int d2,
+                               const std::vector<int32>& axes, float center,
+                               float spread) {
+    Tensor data(DT_FLOAT, TensorShape({d0, d1, d2}));
+    random::PhiloxRandom philox(d0 * 1000 + d2, d1);
+    random::SimplePhilox rnd(&philox);
+    auto flat = data.flat<float>();
+    for (int64 i = 0; i < flat.size(); ++i) {
+      flat(i) = center + spread * (rnd.RandFloat() - 0.5f);
+    }
+    const Tensor expected = Reduce(reduce, data, axes, false);
+    const Tensor actual = Reduce(reduce, data, axes, true);
+    test::ExpectClose(expected, actual, 1e-3, 1e-4);
+  }
+
+  // Covers every geometry the engine takes over from Eigen.
+  void CheckAllGeometries(const string& reduce, float center, float spread) {
+    // Rows: [64, 1000] and [2, 40000], the latter split along the rows.
+    CheckEngineMatchesEigen(reduce, 64, 1000, 1, {1}, center, spread);
+    CheckEngineMatchesEigen(reduce, 2, 40000, 1, {1}, center, spread);
+    // Columns: [1000, 64] and [300, 5000], the latter in column blocks.
+    CheckEngineMatchesEigen(reduce, 1000, 64, 1, {0}, center, spread);
+    CheckEngineMatchesEigen(reduce, 300, 5000, 1, {0}, center, spread);
+    // Middle axis: [8, 300, 40] and [2, 20000, 3], the latter split.
+    CheckEngineMatchesEigen(reduce, 8, 300, 40, {1}, center, spread);
+    CheckEngineMatchesEigen(reduce, 2, 20000, 3, {1}, center, spread);
+  }
+};
+
+TEST_F(ReductionOpTest, SumEngineMatchesEigen) {
+  CheckAllGeometries("Sum", 0, 1);
+}
+
+TEST_F(ReductionOpTest, MeanEngineMatchesEigen) {
+  CheckAllGeometries("Mean", 0, 1);
+}
+
+TEST_F(ReductionOpTest, ProdEngineMatchesEigen) {
+  // Values close to 1 keep long products in range.
+  CheckAllGeometries("Prod", 1, 0.01);
+}
+
+TEST_F(ReductionOpTest, MaxEngineMatchesEigen) {
+  CheckAllGeometries("Max", 0, 1);
+}
+
+TEST_F(ReductionOpTest, MinEngineMatchesEigen) {
+  CheckAllGeometries("Min", 0, 1);
+}
+
+// Creates a Graph which "reduce"s a [d0, d1, d2] float tensor over "axes".
+static Graph* ReduceAxes(const string& reduce, int d0, int d1, int d2,
+                         const std::vector<int32>& axes) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor data(DT_FLOAT, TensorShape({d0, d1, d2}));
+  data.flat<float>().setRandom();
+  Tensor axes_t(DT_INT32, TensorShape({static_cast<int64>(axes.size())}));
+  for (size_t i = 0; i < axes.size(); ++i) axes_t.flat<int32>()(i) = axes[i];
+  test::graph::Reduce(g, reduce, test::graph::Constant(g, data),
+                      test::graph::Constant(g, axes_t));
+  return g;
+}
+
+// Reduces a [d0, d1, d2] tensor over "axes" on the CPU, either through the
+// CPU reduction engine or through the Eigen path it replaces.
+static void ReduceAxesCPU(int iters, bool use_engine, const string& reduce,
+                          int d0, int d1, int d2,
+                          const std::vector<int32>& axes) {
+  testing::StopTiming();
+  setenv("TF_USE_CPU_REDUCTION_ENGINE", use_engine ? "1" : "0", 1);
+  const int64 num = static_cast<int64>(d0) * d1 * d2;
+  testing::ItemsProcessed(static_cast<int64>(iters) * num);
+  testing::BytesProcessed(static_cast<int64>(iters) * num * sizeof(float));
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", ReduceAxes(reduce, d0, d1, d2, axes)).Run(iters);
+  testing::StopTiming();
+  unsetenv("TF_USE_CPU_REDUCTION_ENGINE");
+}
+
+// Benchmark matrix over reduction geometries:
+//   ManyShortRows: [65536, 16] reduced over its rows.
+//   FewLongRows:   [16, 65536] reduced over its rows.
+//   Columns:       [4096, 256] reduced over its columns.
+//   Middle:        [64, 1024, 64] and [512, 32, 256] reduced over axis 1.
+#define BM_REDUCE_AXES(REDUCE, NAME, D0, D1, D2, ...)                    \
+  static void BM_##REDUCE##_##NAME##_Engine(int iters) {                \
+    ReduceAxesCPU(iters, true, #REDUCE, D0, D1, D2, {__VA_ARGS__});     \
+  }                                                                      \
+  BENCHMARK(BM_##REDUCE##_##NAME##_Engine);                              \
+  static void BM_##REDUCE##_##NAME##_Eigen(int iters) {                 \
+    ReduceAxesCPU(iters, false, #REDUCE, D0, D1, D2, {__VA_ARGS__});    \
+  }                                                                      \
+  BENCHMARK(BM_##REDUCE##_##NAME##_Eigen);
+
+#define BM_REDUCE_AXES_ALL(REDUCE)                          \
+  BM_REDUCE_AXES(REDUCE, ManyShortRows, 65536, 16, 1, 1)    \
+  BM_REDUCE_AXES(REDUCE, FewLongRows, 16, 65536, 1, 1)      \
+  BM_REDUCE_AXES(REDUCE, Columns, 4096, 256, 1, 0)          \
+  BM_REDUCE_AXES(REDUCE, Middle64x1024x64, 64, 1024, 64, 1) \
+  BM_REDUCE_AXES(REDUCE, Middle512x32x256, 512, 32, 256, 1)
+
+BM_REDUCE_AXES_ALL(Sum);
+BM_REDUCE_AXES_ALL(Mean);
+BM_REDUCE_AXES_ALL(Max);
+
+#undef BM_REDUCE_AXES_ALL
+#undef BM_REDUCE_AXES
+
 }  // end namespace tensorflow
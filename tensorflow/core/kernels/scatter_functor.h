@@ -16,10 +16,14 @@ limitations under the License.
 #ifndef TENSORFLOW_KERNELS_SCATTER_FUNCTOR_H_
 #define TENSORFLOW_KERNELS_SCATTER_FUNCTOR_H_
 
+#include <algorithm>
+#include <functional>
 #include <type_traits>
+#include <vector>
 
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/platform/prefetch.h"
 #include "tensorflow/core/platform/types.h"
 
 namespace tensorflow {
@@ -146,9 +150,101 @@ struct ScatterFunctorBase<CPUDevice, T, Index, scatter_op::UpdateOp::ASSIGN> {
   }
 };
 
+// Below this many updated elements a scatter runs on the calling thread.
+constexpr int64 kParallelScatterMinElements = 32 * 1024;
+
+// Updates ahead of the one being applied whose rows are prefetched.
+constexpr int kScatterPrefetchDistance = 4;
+
+// Runs 'work' over all updates on the threads of 'd', where update i writes
+// row rows[i] of a tensor with 'num_rows' rows.  The rows are cut into
+// contiguous ranges, and 'work' receives the positions of all the updates of
+// one range, in their original order: no two calls touch the same row, and
+// repeated rows still see their updates in sequence, so the result matches a
+// serial scatter without any locking.  Templated on the device so that this
+// header still compiles where Eigen's thread pool device is not defined.
+template <typename Device, typename Index>
+void ParallelScatter(
+    const Device& d, const std::vector<Index>& rows, Index num_rows,
+    int64 bytes_per_update,
+    const std::function<void(const Index* begin, const Index* end)>& work) {
+  const int64 num_groups =
+      std::min<int64>(4 * d.numThreads(), static_cast<int64>(num_rows));
+  auto group_of = [num_rows, num_groups](Index row) {
+    return static_cast<int64>(row) * num_groups / num_rows;
+  };
+  // Counting sort of the update positions by group.
+  std::vector<Index> group_start(num_groups + 1, 0);
+  for (const Index row : rows) ++group_start[group_of(row) + 1];
+  for (int64 g = 0; g < num_groups; ++g) group_start[g + 1] += group_start[g];
+  std::vector<Index> order(rows.size());
+  std::vector<Index> next(group_start.begin(), group_start.end() - 1);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    order[next[group_of(rows[i])]++] = static_cast<Index>(i);
+  }
+
+  const double bytes_per_group =
+      static_cast<double>(bytes_per_update) * rows.size() / num_groups;
+  d.parallelFor(num_groups,
+                Eigen::TensorOpCost(bytes_per_group, bytes_per_group, 0),
+                [&order, &group_start, &work](int64 begin, int64 end) {
+                  for (int64 g = begin; g < end; ++g) {
+                    work(order.data() + group_start[g],
+                         order.data() + group_start[g + 1]);
+                  }
+                });
+}
+
+// Large scatters validate and copy all indices first, then apply the updates
+// in parallel through ParallelScatter.  Unlike the serial version, no update
+// is applied if any index is out of bounds.
 template <typename T, typename Index, scatter_op::UpdateOp op>
-struct ScatterFunctor<CPUDevice, T, Index, op>
-        : ScatterFunctorBase<CPUDevice, T, Index, op>{};
+struct ScatterFunctor<CPUDevice, T, Index, op> {
+  Index operator()(OpKernelContext* c, const CPUDevice& d,
+                   typename TTypes<T>::Matrix params,
+                   typename TTypes<T>::ConstMatrix updates,
+                   typename TTypes<Index>::ConstFlat indices) {
+    const Index N = static_cast<Index>(indices.size());
+    const Index limit = static_cast<Index>(params.dimension(0));
+    const int64 slice_elems = updates.dimension(1);
+    if (static_cast<int64>(N) * slice_elems < kParallelScatterMinElements) {
+      return ScatterFunctorBase<CPUDevice, T, Index, op>()(c, d, params,
+                                                           updates, indices);
+    }
+    // Only the validated copy is used from here on, so indices changing
+    // underneath us cannot get past the bounds check.
+    std::vector<Index> rows(N);
+    for (Index i = 0; i < N; i++) {
+      const Index index = ::tensorflow::internal::SubtleMustCopy(indices(i));
+      if (!FastBoundsCheck(index, limit)) return i;
+      rows[i] = index;
+    }
+    const int64 slice_bytes = slice_elems * sizeof(T);
+    auto work = [&params, &updates, &rows, slice_elems, slice_bytes](
+        const Index* begin, const Index* end) {
+      for (const Index* it = begin; it != end; ++it) {
+        if (end - it > kScatterPrefetchDistance) {
+          const Index ahead = it[kScatterPrefetchDistance];
+          port::prefetch<port::PREFETCH_HINT_T0>(params.data() +
+                                                 rows[ahead] * slice_elems);
+          port::prefetch<port::PREFETCH_HINT_T0>(updates.data() +
+                                                 ahead * slice_elems);
+        }
+        const Index i = *it;
+        if (op == scatter_op::UpdateOp::ASSIGN &&
+            !std::is_same<T, string>::value) {
+          memmove(params.data() + rows[i] * slice_elems,
+                  updates.data() + i * slice_elems, slice_bytes);
+        } else {
+          scatter_op::internal::Assign<op>::Run(
+              params.template chip<0>(rows[i]), updates.template chip<0>(i));
+        }
+      }
+    };
+    ParallelScatter<CPUDevice, Index>(d, rows, limit, slice_bytes, work);
+    return -1;
+  }
+};
 #if TENSORFLOW_USE_SYCL
 template<typename T, typename Index, scatter_op::UpdateOp op>
 struct ScatterFunctor<SYCLDevice, T, Index, op>
@@ -21,6 +21,7 @@ limitations under the License.
 #define EIGEN_USE_THREADS
 
 #include <atomic>
+#include <vector>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 
@@ -30,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/kernels/fill_functor.h"
+#include "tensorflow/core/kernels/scatter_functor.h"
 #include "tensorflow/core/kernels/scatter_nd_op.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
@@ -127,6 +129,46 @@ struct ScatterNdFunctor<CPUDevice, T, Index, OP, IXDIM> {
       }
     }
 
+    // Large scatters flatten and validate all indices first and then apply
+    // the updates in parallel; no update is applied if any index is bad.
+    if (static_cast<int64>(batch_size) * slice_size >=
+        kParallelScatterMinElements) {
+      std::vector<Index> rows(batch_size);
+      for (Eigen::DenseIndex loc = 0; loc < batch_size; ++loc) {
+        Index i = 0;
+        bool out_of_bounds = false;
+        for (int dim = 0; dim < IXDIM; ++dim) {
+          const Index ix_d = internal::SubtleMustCopy(Tindices(loc, dim));
+          out_of_bounds |= !FastBoundsCheck(ix_d, output_shape_prefix[dim]);
+          i += ix_d * batch_strides[dim];
+        }
+        if (TF_PREDICT_FALSE(out_of_bounds)) return loc;
+        rows[loc] = i;
+      }
+      auto work = [&Toutput, &Tupdates, &rows, slice_size](const Index* begin,
+                                                           const Index* end) {
+        for (const Index* it = begin; it != end; ++it) {
+          if (end - it > kScatterPrefetchDistance) {
+            const Index ahead = it[kScatterPrefetchDistance];
+            port::prefetch<port::PREFETCH_HINT_T0>(
+                Toutput.data() + static_cast<int64>(rows[ahead]) * slice_size);
+            port::prefetch<port::PREFETCH_HINT_T0>(
+                Tupdates.data() + static_cast<int64>(ahead) * slice_size);
+          }
+          auto output_chip = Toutput.template chip<0>(rows[*it]);
+          auto update_chip = Tupdates.template chip<0>(*it);
+          update_executor::UpdateExecutor<
+              decltype(output_chip), decltype(update_chip),
+              decltype(output_chip), OP>::Execute(output_chip, update_chip,
+                                                  output_chip);
+        }
+      };
+      ParallelScatter<CPUDevice, Index>(
+          d, rows, static_cast<Index>(Toutput.dimension(0)),
+          static_cast<int64>(slice_size) * sizeof(T), work);
+      return -1;
+    }
+
     for (Eigen::DenseIndex loc = 0; loc < batch_size; ++loc) {
       Index i = 0;
       bool out_of_bounds = false;
@@ -38,14 +38,49 @@ namespace {
 
 class ScatterUpdateOpTest : public OpsTestBase {
  protected:
-  void MakeOp(DataType variable_ref_type, DataType index_type) {
-    TF_ASSERT_OK(NodeDefBuilder("myop", "ScatterUpdate")
+  void MakeOp(DataType variable_ref_type, DataType index_type,
+              const string& op = "ScatterUpdate") {
+    TF_ASSERT_OK(NodeDefBuilder("myop", op)
                      .Input(FakeInput(variable_ref_type))
                      .Input(FakeInput(index_type))
                      .Input(FakeInput(RemoveRefType(variable_ref_type)))
                      .Finalize(node_def()));
     TF_ASSERT_OK(InitOp());
   }
+
+  // Runs 'op' with enough updates to be applied in parallel, and many updates
+  // of every row, and checks the result against a serial scatter.
+  void CheckManyUpdates(const string& op) {
+    const int kRows = 100;
+    const int kDim = 8;
+    const int kNumUpdates = 10000;
+    random::PhiloxRandom philox(301, 17);
+    random::SimplePhilox rnd(&philox);
+    std::vector<int32> indices(kNumUpdates);
+    for (int32& i : indices) i = rnd.Uniform(kRows);
+    std::vector<float> updates(kNumUpdates * kDim);
+    for (int i = 0; i < kNumUpdates * kDim; ++i) updates[i] = i;
+
+    MakeOp(DT_FLOAT_REF, DT_INT32, op);
+    AddInputFromArray<float>(TensorShape({kRows, kDim}),
+                             std::vector<float>(kRows * kDim, 1));
+    AddInputFromArray<int32>(TensorShape({kNumUpdates}), indices);
+    AddInputFromArray<float>(TensorShape({kNumUpdates, kDim}), updates);
+    TF_ASSERT_OK(RunOpKernel());
+
+    std::vector<float> expected(kRows * kDim, 1);
+    for (int i = 0; i < kNumUpdates; ++i) {
+      for (int j = 0; j < kDim; ++j) {
+        float& e = expected[indices[i] * kDim + j];
+        e = op == "ScatterUpdate" ? updates[i * kDim + j]
+                                  : e + updates[i * kDim + j];
+      }
+    }
+    Tensor params_tensor = *mutable_input(0).tensor;
+    Tensor expected_tensor(allocator(), DT_FLOAT, TensorShape({kRows, kDim}));
+    test::FillValues<float>(&expected_tensor, expected);
+    test::ExpectTensorEqual<float>(expected_tensor, params_tensor);
+  }
 };
 
 TEST_F(ScatterUpdateOpTest, Simple_StringType) {
@@ -160,6 +195,14 @@ TEST_F(ScatterUpdateOpTest, HigherRank) {
   test::ExpectTensorEqual<float>(expected, params_tensor);
 }
 
+TEST_F(ScatterUpdateOpTest, ManyUpdatesWithDuplicates) {
+  CheckManyUpdates("ScatterUpdate");
+}
+
+TEST_F(ScatterUpdateOpTest, ManyAddsWithDuplicates) {
+  CheckManyUpdates("ScatterAdd");
+}
+
 TEST_F(ScatterUpdateOpTest, Error_IndexOutOfRange) {
   MakeOp(DT_FLOAT_REF, DT_INT32);
 
@@ -238,7 +281,8 @@ class ScatterUpdateBM : public ScatterUpdateOpTest {
 };
 
 template <typename Index>
-static void BM_ScatterHelper(int iters, int embedding_size, const char* op) {
+static void BM_ScatterHelper(int iters, int embedding_size, const char* op,
+                             int num_updates = 1000) {
   testing::StopTiming();
   const int kRows = 10000000 / embedding_size;
   std::vector<float> values;
@@ -246,7 +290,7 @@ static void BM_ScatterHelper(int iters, int embedding_size, const char* op) {
   for (int i = 0; i < kRows * embedding_size; i++) {
     values.push_back(i);
   }
-  const int kNumUpdates = 1000;
+  const int kNumUpdates = num_updates;
   random::PhiloxRandom philox(301, 17);
   random::SimplePhilox rnd(&philox);
   std::vector<Index> indices;
@@ -324,6 +368,17 @@ BENCHMARK(BM_ScatterUpdateInt64)
     ->Arg(1024)
     ->Arg(100000);
 
+// Large batches of updates, which are applied in parallel.
+static void BM_ScatterUpdateManyInt32(int iters, int embedding_size) {
+  BM_ScatterHelper<int32>(iters, embedding_size, "ScatterUpdate", 100000);
+}
+static void BM_ScatterAddManyInt32(int iters, int embedding_size) {
+  BM_ScatterHelper<int32>(iters, embedding_size, "ScatterAdd", 100000);
+}
+
+BENCHMARK(BM_ScatterUpdateManyInt32)->Arg(1)->Arg(10)->Arg(64)->Arg(256);
+BENCHMARK(BM_ScatterAddManyInt32)->Arg(1)->Arg(10)->Arg(64)->Arg(256);
+
 BENCHMARK(BM_ScatterAddInt32)->Arg(1)->Arg(10)->Arg(64)->Arg(256)->Arg(1024);
 BENCHMARK(BM_ScatterAddInt64)->Arg(1)->Arg(10)->Arg(64)->Arg(256)->Arg(1024);
 
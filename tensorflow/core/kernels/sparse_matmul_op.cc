@@ -19,6 +19,8 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/sparse_matmul_op.h"
 
+#include <cstring>
+#include <memory>
 #include <vector>
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/common_runtime/device.h"
@@ -35,6 +37,7 @@ limitations under the License.
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
 #ifdef TENSORFLOW_USE_LIBXSMM
 #include "include/libxsmm_intrinsics_x86.h"
 #include "include/libxsmm_malloc.h"
@@ -277,6 +280,30 @@ ALWAYS_INLINE Packet ConvertTwoBfloat16ToFloat(const bfloat16* src) {
       reinterpret_cast<const float*>(src));
 }
 
+// Converts "size" bfloat16 values to float. A bfloat16 value is the upper half
+// of a float, so each value is zero-extended to 32 bits and shifted into place,
+// 16 (AVX-512) or 8 (AVX2) values per instruction.
+inline void ExpandBfloat16(const bfloat16* src, float* dst, int64 size) {
+  int64 i = 0;
+#if defined(EIGEN_VECTORIZE_AVX512)
+  for (; i + 16 <= size; i += 16) {
+    const __m256i in =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm512_storeu_ps(dst + i, _mm512_castsi512_ps(_mm512_slli_epi32(
+                                  _mm512_cvtepu16_epi32(in), 16)));
+  }
+#elif defined(EIGEN_VECTORIZE_AVX2)
+  for (; i + 8 <= size; i += 8) {
+    const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(_mm256_slli_epi32(
+                                  _mm256_cvtepu16_epi32(in), 16)));
+  }
+#endif
+  if (i < size) {
+    BFloat16ToFloat(src + i, dst + i, size - i);
+  }
+}
+
 ALWAYS_INLINE void ScalarMulAdd(const float a, const float** inp, float** out) {
   **out += a * **inp;
   ++*inp;
@@ -765,8 +792,69 @@ class SparseMatMul {
       MatrixMapR;
 
  public:
-  // Not used; added to match interface of LibxsmmSparseMatMul
-  struct TensorInfoCache {};
+  // Keeps the sparse encoding of the left operand across calls. The sparse
+  // operand is usually a weight fed from a constant or a variable, whose buffer
+  // is reused from step to step, so re-encoding it on every call repeats a full
+  // pass over the matrix. An encoding is reused while the buffer, shape and
+  // blocking are unchanged and the contents still match a snapshot taken before
+  // the encoding was built; in-place updates of a variable invalidate it.
+  struct TensorInfoCache {
+    struct Entry {
+      ~Entry() {
+        for (auto& row : slices) {
+          gtl::STLDeleteElements(&row);
+        }
+      }
+      const TL* data = nullptr;
+      int dim0 = 0;
+      int dim1 = 0;
+      bool transpose = false;
+      int slice_num_cols = 0;
+      std::vector<TL> snapshot;
+      std::vector<std::vector<SparseSlice<TL>*>> slices;
+    };
+
+    TensorInfoCache() {}
+
+    // Returns the cached encoding of "mat", or nullptr if there is none or it
+    // is stale. Sets *cacheable if the previous lookup was for the same
+    // buffer; only such operands are worth snapshotting and caching.
+    std::shared_ptr<const Entry> Lookup(const ConstMatrixMapL& mat,
+                                        bool transpose, int slice_num_cols,
+                                        bool* cacheable) LOCKS_EXCLUDED(mu_) {
+      std::shared_ptr<const Entry> entry;
+      {
+        mutex_lock l(mu_);
+        *cacheable = (mat.data() == last_data_);
+        last_data_ = mat.data();
+        entry = entry_;
+      }
+      if (entry == nullptr || entry->data != mat.data() ||
+          entry->dim0 != mat.dimension(0) || entry->dim1 != mat.dimension(1) ||
+          entry->transpose != transpose ||
+          entry->slice_num_cols != slice_num_cols) {
+        return nullptr;
+      }
+      if (memcmp(entry->snapshot.data(), mat.data(),
+                 entry->snapshot.size() * sizeof(TL)) != 0) {
+        return nullptr;
+      }
+      return entry;
+    }
+
+    // Replaces the cached encoding with "entry".
+    void Insert(std::shared_ptr<const Entry> entry) LOCKS_EXCLUDED(mu_) {
+      mutex_lock l(mu_);
+      entry_ = std::move(entry);
+    }
+
+   private:
+    mutex mu_;
+    const TL* last_data_ GUARDED_BY(mu_) = nullptr;
+    std::shared_ptr<const Entry> entry_ GUARDED_BY(mu_);
+
+    TF_DISALLOW_COPY_AND_ASSIGN(TensorInfoCache);
+  };
 
   // Perform matrix multiplication of "left" and "right", and store the result
   // in *"output".
@@ -1121,17 +1209,14 @@ class SparseMatMulOp : public OpKernel {
     if (!a_is_sparse_ && !b_is_sparse_) {
       auto left = &a;
       auto right = &b;
-      // TODO(agarwal): multi-thread the conversions from bfloat16 to float.
       if (std::is_same<TL, bfloat16>::value) {
         a_float.reset(new Tensor(DT_FLOAT, a.shape()));
-        BFloat16ToFloat(a.flat<bfloat16>().data(),
-                        a_float->flat<float>().data(), a.NumElements());
+        ConvertToFloat(ctx, a, a_float.get());
         left = a_float.get();
       }
       if (std::is_same<TR, bfloat16>::value) {
         b_float.reset(new Tensor(DT_FLOAT, b.shape()));
-        BFloat16ToFloat(b.flat<bfloat16>().data(),
-                        b_float->flat<float>().data(), b.NumElements());
+        ConvertToFloat(ctx, b, b_float.get());
         right = b_float.get();
       }
       Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1> dim_pair;
@@ -1191,6 +1276,20 @@ class SparseMatMulOp : public OpKernel {
   }
 
  private:
+  // Converts the bfloat16 tensor "in" to float, split across the worker
+  // threads.
+  static void ConvertToFloat(OpKernelContext* ctx, const Tensor& in,
+                             Tensor* out) {
+    const bfloat16* src = in.flat<bfloat16>().data();
+    float* dst = out->flat<float>().data();
+    auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          in.NumElements(), /*cost_per_unit=*/1,
+          [src, dst](int64 start, int64 limit) {
+            ExpandBfloat16(src + start, dst + start, limit - start);
+          });
+  }
+
   bool transpose_a_;
   bool transpose_b_;
   bool a_is_sparse_;
@@ -1694,21 +1793,43 @@ inline void LibxsmmSparseMatMul<TL, TR>::Compute(
 //    {l_i} and JB elements from {r_j} and compute the IB * JB inner products.
 template <typename TL, typename TR>
 inline void SparseMatMul<TL, TR>::Compute(
-    typename SparseMatMul<TL, TR>::TensorInfoCache* /*cache*/,
+    typename SparseMatMul<TL, TR>::TensorInfoCache* cache,
     const typename SparseMatMul<TL, TR>::ConstMatrixMapL& left,
     const typename SparseMatMul<TL, TR>::ConstMatrixMapR& right,
     bool transpose_left, const DeviceBase::CpuWorkerThreads* thread_pool,
     bool transpose_output, MatrixMap* output) {
+  typedef typename TensorInfoCache::Entry CacheEntry;
   const int num_threads = thread_pool->num_threads;
   int KR, NR, KL, JB, IB;
   ComputeBlockSizes(left, right, transpose_left, num_threads, &KR, &NR, &KL,
                     &JB, &IB);
-  // Slice the left matrix
-  std::vector<std::vector<SparseSlice<TL>*>> left_slices;
+  // Slice the left matrix, unless an encoding of it is cached.
+  std::shared_ptr<const CacheEntry> cached;
+  bool cacheable = false;
+  if (cache != nullptr) {
+    cached = cache->Lookup(left, transpose_left, KL, &cacheable);
+  }
+  std::unique_ptr<CacheEntry> fresh;
   std::unique_ptr<BlockingCounter> sparse_slice_counter;
-  sparse_slice_counter.reset(
-      CreateSparseSlices(ConstMatrixMapL(left.data(), left.dimensions()),
-                         transpose_left, M, K, KL, &left_slices, thread_pool));
+  if (cached == nullptr) {
+    fresh.reset(new CacheEntry);
+    if (cacheable) {
+      // Snapshot before encoding, so that a concurrent update to the operand
+      // can only make the snapshot disagree with the buffer, never the
+      // encoding.
+      fresh->data = left.data();
+      fresh->dim0 = left.dimension(0);
+      fresh->dim1 = left.dimension(1);
+      fresh->transpose = transpose_left;
+      fresh->slice_num_cols = KL;
+      fresh->snapshot.assign(left.data(), left.data() + left.size());
+    }
+    sparse_slice_counter.reset(CreateSparseSlices(
+        ConstMatrixMapL(left.data(), left.dimensions()), transpose_left, M, K,
+        KL, &fresh->slices, thread_pool));
+  }
+  const std::vector<std::vector<SparseSlice<TL>*>>& left_slices =
+      cached != nullptr ? cached->slices : fresh->slices;
   const int num_left_slices = left_slices.size();
 
   const int right_dim0 = right.dimension(0);
@@ -1783,8 +1904,11 @@ inline void SparseMatMul<TL, TR>::Compute(
       right_slices.clear();
     }
   }
-  for (auto& left_slice : left_slices) {
-    gtl::STLDeleteElements(&left_slice);
+  if (sparse_slice_counter) {
+    sparse_slice_counter->Wait();
+  }
+  if (fresh != nullptr && cacheable) {
+    cache->Insert(std::move(fresh));
   }
 }
 
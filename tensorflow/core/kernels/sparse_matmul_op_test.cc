@@ -16,9 +16,14 @@ limitations under the License.
 #include "tensorflow/core/kernels/sparse_matmul_op.h"
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/bfloat16.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/test.h"
@@ -258,6 +263,59 @@ BM_SPARSE_MULTI(2048, 1024, 768, 85, 85, 6);
 BM_SPARSE_MULTI(2048, 768, 512, 85, 85, 6);
 BM_SPARSE_MULTI(2048, 512, 256, 85, 85, 6);
 
+class SparseMatMulKernelTest : public OpsTestBase {};
+
+TEST_F(SparseMatMulKernelTest, ReusesSparseOperandUntilChanged) {
+  TF_ASSERT_OK(NodeDefBuilder("sparse_matmul", "SparseMatMul")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Attr("a_is_sparse", true)
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<float>(TensorShape({2, 3}), {1, 0, 2, 0, 3, 0});
+  AddInputFromArray<float>(TensorShape({3, 2}), {1, 2, 3, 4, 5, 6});
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected, {11, 14, 9, 12});
+  // The encoding of "a" is cached on the second run and reused on the third.
+  for (int i = 0; i < 3; ++i) {
+    TF_ASSERT_OK(RunOpKernel());
+    test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+  }
+
+  // Updating "a" in place, as an optimizer does to a variable, must
+  // invalidate the cached encoding.
+  mutable_input(0).tensor->matrix<float>()(0, 1) = 1;
+  TF_ASSERT_OK(RunOpKernel());
+  test::FillValues<float>(&expected, {14, 18, 9, 12});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(SparseMatMulKernelTest, Bfloat16DenseOperands) {
+  TF_ASSERT_OK(NodeDefBuilder("sparse_matmul", "SparseMatMul")
+                   .Input(FakeInput(DT_BFLOAT16))
+                   .Input(FakeInput(DT_BFLOAT16))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  // Long enough for the vectorized bfloat16 expansion and a scalar tail.
+  const int k = 37;
+  std::vector<float> a(k), b(k);
+  std::vector<bfloat16> a_bf(k), b_bf(k);
+  float dot = 0;
+  for (int i = 0; i < k; ++i) {
+    a[i] = i % 5 - 2;
+    b[i] = i % 3 + 1;
+    dot += a[i] * b[i];
+  }
+  FloatToBFloat16(a.data(), a_bf.data(), k);
+  FloatToBFloat16(b.data(), b_bf.data(), k);
+  AddInputFromArray<bfloat16>(TensorShape({1, k}), a_bf);
+  AddInputFromArray<bfloat16>(TensorShape({k, 1}), b_bf);
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 1}));
+  test::FillValues<float>(&expected, {dot});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
 }  // end namespace tensorflow
 
 namespace Eigen {
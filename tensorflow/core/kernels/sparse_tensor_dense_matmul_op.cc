@@ -19,16 +19,123 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/sparse_tensor_dense_matmul_op.h"
 
+#include <memory>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/kernels/fill_functor.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace tensorflow {
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
 typedef Eigen::GpuDevice GPUDevice;
 
+namespace functor {
+
+// Compressed sparse row form of the sparse operand of the CPU kernel, rows
+// being rows of the output.  The nonzeros of row m are
+// [row_start[m], row_start[m + 1]); nonzero j multiplies row inner[j] of the
+// dense operand by a_values(source[j]).  Within a row, nonzeros keep their
+// order in a_indices.
+struct SparseTensorDenseMatMulCsr {
+  std::vector<int64> row_start;
+  std::vector<int64> inner;
+  std::vector<int64> source;
+
+  // Builds the structure from 'a_indices' for an output with 'num_rows' rows
+  // and a dense operand with 'num_inner' rows.  Output rows come from column
+  // 1 of 'a_indices' if 'adjoint_a', column 0 otherwise.
+  Status Init(TTypes<int64>::ConstMatrix a_indices, bool adjoint_a,
+              int64 num_rows, int64 num_inner) {
+    const int64 nnz = a_indices.dimension(0);
+    const int lhs_index_a = adjoint_a ? 1 : 0;
+    const int rhs_index_a = adjoint_a ? 0 : 1;
+    // Validate and copy the indices once; placement only reads the copies.
+    std::vector<int64> rows(nnz);
+    std::vector<int64> cols(nnz);
+    row_start.assign(num_rows + 1, 0);
+    for (int64 i = 0; i < nnz; ++i) {
+      const int64 m = internal::SubtleMustCopy(a_indices(i, lhs_index_a));
+      const int64 k = internal::SubtleMustCopy(a_indices(i, rhs_index_a));
+      if (!FastBoundsCheck(m, num_rows)) {
+        return errors::InvalidArgument("a_indices[", i, ", ", lhs_index_a,
+                                       "] = ", m, " is not in [0, ",
+                                       num_rows, ")");
+      }
+      if (!FastBoundsCheck(k, num_inner)) {
+        return errors::InvalidArgument("a_indices[", i, ", ", rhs_index_a,
+                                       "] = ", k, " is not in [0, ",
+                                       num_inner, ")");
+      }
+      rows[i] = m;
+      cols[i] = k;
+      ++row_start[m + 1];
+    }
+    for (int64 m = 0; m < num_rows; ++m) row_start[m + 1] += row_start[m];
+    std::vector<int64> next(row_start.begin(), row_start.end() - 1);
+    inner.resize(nnz);
+    source.resize(nnz);
+    for (int64 i = 0; i < nnz; ++i) {
+      const int64 j = next[rows[i]]++;
+      inner[j] = cols[i];
+      source[j] = i;
+    }
+    return Status::OK();
+  }
+};
+
+// Multiplies by the sparse operand in CSR form.  Output rows are sharded
+// across the device's threads; each row is a sum of scaled rows of the dense
+// operand, accumulated with vectorized Eigen operations.
+template <typename T, bool ADJ_A, bool ADJ_B>
+struct SparseTensorDenseMatMulCsrFunctor {
+  static void Compute(const CPUDevice& d, const SparseTensorDenseMatMulCsr& csr,
+                      typename TTypes<T>::Matrix out,
+                      typename TTypes<T>::ConstVec a_values,
+                      typename TTypes<T>::ConstMatrix b) {
+    typedef Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, 1>> Row;
+    typedef Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 1>> ConstRow;
+
+    const int64 num_rows = out.dimension(0);
+    const int64 n = out.dimension(1);
+    // The rows of the dense operand must be contiguous, so with adjoint_b
+    // the conjugate transpose of b is formed once up front.
+    Eigen::Tensor<T, 2, Eigen::RowMajor> b_adjoint;
+    const T* b_data = b.data();
+    if (ADJ_B) {
+      Eigen::array<int, 2> shuffle(1, 0);
+      b_adjoint.resize(b.dimension(1), b.dimension(0));
+      b_adjoint.device(d) = b.shuffle(shuffle).conjugate();
+      b_data = b_adjoint.data();
+    }
+
+    auto work = [&csr, &out, &a_values, b_data, n](int64 begin, int64 end) {
+      for (int64 m = begin; m < end; ++m) {
+        Row out_row(out.data() + m * n, n);
+        out_row.setZero();
+        for (int64 j = csr.row_start[m]; j < csr.row_start[m + 1]; ++j) {
+          const T a_value = ADJ_A ? MaybeConj(a_values(csr.source[j]))
+                                  : a_values(csr.source[j]);
+          out_row += a_value * ConstRow(b_data + csr.inner[j] * n, n);
+        }
+      }
+    };
+    const double nnz_per_row =
+        static_cast<double>(csr.inner.size()) / num_rows;
+    d.parallelFor(num_rows,
+                  Eigen::TensorOpCost(nnz_per_row * n * sizeof(T),
+                                      n * sizeof(T), 2 * nnz_per_row * n),
+                  work);
+  }
+};
+
+}  // namespace functor
+
 template <typename Device, typename T>
 class SparseTensorDenseMatMulOp : public OpKernel {
  public:
@@ -111,6 +218,26 @@ class SparseTensorDenseMatMulOp : public OpKernel {
       return;
     }
 
+    if (std::is_same<Device, CPUDevice>::value) {
+      std::shared_ptr<const functor::SparseTensorDenseMatMulCsr> csr;
+      OP_REQUIRES_OK(ctx, GetCsr(*a_indices, outer_left, inner_left, &csr));
+
+#define MAYBE_ADJOINT(ADJ_A, ADJ_B)                                        \
+  if (adjoint_a_ == ADJ_A && adjoint_b_ == ADJ_B) {                        \
+    functor::SparseTensorDenseMatMulCsrFunctor<T, ADJ_A, ADJ_B>::Compute( \
+        ctx->eigen_device<CPUDevice>(), *csr, out->matrix<T>(),            \
+        a_values->vec<T>(), b->matrix<T>());                               \
+  }
+
+      MAYBE_ADJOINT(false, false);
+      MAYBE_ADJOINT(false, true);
+      MAYBE_ADJOINT(true, false);
+      MAYBE_ADJOINT(true, true);
+
+#undef MAYBE_ADJOINT
+      return;
+    }
+
     Tensor scratch;
 
     if (std::is_same<Device, GPUDevice>::value) {
@@ -156,8 +283,66 @@ class SparseTensorDenseMatMulOp : public OpKernel {
   }
 
  private:
+  // Returns the CSR form of 'a_indices'.  A sparse operand that does not
+  // change between steps, such as a constant, is converted only once: when
+  // 'a_indices' arrives in the same buffer as on the previous call, a copy of
+  // it is kept with its CSR form, which is reused for as long as later
+  // indices match the copy byte for byte.
+  Status GetCsr(const Tensor& a_indices, int64 num_rows, int64 num_inner,
+                std::shared_ptr<const functor::SparseTensorDenseMatMulCsr>*
+                    csr) {
+    Tensor cached_indices;
+    std::shared_ptr<const functor::SparseTensorDenseMatMulCsr> cached_csr;
+    bool same_buffer;
+    {
+      mutex_lock l(mu_);
+      cached_indices = cached_indices_;
+      cached_csr = cached_csr_;
+      same_buffer = a_indices.tensor_data().data() == last_indices_data_ &&
+                    num_rows == cached_num_rows_ &&
+                    num_inner == cached_num_inner_;
+      last_indices_data_ = a_indices.tensor_data().data();
+      cached_num_rows_ = num_rows;
+      cached_num_inner_ = num_inner;
+    }
+    if (same_buffer && cached_csr != nullptr &&
+        cached_indices.shape() == a_indices.shape() &&
+        cached_indices.tensor_data() == a_indices.tensor_data()) {
+      *csr = std::move(cached_csr);
+      return Status::OK();
+    }
+
+    auto built = std::make_shared<functor::SparseTensorDenseMatMulCsr>();
+    if (!same_buffer) {
+      TF_RETURN_IF_ERROR(built->Init(a_indices.matrix<int64>(), adjoint_a_,
+                                     num_rows, num_inner));
+      *csr = std::move(built);
+      return Status::OK();
+    }
+    // Build from the copy, so that the cached structure always describes
+    // exactly the indices it is compared against.
+    const Tensor indices_copy = tensor::DeepCopy(a_indices);
+    TF_RETURN_IF_ERROR(built->Init(indices_copy.matrix<int64>(), adjoint_a_,
+                                   num_rows, num_inner));
+    {
+      mutex_lock l(mu_);
+      cached_indices_ = indices_copy;
+      cached_csr_ = built;
+    }
+    *csr = std::move(built);
+    return Status::OK();
+  }
+
   bool adjoint_a_;
   bool adjoint_b_;
+
+  mutex mu_;
+  const char* last_indices_data_ GUARDED_BY(mu_) = nullptr;
+  int64 cached_num_rows_ GUARDED_BY(mu_) = -1;
+  int64 cached_num_inner_ GUARDED_BY(mu_) = -1;
+  Tensor cached_indices_ GUARDED_BY(mu_);
+  std::shared_ptr<const functor::SparseTensorDenseMatMulCsr> cached_csr_
+      GUARDED_BY(mu_);
 };
 
 #define REGISTER_CPU(T)                                   \
@@ -213,67 +398,17 @@ namespace functor {
 
 template <typename T, bool ADJ_A, bool ADJ_B>
 struct SparseTensorDenseMatMulFunctor<CPUDevice, T, ADJ_A, ADJ_B> {
-  // Vectorize certain operations above this size.
-  static const std::size_t kNumVectorize = 32;
-
   static void Compute(const CPUDevice& d, typename TTypes<T>::Matrix out,
                       TTypes<int64>::ConstMatrix a_indices,
                       typename TTypes<T>::ConstVec a_values,
                       typename TTypes<T>::ConstMatrix b,
                       typename TTypes<T>::Vec scratch) {
-    const std::size_t nnz = a_values.size();
-    const std::size_t rhs_right = (ADJ_B ? b.dimension(0) : b.dimension(1));
-    const std::size_t lhs_right = (ADJ_B ? b.dimension(1) : b.dimension(0));
-    const int lhs_index_a = ADJ_A ? 1 : 0;
-    const int rhs_index_a = ADJ_A ? 0 : 1;
-
-    out.setZero();
-
-    // TODO(ebrevdo): After many failed experiments, can't find a multi-threaded
-    // approach that achieves the performance of the single threaded
-    // one.  Perhaps Eigen threadpool implementation is just too slow?
-
-    if (rhs_right < kNumVectorize) {
-      // Disable vectorization if the RHS of output is too small
-      auto maybe_adjoint_b = MaybeAdjoint<decltype(b), ADJ_B>(b);
-      for (std::size_t i = 0; i < nnz; ++i) {
-        const int64 m = internal::SubtleMustCopy(a_indices(i, lhs_index_a));
-        const int64 k = internal::SubtleMustCopy(a_indices(i, rhs_index_a));
-        CHECK_LT(k, lhs_right);
-        CHECK_LT(m, out.dimension(0));
-        const T a_value = ADJ_A ? MaybeConj(a_values(i)) : a_values(i);
-        for (std::size_t n = 0; n < rhs_right; ++n) {
-          const T b_value = maybe_adjoint_b(k, n);
-          out(m, n) += a_value * b_value;
-        }
-      }
-    } else {
-      // Vectorization via Eigen.
-      const int b_chip_index = ADJ_B ? 1 : 0;
-
-#define LOOP_NNZ(b_passed)                                               \
-  for (std::size_t i = 0; i < nnz; ++i) {                                \
-    const int64 m = internal::SubtleMustCopy(a_indices(i, lhs_index_a)); \
-    const int64 k = internal::SubtleMustCopy(a_indices(i, rhs_index_a)); \
-    const T a_value = (ADJ_A) ? MaybeConj(a_values(i)) : a_values(i);    \
-    CHECK_LT(m, out.dimension(0));                                       \
-    CHECK_LT(k, lhs_right);                                              \
-    out.template chip<0>(m) +=                                           \
-        b_passed.template chip<b_chip_index>(k) * a_value;               \
-  }
-
-      if (ADJ_B) {
-        // Perform transpose and conjugation on B once, since we chip out B's
-        // columns in the nnz loop.
-        Eigen::array<int, 2> shuffle(1, 0);  // preserve dimension order
-        Eigen::Tensor<T, 2, Eigen::ColMajor> col_major_conj_b =
-            b.swap_layout().shuffle(shuffle).conjugate();
-        LOOP_NNZ(col_major_conj_b);
-      } else {
-        LOOP_NNZ(b);
-      }
-#undef LOOP_NNZ
-    }
+    SparseTensorDenseMatMulCsr csr;
+    const Status s = csr.Init(a_indices, ADJ_A, out.dimension(0),
+                              ADJ_B ? b.dimension(1) : b.dimension(0));
+    CHECK(s.ok()) << s;
+    SparseTensorDenseMatMulCsrFunctor<T, ADJ_A, ADJ_B>::Compute(d, csr, out,
+                                                               a_values, b);
   }
 };
 
@@ -16,13 +16,99 @@ limitations under the License.
 #include <random>
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 
+class SparseTensorDenseMatMulOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(bool adjoint_a, bool adjoint_b) {
+    TF_ASSERT_OK(NodeDefBuilder("matmul", "SparseTensorDenseMatMul")
+                     .Input(FakeInput(DT_INT64))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT64))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("adjoint_a", adjoint_a)
+                     .Attr("adjoint_b", adjoint_b)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(SparseTensorDenseMatMulOpTest, Simple) {
+  MakeOp(false, false);
+  // a = [[0, 2, 0], [1, 0, 3]], with the nonzeros of row 1 out of order.
+  AddInputFromArray<int64>(TensorShape({3, 2}), {1, 2, 0, 1, 1, 0});
+  AddInputFromArray<float>(TensorShape({3}), {3, 2, 1});
+  AddInputFromArray<int64>(TensorShape({2}), {2, 3});
+  AddInputFromArray<float>(TensorShape({3, 2}), {1, 2, 3, 4, 5, 6});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected, {6, 8, 16, 20});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(SparseTensorDenseMatMulOpTest, Adjoints) {
+  MakeOp(true, true);
+  // a^T = [[0, 2, 0], [1, 0, 3]] and b^T = [[1, 2], [3, 4], [5, 6]].
+  AddInputFromArray<int64>(TensorShape({3, 2}), {2, 1, 1, 0, 0, 1});
+  AddInputFromArray<float>(TensorShape({3}), {3, 2, 1});
+  AddInputFromArray<int64>(TensorShape({2}), {3, 2});
+  AddInputFromArray<float>(TensorShape({2, 3}), {1, 3, 5, 2, 4, 6});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected, {6, 8, 16, 20});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(SparseTensorDenseMatMulOpTest, CachedStructureFollowsIndices) {
+  MakeOp(false, false);
+  AddInputFromArray<int64>(TensorShape({2, 2}), {0, 0, 1, 1});
+  AddInputFromArray<float>(TensorShape({2}), {1, 1});
+  AddInputFromArray<int64>(TensorShape({2}), {2, 2});
+  AddInputFromArray<float>(TensorShape({2, 1}), {10, 20});
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 1}));
+
+  // The second run caches the structure of the unchanged indices.
+  for (int i = 0; i < 2; ++i) {
+    TF_ASSERT_OK(RunOpKernel());
+    test::FillValues<float>(&expected, {10, 20});
+    test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+  }
+  // Rewriting the indices in place must not reuse the stale structure.
+  mutable_input(0).tensor->matrix<int64>()(1, 1) = 0;
+  for (int i = 0; i < 2; ++i) {
+    TF_ASSERT_OK(RunOpKernel());
+    test::FillValues<float>(&expected, {10, 10});
+    test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+  }
+  // Neither must changed values.
+  mutable_input(1).tensor->vec<float>()(0) = 2;
+  TF_ASSERT_OK(RunOpKernel());
+  test::FillValues<float>(&expected, {20, 10});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(SparseTensorDenseMatMulOpTest, Error_IndexOutOfRange) {
+  MakeOp(false, false);
+  AddInputFromArray<int64>(TensorShape({2, 2}), {0, 0, 1, 3});
+  AddInputFromArray<float>(TensorShape({2}), {1, 1});
+  AddInputFromArray<int64>(TensorShape({2}), {2, 2});
+  AddInputFromArray<float>(TensorShape({2, 1}), {10, 20});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.ToString())
+                  .contains("a_indices[1, 1] = 3 is not in [0, 2)"))
+      << s;
+}
+
 Node* SparseTensorDenseMatMulNode(Graph* g, Node* a_indices, Node* a_values,
                                   Node* a_shape, Node* b, bool adjoint_a,
                                   bool adjoint_b) {
@@ -117,4 +203,25 @@ BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, false, true);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, false);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, true);
 
+// Wide sparse layers: a [4096, 65536] sparse operand at densities from 0.01%
+// to 1% times dense operands of width 16 to 256.  Arg pairs are (nonzeros per
+// million entries of a, n).
+static void BM_SparseTensorDenseMatmulDensity(int iters, int density_ppm,
+                                              int n) {
+  const int m = 4096;
+  const int k = 65536;
+  const int nnz = static_cast<int64>(m) * k * density_ppm / 1000000;
+  const int64 items_per_iter = static_cast<int64>(nnz) * n;
+  testing::ItemsProcessed(static_cast<int64>(iters) * items_per_iter);
+  test::Benchmark("cpu", SparseTensorDenseMatmul(nnz, m, k, n, false, false))
+      .Run(iters);
+}
+BENCHMARK(BM_SparseTensorDenseMatmulDensity)
+    ->ArgPair(100, 16)
+    ->ArgPair(100, 256)
+    ->ArgPair(1000, 16)
+    ->ArgPair(1000, 256)
+    ->ArgPair(10000, 16)
+    ->ArgPair(10000, 256);
+
 }  // end namespace tensorflow
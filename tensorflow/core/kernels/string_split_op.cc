@@ -17,28 +17,43 @@ limitations under the License.
 
 #include <string>
 
+#include "tensorflow/core/framework/compact_string_tensor.h"
 #include "tensorflow/core/framework/kernel_def_builder.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/delimiter_scanner.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
-#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
 namespace {
 
-std::vector<string> Split(const string& str, const string& delimiter) {
-  if (delimiter.size()) {
-    return str_util::Split(str, delimiter, str_util::SkipEmpty());
+// Calls 'fn(token)' for every token of 'str'. An empty delimiter set splits
+// 'str' into single characters; otherwise tokens are the non-empty runs
+// between delimiters.
+template <typename Fn>
+void ForEachToken(StringPiece str, const DelimiterScanner& scanner,
+                  bool split_chars, Fn fn) {
+  const char* data = str.data();
+  const size_t size = str.size();
+  if (split_chars) {
+    for (size_t i = 0; i < size; ++i) fn(StringPiece(data + i, 1));
+    return;
   }
-  std::vector<string> char_vector(str.size());
-  for (size_t i = 0; i < str.size(); ++i) {
-    char_vector[i] = str[i];
+  size_t pos = 0;
+  while (pos < size) {
+    const size_t end = pos + scanner.Find(data + pos, size - pos);
+    if (end > pos) fn(StringPiece(data + pos, end - pos));
+    pos = end + 1;
   }
-  return char_vector;
 }
 
+// Rough number of cycles spent per input byte by each pass over the input.
+constexpr int64 kCostPerByte = 4;
+
 }  // namespace
 
 class StringSplitOp : public OpKernel {
@@ -52,8 +67,9 @@ class StringSplitOp : public OpKernel {
                 errors::InvalidArgument("input must be a vector, got shape: ",
                                         input_tensor->shape().DebugString()));
 
-    const auto input_vec = input_tensor->vec<string>();
-    const int64 batch_size = input_vec.dimension(0);
+    // Read through a view so that compact inputs stay compact.
+    const StringTensorView input_vec(*input_tensor);
+    const int64 batch_size = input_vec.size();
 
     const Tensor* delimiter_tensor;
     OP_REQUIRES_OK(ctx, ctx->input("delimiter", &delimiter_tensor));
@@ -64,46 +80,87 @@ class StringSplitOp : public OpKernel {
     const auto delimiter_vec = delimiter_tensor->flat<string>();
     const string& delimiter = delimiter_vec(0);
     // Empty delimiter means split the input character by character.
-    std::vector<string> tokens;
-    // Guess that we'll be unpacking a handful of tokens per example.
-    static constexpr int kReserveSize = 4;
-    tokens.reserve(batch_size * kReserveSize);
+    const bool split_chars = delimiter.empty();
+    const DelimiterScanner scanner(delimiter);
+
+    int64 total_bytes = 0;
+    for (int64 i = 0; i < batch_size; ++i) {
+      total_bytes += input_vec(i).size();
+    }
+    const int64 cost_per_row =
+        kCostPerByte * (1 + total_bytes / std::max<int64>(batch_size, 1));
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *ctx->device()->tensorflow_cpu_worker_threads();
+
+    // First pass: count the tokens of every row and the arena bytes they
+    // need, so that the outputs can be allocated once and filled in place.
+    std::vector<int64> num_indices(batch_size);
+    std::vector<int64> arena_bytes(batch_size);
+    Shard(worker_threads.num_threads, worker_threads.workers, batch_size,
+          cost_per_row, [&](int64 start, int64 limit) {
+            for (int64 i = start; i < limit; ++i) {
+              int64 n_entries = 0;
+              int64 n_bytes = 0;
+              ForEachToken(input_vec(i), scanner, split_chars,
+                           [&](StringPiece token) {
+                             ++n_entries;
+                             n_bytes += CompactStringTensorBuilder::ArenaBytes(
+                                 token.size());
+                           });
+              num_indices[i] = n_entries;
+              arena_bytes[i] = n_bytes;
+            }
+          });
 
     int64 output_size = 0;
+    int64 output_arena_bytes = 0;
     int64 max_num_entries = 0;
-    std::vector<int64> num_indices(batch_size);
+    std::vector<int64> row_offsets(batch_size);
+    std::vector<int64> row_arena_offsets(batch_size);
     for (int64 i = 0; i < batch_size; ++i) {
-      std::vector<string> parts = Split(input_vec(i), delimiter);
-      int64 n_entries = parts.size();
-      num_indices[i] = n_entries;
-      output_size += n_entries;
-      max_num_entries = std::max(max_num_entries, n_entries);
-      tokens.insert(tokens.end(), parts.begin(), parts.end());
+      row_offsets[i] = output_size;
+      row_arena_offsets[i] = output_arena_bytes;
+      output_size += num_indices[i];
+      output_arena_bytes += arena_bytes[i];
+      max_num_entries = std::max(max_num_entries, num_indices[i]);
     }
 
     Tensor* sp_indices_t;
     OP_REQUIRES_OK(ctx, ctx->allocate_output(0, TensorShape({output_size, 2}),
                                              &sp_indices_t));
-    Tensor* sp_tokens_t;
-    OP_REQUIRES_OK(
-        ctx, ctx->allocate_output(1, TensorShape({output_size}), &sp_tokens_t));
+    // The tokens are mostly short, so they go into a compact string tensor:
+    // one allocation for all of them instead of one per long token.
+    CompactStringTensorBuilder sp_tokens(
+        ctx->device()->GetAllocator(ctx->output_alloc_attr(1)),
+        TensorShape({output_size}), output_arena_bytes);
     Tensor* sp_shape_t;
     OP_REQUIRES_OK(ctx, ctx->allocate_output(2, TensorShape({2}), &sp_shape_t));
 
     auto sp_indices = sp_indices_t->matrix<int64>();
-    auto sp_tokens = sp_tokens_t->vec<string>();
     auto sp_shape = sp_shape_t->vec<int64>();
     sp_shape(0) = batch_size;
     sp_shape(1) = max_num_entries;
-    size_t c = 0;
-    for (size_t i = 0; i < batch_size; ++i) {
-      for (size_t j = 0; j < num_indices[i]; ++j) {
-        sp_indices(c, 0) = i;
-        sp_indices(c, 1) = j;
-        sp_tokens(c) = tokens[c];
-        ++c;
-      }
-    }
+
+    // Second pass: write every token straight into its output slot.
+    Shard(worker_threads.num_threads, worker_threads.workers, batch_size,
+          cost_per_row, [&](int64 start, int64 limit) {
+            for (int64 i = start; i < limit; ++i) {
+              int64 c = row_offsets[i];
+              int64 arena_offset = row_arena_offsets[i];
+              int64 j = 0;
+              ForEachToken(input_vec(i), scanner, split_chars,
+                           [&](StringPiece token) {
+                             sp_indices(c, 0) = i;
+                             sp_indices(c, 1) = j++;
+                             sp_tokens.Set(c, token, arena_offset);
+                             arena_offset +=
+                                 CompactStringTensorBuilder::ArenaBytes(
+                                     token.size());
+                             ++c;
+                           });
+            }
+          });
+    ctx->set_output(1, sp_tokens.Finish());
   }
 };
 
@@ -0,0 +1,161 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/compact_string_tensor.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class StringSplitOpTest : public OpsTestBase {
+ protected:
+  void MakeOp() {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "StringSplit")
+                     .Input(FakeInput(DT_STRING))
+                     .Input(FakeInput(DT_STRING))
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(StringSplitOpTest, MultipleDelimiters) {
+  MakeOp();
+  AddInputFromArray<string>(TensorShape({3}),
+                            {"a b,,c", "", ",,hello world,"});
+  AddInputFromArray<string>(TensorShape({}), {" ,"});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_indices(allocator(), DT_INT64, TensorShape({5, 2}));
+  test::FillValues<int64>(&expected_indices, {0, 0, 0, 1, 0, 2, 2, 0, 2, 1});
+  test::ExpectTensorEqual<int64>(expected_indices, *GetOutput(0));
+  Tensor expected_values(allocator(), DT_STRING, TensorShape({5}));
+  test::FillValues<string>(&expected_values,
+                           {"a", "b", "c", "hello", "world"});
+  test::ExpectTensorEqual<string>(expected_values, *GetOutput(1));
+  Tensor expected_shape(allocator(), DT_INT64, TensorShape({2}));
+  test::FillValues<int64>(&expected_shape, {3, 3});
+  test::ExpectTensorEqual<int64>(expected_shape, *GetOutput(2));
+}
+
+TEST_F(StringSplitOpTest, LongInputs) {
+  // Long enough to exercise the vectorized delimiter scan and its tail.
+  MakeOp();
+  AddInputFromArray<string>(
+      TensorShape({2}),
+      {"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa;bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb",
+       "cccccccccccccccccccccccc:dddddddddddddddddddddddddddd|"});
+  AddInputFromArray<string>(TensorShape({}), {";:|"});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_values(allocator(), DT_STRING, TensorShape({4}));
+  test::FillValues<string>(
+      &expected_values,
+      {"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+       "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb", "cccccccccccccccccccccccc",
+       "dddddddddddddddddddddddddddd"});
+  test::ExpectTensorEqual<string>(expected_values, *GetOutput(1));
+}
+
+TEST_F(StringSplitOpTest, EmptyDelimiter) {
+  MakeOp();
+  AddInputFromArray<string>(TensorShape({2}), {"ab", "c"});
+  AddInputFromArray<string>(TensorShape({}), {""});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_indices(allocator(), DT_INT64, TensorShape({3, 2}));
+  test::FillValues<int64>(&expected_indices, {0, 0, 0, 1, 1, 0});
+  test::ExpectTensorEqual<int64>(expected_indices, *GetOutput(0));
+  Tensor expected_values(allocator(), DT_STRING, TensorShape({3}));
+  test::FillValues<string>(&expected_values, {"a", "b", "c"});
+  test::ExpectTensorEqual<string>(expected_values, *GetOutput(1));
+}
+
+TEST_F(StringSplitOpTest, CompactTokensReadThroughView) {
+  MakeOp();
+  AddInputFromArray<string>(TensorShape({2}),
+                            {"tiny a_token_too_long_to_inline",
+                             "another_long_one b"});
+  AddInputFromArray<string>(TensorShape({}), {" "});
+  TF_ASSERT_OK(RunOpKernel());
+
+  const StringTensorView tokens(*GetOutput(1));
+  ASSERT_EQ(4, tokens.size());
+  EXPECT_EQ("tiny", tokens(0).ToString());
+  EXPECT_EQ("a_token_too_long_to_inline", tokens(1).ToString());
+  EXPECT_EQ("another_long_one", tokens(2).ToString());
+  EXPECT_EQ("b", tokens(3).ToString());
+}
+
+// Builds 'batch_size' lines of 'tokens_per_line' random words joined by ' '.
+Tensor GetTestLines(int batch_size, int tokens_per_line) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor lines(DT_STRING, TensorShape({batch_size}));
+  auto lines_t = lines.flat<string>();
+  for (int i = 0; i < batch_size; ++i) {
+    string& line = lines_t(i);
+    for (int j = 0; j < tokens_per_line; ++j) {
+      if (j > 0) line.push_back(' ');
+      const int len = 1 + rnd.Uniform(12);
+      for (int k = 0; k < len; ++k) line.push_back('a' + rnd.Uniform(26));
+    }
+  }
+  return lines;
+}
+
+Graph* SetupStringSplitGraph(const Tensor& input) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor delim(DT_STRING, TensorShape({}));
+  delim.flat<string>().setConstant(" ");
+
+  TF_CHECK_OK(NodeBuilder("string_split_op", "StringSplit")
+                  .Input(test::graph::Constant(g, input))
+                  .Input(test::graph::Constant(g, delim))
+                  .Finalize(g, nullptr /* node */));
+  return g;
+}
+
+static void BM_StringSplit(int iters, int batch_size, int tokens_per_line) {
+  testing::StopTiming();
+  Tensor input = GetTestLines(batch_size, tokens_per_line);
+  int64 bytes = 0;
+  for (int i = 0; i < batch_size; ++i) bytes += input.flat<string>()(i).size();
+  Graph* g = SetupStringSplitGraph(input);
+  testing::BytesProcessed(static_cast<int64>(iters) * bytes);
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+BENCHMARK(BM_StringSplit)
+    ->ArgPair(1, 1000)
+    ->ArgPair(64, 16)
+    ->ArgPair(64, 256)
+    ->ArgPair(1024, 16)
+    ->ArgPair(1024, 256)
+    ->ArgPair(16 * 1024, 16);
+
+}  // namespace
+}  // namespace tensorflow
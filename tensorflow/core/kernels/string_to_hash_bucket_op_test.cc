@@ -0,0 +1,108 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class StringToHashBucketFastOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(int64 num_buckets) {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "StringToHashBucketFast")
+                     .Input(FakeInput(DT_STRING))
+                     .Attr("num_buckets", num_buckets)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(StringToHashBucketFastOpTest, MatchesFingerprint) {
+  const int64 kNumBuckets = 1000;
+  MakeOp(kNumBuckets);
+  // Enough elements to be split across several shards.
+  const int kSize = 10000;
+  std::vector<string> input(kSize);
+  std::vector<int64> expected(kSize);
+  for (int i = 0; i < kSize; ++i) {
+    input[i] = strings::StrCat("feature_", i);
+    expected[i] = Fingerprint64(input[i]) % kNumBuckets;
+  }
+  AddInputFromArray<string>(TensorShape({100, kSize / 100}), input);
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_tensor(allocator(), DT_INT64,
+                         TensorShape({100, kSize / 100}));
+  test::FillValues<int64>(&expected_tensor, expected);
+  test::ExpectTensorEqual<int64>(expected_tensor, *GetOutput(0));
+}
+
+static void BM_StringToHashBucket(int iters, int size, int str_len,
+                                  const string& op) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DT_STRING, TensorShape({size}));
+  auto input_t = input.flat<string>();
+  for (int i = 0; i < size; ++i) {
+    input_t(i) = strings::StrCat(i);
+    input_t(i).resize(str_len, 'x');
+  }
+
+  NodeBuilder builder(g->NewName("n"), op);
+  builder.Input(test::graph::Constant(g, input)).Attr("num_buckets", 1 << 20);
+  if (op == "StringToHashBucketStrong") {
+    builder.Attr("key", std::vector<int64>({17, 31}));
+  }
+  TF_CHECK_OK(builder.Finalize(g, nullptr /* node */));
+
+  testing::BytesProcessed(static_cast<int64>(iters) * size * str_len);
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+static void BM_StringToHashBucketFast(int iters, int size, int str_len) {
+  BM_StringToHashBucket(iters, size, str_len, "StringToHashBucketFast");
+}
+
+static void BM_StringToHashBucketStrong(int iters, int size, int str_len) {
+  BM_StringToHashBucket(iters, size, str_len, "StringToHashBucketStrong");
+}
+
+BENCHMARK(BM_StringToHashBucketFast)
+    ->ArgPair(1024, 8)
+    ->ArgPair(1024, 64)
+    ->ArgPair(64 * 1024, 8)
+    ->ArgPair(64 * 1024, 64)
+    ->ArgPair(1024 * 1024, 8);
+
+BENCHMARK(BM_StringToHashBucketStrong)
+    ->ArgPair(1024, 8)
+    ->ArgPair(64 * 1024, 8)
+    ->ArgPair(1024 * 1024, 8);
+
+}  // namespace
+}  // namespace tensorflow
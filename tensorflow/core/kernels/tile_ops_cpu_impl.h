@@ -17,6 +17,8 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
+
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/kernels/tile_ops_impl.h"
 
@@ -25,6 +27,116 @@ namespace functor {
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
 
+namespace internal {
+
+// Output rows shorter than this many elements are left to Eigen's broadcast.
+constexpr int64 kTileMinCopyRun = 16;
+// Blocks smaller than this are replicated by doubling on one thread; larger
+// ones are copied in parallel, one copy per task.
+constexpr int64 kTileParallelCopyBytes = 16 << 10;
+
+// Fills [0, block * copies) of 'base' with copies of [0, block), doubling the
+// filled prefix with every copy.
+template <typename T>
+void ReplicateBlock(T* base, int64 block, int64 copies) {
+  const int64 total = block * copies;
+  for (int64 filled = block; filled < total;) {
+    const int64 n = std::min(filled, total - filled);
+    std::copy(base, base + n, base + filled);
+    filled += n;
+  }
+}
+
+template <typename T, int NDIM>
+struct TileUsingCopies<CPUDevice, T, NDIM> {
+  static bool Run(const CPUDevice& d, typename TTypes<T, NDIM>::Tensor out,
+                  typename TTypes<T, NDIM>::ConstTensor in,
+                  const Eigen::array<int32, NDIM>& broadcast_array) {
+    if (out.size() == 0) return true;
+    // Fold every dimension that is not tiled into the one before it: tiling
+    // [a, b] by [m, 1] is tiling [a * b] by [m].
+    int64 in_dims[NDIM];
+    int64 multiples[NDIM];
+    int nd = 0;
+    for (int i = 0; i < NDIM; ++i) {
+      if (nd > 0 && broadcast_array[i] == 1) {
+        in_dims[nd - 1] *= in.dimension(i);
+      } else {
+        in_dims[nd] = in.dimension(i);
+        multiples[nd] = broadcast_array[i];
+        ++nd;
+      }
+    }
+    if (in_dims[nd - 1] * multiples[nd - 1] < kTileMinCopyRun) return false;
+    int64 out_strides[NDIM];
+    out_strides[nd - 1] = 1;
+    for (int i = nd - 2; i >= 0; --i) {
+      out_strides[i] = out_strides[i + 1] * in_dims[i + 1] * multiples[i + 1];
+    }
+
+    const T* src = in.data();
+    T* dst = out.data();
+    // Output offset of the first copy of the input elements whose coordinates
+    // in dimensions [0, dim) are those of 'outer'.
+    auto outer_offset = [&in_dims, &out_strides](int64 outer, int dim) {
+      int64 offset = 0;
+      for (int i = dim - 1; i >= 0; --i) {
+        offset += (outer % in_dims[i]) * out_strides[i];
+        outer /= in_dims[i];
+      }
+      return offset;
+    };
+
+    // Copy every input row to its first copy in the output.
+    const int64 row = in_dims[nd - 1];
+    const int64 num_rows = in.size() / row;
+    const double row_bytes = row * sizeof(T);
+    d.parallelFor(num_rows, Eigen::TensorOpCost(row_bytes, row_bytes, 0),
+                  [src, dst, row, nd, &outer_offset](int64 first, int64 last) {
+                    for (int64 r = first; r < last; ++r) {
+                      std::copy(src + r * row, src + (r + 1) * row,
+                                dst + outer_offset(r, nd - 1));
+                    }
+                  });
+
+    // Then replicate the dimensions from the innermost out.  By the time
+    // dimension 'dim' is replicated, the dimensions after it are complete, so
+    // each of its slabs is a contiguous block followed by room for the copies.
+    int64 num_slabs = num_rows;
+    for (int dim = nd - 1; dim >= 0; --dim) {
+      const int64 m = multiples[dim];
+      const int64 block = in_dims[dim] * out_strides[dim];
+      const double block_bytes = block * sizeof(T);
+      if (m > 1 && block_bytes < kTileParallelCopyBytes) {
+        d.parallelFor(
+            num_slabs, Eigen::TensorOpCost(block_bytes, block_bytes * m, 0),
+            [dst, dim, m, block, &outer_offset](int64 first, int64 last) {
+              for (int64 s = first; s < last; ++s) {
+                ReplicateBlock(dst + outer_offset(s, dim), block, m);
+              }
+            });
+      } else if (m > 1) {
+        d.parallelFor(
+            num_slabs * (m - 1),
+            Eigen::TensorOpCost(block_bytes, block_bytes, 0),
+            [dst, dim, m, block, &outer_offset](int64 first, int64 last) {
+              for (int64 u = first; u < last; ++u) {
+                T* base = dst + outer_offset(u / (m - 1), dim);
+                std::copy(base, base + block, base + (u % (m - 1) + 1) * block);
+              }
+            });
+      }
+      if (dim > 0) num_slabs /= in_dims[dim - 1];
+    }
+    return true;
+  }
+};
+
+}  // namespace internal
+
+// Tests include this header for the specialization above alone; the functors
+// are instantiated once per dimension by tile_ops_cpu_impl_*.cc.
+#ifdef CPU_PROVIDED_IXDIM
 // Register functors used for TileOp.
 #define DEFINE_DIM(T, NDIM) template struct Tile<CPUDevice, T, NDIM>;
 #define DEFINE_TYPE(T) DEFINE_DIM(T, CPU_PROVIDED_IXDIM)
@@ -89,6 +201,7 @@ TF_CALL_int32(DEFINE_TYPE);
 #undef DEFINE_DIM
 #undef DEFINE_TYPE
 #endif // TENSORFLOW_USE_SYCL
+#endif  // CPU_PROVIDED_IXDIM
 
 }  // end namespace functor
 }  // end namespace tensorflow
@@ -23,11 +23,32 @@ limitations under the License.
 namespace tensorflow {
 namespace functor {
 
+namespace internal {
+
+// Tiles by copying contiguous blocks of the input instead of evaluating a
+// broadcast expression, which computes an index for every element.  Only the
+// CPU has an implementation (see tile_ops_cpu_impl.h); Run() returns false if
+// the broadcast should be evaluated instead.
+template <typename Device, typename T, int NDIM>
+struct TileUsingCopies {
+  static bool Run(const Device& d, typename TTypes<T, NDIM>::Tensor out,
+                  typename TTypes<T, NDIM>::ConstTensor in,
+                  const Eigen::array<int32, NDIM>& broadcast_array) {
+    return false;
+  }
+};
+
+}  // namespace internal
+
 template <typename Device, typename T, int NDIM>
 struct Tile {
   void operator()(const Device& d, typename TTypes<T, NDIM>::Tensor out,
                   typename TTypes<T, NDIM>::ConstTensor in,
                   const Eigen::array<int32, NDIM>& broadcast_array) const {
+    if (internal::TileUsingCopies<Device, T, NDIM>::Run(d, out, in,
+                                                         broadcast_array)) {
+      return;
+    }
     if (Eigen::internal::is_same<Device, Eigen::GpuDevice>::value) {
       // Use 32bit indexing to speed up the computations
       To32Bit(out).device(d) = To32Bit(in).broadcast(broadcast_array);
@@ -0,0 +1,141 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include "tensorflow/core/kernels/tile_ops_cpu_impl.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/common_runtime/eigen_thread_pool.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+// Tiles 'in' by 'multiples' with either the Tile functor or the broadcast
+// expression it used to evaluate unconditionally.
+void Tile(const CPUDevice& d, const Tensor& in,
+          const Eigen::array<int32, 4>& multiples, bool use_functor,
+          Tensor* out) {
+  if (use_functor) {
+    functor::Tile<CPUDevice, float, 4>()(d, out->tensor<float, 4>(),
+                                         in.tensor<float, 4>(), multiples);
+  } else {
+    out->tensor<float, 4>().device(d) =
+        in.tensor<float, 4>().broadcast(multiples);
+  }
+}
+
+Tensor TiledTensor(const Tensor& in, const Eigen::array<int32, 4>& multiples) {
+  TensorShape shape;
+  for (int i = 0; i < 4; ++i) shape.AddDim(in.dim_size(i) * multiples[i]);
+  return Tensor(DT_FLOAT, shape);
+}
+
+TEST(TileOpsTest, MatchesBroadcast) {
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  EigenThreadPoolWrapper wrapper(&pool);
+  CPUDevice d(&wrapper, 4);
+  random::PhiloxRandom philox(17, 5);
+  random::SimplePhilox rnd(&philox);
+  for (int iter = 0; iter < 200; ++iter) {
+    TensorShape shape;
+    Eigen::array<int32, 4> multiples;
+    for (int i = 0; i < 4; ++i) {
+      shape.AddDim(1 + rnd.Uniform(rnd.OneIn(4) ? 40 : 6));
+      multiples[i] = 1 + rnd.Uniform(rnd.OneIn(3) ? 1 : 5);
+    }
+    Tensor in(DT_FLOAT, shape);
+    in.flat<float>().setRandom();
+    Tensor expected = TiledTensor(in, multiples);
+    Tensor actual = TiledTensor(in, multiples);
+    Tile(d, in, multiples, false, &expected);
+    Tile(d, in, multiples, true, &actual);
+    test::ExpectTensorEqual<float>(expected, actual);
+  }
+}
+
+TEST(TileOpsTest, CopiesLongRows) {
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  EigenThreadPoolWrapper wrapper(&pool);
+  CPUDevice d(&wrapper, 4);
+  Tensor random_in(DT_FLOAT, TensorShape({3, 1, 5, 8}));
+  random_in.flat<float>().setRandom();
+  const Tensor& in = random_in;
+  // The innermost two dimensions are not tiled and fold into rows of 40.
+  const Eigen::array<int32, 4> multiples = {{2, 3, 1, 1}};
+  Tensor expected = TiledTensor(in, multiples);
+  Tensor actual = TiledTensor(in, multiples);
+  Tile(d, in, multiples, false, &expected);
+  EXPECT_TRUE((functor::internal::TileUsingCopies<CPUDevice, float, 4>::Run(
+      d, actual.tensor<float, 4>(), in.tensor<float, 4>(), multiples)));
+  test::ExpectTensorEqual<float>(expected, actual);
+
+  // Rows of 2 * 3 elements are left to the broadcast.
+  const Tensor short_in(DT_FLOAT, TensorShape({4, 1, 1, 2}));
+  const Eigen::array<int32, 4> short_multiples = {{1, 5, 1, 3}};
+  Tensor short_out = TiledTensor(short_in, short_multiples);
+  EXPECT_FALSE((functor::internal::TileUsingCopies<CPUDevice, float, 4>::Run(
+      d, short_out.tensor<float, 4>(), short_in.tensor<float, 4>(),
+      short_multiples)));
+}
+
+// Typical image and sequence shapes; each entry is the input dimensions
+// followed by the multiples.
+const int64 kTileCases[][8] = {
+    {1, 224, 224, 3, 32, 1, 1, 1},   // Replicate one image across a batch.
+    {32, 1, 1, 64, 1, 56, 56, 1},    // Spread per-channel values spatially.
+    {1, 1, 1, 1000, 1, 1, 1000, 1},  // Repeat a row.
+    {32, 1, 512, 1, 1, 50, 1, 1},    // Repeat a sequence embedding per step.
+    {32, 50, 1, 1, 1, 1, 512, 1},    // Widen per-step scalars.
+};
+
+static void BM_Tile(int iters, int index, bool use_functor) {
+  testing::StopTiming();
+  thread::ThreadPool pool(Env::Default(), "bench", port::NumSchedulableCPUs());
+  EigenThreadPoolWrapper wrapper(&pool);
+  CPUDevice d(&wrapper, port::NumSchedulableCPUs());
+  const int64* c = kTileCases[index];
+  Tensor in(DT_FLOAT, TensorShape({c[0], c[1], c[2], c[3]}));
+  in.flat<float>().setRandom();
+  const Eigen::array<int32, 4> multiples = {{static_cast<int32>(c[4]),
+                                             static_cast<int32>(c[5]),
+                                             static_cast<int32>(c[6]),
+                                             static_cast<int32>(c[7])}};
+  Tensor out = TiledTensor(in, multiples);
+  testing::BytesProcessed(static_cast<int64>(iters) * out.TotalBytes());
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) Tile(d, in, multiples, use_functor, &out);
+}
+
+static void BM_Tile_Broadcast(int iters, int index) {
+  BM_Tile(iters, index, false);
+}
+static void BM_Tile_Functor(int iters, int index) {
+  BM_Tile(iters, index, true);
+}
+BENCHMARK(BM_Tile_Broadcast)->Arg(0)->Arg(1)->Arg(2)->Arg(3)->Arg(4);
+BENCHMARK(BM_Tile_Functor)->Arg(0)->Arg(1)->Arg(2)->Arg(3)->Arg(4);
+
+}  // namespace
+}  // namespace tensorflow
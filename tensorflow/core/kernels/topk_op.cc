@@ -17,16 +17,144 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
 #include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
-#include "tensorflow/core/lib/gtl/top_n.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
+namespace {
+
+// Smallest candidate buffer of a TopKSelector for k > kMaxInsertionK.
+constexpr int kMinCapacity = 512;
+
+// Columns a chunk of a row must have to be worth its own shard.
+constexpr int64 kMinColumnsPerChunk = 32 * 1024;
+
+// Selects the k largest elements of a row.  Larger values come first, and
+// among equal values lower column indices come first, matching the
+// (value, -index) ordering the kernel has always used.
+//
+// Columns are offered in increasing index order, so once k candidates are
+// held any later column must be strictly greater than the current k-th best
+// to matter.  That threshold is checked a block at a time with a vectorized
+// max, and almost every block of a long row is skipped without touching the
+// candidates.  For tiny k the candidates are kept sorted by insertion; larger
+// k append to a buffer that is trimmed back to k with nth_element when full.
+template <typename T>
+class TopKSelector {
+ public:
+  struct Entry {
+    T value;
+    int32 index;
+  };
+
+  static bool Better(const Entry& a, const Entry& b) {
+    return a.value > b.value || (a.value == b.value && a.index < b.index);
+  }
+
+  explicit TopKSelector(int k)
+      : k_(k), capacity_(std::max(2 * k, kMinCapacity)) {
+    buffer_.reserve(k_ <= kMaxInsertionK ? k_ + 1 : capacity_);
+  }
+
+  void Reset() { buffer_.clear(); }
+
+  // Offers columns [begin, end) of 'row', where 'row' points at column 0.
+  // Must be called with increasing, non-overlapping ranges.
+  void Scan(const T* row, int32 begin, int32 end) {
+    int32 c = begin;
+    for (; c < end && static_cast<int>(buffer_.size()) < k_; ++c) {
+      Add(row[c], c);
+    }
+    if (c == end) return;
+    if (k_ > kMaxInsertionK) {
+      threshold_ = std::min_element(buffer_.begin(), buffer_.end(),
+                                    [](const Entry& a, const Entry& b) {
+                                      return a.value < b.value;
+                                    })
+                       ->value;
+    }
+    for (; c + kBlockSize <= end; c += kBlockSize) {
+      if (ConstBlock(row + c, kBlockSize).maxCoeff() <= threshold_) continue;
+      for (int32 j = c; j < c + kBlockSize; ++j) {
+        if (row[j] > threshold_) Add(row[j], j);
+      }
+    }
+    for (; c < end; ++c) {
+      if (row[c] > threshold_) Add(row[c], c);
+    }
+  }
+
+  // Adds a candidate regardless of the threshold.  Used to merge the results
+  // of several selectors; Scan() must not be called afterwards.
+  void Append(T value, int32 index) { buffer_.push_back({value, index}); }
+
+  // Writes the best k candidates to 'values' and 'indices', in descending
+  // order if 'sorted' and in column order otherwise.
+  void Finish(bool sorted, T* values, int32* indices) {
+    if (static_cast<int>(buffer_.size()) > k_) {
+      std::nth_element(buffer_.begin(), buffer_.begin() + k_ - 1,
+                       buffer_.end(), Better);
+      buffer_.resize(k_);
+    }
+    if (sorted) {
+      std::sort(buffer_.begin(), buffer_.end(), Better);
+    } else {
+      std::sort(buffer_.begin(), buffer_.end(),
+                [](const Entry& a, const Entry& b) {
+                  return a.index < b.index;
+                });
+    }
+    for (size_t i = 0; i < buffer_.size(); ++i) {
+      values[i] = buffer_[i].value;
+      indices[i] = buffer_[i].index;
+    }
+  }
+
+ private:
+  static constexpr int kMaxInsertionK = 8;
+  static constexpr int32 kBlockSize = 64;
+
+  typedef Eigen::Map<const Eigen::Array<T, kBlockSize, 1>> ConstBlock;
+
+  void Add(T value, int32 index) {
+    const Entry entry = {value, index};
+    if (k_ <= kMaxInsertionK) {
+      // Columns arrive in index order, so a new entry goes after all equal
+      // values already held.
+      auto pos = buffer_.end();
+      while (pos != buffer_.begin() && Better(entry, *(pos - 1))) --pos;
+      buffer_.insert(pos, entry);
+      if (static_cast<int>(buffer_.size()) > k_) buffer_.pop_back();
+      threshold_ = buffer_.back().value;
+      return;
+    }
+    buffer_.push_back(entry);
+    if (static_cast<int>(buffer_.size()) == capacity_) {
+      std::nth_element(buffer_.begin(), buffer_.begin() + k_ - 1,
+                       buffer_.end(), Better);
+      buffer_.resize(k_);
+      threshold_ = buffer_[k_ - 1].value;
+    }
+  }
+
+  const int k_;
+  const int capacity_;
+  std::vector<Entry> buffer_;
+  // Only meaningful once k candidates are held.
+  T threshold_ = T();
+};
+
+}  // namespace
+
 template <typename T>
 class TopK : public OpKernel {
  public:
@@ -72,39 +200,80 @@ class TopK : public OpKernel {
                    context->allocate_output(1, output_shape, &indices_out));
 
     // Nothing to do for top-nothing.
-    if (k == 0) return;
-
-    auto values = values_out->flat_inner_dims<T>();
-    auto indices = indices_out->flat_inner_dims<int32>();
-    gtl::TopN<std::pair<T, int32>> filter(k);
-    for (int r = 0; r < num_rows; r++) {
-      for (int32 c = 0; c < num_cols; ++c) {
-        // The second element is the negated index, so that lower-index elements
-        // are considered larger than higher-index elements in case of ties.
-        filter.push(std::make_pair(input(r, c), -c));
-      }
+    if (k == 0 || num_rows == 0) return;
 
-      int32 i = 0;
-      if (sorted_ && k > 1) {
-        std::unique_ptr<std::vector<std::pair<T, int32>>> top_k(
-            filter.Extract());
-        for (auto top_k_it = top_k->begin(); top_k_it != top_k->end();
-             ++top_k_it, ++i) {
-          values(r, i) = top_k_it->first;
-          indices(r, i) = -top_k_it->second;
+    const T* input_data = input.data();
+    T* values = values_out->flat<T>().data();
+    int32* indices = indices_out->flat<int32>().data();
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    const bool sorted = sorted_;
+
+    // Rows are independent.  When there are fewer rows than threads, long
+    // rows are also split into column chunks that each select their own top
+    // k; a second pass picks the final k of every row from those candidates.
+    const int64 num_chunks =
+        ChunksPerRow(num_rows, num_cols, k, worker_threads->num_threads);
+    const int64 cost_per_chunk = 2 * num_cols / num_chunks + 20 * k;
+    if (num_chunks == 1) {
+      auto select_rows = [input_data, values, indices, num_cols, k,
+                          sorted](int64 start, int64 limit) {
+        TopKSelector<T> selector(k);
+        for (int64 r = start; r < limit; ++r) {
+          selector.Reset();
+          selector.Scan(input_data + r * num_cols, 0, num_cols);
+          selector.Finish(sorted, values + r * k, indices + r * k);
         }
-      } else {
-        for (auto top_k_it = filter.unsorted_begin();
-             top_k_it != filter.unsorted_end(); ++top_k_it, ++i) {
-          values(r, i) = top_k_it->first;
-          indices(r, i) = -top_k_it->second;
+      };
+      Shard(worker_threads->num_threads, worker_threads->workers, num_rows,
+            cost_per_chunk, select_rows);
+      return;
+    }
+
+    const int64 num_candidates = num_chunks * k;
+    std::vector<T> chunk_values(num_rows * num_candidates);
+    std::vector<int32> chunk_indices(num_rows * num_candidates);
+    auto select_chunks = [input_data, num_cols, num_chunks, k, &chunk_values,
+                          &chunk_indices](int64 start, int64 limit) {
+      TopKSelector<T> selector(k);
+      for (int64 u = start; u < limit; ++u) {
+        const int64 r = u / num_chunks;
+        const int64 chunk = u % num_chunks;
+        selector.Reset();
+        selector.Scan(input_data + r * num_cols, num_cols * chunk / num_chunks,
+                      num_cols * (chunk + 1) / num_chunks);
+        selector.Finish(/*sorted=*/false, chunk_values.data() + u * k,
+                        chunk_indices.data() + u * k);
+      }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          num_rows * num_chunks, cost_per_chunk, select_chunks);
+
+    auto merge_rows = [values, indices, num_candidates, k, sorted,
+                       &chunk_values, &chunk_indices](int64 start,
+                                                      int64 limit) {
+      TopKSelector<T> selector(k);
+      for (int64 r = start; r < limit; ++r) {
+        selector.Reset();
+        for (int64 i = r * num_candidates; i < (r + 1) * num_candidates; ++i) {
+          selector.Append(chunk_values[i], chunk_indices[i]);
         }
+        selector.Finish(sorted, values + r * k, indices + r * k);
       }
-      filter.Reset();
-    }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers, num_rows,
+          20 * num_candidates, merge_rows);
   }
 
  private:
+  static int64 ChunksPerRow(int64 num_rows, int64 num_cols, int k,
+                            int num_threads) {
+    if (num_rows >= num_threads) return 1;
+    const int64 wanted = (num_threads + num_rows - 1) / num_rows;
+    const int64 max_chunks =
+        num_cols / std::max<int64>(kMinColumnsPerChunk, 4 * k);
+    return std::max<int64>(1, std::min(wanted, max_chunks));
+  }
+
   int k_;
   bool sorted_;
 };
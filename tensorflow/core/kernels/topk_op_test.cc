@@ -0,0 +1,199 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class TopKOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(bool sorted) {
+    TF_ASSERT_OK(NodeDefBuilder("topk", "TopKV2")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("sorted", sorted)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Gives the kernel 'num_threads' worker threads regardless of the host, so
+  // that the way TopK splits its work does not depend on the machine.
+  void PinWorkerThreads(int num_threads) {
+    pool_.reset(
+        new thread::ThreadPool(Env::Default(), "topk_test", num_threads));
+    worker_threads_.num_threads = num_threads;
+    worker_threads_.workers = pool_.get();
+    device_->set_tensorflow_cpu_worker_threads(&worker_threads_);
+  }
+
+  // Runs a sorted TopK over 'input' and checks it against a full sort, with
+  // ties broken by the lower index.
+  void ExpectMatchesFullSort(int num_rows, int num_cols, int k,
+                             const std::vector<float>& input) {
+    MakeOp(true);
+    AddInputFromArray<float>(TensorShape({num_rows, num_cols}), input);
+    AddInputFromArray<int32>(TensorShape({}), {k});
+    TF_ASSERT_OK(RunOpKernel());
+
+    auto values = GetOutput(0)->matrix<float>();
+    auto indices = GetOutput(1)->matrix<int32>();
+    for (int r = 0; r < num_rows; ++r) {
+      std::vector<std::pair<float, int32>> row;
+      for (int c = 0; c < num_cols; ++c) {
+        row.emplace_back(input[r * num_cols + c], -c);
+      }
+      std::partial_sort(row.begin(), row.begin() + k, row.end(),
+                        std::greater<std::pair<float, int32>>());
+      for (int i = 0; i < k; ++i) {
+        ASSERT_EQ(values(r, i), row[i].first) << "row " << r << " rank " << i;
+        ASSERT_EQ(indices(r, i), -row[i].second)
+            << "row " << r << " rank " << i;
+      }
+    }
+  }
+
+ private:
+  std::unique_ptr<thread::ThreadPool> pool_;
+  DeviceBase::CpuWorkerThreads worker_threads_;
+};
+
+// Uniform values with many duplicates, so that most column blocks are skipped
+// by the threshold prefilter and ties have to be broken.
+std::vector<float> RandomInput(int size) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<float> input(size);
+  for (float& v : input) v = rnd.Uniform(1000);
+  return input;
+}
+
+TEST_F(TopKOpTest, Sorted) {
+  MakeOp(true);
+  AddInputFromArray<float>(TensorShape({2, 5}),
+                           {1, 5, 2, 5, 3, /**/ -1, -2, -3, -4, -5});
+  AddInputFromArray<int32>(TensorShape({}), {3});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // Ties are broken by the lower index.
+  Tensor expected_values(allocator(), DT_FLOAT, TensorShape({2, 3}));
+  test::FillValues<float>(&expected_values, {5, 5, 3, -1, -2, -3});
+  test::ExpectTensorEqual<float>(expected_values, *GetOutput(0));
+  Tensor expected_indices(allocator(), DT_INT32, TensorShape({2, 3}));
+  test::FillValues<int32>(&expected_indices, {1, 3, 4, 0, 1, 2});
+  test::ExpectTensorEqual<int32>(expected_indices, *GetOutput(1));
+}
+
+TEST_F(TopKOpTest, Unsorted) {
+  MakeOp(false);
+  AddInputFromArray<float>(TensorShape({6}), {4, 1, 6, 3, 5, 2});
+  AddInputFromArray<int32>(TensorShape({}), {3});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // Unsorted results come back in column order.
+  Tensor expected_values(allocator(), DT_FLOAT, TensorShape({3}));
+  test::FillValues<float>(&expected_values, {4, 6, 5});
+  test::ExpectTensorEqual<float>(expected_values, *GetOutput(0));
+  Tensor expected_indices(allocator(), DT_INT32, TensorShape({3}));
+  test::FillValues<int32>(&expected_indices, {0, 2, 4});
+  test::ExpectTensorEqual<int32>(expected_indices, *GetOutput(1));
+}
+
+// With 8 worker threads and a single row of 300000 columns, the row is split
+// into 8 column chunks (one per thread, each above kMinColumnsPerChunk) whose
+// candidates are merged afterwards.
+TEST_F(TopKOpTest, ChunkedRowMatchesFullSort) {
+  PinWorkerThreads(8);
+  const int kCols = 300000;
+  ExpectMatchesFullSort(1, kCols, 100, RandomInput(kCols));
+}
+
+TEST_F(TopKOpTest, ChunkedRowSmallKMatchesFullSort) {
+  // k <= 8 keeps the candidates sorted by insertion.
+  PinWorkerThreads(8);
+  const int kCols = 300000;
+  ExpectMatchesFullSort(1, kCols, 5, RandomInput(kCols));
+}
+
+TEST_F(TopKOpTest, ChunkedAscendingRowMatchesFullSort) {
+  // Every block beats the threshold, so the prefilter never skips one.
+  PinWorkerThreads(8);
+  const int kCols = 300000;
+  std::vector<float> input(kCols);
+  for (int c = 0; c < kCols; ++c) input[c] = c / 4;
+  ExpectMatchesFullSort(1, kCols, 100, input);
+}
+
+TEST_F(TopKOpTest, ShardedRowsMatchFullSort) {
+  // More rows than threads: whole rows are sharded and never chunked.
+  PinWorkerThreads(4);
+  const int kRows = 64;
+  const int kCols = 5000;
+  ExpectMatchesFullSort(kRows, kCols, 10, RandomInput(kRows * kCols));
+}
+
+static Graph* TopK(int num_rows, int num_cols, int k) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DT_FLOAT, TensorShape({num_rows, num_cols}));
+  input.flat<float>().setRandom();
+  Tensor k_tensor(DT_INT32, TensorShape({}));
+  k_tensor.scalar<int32>()() = k;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "TopKV2")
+                  .Input(test::graph::Constant(g, input))
+                  .Input(test::graph::Constant(g, k_tensor))
+                  .Finalize(g, nullptr));
+  return g;
+}
+
+// Arg pairs are (k, num_cols).
+#define BM_TopKRows(ROWS)                                                      \
+  static void BM_TopK_Rows##ROWS(int iters, int k, int num_cols) {            \
+    testing::ItemsProcessed(static_cast<int64>(iters) * ROWS * num_cols);     \
+    test::Benchmark("cpu", TopK(ROWS, num_cols, k)).Run(iters);               \
+  }                                                                            \
+  BENCHMARK(BM_TopK_Rows##ROWS)                                                \
+      ->ArgPair(1, 1000)                                                       \
+      ->ArgPair(10, 1000)                                                      \
+      ->ArgPair(100, 1000)                                                     \
+      ->ArgPair(1, 100000)                                                     \
+      ->ArgPair(10, 100000)                                                    \
+      ->ArgPair(100, 100000)                                                   \
+      ->ArgPair(1000, 100000)                                                  \
+      ->ArgPair(1, 1000000)                                                    \
+      ->ArgPair(10, 1000000)                                                   \
+      ->ArgPair(100, 1000000)                                                  \
+      ->ArgPair(1000, 1000000);
+
+BM_TopKRows(1);
+BM_TopKRows(32);
+
+}  // namespace
+}  // namespace tensorflow
@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/where_op.h"
 
 #include <memory>
+#include <vector>
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -45,14 +46,11 @@ class WhereOp : public OpKernel {
     const Tensor& input = context->input(0);
 
     const int input_dims = input.dims();
-    Tensor num_true;
-    OP_REQUIRES_OK(
-        context, context->allocate_temp(DT_INT64, TensorShape({}), &num_true));
-    auto num_true_t = num_true.scalar<int64>();
-
-    functor::NumTrue<Device>::Compute(context->eigen_device<Device>(),
-                                      input.flat<bool>(), num_true_t);
-    TensorShape output_shape({num_true_t(), input_dims});
+    std::vector<int64> offsets;
+    const int64 num_true = functor::CountTrueBlocks(
+        context->eigen_device<Device>(), input.flat<bool>().data(),
+        input.NumElements(), &offsets);
+    TensorShape output_shape({num_true, input_dims});
     Tensor* output = nullptr;
     OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
 
@@ -60,7 +58,7 @@ class WhereOp : public OpKernel {
   case NDIM:                                                         \
     found_true = functor::Where<Device, NDIM>::Compute(              \
         context->eigen_device<Device>(), input.tensor<bool, NDIM>(), \
-        output->matrix<int64>());                                    \
+        offsets, output->matrix<int64>());                           \
     break;
 
     int64 found_true = 0;
@@ -79,11 +77,11 @@ class WhereOp : public OpKernel {
 #undef HANDLE_DIM
 
     OP_REQUIRES(
-        context, num_true_t() == found_true,
+        context, num_true == found_true,
         errors::InvalidArgument(
             "WhereOp: Race condition between counting the number of true "
             "elements and writing them.  When counting, saw ",
-            num_true_t(), " elements; but when writing their indices, saw ",
+            num_true, " elements; but when writing their indices, saw ",
             found_true, " elements."));
   }
 
@@ -16,6 +16,11 @@ limitations under the License.
 #ifndef TENSORFLOW_KERNELS_WHERE_OP_H_
 #define TENSORFLOW_KERNELS_WHERE_OP_H_
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/tensor_types.h"
 #include "tensorflow/core/platform/macros.h"
@@ -25,21 +30,97 @@ namespace tensorflow {
 
 namespace functor {
 
+// Stream compaction of a boolean mask on the threads of 'd', shared by kernels
+// that emit one output row per true element.  The mask is split into blocks
+// of kMaskBlockSize elements; CountTrueBlocks counts the true elements of
+// every block in parallel and turns the counts into output offsets, after
+// which ForEachMaskBlock visits the blocks in parallel, each writing its rows
+// independently of the others.  Templated on the device so that this header
+// still compiles where Eigen's thread pool device is not defined.
+constexpr int64 kMaskBlockSize = 1 << 16;
+
+// Returns the number of true values in mask[begin, end).  Bools are bytes
+// holding 0 or 1, so eight of them are added at once as the byte lanes of a
+// uint64; a lane overflows only after 255 additions.  Compilers vectorize the
+// inner loop.
+inline int64 CountTrue(const bool* mask, int64 begin, int64 end) {
+  const uint64 kLowBytes = 0x00FF00FF00FF00FFull;
+  int64 count = 0;
+  int64 i = begin;
+  while (end - i >= 8) {
+    const int64 num_words = std::min<int64>((end - i) / 8, 255);
+    uint64 lanes = 0;
+    for (int64 w = 0; w < num_words; ++w) {
+      uint64 word;
+      memcpy(&word, mask + i + 8 * w, sizeof(word));
+      lanes += word;
+    }
+    lanes = (lanes & kLowBytes) + ((lanes >> 8) & kLowBytes);
+    count += (lanes * 0x0001000100010001ull) >> 48;
+    i += 8 * num_words;
+  }
+  for (; i < end; ++i) {
+    count += mask[i];
+  }
+  return count;
+}
+
+// Counts the true values of each block of 'mask' and stores their exclusive
+// prefix sum in 'offsets', which gets one entry per block plus the total: the
+// rows of block b are [offsets[b], offsets[b + 1]).  Returns the total.
 template <typename Device>
-struct NumTrue {
-  EIGEN_ALWAYS_INLINE static void Compute(
-      const Device& d, typename TTypes<bool>::ConstFlat input,
-      TTypes<int64>::Scalar num_true) {
-    num_true.device(d) = input.template cast<int64>().sum();
+int64 CountTrueBlocks(const Device& d, const bool* mask, int64 size,
+                      std::vector<int64>* offsets) {
+  const int64 num_blocks = (size + kMaskBlockSize - 1) / kMaskBlockSize;
+  offsets->assign(num_blocks + 1, 0);
+  int64* counts = offsets->data() + 1;
+  d.parallelFor(num_blocks,
+                Eigen::TensorOpCost(kMaskBlockSize, sizeof(int64),
+                                    kMaskBlockSize / 8),
+                [mask, size, counts](int64 first, int64 last) {
+                  for (int64 b = first; b < last; ++b) {
+                    const int64 begin = b * kMaskBlockSize;
+                    counts[b] = CountTrue(
+                        mask, begin, std::min(begin + kMaskBlockSize, size));
+                  }
+                });
+  for (int64 b = 0; b < num_blocks; ++b) {
+    counts[b] += (*offsets)[b];
   }
-};
+  return offsets->back();
+}
+
+// Calls fn(begin, end, first_row, end_row) on the threads of 'd' for every
+// block [begin, end) of a mask of 'size' elements, where [first_row, end_row)
+// are the output rows of the block according to 'offsets' from
+// CountTrueBlocks.  'cost_per_element' is in cycles.
+template <typename Device, typename Fn>
+void ForEachMaskBlock(const Device& d, int64 size,
+                      const std::vector<int64>& offsets,
+                      double cost_per_element, Fn fn) {
+  const int64 num_blocks = offsets.size() - 1;
+  d.parallelFor(num_blocks,
+                Eigen::TensorOpCost(kMaskBlockSize, 0,
+                                    kMaskBlockSize * cost_per_element),
+                [size, &offsets, &fn](int64 first, int64 last) {
+                  for (int64 b = first; b < last; ++b) {
+                    const int64 begin = b * kMaskBlockSize;
+                    fn(begin, std::min(begin + kMaskBlockSize, size),
+                       offsets[b], offsets[b + 1]);
+                  }
+                });
+}
 
 template <typename Device, int NDIM>
 struct Where {
-  EIGEN_ALWAYS_INLINE static int64 Compute(
-      const Device& d, typename TTypes<bool, NDIM>::ConstTensor input,
-      typename TTypes<int64>::Matrix output) {
-    Eigen::DenseIndex true_n = 0;
+  // Writes the coordinates of the true elements of 'input' to 'output', block
+  // by block at the offsets computed by CountTrueBlocks.  Returns the number
+  // of true elements seen, which differs from the count only if 'input'
+  // changed in between.
+  static int64 Compute(const Device& d,
+                       typename TTypes<bool, NDIM>::ConstTensor input,
+                       const std::vector<int64>& offsets,
+                       typename TTypes<int64>::Matrix output) {
     Eigen::DSizes<Eigen::DenseIndex, NDIM> dims = input.dimensions();
     Eigen::DSizes<Eigen::DenseIndex, NDIM> strides;
 
@@ -53,26 +134,49 @@ struct Where {
       strides[i] = strides[i + 1] * dims[i + 1];
     }
 
-    Eigen::DenseIndex output_size = output.dimension(0);
-    for (Eigen::DenseIndex n = 0; n < input.size(); ++n) {
-      if (input.data()[n]) {
-        if (TF_PREDICT_TRUE(true_n < output_size)) {
-          WriteIndexRowMajor(output, strides, true_n, n);
+    const bool* mask = input.data();
+    std::atomic<int64> found(0);
+    auto write = [mask, &dims, &strides, &output, &found](
+        int64 begin, int64 end, int64 row, int64 end_row) {
+      // Only the coordinates of the first element are divided out; after that
+      // they are advanced incrementally, skipping runs of eight false values.
+      Eigen::DenseIndex coords[NDIM];
+      Eigen::DenseIndex index = begin;
+      for (int i = 0; i < NDIM; ++i) {
+        coords[i] = index / strides[i];
+        index %= strides[i];
+      }
+      const int64 first_row = row;
+      int64 n = begin;
+      while (n < end) {
+        Eigen::DenseIndex step = 1;
+        uint64 word = 1;
+        if (end - n >= 8) {
+          memcpy(&word, mask + n, sizeof(word));
+        }
+        if (word == 0) {
+          step = 8;
+        } else if (TF_PREDICT_TRUE(row < end_row)) {
+          // Writes unconditionally rather than branching on the mask; the row
+          // is overwritten unless the element is true.
+          for (int i = 0; i < NDIM; ++i) {
+            output(row, i) = coords[i];
+          }
+          row += mask[n];
+        } else {
+          row += mask[n];
+        }
+        n += step;
+        coords[NDIM - 1] += step;
+        for (int i = NDIM - 1; i > 0 && coords[i] >= dims[i]; --i) {
+          coords[i - 1] += coords[i] / dims[i];
+          coords[i] %= dims[i];
         }
-        ++true_n;
       }
-    }
-    return true_n;
-  }
-
-  EIGEN_ALWAYS_INLINE static void WriteIndexRowMajor(
-      typename TTypes<int64>::Matrix output,
-      const Eigen::DSizes<Eigen::DenseIndex, NDIM>& strides,
-      Eigen::DenseIndex true_n, Eigen::DenseIndex index) {
-    for (int i = 0; i < NDIM; ++i) {
-      output(true_n, i) = index / strides[i];
-      index %= strides[i];
-    }
+      found += row - first_row;
+    };
+    ForEachMaskBlock(d, input.size(), offsets, 2 + NDIM, write);
+    return found;
   }
 };
 
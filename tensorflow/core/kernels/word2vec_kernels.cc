@@ -13,6 +13,10 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <memory>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
@@ -23,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/util/guarded_philox_random.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -48,23 +53,35 @@ bool ScanWord(StringPiece* input, string* word) {
 
 class SkipgramOp : public OpKernel {
  public:
-  explicit SkipgramOp(OpKernelConstruction* ctx)
-      : OpKernel(ctx), rng_(&philox_) {
+  explicit SkipgramOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     string filename;
     OP_REQUIRES_OK(ctx, ctx->GetAttr("filename", &filename));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("batch_size", &batch_size_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("window_size", &window_size_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("min_count", &min_count_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("subsample", &subsample_));
-    OP_REQUIRES_OK(ctx, Init(ctx->env(), filename));
-
-    mutex_lock l(mu_);
-    example_pos_ = corpus_size_;
-    label_pos_ = corpus_size_;
-    label_limit_ = corpus_size_;
-    sentence_index_ = kSentenceSize;
-    for (int i = 0; i < kPrecalc; ++i) {
-      NextExample(&precalc_examples_[i].input, &precalc_examples_[i].label);
+    int32 num_threads;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_threads", &num_threads));
+    OP_REQUIRES_OK(ctx, Init(ctx->env(), filename, num_threads));
+
+    // Cursor k reads the k-th contiguous part of the corpus, with its own
+    // random stream.  A single cursor reads the whole corpus.
+    for (int32 k = 0; k < num_threads; ++k) {
+      cursors_.emplace_back(new Cursor(k));
+      Cursor* c = cursors_.back().get();
+      mutex_lock l(c->mu);
+      c->begin = corpus_size_ * k / num_threads;
+      c->end = corpus_size_ * (k + 1) / num_threads;
+      c->example_pos = c->end;
+      c->label_pos = c->end;
+      c->label_limit = c->end;
+      c->sentence.resize(kSentenceSize);
+      c->sentence_index = kSentenceSize;
+      c->precalc_examples.resize(kPrecalc);
+      for (int i = 0; i < kPrecalc; ++i) {
+        NextExample(c, &c->precalc_examples[i].input,
+                    &c->precalc_examples[i].label);
+      }
     }
   }
 
@@ -76,24 +93,52 @@ class SkipgramOp : public OpKernel {
     auto Texamples = examples.flat<int32>();
     Tensor labels(DT_INT32, TensorShape({batch_size_}));
     auto Tlabels = labels.flat<int32>();
-    {
-      mutex_lock l(mu_);
-      for (int i = 0; i < batch_size_; ++i) {
-        Texamples(i) = precalc_examples_[precalc_index_].input;
-        Tlabels(i) = precalc_examples_[precalc_index_].label;
-        precalc_index_++;
-        if (precalc_index_ >= kPrecalc) {
-          precalc_index_ = 0;
-          for (int j = 0; j < kPrecalc; ++j) {
-            NextExample(&precalc_examples_[j].input,
-                        &precalc_examples_[j].label);
+
+    // Cursor k fills the k-th contiguous part of the batch.
+    const int64 num_cursors = cursors_.size();
+    auto fill = [this, num_cursors, &Texamples, &Tlabels](int64 start,
+                                                          int64 limit) {
+      for (int64 k = start; k < limit; ++k) {
+        Cursor* c = cursors_[k].get();
+        mutex_lock l(c->mu);
+        const int64 end = batch_size_ * (k + 1) / num_cursors;
+        for (int64 i = batch_size_ * k / num_cursors; i < end; ++i) {
+          Texamples(i) = c->precalc_examples[c->precalc_index].input;
+          Tlabels(i) = c->precalc_examples[c->precalc_index].label;
+          c->precalc_index++;
+          if (c->precalc_index >= kPrecalc) {
+            c->precalc_index = 0;
+            for (int j = 0; j < kPrecalc; ++j) {
+              NextExample(c, &c->precalc_examples[j].input,
+                          &c->precalc_examples[j].label);
+            }
           }
         }
       }
-      words_per_epoch.scalar<int64>()() = corpus_size_;
-      current_epoch.scalar<int32>()() = current_epoch_;
-      total_words_processed.scalar<int64>()() = total_words_processed_;
+    };
+    if (num_cursors == 1) {
+      fill(0, 1);
+    } else {
+      auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
+      // Refilling the precalculated examples dominates the cost.
+      const int64 cost_per_cursor =
+          1000 * (batch_size_ / num_cursors + kPrecalc);
+      Shard(worker_threads.num_threads, worker_threads.workers, num_cursors,
+            cost_per_cursor, fill);
     }
+
+    // An epoch ends once every cursor has been through its part.
+    int32 epoch = kint32max;
+    int64 words_processed = 0;
+    for (const auto& c : cursors_) {
+      mutex_lock l(c->mu);
+      epoch = std::min(epoch, c->current_epoch);
+      words_processed += c->total_words_processed;
+    }
+    words_per_epoch.scalar<int64>()() = corpus_size_;
+    current_epoch.scalar<int32>()() = epoch;
+    total_words_processed.scalar<int64>()() = words_processed;
+
     ctx->set_output(0, word_);
     ctx->set_output(1, freq_);
     ctx->set_output(2, words_per_epoch);
@@ -109,6 +154,27 @@ class SkipgramOp : public OpKernel {
     int32 label;
   };
 
+  // The example generation state for one part of the corpus.
+  struct Cursor {
+    explicit Cursor(int32 k) : philox(0, k), rng(&philox) {}
+
+    mutex mu;
+    random::PhiloxRandom philox GUARDED_BY(mu);
+    random::SimplePhilox rng GUARDED_BY(mu);
+    // [begin, end) is the part of corpus_ this cursor reads.
+    int32 begin = 0;
+    int32 end = 0;
+    int32 current_epoch GUARDED_BY(mu) = -1;
+    int64 total_words_processed GUARDED_BY(mu) = 0;
+    int32 example_pos GUARDED_BY(mu);
+    int32 label_pos GUARDED_BY(mu);
+    int32 label_limit GUARDED_BY(mu);
+    std::vector<int32> sentence GUARDED_BY(mu);
+    int sentence_index GUARDED_BY(mu) = 0;
+    std::vector<Example> precalc_examples GUARDED_BY(mu);
+    int precalc_index GUARDED_BY(mu) = 0;
+  };
+
   int32 batch_size_ = 0;
   int32 window_size_ = 5;
   float subsample_ = 1e-3;
@@ -118,65 +184,56 @@ class SkipgramOp : public OpKernel {
   Tensor freq_;
   int64 corpus_size_ = 0;
   std::vector<int32> corpus_;
-  std::vector<Example> precalc_examples_;
-  int precalc_index_ = 0;
-  std::vector<int32> sentence_;
-  int sentence_index_ = 0;
-
-  mutex mu_;
-  random::PhiloxRandom philox_ GUARDED_BY(mu_);
-  random::SimplePhilox rng_ GUARDED_BY(mu_);
-  int32 current_epoch_ GUARDED_BY(mu_) = -1;
-  int64 total_words_processed_ GUARDED_BY(mu_) = 0;
-  int32 example_pos_ GUARDED_BY(mu_);
-  int32 label_pos_ GUARDED_BY(mu_);
-  int32 label_limit_ GUARDED_BY(mu_);
-
-  // {example_pos_, label_pos_} is the cursor for the next example.
-  // example_pos_ wraps around at the end of corpus_. For each
-  // example, we randomly generate [label_pos_, label_limit) for
+  std::vector<std::unique_ptr<Cursor>> cursors_;
+
+  // {example_pos, label_pos} is the cursor for the next example.
+  // example_pos wraps around at the end of the cursor's part of corpus_.
+  // For each example, we randomly generate [label_pos, label_limit) for
   // labels.
-  void NextExample(int32* example, int32* label) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+  void NextExample(Cursor* c, int32* example, int32* label)
+      EXCLUSIVE_LOCKS_REQUIRED(c->mu) {
     while (true) {
-      if (label_pos_ >= label_limit_) {
-        ++total_words_processed_;
-        ++sentence_index_;
-        if (sentence_index_ >= kSentenceSize) {
-          sentence_index_ = 0;
-          for (int i = 0; i < kSentenceSize; ++i, ++example_pos_) {
-            if (example_pos_ >= corpus_size_) {
-              ++current_epoch_;
-              example_pos_ = 0;
+      if (c->label_pos >= c->label_limit) {
+        ++c->total_words_processed;
+        ++c->sentence_index;
+        if (c->sentence_index >= kSentenceSize) {
+          c->sentence_index = 0;
+          for (int i = 0; i < kSentenceSize; ++i, ++c->example_pos) {
+            if (c->example_pos >= c->end) {
+              ++c->current_epoch;
+              c->example_pos = c->begin;
             }
             if (subsample_ > 0) {
-              int32 word_freq = freq_.flat<int32>()(corpus_[example_pos_]);
+              int32 word_freq = freq_.flat<int32>()(corpus_[c->example_pos]);
               // See Eq. 5 in http://arxiv.org/abs/1310.4546
               float keep_prob =
                   (std::sqrt(word_freq / (subsample_ * corpus_size_)) + 1) *
                   (subsample_ * corpus_size_) / word_freq;
-              if (rng_.RandFloat() > keep_prob) {
+              if (c->rng.RandFloat() > keep_prob) {
                 i--;
                 continue;
               }
             }
-            sentence_[i] = corpus_[example_pos_];
+            c->sentence[i] = corpus_[c->example_pos];
           }
         }
-        const int32 skip = 1 + rng_.Uniform(window_size_);
-        label_pos_ = std::max<int32>(0, sentence_index_ - skip);
-        label_limit_ =
-            std::min<int32>(kSentenceSize, sentence_index_ + skip + 1);
+        const int32 skip = 1 + c->rng.Uniform(window_size_);
+        c->label_pos = std::max<int32>(0, c->sentence_index - skip);
+        c->label_limit =
+            std::min<int32>(kSentenceSize, c->sentence_index + skip + 1);
       }
-      if (sentence_index_ != label_pos_) {
+      if (c->sentence_index != c->label_pos) {
         break;
       }
-      ++label_pos_;
+      ++c->label_pos;
     }
-    *example = sentence_[sentence_index_];
-    *label = sentence_[label_pos_++];
+    *example = c->sentence[c->sentence_index];
+    *label = c->sentence[c->label_pos++];
   }
 
-  Status Init(Env* env, const string& filename) {
+  // Reads the corpus and builds the vocabulary.  Each of the 'num_threads'
+  // parts of the corpus must be able to hold 10 windows.
+  Status Init(Env* env, const string& filename, int32 num_threads) {
     string data;
     TF_RETURN_IF_ERROR(ReadFileToString(env, filename, &data));
     StringPiece input = data;
@@ -187,10 +244,11 @@ class SkipgramOp : public OpKernel {
       ++(word_freq[w]);
       ++corpus_size_;
     }
-    if (corpus_size_ < window_size_ * 10) {
+    if (corpus_size_ < num_threads * window_size_ * 10) {
       return errors::InvalidArgument("The text file ", filename,
                                      " contains too little data: ",
-                                     corpus_size_, " words");
+                                     corpus_size_, " words, need ",
+                                     num_threads * window_size_ * 10);
     }
     typedef std::pair<string, int32> WordFreq;
     std::vector<WordFreq> ordered;
@@ -230,8 +288,6 @@ class SkipgramOp : public OpKernel {
     while (ScanWord(&input, &w)) {
       corpus_.push_back(gtl::FindWithDefault(word_id, w, kUnkId));
     }
-    precalc_examples_.resize(kPrecalc);
-    sentence_.resize(kSentenceSize);
     return Status::OK();
   }
 };
@@ -244,6 +300,7 @@ class NegTrainOp : public OpKernel {
     base_.Init(0, 0);
 
     OP_REQUIRES_OK(ctx, ctx->GetAttr("num_negative_samples", &num_samples_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_threads", &num_threads_));
 
     std::vector<int32> vocab_count;
     OP_REQUIRES_OK(ctx, ctx->GetAttr("vocab_count", &vocab_count));
@@ -288,64 +345,79 @@ class NegTrainOp : public OpKernel {
                 errors::InvalidArgument("vocab_size mismatches: ", vocab_size,
                                         " vs. ", sampler_->num()));
 
-    // Gradient accumulator for v_in.
-    Tensor buf(DT_FLOAT, TensorShape({dims}));
-    auto Tbuf = buf.flat<float>();
-
-    // Scalar buffer to hold sigmoid(+/- dot).
-    Tensor g_buf(DT_FLOAT, TensorShape({}));
-    auto g = g_buf.scalar<float>();
-
     // The following loop needs 2 random 32-bit values per negative
     // sample.  We reserve 8 values per sample just in case the
     // underlying implementation changes.
-    auto rnd = base_.ReserveSamples32(batch_size * num_samples_ * 8);
-    random::SimplePhilox srnd(&rnd);
-
-    for (int64 i = 0; i < batch_size; ++i) {
-      const int32 example = Texamples(i);
-      DCHECK(0 <= example && example < vocab_size) << example;
-      const int32 label = Tlabels(i);
-      DCHECK(0 <= label && label < vocab_size) << label;
-      auto v_in = Tw_in.chip<0>(example);
-
-      // Positive: example predicts label.
-      //   forward: x = v_in' * v_out
-      //            l = log(sigmoid(x))
-      //   backward: dl/dx = g = sigmoid(-x)
-      //             dl/d(v_in) = g * v_out'
-      //             dl/d(v_out) = v_in' * g
-      {
-        auto v_out = Tw_out.chip<0>(label);
-        auto dot = (v_in * v_out).sum();
-        g = (dot.exp() + 1.f).inverse();
-        Tbuf = v_out * (g() * lr);
-        v_out += v_in * (g() * lr);
-      }
+    const random::PhiloxRandom rnd =
+        base_.ReserveSamples32(batch_size * num_samples_ * 8);
+
+    // With num_threads > 1, examples are trained in parallel, Hogwild style:
+    // shards update rows of w_in and w_out without locking, like concurrent
+    // NegTrain steps already do.  The shard starting at example "start" draws
+    // from "rnd" skipped ahead to that example's reserved samples, so a
+    // single shard draws exactly the samples the serial loop always did.
+    auto train = [this, &Tw_in, &Tw_out, &Texamples, &Tlabels, &rnd, lr,
+                  vocab_size, dims](int64 start, int64 limit) {
+      random::PhiloxRandom shard_rnd = rnd;
+      shard_rnd.Skip(start * num_samples_ * 2);
+      random::SimplePhilox srnd(&shard_rnd);
+
+      // Gradient accumulator for v_in.
+      Eigen::VectorXf buf(dims);
+
+      for (int64 i = start; i < limit; ++i) {
+        const int32 example = Texamples(i);
+        DCHECK(0 <= example && example < vocab_size) << example;
+        const int32 label = Tlabels(i);
+        DCHECK(0 <= label && label < vocab_size) << label;
+        Eigen::Map<Eigen::VectorXf> v_in(&Tw_in(example, 0), dims);
+
+        // Positive: example predicts label.
+        //   forward: x = v_in' * v_out
+        //            l = log(sigmoid(x))
+        //   backward: dl/dx = g = sigmoid(-x)
+        //             dl/d(v_in) = g * v_out'
+        //             dl/d(v_out) = v_in' * g
+        {
+          Eigen::Map<Eigen::VectorXf> v_out(&Tw_out(label, 0), dims);
+          const float g = 1.f / (std::exp(v_in.dot(v_out)) + 1.f);
+          buf.noalias() = v_out * (g * lr);
+          v_out.noalias() += v_in * (g * lr);
+        }
 
-      // Negative samples:
-      //   forward: x = v_in' * v_sample
-      //            l = log(sigmoid(-x))
-      //   backward: dl/dx = g = -sigmoid(x)
-      //             dl/d(v_in) = g * v_out'
-      //             dl/d(v_out) = v_in' * g
-      for (int j = 0; j < num_samples_; ++j) {
-        const int sample = sampler_->Sample(&srnd);
-        if (sample == label) continue;  // Skip.
-        auto v_sample = Tw_out.chip<0>(sample);
-        auto dot = (v_in * v_sample).sum();
-        g = -((-dot).exp() + 1.f).inverse();
-        Tbuf += v_sample * (g() * lr);
-        v_sample += v_in * (g() * lr);
-      }
+        // Negative samples:
+        //   forward: x = v_in' * v_sample
+        //            l = log(sigmoid(-x))
+        //   backward: dl/dx = g = -sigmoid(x)
+        //             dl/d(v_in) = g * v_out'
+        //             dl/d(v_out) = v_in' * g
+        for (int j = 0; j < num_samples_; ++j) {
+          const int sample = sampler_->Sample(&srnd);
+          if (sample == label) continue;  // Skip.
+          Eigen::Map<Eigen::VectorXf> v_sample(&Tw_out(sample, 0), dims);
+          const float g = -1.f / (std::exp(-v_in.dot(v_sample)) + 1.f);
+          buf.noalias() += v_sample * (g * lr);
+          v_sample.noalias() += v_in * (g * lr);
+        }
 
-      // Applies the gradient on v_in.
-      v_in += Tbuf;
+        // Applies the gradient on v_in.
+        v_in += buf;
+      }
+    };
+    if (num_threads_ == 1) {
+      train(0, batch_size);
+    } else {
+      auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
+      // Each example reads and writes 2 + num_samples_ rows.
+      const int64 cost_per_example = (2 + num_samples_) * dims * 8;
+      Shard(std::min(num_threads_, worker_threads.num_threads),
+            worker_threads.workers, batch_size, cost_per_example, train);
     }
   }
 
  private:
   int32 num_samples_ = 0;
+  int32 num_threads_ = 1;
   random::DistributionSampler* sampler_ = nullptr;
   GuardedPhiloxRandom base_;
 };
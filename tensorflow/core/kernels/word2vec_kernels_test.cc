@@ -0,0 +1,245 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Both ops are deprecated at GraphDef version 19.
+const int kGraphDefVersion = 18;
+
+class SkipgramOpTest : public OpsTestBase {
+ protected:
+  // Writes a corpus whose first half cycles through "a b c" and whose second
+  // half cycles through "x y z", 'words_per_half' words each.
+  string WriteCorpus(int words_per_half) {
+    string corpus;
+    for (int i = 0; i < words_per_half; ++i) {
+      corpus.append({"abc"[i % 3], ' '});
+    }
+    for (int i = 0; i < words_per_half; ++i) {
+      corpus.append({"xyz"[i % 3], ' '});
+    }
+    const string filename = io::JoinPath(testing::TmpDir(), "corpus.txt");
+    TF_CHECK_OK(WriteStringToFile(Env::Default(), filename, corpus));
+    return filename;
+  }
+
+  void MakeOp(const string& filename, int batch_size, int num_threads) {
+    TF_ASSERT_OK(NodeDefBuilder("skipgram", "Skipgram")
+                     .Attr("filename", filename)
+                     .Attr("batch_size", batch_size)
+                     .Attr("window_size", 2)
+                     .Attr("min_count", 1)
+                     .Attr("subsample", 0.0f)
+                     .Attr("num_threads", num_threads)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOpWithGraphVersion(kGraphDefVersion));
+  }
+};
+
+TEST_F(SkipgramOpTest, ThreadsSplitTheCorpus) {
+  const string filename = WriteCorpus(300);
+  const int kBatchSize = 40;
+
+  MakeOp(filename, kBatchSize, 1);
+  TF_ASSERT_OK(RunOpKernel());
+  const Tensor vocab_word = *GetOutput(0);
+  const Tensor vocab_freq = *GetOutput(1);
+
+  // The vocabulary is built from the whole corpus, whatever the number of
+  // threads that read it.
+  MakeOp(filename, kBatchSize, 2);
+  TF_ASSERT_OK(RunOpKernel());
+  test::ExpectTensorEqual<string>(vocab_word, *GetOutput(0));
+  test::ExpectTensorEqual<int32>(vocab_freq, *GetOutput(1));
+  EXPECT_EQ(600, GetOutput(2)->scalar<int64>()());
+
+  // Cursor k fills the k-th half of the batch from the k-th half of the
+  // corpus, so every example and label of a half comes from its words.
+  std::set<int32> first_half_ids;
+  std::set<int32> second_half_ids;
+  auto words = vocab_word.flat<string>();
+  for (int i = 0; i < words.size(); ++i) {
+    if (words(i) == "a" || words(i) == "b" || words(i) == "c") {
+      first_half_ids.insert(i);
+    } else if (words(i) == "x" || words(i) == "y" || words(i) == "z") {
+      second_half_ids.insert(i);
+    }
+  }
+  ASSERT_EQ(3, first_half_ids.size());
+  ASSERT_EQ(3, second_half_ids.size());
+  auto examples = GetOutput(5)->flat<int32>();
+  auto labels = GetOutput(6)->flat<int32>();
+  ASSERT_EQ(kBatchSize, examples.size());
+  ASSERT_EQ(kBatchSize, labels.size());
+  for (int i = 0; i < kBatchSize; ++i) {
+    const std::set<int32>& ids =
+        i < kBatchSize / 2 ? first_half_ids : second_half_ids;
+    EXPECT_EQ(1, ids.count(examples(i))) << "example " << i;
+    EXPECT_EQ(1, ids.count(labels(i))) << "label " << i;
+    // Neighbors within the window are always different words.
+    EXPECT_NE(examples(i), labels(i));
+  }
+}
+
+TEST_F(SkipgramOpTest, CorpusTooSmallForThreads) {
+  // 60 words are enough for one thread (10 windows of 2) but not for 4.
+  const string filename = WriteCorpus(30);
+  TF_ASSERT_OK(NodeDefBuilder("skipgram", "Skipgram")
+                   .Attr("filename", filename)
+                   .Attr("batch_size", 8)
+                   .Attr("window_size", 2)
+                   .Attr("num_threads", 4)
+                   .Finalize(node_def()));
+  Status s = InitOpWithGraphVersion(kGraphDefVersion);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+  EXPECT_TRUE(StringPiece(s.error_message()).contains("too little data"))
+      << s;
+}
+
+class NegTrainOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const std::vector<int32>& vocab_count, int num_negative_samples,
+              int num_threads) {
+    TF_ASSERT_OK(NodeDefBuilder("neg_train", "NegTrain")
+                     .Input(FakeInput(DT_FLOAT_REF))
+                     .Input(FakeInput(DT_FLOAT_REF))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("vocab_count", vocab_count)
+                     .Attr("num_negative_samples", num_negative_samples)
+                     .Attr("num_threads", num_threads)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOpWithGraphVersion(kGraphDefVersion));
+  }
+
+  // Gives the kernel 'num_threads' worker threads regardless of the host.
+  void PinWorkerThreads(int num_threads) {
+    pool_.reset(
+        new thread::ThreadPool(Env::Default(), "neg_train_test", num_threads));
+    worker_threads_.num_threads = num_threads;
+    worker_threads_.workers = pool_.get();
+    device_->set_tensorflow_cpu_worker_threads(&worker_threads_);
+  }
+
+  // Runs the kernel and expects w_in and w_out to match the serial
+  // reference update.  Every negative sample is 'sample'.
+  void RunAndCheck(int vocab_size, int dims, const std::vector<int32>& examples,
+                   const std::vector<int32>& labels, int num_negative_samples,
+                   int sample) {
+    random::PhiloxRandom philox(301, 17);
+    random::SimplePhilox rnd(&philox);
+    std::vector<float> w_in(vocab_size * dims);
+    std::vector<float> w_out(vocab_size * dims);
+    for (float& v : w_in) v = rnd.RandFloat() - 0.5f;
+    for (float& v : w_out) v = rnd.RandFloat() - 0.5f;
+    const float lr = 0.1f;
+    const int batch_size = examples.size();
+    AddInputFromArray<float>(TensorShape({vocab_size, dims}), w_in);
+    AddInputFromArray<float>(TensorShape({vocab_size, dims}), w_out);
+    AddInputFromArray<int32>(TensorShape({batch_size}), examples);
+    AddInputFromArray<int32>(TensorShape({batch_size}), labels);
+    AddInputFromArray<float>(TensorShape({}), {lr});
+    TF_ASSERT_OK(RunOpKernel());
+
+    // The update NegTrain has always made, one example after the other.
+    std::vector<float> buf(dims);
+    for (int i = 0; i < batch_size; ++i) {
+      float* v_in = &w_in[examples[i] * dims];
+      float* v_out = &w_out[labels[i] * dims];
+      float dot = 0;
+      for (int d = 0; d < dims; ++d) dot += v_in[d] * v_out[d];
+      float g = 1.f / (std::exp(dot) + 1.f);
+      for (int d = 0; d < dims; ++d) {
+        buf[d] = v_out[d] * (g * lr);
+        v_out[d] += v_in[d] * (g * lr);
+      }
+      for (int j = 0; j < num_negative_samples; ++j) {
+        if (sample == labels[i]) continue;
+        float* v_sample = &w_out[sample * dims];
+        dot = 0;
+        for (int d = 0; d < dims; ++d) dot += v_in[d] * v_sample[d];
+        g = -1.f / (std::exp(-dot) + 1.f);
+        for (int d = 0; d < dims; ++d) {
+          buf[d] += v_sample[d] * (g * lr);
+          v_sample[d] += v_in[d] * (g * lr);
+        }
+      }
+      for (int d = 0; d < dims; ++d) v_in[d] += buf[d];
+    }
+
+    Tensor expected_w_in(allocator(), DT_FLOAT,
+                         TensorShape({vocab_size, dims}));
+    test::FillValues<float>(&expected_w_in, w_in);
+    test::ExpectTensorNear<float>(expected_w_in, *mutable_input(0).tensor,
+                                  1e-5);
+    Tensor expected_w_out(allocator(), DT_FLOAT,
+                          TensorShape({vocab_size, dims}));
+    test::FillValues<float>(&expected_w_out, w_out);
+    test::ExpectTensorNear<float>(expected_w_out, *mutable_input(1).tensor,
+                                  1e-5);
+  }
+
+ private:
+  std::unique_ptr<thread::ThreadPool> pool_;
+  DeviceBase::CpuWorkerThreads worker_threads_;
+};
+
+TEST_F(NegTrainOpTest, SerialMatchesReference) {
+  // Only word 1 has a nonzero count, so every negative sample is word 1 and
+  // the update does not depend on the random stream.  Examples repeat, so
+  // later examples see the updates of earlier ones.
+  MakeOp({0, 1, 0, 0, 0, 0}, 3, 1);
+  RunAndCheck(6, 16, {0, 2, 3, 0, 5, 2, 4, 0}, {2, 3, 4, 5, 0, 1, 3, 2}, 3,
+              1);
+}
+
+TEST_F(NegTrainOpTest, ParallelMatchesReferenceOnDisjointRows) {
+  // Examples touch disjoint rows and draw no negative samples, so the
+  // Hogwild shards do not interact and must give the serial result.
+  const int kBatchSize = 64;
+  const int kDims = 64;
+  std::vector<int32> vocab_count(2 * kBatchSize, 1);
+  std::vector<int32> examples;
+  std::vector<int32> labels;
+  for (int i = 0; i < kBatchSize; ++i) {
+    examples.push_back(i);
+    labels.push_back(kBatchSize + i);
+  }
+  PinWorkerThreads(4);
+  MakeOp(vocab_count, 0, 4);
+  RunAndCheck(2 * kBatchSize, kDims, examples, labels, 0, -1);
+}
+
+}  // namespace
+}  // namespace tensorflow
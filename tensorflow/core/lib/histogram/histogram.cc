@@ -244,6 +244,13 @@ void ThreadSafeHistogram::Add(double value) {
   histogram_.Add(value);
 }
 
+void ThreadSafeHistogram::AddN(gtl::ArraySlice<double> values) {
+  mutex_lock l(mu_);
+  for (double value : values) {
+    histogram_.Add(value);
+  }
+}
+
 void ThreadSafeHistogram::EncodeToProto(HistogramProto* proto,
                                         bool preserve_zero_buckets) const {
   mutex_lock l(mu_);
@@ -117,10 +117,11 @@ class ThreadSafeHistogram {
 
   void Clear();
 
-  // TODO(touts): It might be a good idea to provide a AddN(<many values>)
-  // method to avoid grabbing/releasing the lock when adding many values.
   void Add(double value);
 
+  // Adds all of "values" while holding the lock once.
+  void AddN(gtl::ArraySlice<double> values);
+
   void EncodeToProto(HistogramProto* proto, bool preserve_zero_buckets) const;
   double Median() const;
   double Percentile(double p) const;
@@ -149,5 +149,32 @@ TEST(ThreadSafeHistogram, Basic) {
   EXPECT_EQ(h.ToString(), tsh.ToString());
 }
 
+TEST(ThreadSafeHistogram, AddN) {
+  Histogram h;
+  for (int i = 0; i < 100; i++) {
+    h.Add(i);
+  }
+
+  // Adding the values in batches, including an empty one, gives the same
+  // histogram as adding them one at a time.
+  ThreadSafeHistogram tsh;
+  std::vector<double> values;
+  for (int i = 0; i < 50; i++) {
+    values.push_back(i);
+  }
+  tsh.AddN(values);
+  tsh.AddN({});
+  values.clear();
+  for (int i = 50; i < 100; i++) {
+    values.push_back(i);
+  }
+  tsh.AddN(values);
+
+  EXPECT_EQ(h.Median(), tsh.Median());
+  EXPECT_EQ(h.Average(), tsh.Average());
+  EXPECT_EQ(h.StandardDeviation(), tsh.StandardDeviation());
+  EXPECT_EQ(h.ToString(), tsh.ToString());
+}
+
 }  // namespace histogram
 }  // namespace tensorflow
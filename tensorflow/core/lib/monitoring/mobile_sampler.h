@@ -19,6 +19,7 @@ limitations under the License.
 #define THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_MOBILE_SAMPLER_H_
 
 #include "tensorflow/core/framework/summary.pb.h"
+#include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
 
@@ -32,6 +33,7 @@ class SamplerCell {
   ~SamplerCell() {}
 
   void Add(double value) {}
+  void AddN(gtl::ArraySlice<double> values) {}
   HistogramProto value() const { return HistogramProto(); }
 
  private:
@@ -27,6 +27,7 @@ limitations under the License.
 #include <map>
 
 #include "tensorflow/core/framework/summary.pb.h"
+#include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/histogram/histogram.h"
 #include "tensorflow/core/lib/monitoring/collection_registry.h"
 #include "tensorflow/core/lib/monitoring/metric_def.h"
@@ -56,6 +57,10 @@ class SamplerCell {
   // Atomically adds a sample.
   void Add(double sample);
 
+  // Atomically adds all of "samples", which is cheaper than adding them one
+  // at a time.
+  void AddN(gtl::ArraySlice<double> samples);
+
   // Returns the current histogram value as a proto.
   HistogramProto value() const;
 
@@ -152,6 +157,10 @@ class Sampler {
 
 inline void SamplerCell::Add(const double sample) { histogram_.Add(sample); }
 
+inline void SamplerCell::AddN(gtl::ArraySlice<double> samples) {
+  histogram_.AddN(samples);
+}
+
 inline HistogramProto SamplerCell::value() const {
   HistogramProto pb;
   histogram_.EncodeToProto(&pb, true /* preserve_zero_buckets */);
@@ -0,0 +1,123 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/monitoring/text_exporter.h"
+
+#include <float.h>
+
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace monitoring {
+
+namespace {
+
+string ExportedName(const string& metric_name) {
+  string name = metric_name;
+  if (!name.empty() && name[0] == '/') name.erase(0, 1);
+  for (char& c : name) {
+    if (c == '/' || c == '-') c = '_';
+  }
+  return name;
+}
+
+// Escapes the characters that may not appear as is in the text format.
+string Escape(const string& text) {
+  string escaped;
+  for (char c : text) {
+    switch (c) {
+      case '\\':
+        escaped += "\\\\";
+        break;
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\n':
+        escaped += "\\n";
+        break;
+      default:
+        escaped += c;
+    }
+  }
+  return escaped;
+}
+
+// Returns the labels of "point", followed by "extra_label" if it is not
+// empty, in braces, or an empty string if there are none.
+string Labels(const Point& point, const string& extra_label) {
+  string labels;
+  for (const Point::Label& label : point.labels) {
+    strings::StrAppend(&labels, labels.empty() ? "" : ",", label.name, "=\"",
+                       Escape(label.value), "\"");
+  }
+  if (!extra_label.empty()) {
+    strings::StrAppend(&labels, labels.empty() ? "" : ",", extra_label);
+  }
+  return labels.empty() ? labels : strings::StrCat("{", labels, "}");
+}
+
+const char* TypeName(const MetricDescriptor& descriptor) {
+  if (descriptor.value_type == ValueType::kHistogram) return "histogram";
+  return descriptor.metric_kind == MetricKind::kGauge ? "gauge" : "counter";
+}
+
+void AppendHistogram(const string& name, const Point& point, string* out) {
+  const HistogramProto& histogram = point.histogram_value;
+  double cumulative = 0;
+  for (int i = 0; i < histogram.bucket_size(); ++i) {
+    cumulative += histogram.bucket(i);
+    const double limit =
+        i < histogram.bucket_limit_size() ? histogram.bucket_limit(i) : DBL_MAX;
+    const string le = limit == DBL_MAX ? string("+Inf")
+                                       : strings::StrCat(limit);
+    strings::StrAppend(out, name, "_bucket",
+                       Labels(point, strings::StrCat("le=\"", le, "\"")), " ",
+                       cumulative, "\n");
+  }
+  strings::StrAppend(out, name, "_sum", Labels(point, ""), " ",
+                     histogram.sum(), "\n");
+  strings::StrAppend(out, name, "_count", Labels(point, ""), " ",
+                     histogram.num(), "\n");
+}
+
+}  // namespace
+
+string ExportMetricsAsText(const CollectedMetrics& metrics) {
+  string out;
+  for (const auto& name_and_points : metrics.point_set_map) {
+    const string name = ExportedName(name_and_points.first);
+    const auto descriptor =
+        metrics.metric_descriptor_map.find(name_and_points.first);
+    if (descriptor != metrics.metric_descriptor_map.end()) {
+      strings::StrAppend(&out, "# HELP ", name, " ",
+                         Escape(descriptor->second->description), "\n");
+      strings::StrAppend(&out, "# TYPE ", name, " ",
+                         TypeName(*descriptor->second), "\n");
+    }
+    for (const std::unique_ptr<Point>& point :
+         name_and_points.second->points) {
+      if (point->value_type == ValueType::kHistogram) {
+        AppendHistogram(name, *point, &out);
+      } else {
+        strings::StrAppend(&out, name, Labels(*point, ""), " ",
+                           point->int64_value, "\n");
+      }
+    }
+  }
+  return out;
+}
+
+}  // namespace monitoring
+}  // namespace tensorflow
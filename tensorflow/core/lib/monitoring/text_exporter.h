@@ -0,0 +1,40 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_TEXT_EXPORTER_H_
+#define THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_TEXT_EXPORTER_H_
+
+#include "tensorflow/core/lib/monitoring/collected_metrics.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace monitoring {
+
+// Returns "metrics" in the Prometheus text exposition format, so that a
+// process can serve them to a scraper. Metric names are turned into valid
+// Prometheus names by dropping the leading '/' and replacing the others by
+// '_', e.g. /tensorflow/core/op_latency_usecs becomes
+// tensorflow_core_op_latency_usecs. Histograms are exported as cumulative
+// buckets, with a count and a sum.
+//
+// Example:
+//   const string text = ExportMetricsAsText(
+//       *CollectionRegistry::Default()->CollectMetrics({}));
+string ExportMetricsAsText(const CollectedMetrics& metrics);
+
+}  // namespace monitoring
+}  // namespace tensorflow
+
+#endif  // THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_TEXT_EXPORTER_H_
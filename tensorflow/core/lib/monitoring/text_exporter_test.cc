@@ -0,0 +1,98 @@
+/* Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/monitoring/text_exporter.h"
+
+#include <float.h>
+
+#include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace monitoring {
+namespace {
+
+// Adds a metric named "name" with a single label "op" to "metrics".
+PointSet* AddMetric(const string& name, MetricKind kind, ValueType type,
+                    CollectedMetrics* metrics) {
+  MetricDescriptor* descriptor = new MetricDescriptor;
+  descriptor->name = name;
+  descriptor->description = "A \"test\" metric.";
+  descriptor->label_names = {"op"};
+  descriptor->metric_kind = kind;
+  descriptor->value_type = type;
+  metrics->metric_descriptor_map[name].reset(descriptor);
+  PointSet* point_set = new PointSet;
+  point_set->metric_name = name;
+  metrics->point_set_map[name].reset(point_set);
+  return point_set;
+}
+
+Point* AddPoint(const string& op, ValueType type, PointSet* point_set) {
+  Point* point = new Point;
+  point->labels.push_back({"op", op});
+  point->value_type = type;
+  point_set->points.emplace_back(point);
+  return point;
+}
+
+TEST(TextExporterTest, Empty) {
+  EXPECT_EQ("", ExportMetricsAsText(CollectedMetrics()));
+}
+
+TEST(TextExporterTest, Counter) {
+  CollectedMetrics metrics;
+  PointSet* point_set =
+      AddMetric("/tensorflow/test/op_count", MetricKind::kCumulative,
+                ValueType::kInt64, &metrics);
+  AddPoint("MatMul", ValueType::kInt64, point_set)->int64_value = 42;
+  AddPoint("a\"b", ValueType::kInt64, point_set)->int64_value = 7;
+
+  EXPECT_EQ(
+      "# HELP tensorflow_test_op_count A \\\"test\\\" metric.\n"
+      "# TYPE tensorflow_test_op_count counter\n"
+      "tensorflow_test_op_count{op=\"MatMul\"} 42\n"
+      "tensorflow_test_op_count{op=\"a\\\"b\"} 7\n",
+      ExportMetricsAsText(metrics));
+}
+
+TEST(TextExporterTest, Histogram) {
+  CollectedMetrics metrics;
+  PointSet* point_set =
+      AddMetric("/tensorflow/test/op_latency", MetricKind::kCumulative,
+                ValueType::kHistogram, &metrics);
+  histogram::Histogram histogram({10.0, 20.0, DBL_MAX});
+  histogram.Add(5);
+  histogram.Add(15);
+  histogram.Add(16);
+  histogram.Add(100);
+  histogram.EncodeToProto(
+      &AddPoint("MatMul", ValueType::kHistogram, point_set)->histogram_value,
+      true /* preserve_zero_buckets */);
+
+  EXPECT_EQ(
+      "# HELP tensorflow_test_op_latency A \\\"test\\\" metric.\n"
+      "# TYPE tensorflow_test_op_latency histogram\n"
+      "tensorflow_test_op_latency_bucket{op=\"MatMul\",le=\"10\"} 1\n"
+      "tensorflow_test_op_latency_bucket{op=\"MatMul\",le=\"20\"} 3\n"
+      "tensorflow_test_op_latency_bucket{op=\"MatMul\",le=\"+Inf\"} 4\n"
+      "tensorflow_test_op_latency_sum{op=\"MatMul\"} 136\n"
+      "tensorflow_test_op_latency_count{op=\"MatMul\"} 4\n",
+      ExportMetricsAsText(metrics));
+}
+
+}  // namespace
+}  // namespace monitoring
+}  // namespace tensorflow
@@ -139,6 +139,8 @@ REGISTER_OP("CTCBeamSearchDecoder")
     .Attr("beam_width: int >= 1")
     .Attr("top_paths: int >= 1")
     .Attr("merge_repeated: bool = true")
+    .Attr("label_selection_size: int >= 0 = 0")
+    .Attr("label_selection_margin: float = -1")
     .Output("decoded_indices: top_paths * int64")
     .Output("decoded_values: top_paths * int64")
     .Output("decoded_shape: top_paths * int64")
@@ -187,6 +189,12 @@ sequence_length: A vector containing sequence lengths, size `(batch)`.
 beam_width: A scalar >= 0 (beam search beam width).
 top_paths: A scalar >= 0, <= beam_width (controls output size).
 merge_repeated: If true, merge repeated classes in output.
+label_selection_size: If positive, at each time step only the
+  `label_selection_size` labels with the highest logits are considered for
+  extending a beam.  0 considers all labels.
+label_selection_margin: If non-negative, at each time step labels whose
+  logit is more than `label_selection_margin` below the best label's are not
+  considered for extending a beam.  -1 disables the margin.
 decoded_indices: A list (length: top_paths) of indices matrices.  Matrix j,
   size `(total_decoded_outputs[j] x 2)`, has indices of a
   `SparseTensor<int64, 2>`.  The rows store: [batch, time].
@@ -1004,4 +1004,52 @@ selected_indices: A 1-D integer tensor of shape `[M]` representing the selected
   indices from the boxes tensor, where `M <= max_output_size`.
 )doc");
 
+REGISTER_OP("BatchNonMaxSuppression")
+    .Input("boxes: float")
+    .Input("scores: float")
+    .Input("max_output_size: int32")
+    .Output("selected_indices: int32")
+    .Output("valid_outputs: int32")
+    .Attr("iou_threshold: float = 0.5")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle boxes;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 3, &boxes));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(c->WithValue(c->Dim(boxes, 2), 4, &unused));
+      ShapeHandle scores;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &scores));
+      ShapeHandle batch_and_boxes;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Matrix(c->Dim(boxes, 0), c->Dim(boxes, 1)), scores,
+                   &batch_and_boxes));
+      ShapeHandle unused_shape;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused_shape));
+      DimensionHandle max_output_size;
+      TF_RETURN_IF_ERROR(c->MakeDimForScalarInput(2, &max_output_size));
+      DimensionHandle batch_size = c->Dim(batch_and_boxes, 0);
+      c->set_output(0, c->Matrix(batch_size, max_output_size));
+      c->set_output(1, c->Vector(batch_size));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Runs NonMaxSuppression on each image of a batch.
+
+The images are processed in parallel.  Each row of `selected_indices` holds
+the indices selected for one image, as NonMaxSuppression would return them,
+followed by zeros up to `max_output_size`; `valid_outputs` says how many of
+them are valid.
+
+boxes: A 3-D float tensor of shape `[batch_size, num_boxes, 4]`.
+scores: A 2-D float tensor of shape `[batch_size, num_boxes]` representing a
+  single score corresponding to each box.
+max_output_size: A scalar integer tensor representing the maximum number of
+  boxes to be selected by non max suppression for each image.
+iou_threshold: A float representing the threshold for deciding whether boxes
+  overlap too much with respect to IOU.
+selected_indices: A 2-D integer tensor of shape `[batch_size, max_output_size]`
+  representing the selected indices into the boxes of each image.
+valid_outputs: A 1-D integer tensor of shape `[batch_size]` holding the number
+  of valid indices in each row of `selected_indices`.
+)doc");
+
 }  // namespace tensorflow
@@ -2333,4 +2333,31 @@ output_max: the computed max output.
 
 )doc");
 
+// --------------------------------------------------------------------------
+
+REGISTER_OP("_FusedElementwise")
+    .Input("inputs: N * T")
+    .Output("y: T")
+    .Attr("T: {float, double}")
+    .Attr("N: int >= 1")
+    .Attr("ops: list(string) >= 1")
+    .Attr("operands: list(int) >= 1")
+    .Attr("swap: list(bool) >= 1")
+    .SetShapeFn(shape_inference::UnknownShape)
+    .Doc(R"doc(
+Evaluates a chain of elementwise ops in a single pass over memory.
+
+Internal op inserted by the elementwise fusion graph pass.  The accumulator
+starts as `inputs[0]` and step `i` updates it with `ops[i]`.  Unary steps have
+`operands[i] == -1`; binary steps compute `ops[i](acc, inputs[operands[i]])`,
+or `ops[i](inputs[operands[i]], acc)` when `swap[i]` is true.  All inputs are
+broadcast to a common shape.
+
+inputs: The tensors read by the chain.
+y: The value of the last op in the chain.
+ops: Op names of the chain, in evaluation order.
+operands: Input index of the second operand of each step, or -1.
+swap: Whether the accumulator is the right-hand operand of each step.
+)doc");
+
 }  // namespace tensorflow
@@ -34,6 +34,7 @@ REGISTER_OP("Skipgram")
     .Attr("window_size: int = 5")
     .Attr("min_count: int = 5")
     .Attr("subsample: float = 1e-3")
+    .Attr("num_threads: int >= 1 = 1")
     .Doc(R"doc(
 Parses a text file and creates a batch of examples.
 
@@ -51,6 +52,9 @@ min_count: The minimum number of word occurrences for it to be included in the
     vocabulary.
 subsample: Threshold for word occurrence. Words that appear with higher
     frequency will be randomly down-sampled. Set to 0 to disable.
+num_threads: The number of parts the corpus is split into.  Each part is read by
+    its own cursor with its own random stream, and the cursors fill a batch in
+    parallel.
 )doc");
 
 REGISTER_OP("NegTrain")
@@ -65,6 +69,7 @@ REGISTER_OP("NegTrain")
     .SetIsStateful()
     .Attr("vocab_count: list(int)")
     .Attr("num_negative_samples: int")
+    .Attr("num_threads: int >= 1 = 1")
     .Doc(R"doc(
 Training via negative sampling.
 
@@ -74,6 +79,9 @@ examples: A vector of word ids.
 labels: A vector of word ids.
 vocab_count: Count of words in the vocabulary.
 num_negative_samples: Number of negative samples per example.
+num_threads: The maximum number of threads a batch is trained on.  With more
+    than one thread, examples are trained in parallel and update the
+    embeddings without locking (Hogwild).
 )doc");
 
 }  // end namespace tensorflow
@@ -17,9 +17,11 @@ limitations under the License.
 #define TENSORFLOW_CORE_UTIL_CTC_CTC_BEAM_ENTRY_H_
 
 #include <algorithm>
+#include <memory>
 #include <vector>
 
 #include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
@@ -50,36 +52,40 @@ struct BeamProbability {
   float label;
 };
 
+template <class CTCBeamState>
+class BeamEntryArena;
+
 template <class CTCBeamState = EmptyBeamState>
 struct BeamEntry {
-  // Default constructor does not create a vector of children.
   BeamEntry() : parent(nullptr), label(-1) {}
-  // Constructor giving parent, label, and number of children does
-  // create a vector of children.  The object pointed to by p
-  // cannot be copied and should not be moved, otherwise parent will
-  // become invalid.
-  BeamEntry(BeamEntry* p, int l, int L, int t) : parent(p), label(l) {
-    PopulateChildren(L);
+  // Reinitializes the entry as child 'l' of 'p'.  Entries are recycled by
+  // BeamEntryArena, so this is what takes the place of a constructor.
+  void Reset(BeamEntry* p, int l) {
+    parent = p;
+    label = l;
+    children = gtl::MutableArraySlice<BeamEntry>();
+    oldp.Reset();
+    newp.Reset();
+    state = CTCBeamState();
   }
   inline bool Active() const { return newp.total != kLogZero; }
   inline bool HasChildren() const { return !children.empty(); }
-  void PopulateChildren(int L) {
+  // Allocates the L children of this entry as one contiguous run of 'arena'.
+  // The children point back at this entry, which therefore cannot be copied
+  // or moved while they are alive.
+  void PopulateChildren(int L, BeamEntryArena<CTCBeamState>* arena) {
     CHECK(!HasChildren());
-    children = std::vector<BeamEntry>(L);
-    int ci = 0;
-    for (auto& c : children) {
-      // The current object cannot be copied, and should not be moved.
-      // Otherwise the child's parent will become invalid.
-      c.parent = this;
-      c.label = ci;
-      ++ci;
+    BeamEntry* c = arena->Allocate(L);
+    for (int ci = 0; ci < L; ++ci) {
+      c[ci].Reset(this, ci);
     }
+    children = gtl::MutableArraySlice<BeamEntry>(c, L);
   }
-  inline std::vector<BeamEntry>* Children() {
+  inline gtl::MutableArraySlice<BeamEntry>* Children() {
     CHECK(HasChildren());
     return &children;
   }
-  inline const std::vector<BeamEntry>* Children() const {
+  inline const gtl::MutableArraySlice<BeamEntry>* Children() const {
     CHECK(HasChildren());
     return &children;
   }
@@ -100,7 +106,7 @@ struct BeamEntry {
 
   BeamEntry<CTCBeamState>* parent;
   int label;
-  std::vector<BeamEntry<CTCBeamState>> children;
+  gtl::MutableArraySlice<BeamEntry<CTCBeamState>> children;
   BeamProbability oldp;
   BeamProbability newp;
   CTCBeamState state;
@@ -109,6 +115,55 @@ struct BeamEntry {
   TF_DISALLOW_COPY_AND_ASSIGN(BeamEntry);
 };
 
+// Owns the BeamEntry nodes of a beam search.  Entries are handed out in
+// contiguous runs from large blocks instead of one heap allocation per
+// expanded node, and Reset() recycles all of them at once, so a decoder that
+// is reused across sequences stops allocating once its blocks are warm.
+template <class CTCBeamState = EmptyBeamState>
+class BeamEntryArena {
+ public:
+  typedef BeamEntry<CTCBeamState> Entry;
+
+  BeamEntryArena() {}
+
+  // Returns 'n' contiguous entries.  Recycled entries keep stale contents;
+  // callers must Reset() each of them.
+  Entry* Allocate(int n) {
+    while (block_ < blocks_.size() && used_ + n > blocks_[block_].size) {
+      ++block_;
+      used_ = 0;
+    }
+    if (block_ == blocks_.size()) {
+      const size_t size = n > kMinBlockEntries ? n : kMinBlockEntries;
+      blocks_.push_back({std::unique_ptr<Entry[]>(new Entry[size]), size});
+      used_ = 0;
+    }
+    Entry* entries = blocks_[block_].entries.get() + used_;
+    used_ += n;
+    return entries;
+  }
+
+  // Makes all entries available again.  Pointers returned by Allocate()
+  // must not be used afterwards.
+  void Reset() {
+    block_ = 0;
+    used_ = 0;
+  }
+
+ private:
+  static constexpr int kMinBlockEntries = 4096;
+
+  struct Block {
+    std::unique_ptr<Entry[]> entries;
+    size_t size;
+  };
+  std::vector<Block> blocks_;
+  size_t block_ = 0;  // Block currently being filled.
+  size_t used_ = 0;   // Entries of blocks_[block_] already handed out.
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BeamEntryArena);
+};
+
 // BeamComparer is the default beam comparer provided in CTCBeamSearch.
 template <class CTCBeamState = EmptyBeamState>
 class BeamComparer {
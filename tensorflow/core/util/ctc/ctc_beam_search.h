@@ -18,6 +18,7 @@ limitations under the License.
 
 #include <cmath>
 #include <memory>
+#include <vector>
 
 #include "third_party/eigen3/Eigen/Core"
 #include "tensorflow/core/lib/gtl/top_n.h"
@@ -136,9 +137,17 @@ class CTCBeamSearchDecoder : public CTCDecoder {
   float label_selection_margin_ = -1;  // -1 means unlimited.
 
   gtl::TopN<BeamEntry*, CTCBeamComparer> leaves_;
-  std::unique_ptr<BeamEntry> beam_root_;
+  // All beam entries live in arena_; beam_root_ and its descendants are
+  // recycled by Reset().
+  ctc_beam_search::BeamEntryArena<CTCBeamState> arena_;
+  BeamEntry* beam_root_ = nullptr;
   BaseBeamScorer<CTCBeamState>* beam_scorer_;
 
+  // Scratch space reused by Step() across time steps.
+  Eigen::ArrayXf input_;
+  std::vector<float> label_selection_scratch_;
+  std::vector<BeamEntry*> branches_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(CTCBeamSearchDecoder);
 };
 
@@ -189,14 +198,16 @@ template <typename CTCBeamState, typename CTCBeamComparer>
 template <typename Vector>
 void CTCBeamSearchDecoder<CTCBeamState, CTCBeamComparer>::Step(
     const Vector& raw_input) {
-  Eigen::ArrayXf input = raw_input;
+  input_ = raw_input;
+  Eigen::ArrayXf& input = input_;
   // Remove the max for stability when performing log-prob calculations.
   input -= input.maxCoeff();
 
   // Minimum allowed input value for label selection:
   float label_selection_input_min = -std::numeric_limits<float>::infinity();
   if (label_selection_size_ > 0 && label_selection_size_ < input.size()) {
-    std::vector<float> input_copy(input.data(), input.data() + input.size());
+    std::vector<float>& input_copy = label_selection_scratch_;
+    input_copy.assign(input.data(), input.data() + input.size());
     std::nth_element(input_copy.begin(),
                      input_copy.begin() + label_selection_size_ - 1,
                      input_copy.end(), [](float a, float b) { return a > b; });
@@ -211,15 +222,16 @@ void CTCBeamSearchDecoder<CTCBeamState, CTCBeamComparer>::Step(
   // Extract the beams sorted in decreasing new probability
   CHECK_EQ(num_classes_, input.size());
 
-  std::unique_ptr<std::vector<BeamEntry*>> branches(leaves_.Extract());
+  std::vector<BeamEntry*>& branches = branches_;
+  leaves_.ExtractNondestructive(&branches);
   leaves_.Reset();
 
-  for (BeamEntry* b : *branches) {
+  for (BeamEntry* b : branches) {
     // P(.. @ t) becomes the new P(.. @ t-1)
     b->oldp = b->newp;
   }
 
-  for (BeamEntry* b : *branches) {
+  for (BeamEntry* b : branches) {
     if (b->parent != nullptr) {  // if not the root
       if (b->parent->Active()) {
         // If last two sequence characters are identical:
@@ -253,7 +265,7 @@ void CTCBeamSearchDecoder<CTCBeamState, CTCBeamComparer>::Step(
   // originally in descending newp order and we copied newp to oldp.
 
   // Grow new leaves
-  for (BeamEntry* b : *branches) {
+  for (BeamEntry* b : branches) {
     // A new leaf (represented by its BeamProbability) is a candidate
     // iff its total probability is nonzero and either the beam list
     // isn't full, or the lowest probability entry in the beam has a
@@ -269,7 +281,7 @@ void CTCBeamSearchDecoder<CTCBeamState, CTCBeamComparer>::Step(
     }
 
     if (!b->HasChildren()) {
-      b->PopulateChildren(num_classes_ - 1);
+      b->PopulateChildren(num_classes_ - 1, &arena_);
     }
 
     for (BeamEntry& c : *b->Children()) {
@@ -316,12 +328,15 @@ void CTCBeamSearchDecoder<CTCBeamState, CTCBeamComparer>::Reset() {
 
   // This beam root, and all of its children, will be in memory until
   // the next reset.
-  beam_root_.reset(new BeamEntry(nullptr, -1, num_classes_ - 1, -1));
+  arena_.Reset();
+  beam_root_ = arena_.Allocate(1);
+  beam_root_->Reset(nullptr, -1);
+  beam_root_->PopulateChildren(num_classes_ - 1, &arena_);
   beam_root_->newp.total = 0.0;  // ln(1)
   beam_root_->newp.blank = 0.0;  // ln(1)
 
   // Add the root as the initial leaf.
-  leaves_.push(beam_root_.get());
+  leaves_.push(beam_root_);
 
   // Call initialize state on the root object.
   beam_scorer_->InitializeState(&beam_root_->state);
@@ -299,4 +299,29 @@ TEST(CtcBeamSearch, LabelSelection) {
   }
 }
 
+TEST(CtcBeamSearch, BeamEntryArenaRecyclesEntries) {
+  typedef tensorflow::ctc::ctc_beam_search::BeamEntryArena<> Arena;
+  typedef Arena::Entry Entry;
+  Arena arena;
+  Entry* root = arena.Allocate(1);
+  root->Reset(nullptr, -1);
+  root->PopulateChildren(5, &arena);
+  ASSERT_TRUE(root->HasChildren());
+  EXPECT_EQ(root->Children()->size(), 5);
+  Entry* child = &(*root->Children())[3];
+  EXPECT_EQ(child->parent, root);
+  EXPECT_EQ(child->label, 3);
+  EXPECT_FALSE(child->Active());
+
+  // After a reset the same memory is handed out again, and Reset() clears
+  // whatever the previous search left behind.
+  child->newp.total = 0.0;
+  arena.Reset();
+  Entry* recycled = arena.Allocate(1);
+  EXPECT_EQ(recycled, root);
+  recycled->Reset(nullptr, -1);
+  EXPECT_FALSE(recycled->HasChildren());
+  EXPECT_FALSE(recycled->Active());
+}
+
 }  // namespace
@@ -64,6 +64,14 @@ class WhereOpTest(test.TestCase):
 
     self._testWhere(x, truth)
 
+  def testRandomLarge(self):
+    # Spans several of the blocks the CPU kernel counts and fills in parallel.
+    np.random.seed(7)
+    for shape in [(300001,), (371, 1013), (7, 151, 97), (3, 5, 7, 11, 131)]:
+      for p in [0.001, 0.5, 1.0]:
+        x = np.random.rand(*shape) < p
+        self._testWhere(x, np.argwhere(x))
+
   def testThreeArgument(self):
     x = np.array([[-2, 3, -1], [1, -3, -3]])
     np_val = np.where(x > 0, x * x, -x)
@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "tensorflow/tools/benchmark/benchmark_model.h"
 
+#include <atomic>
 #include <cstdlib>
 #include <memory>
 #include <string>
@@ -31,17 +32,22 @@ limitations under the License.
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/graph_constructor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/histogram/histogram.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/init_main.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/platform.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/util/command_line_flags.h"
 #include "tensorflow/core/util/reporter.h"
 #include "tensorflow/core/util/stat_summarizer.h"
+#include "tensorflow/core/util/test_log.pb.h"
 
 namespace tensorflow {
 namespace benchmark_model {
@@ -49,12 +55,22 @@ namespace benchmark_model {
 Status InitializeSession(int num_threads, const string& graph,
                          std::unique_ptr<Session>* session,
                          std::unique_ptr<GraphDef>* graph_def) {
+  return InitializeSession(-1, num_threads, graph, session, graph_def);
+}
+
+Status InitializeSession(int inter_op_threads, int intra_op_threads,
+                         const string& graph,
+                         std::unique_ptr<Session>* session,
+                         std::unique_ptr<GraphDef>* graph_def) {
   LOG(INFO) << "Loading TensorFlow.";
 
   tensorflow::SessionOptions options;
   tensorflow::ConfigProto& config = options.config;
-  if (num_threads > 0) {
-    config.set_intra_op_parallelism_threads(num_threads);
+  if (inter_op_threads > 0) {
+    config.set_inter_op_parallelism_threads(inter_op_threads);
+  }
+  if (intra_op_threads > 0) {
+    config.set_intra_op_parallelism_threads(intra_op_threads);
   }
   LOG(INFO) << "Got config, " << config.device_count_size() << " devices";
 
@@ -287,6 +303,175 @@ Status TimeMultipleRuns(double sleep_seconds, int num_runs,
   return Status::OK();
 }
 
+Status RunLoadTest(const LoadTestOptions& options,
+                   const std::vector<InputLayerInfo>& inputs,
+                   const std::vector<string>& outputs, Session* session,
+                   StatSummarizer* stats, LoadTestResult* result) {
+  if (options.num_clients < 1 || options.num_requests < 1) {
+    return errors::InvalidArgument(
+        "A load test needs at least one client and one request, got ",
+        options.num_clients, " clients and ", options.num_requests,
+        " requests");
+  }
+  std::vector<std::pair<string, tensorflow::Tensor> > input_tensors;
+  CreateTensorsFromInputInfo(inputs, &input_tensors);
+
+  LOG(INFO) << "Running load test with " << options.num_clients
+            << " clients, " << options.num_requests << " requests at "
+            << (options.target_qps > 0.0
+                    ? strings::StrCat(options.target_qps, " QPS")
+                    : string("maximum rate"));
+
+  // The default buckets grow by 10% each, so percentiles stay accurate to a
+  // few percent from microseconds up to minutes.
+  histogram::ThreadSafeHistogram latency_us;
+  std::atomic<int64> next_request(0);
+  mutex mu;
+  int64 num_errors = 0;
+  Status first_error;
+
+  Env* env = Env::Default();
+  const double interval_us =
+      options.target_qps > 0.0 ? 1000000.0 / options.target_qps : 0.0;
+  const int64 start_time = env->NowMicros();
+  auto client = [&]() {
+    for (int64 i = next_request++; i < options.num_requests;
+         i = next_request++) {
+      int64 arrival_time = env->NowMicros();
+      if (interval_us > 0.0) {
+        const int64 scheduled_time =
+            start_time + static_cast<int64>(i * interval_us);
+        if (scheduled_time > arrival_time) {
+          env->SleepForMicroseconds(scheduled_time - arrival_time);
+        }
+        arrival_time = scheduled_time;
+      }
+      const bool trace = stats != nullptr && options.trace_every_n > 0 &&
+                         i % options.trace_every_n == 0;
+      RunOptions run_options;
+      if (trace) {
+        run_options.set_trace_level(RunOptions::FULL_TRACE);
+      }
+      RunMetadata run_metadata;
+      std::vector<tensorflow::Tensor> output_tensors;
+      Status s = session->Run(run_options, input_tensors, outputs, {},
+                              &output_tensors, &run_metadata);
+      latency_us.Add(env->NowMicros() - arrival_time);
+
+      if (!s.ok() || trace) {
+        mutex_lock l(mu);
+        if (!s.ok()) {
+          ++num_errors;
+          if (first_error.ok()) first_error = s;
+        } else {
+          stats->ProcessStepStats(run_metadata.step_stats());
+        }
+      }
+    }
+  };
+  {
+    thread::ThreadPool clients(env, "load_test_client", options.num_clients);
+    for (int c = 0; c < options.num_clients; ++c) {
+      clients.Schedule(client);
+    }
+  }
+  const int64 end_time = env->NowMicros();
+
+  result->num_requests = options.num_requests;
+  result->num_errors = num_errors;
+  result->wall_time_seconds = (end_time - start_time) / 1000000.0;
+  result->achieved_qps = options.num_requests / result->wall_time_seconds;
+  result->mean_us = latency_us.Average();
+  result->p50_us = latency_us.Percentile(50.0);
+  result->p99_us = latency_us.Percentile(99.0);
+  result->p999_us = latency_us.Percentile(99.9);
+  result->max_us = latency_us.Percentile(100.0);
+
+  if (!first_error.ok()) {
+    LOG(ERROR) << num_errors << " of " << options.num_requests
+               << " requests failed, first with: " << first_error;
+  }
+  return first_error;
+}
+
+// Runs the load test once for every combination of inter-op and intra-op
+// thread pool sizes, each in a fresh session, and adds one entry per
+// combination to 'results'.  'idle_op_time_us' is the summed op time of an
+// unloaded run, against which op times under load are compared.
+Status RunLoadTestSweep(const string& graph,
+                        const std::vector<int32>& inter_op_threads,
+                        const std::vector<int32>& intra_op_threads,
+                        const LoadTestOptions& options, int warmup_runs,
+                        const std::vector<InputLayerInfo>& inputs,
+                        const std::vector<string>& outputs,
+                        const StatSummarizerOptions& stats_options,
+                        const string& benchmark_name, double idle_op_time_us,
+                        TestResults* results) {
+  const int64 input_bytes =
+      DataTypeSize(inputs[0].data_type) * inputs[0].shape.num_elements();
+  for (int32 inter_op : inter_op_threads) {
+    for (int32 intra_op : intra_op_threads) {
+      LOG(INFO) << "Load test with inter_op_parallelism_threads=" << inter_op
+                << ", intra_op_parallelism_threads=" << intra_op;
+      std::unique_ptr<Session> session;
+      std::unique_ptr<GraphDef> graph_def;
+      TF_RETURN_IF_ERROR(
+          InitializeSession(inter_op, intra_op, graph, &session, &graph_def));
+      if (warmup_runs > 0) {
+        int64 warmup_time_us;
+        TF_RETURN_IF_ERROR(TimeMultipleRuns(0.0, warmup_runs, inputs,
+                                            outputs, session.get(), nullptr,
+                                            &warmup_time_us));
+      }
+      StatSummarizer stats(stats_options);
+      LoadTestResult result;
+      TF_RETURN_IF_ERROR(RunLoadTest(options, inputs, outputs, session.get(),
+                                     &stats, &result));
+
+      LOG(INFO) << "Achieved " << result.achieved_qps << " QPS, latency in us:"
+                << " mean " << result.mean_us << ", p50 " << result.p50_us
+                << ", p99 " << result.p99_us << ", p99.9 " << result.p999_us
+                << ", max " << result.max_us;
+      // Op times of the traced requests show where the extra latency under
+      // load comes from: ops whose time grows relative to the unloaded run
+      // are the ones contending for threads or memory bandwidth.
+      double loaded_op_time_us = 0.0;
+      if (stats.num_runs() > 0) {
+        loaded_op_time_us = stats.run_total_us().avg();
+        LOG(INFO) << "Summed op time per request: " << loaded_op_time_us
+                  << " us under load vs. " << idle_op_time_us << " us idle";
+        LOG(INFO) << stats.GetStatsByMetric(
+            "Top by computation time under load", StatSummarizer::BY_TIME,
+            stats_options.time_limit);
+        LOG(INFO) << stats.GetStatsByNodeType();
+      }
+
+      BenchmarkEntry* entry = results->mutable_entries()->add_entry();
+      entry->set_name(strings::StrCat(benchmark_name, "/clients_",
+                                      options.num_clients, "/inter_op_",
+                                      inter_op, "/intra_op_", intra_op));
+      entry->set_iters(result.num_requests);
+      entry->set_wall_time(result.wall_time_seconds);
+      entry->set_throughput(input_bytes * result.num_requests /
+                            result.wall_time_seconds / (1024 * 1024));
+      auto& extras = *entry->mutable_extras();
+      extras["qps"].set_double_value(result.achieved_qps);
+      extras["target_qps"].set_double_value(options.target_qps);
+      extras["latency_mean_us"].set_double_value(result.mean_us);
+      extras["latency_p50_us"].set_double_value(result.p50_us);
+      extras["latency_p99_us"].set_double_value(result.p99_us);
+      extras["latency_p999_us"].set_double_value(result.p999_us);
+      extras["latency_max_us"].set_double_value(result.max_us);
+      extras["errors"].set_double_value(result.num_errors);
+      if (loaded_op_time_us > 0.0 && idle_op_time_us > 0.0) {
+        extras["op_time_under_load_ratio"].set_double_value(
+            loaded_op_time_us / idle_op_time_us);
+      }
+    }
+  }
+  return Status::OK();
+}
+
 int Main(int argc, char** argv) {
   string graph = "/data/local/tmp/tensorflow_inception_graph.pb";
   string input_layer_string = "input:0";
@@ -310,6 +495,12 @@ int Main(int argc, char** argv) {
   bool show_summary = true;
   bool show_flops = false;
   int warmup_runs = 2;
+  int num_clients = 0;
+  int load_num_requests = 1000;
+  string target_qps = "0";
+  string load_inter_op_threads = "";
+  string load_intra_op_threads = "";
+  int load_trace_every_n = 0;
 
   std::vector<Flag> flag_list = {
       Flag("graph", &graph, "graph file name"),
@@ -339,7 +530,22 @@ int Main(int argc, char** argv) {
            "whether to show a summary of the stats"),
       Flag("show_flops", &show_flops, "whether to estimate the model's FLOPs"),
       Flag("warmup_runs", &warmup_runs, "how many runs to initialize model"),
+      Flag("num_clients", &num_clients,
+           "number of concurrent clients for a load test; 0 skips it"),
+      Flag("load_num_requests", &load_num_requests,
+           "total number of requests in each load test"),
+      Flag("target_qps", &target_qps,
+           "request arrival rate of the load test; 0 sends as fast as the "
+           "clients can"),
+      Flag("load_inter_op_threads", &load_inter_op_threads,
+           "comma-separated inter-op thread pool sizes to sweep"),
+      Flag("load_intra_op_threads", &load_intra_op_threads,
+           "comma-separated intra-op thread pool sizes to sweep"),
+      Flag("load_trace_every_n", &load_trace_every_n,
+           "trace every n-th load test request for per-op stats; 0 disables"),
   };
+  // Kept for the load test report, since parsing removes the flags from argv.
+  const std::vector<string> arguments(argv, argv + argc);
   string usage = Flags::Usage(argv[0], flag_list);
   const bool parse_result = Flags::Parse(&argc, argv, flag_list);
 
@@ -390,6 +596,7 @@ int Main(int argc, char** argv) {
   LOG(INFO) << "Output prefix: [" << output_prefix << "]";
   LOG(INFO) << "Show sizes: [" << show_sizes << "]";
   LOG(INFO) << "Warmup runs: [" << warmup_runs << "]";
+  LOG(INFO) << "Load test clients: [" << num_clients << "]";
 
   std::unique_ptr<Session> session;
   std::unique_ptr<StatSummarizer> stats;
@@ -529,6 +736,52 @@ int Main(int argc, char** argv) {
     TF_QCHECK_OK(reporter.Close());
   }
 
+  if (num_clients > 0) {
+    std::vector<int32> inter_op_sweep = {-1};
+    std::vector<int32> intra_op_sweep = {num_threads};
+    if (!load_inter_op_threads.empty()) {
+      CHECK(str_util::SplitAndParseAsInts(load_inter_op_threads, ',',
+                                          &inter_op_sweep))
+          << "Incorrect thread counts specified: " << load_inter_op_threads;
+    }
+    if (!load_intra_op_threads.empty()) {
+      CHECK(str_util::SplitAndParseAsInts(load_intra_op_threads, ',',
+                                          &intra_op_sweep))
+          << "Incorrect thread counts specified: " << load_intra_op_threads;
+    }
+    LoadTestOptions load_options;
+    load_options.num_clients = num_clients;
+    load_options.num_requests = load_num_requests;
+    load_options.target_qps = std::strtod(target_qps.c_str(), nullptr);
+    load_options.trace_every_n = load_trace_every_n;
+
+    TestResults results;
+    results.set_target(graph);
+    results.set_name(benchmark_name);
+    results.set_start_time(Env::Default()->NowSeconds());
+    for (const string& argument : arguments) {
+      results.mutable_run_configuration()->add_argument(argument);
+    }
+    const int64 load_start_us = Env::Default()->NowMicros();
+    Status load_status = RunLoadTestSweep(
+        graph, inter_op_sweep, intra_op_sweep, load_options, warmup_runs,
+        inputs, output_layers, stats_options, benchmark_name,
+        stats->run_total_us().avg(), &results);
+    if (!load_status.ok()) {
+      LOG(ERROR) << "Load test failed with " << load_status;
+      return -1;
+    }
+    results.set_run_time((Env::Default()->NowMicros() - load_start_us) /
+                         1000000.0);
+
+    if (!benchmark_name.empty() && !output_prefix.empty()) {
+      const string fname = strings::StrCat(output_prefix, benchmark_name,
+                                           "_load_test");
+      TF_QCHECK_OK(WriteBinaryProto(Env::Default(), fname, results));
+      LOG(INFO) << "Wrote load test results to " << fname;
+    }
+  }
+
   return 0;
 }
 
@@ -30,11 +30,47 @@ struct InputLayerInfo {
   std::vector<float> initialization_values;
 };
 
+// Settings for RunLoadTest().
+struct LoadTestOptions {
+  // Number of client threads issuing requests concurrently.
+  int num_clients = 1;
+  // Total number of requests, shared between the clients.
+  int num_requests = 100;
+  // Requests arrive on a fixed schedule at this rate regardless of how fast
+  // earlier ones complete.  If <= 0, each client issues its next request as
+  // soon as the previous one returns.
+  double target_qps = 0.0;
+  // Traces every n-th request into the StatSummarizer; 0 disables tracing.
+  int trace_every_n = 0;
+};
+
+// Latencies observed by RunLoadTest(), in microseconds.  With a target QPS,
+// the latency of a request is measured from its scheduled arrival, so time
+// spent queued behind busy clients is included.
+struct LoadTestResult {
+  int64 num_requests = 0;
+  int64 num_errors = 0;
+  double wall_time_seconds = 0.0;
+  double achieved_qps = 0.0;
+  double mean_us = 0.0;
+  double p50_us = 0.0;
+  double p99_us = 0.0;
+  double p999_us = 0.0;
+  double max_us = 0.0;
+};
+
 // Loads a model from disk into a new session.
 Status InitializeSession(int num_threads, const string& graph,
                          std::unique_ptr<Session>* session,
                          std::unique_ptr<GraphDef>* graph_def);
 
+// As above, but also sets the size of the inter-op thread pool.  A value <= 0
+// leaves the corresponding pool at its default size.
+Status InitializeSession(int inter_op_threads, int intra_op_threads,
+                         const string& graph,
+                         std::unique_ptr<Session>* session,
+                         std::unique_ptr<GraphDef>* graph_def);
+
 // Does a single run of the model that's been loaded into the given session.
 Status RunBenchmark(const std::vector<InputLayerInfo>& inputs,
                     const std::vector<string>& outputs, Session* session,
@@ -46,6 +82,13 @@ Status TimeMultipleRuns(double sleep_seconds, int num_runs,
                         const std::vector<string>& outputs, Session* session,
                         StatSummarizer* stats, int64* total_time_us);
 
+// Runs the model from several client threads at once, as a serving system
+// would, and records the latency distribution.  'stats' may be null.
+Status RunLoadTest(const LoadTestOptions& options,
+                   const std::vector<InputLayerInfo>& inputs,
+                   const std::vector<string>& outputs, Session* session,
+                   StatSummarizer* stats, LoadTestResult* result);
+
 // Handles all setup and argument parsing.
 int Main(int argc, char** argv);
 
@@ -26,16 +26,18 @@ limitations under the License.
 namespace tensorflow {
 namespace {
 
-TEST(BenchmarkModelTest, InitializeAndRun) {
+// Writes a graph multiplying a placeholder by a constant to a file, and fills
+// in how to feed and fetch it.
+void CreateTestGraph(benchmark_model::InputLayerInfo* input,
+                     string* output_name, string* filename_pb) {
   const string dir = testing::TmpDir();
-  const string filename_pb = io::JoinPath(dir, "graphdef.pb");
+  *filename_pb = io::JoinPath(dir, "graphdef.pb");
 
   // Create a simple graph and write it to filename_pb.
   const int input_width = 400;
   const int input_height = 10;
-  benchmark_model::InputLayerInfo input;
-  input.shape = TensorShape({input_width, input_height});
-  input.data_type = DT_FLOAT;
+  input->shape = TensorShape({input_width, input_height});
+  input->data_type = DT_FLOAT;
   const TensorShape constant_shape({input_height, input_width});
 
   Tensor constant_tensor(DT_FLOAT, constant_shape);
@@ -43,17 +45,24 @@ TEST(BenchmarkModelTest, InitializeAndRun) {
 
   auto root = Scope::NewRootScope().ExitOnError();
   auto placeholder =
-      ops::Placeholder(root, DT_FLOAT, ops::Placeholder::Shape(input.shape));
-  input.name = placeholder.node()->name();
+      ops::Placeholder(root, DT_FLOAT, ops::Placeholder::Shape(input->shape));
+  input->name = placeholder.node()->name();
   auto m = ops::MatMul(root, placeholder, constant_tensor);
-  const string output_name = m.node()->name();
+  *output_name = m.node()->name();
 
   GraphDef graph_def;
   TF_ASSERT_OK(root.ToGraphDef(&graph_def));
   string graph_def_serialized;
   graph_def.SerializeToString(&graph_def_serialized);
   TF_ASSERT_OK(
-      WriteStringToFile(Env::Default(), filename_pb, graph_def_serialized));
+      WriteStringToFile(Env::Default(), *filename_pb, graph_def_serialized));
+}
+
+TEST(BenchmarkModelTest, InitializeAndRun) {
+  benchmark_model::InputLayerInfo input;
+  string output_name;
+  string filename_pb;
+  CreateTestGraph(&input, &output_name, &filename_pb);
 
   std::unique_ptr<Session> session;
   std::unique_ptr<GraphDef> loaded_graph_def;
@@ -66,5 +75,38 @@ TEST(BenchmarkModelTest, InitializeAndRun) {
       0.0, 10, {input}, {output_name}, session.get(), stats.get(), &time));
 }
 
+TEST(BenchmarkModelTest, LoadTest) {
+  benchmark_model::InputLayerInfo input;
+  string output_name;
+  string filename_pb;
+  CreateTestGraph(&input, &output_name, &filename_pb);
+
+  std::unique_ptr<Session> session;
+  std::unique_ptr<GraphDef> loaded_graph_def;
+  TF_ASSERT_OK(benchmark_model::InitializeSession(2, 2, filename_pb, &session,
+                                                  &loaded_graph_def));
+  StatSummarizer stats((StatSummarizerOptions()));
+  benchmark_model::LoadTestOptions options;
+  options.num_clients = 4;
+  options.num_requests = 40;
+  options.target_qps = 2000.0;
+  options.trace_every_n = 10;
+  benchmark_model::LoadTestResult result;
+  TF_ASSERT_OK(benchmark_model::RunLoadTest(options, {input}, {output_name},
+                                            session.get(), &stats, &result));
+  EXPECT_EQ(40, result.num_requests);
+  EXPECT_EQ(0, result.num_errors);
+  EXPECT_EQ(4, stats.num_runs());
+  EXPECT_GT(result.achieved_qps, 0.0);
+  EXPECT_LE(result.p50_us, result.p99_us);
+  EXPECT_LE(result.p99_us, result.p999_us);
+  EXPECT_LE(result.p999_us, result.max_us);
+
+  options.num_clients = 0;
+  EXPECT_FALSE(benchmark_model::RunLoadTest(options, {input}, {output_name},
+                                            session.get(), nullptr, &result)
+                   .ok());
+}
+
 }  // namespace
 }  // namespace tensorflow